@@ -72,6 +72,8 @@ uint32_t BSP_CdcPrintf(const char* format,...);
 uint32_t BSP_CdcGetNbRxAvailableBytes(uint8_t waitForNewLine);
 int8_t BSP_CdcGetNextRxByte(void);
 uint32_t BSP_CdcCopyNextRxBytes(uint8_t *buff, uint32_t maxlen);
+uint32_t BSP_CdcGetNbRxLines(void);
+int32_t BSP_CdcCopyNextRxLine(uint8_t *buff, uint32_t maxlen);
 uint8_t BSP_CdcIsTxOnGoing(void);
 void BSP_CdcLockingTx(uint8_t *pBuf, uint8_t nbData);
 #ifdef __cplusplus
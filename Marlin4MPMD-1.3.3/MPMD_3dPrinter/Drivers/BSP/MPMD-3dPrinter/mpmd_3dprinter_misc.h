@@ -46,6 +46,7 @@
 
 /* Includes ------------------------------------------------------------------*/
 #include "stm32f0xx_hal.h"
+#include "Configuration_STM.h"
    
 /* Exported macros ------------------------------------------------------------*/
 
@@ -92,7 +93,9 @@
 
 /* Definition for FAN 0*/
 //TODO: remove unused fans
+#ifndef BSP_FAN_PWM_FREQ
 #define BSP_FAN_PWM_FREQ			(75) //Desired PWM frequency in hertz
+#endif
 
 #define BSP_FAN_E1_PIN              (GPIO_PIN_8)
 #define BSP_FAN_E1_PORT             (GPIOA)
@@ -101,6 +104,16 @@
 //#define BSP_FAN_E3_PIN              (GPIO_PIN_8)
 //#define BSP_FAN_E3_PORT             (GPIOA)
 
+/* Definition for the E1 fan PWM timer (FAN_TIMER_PWM) */
+/// Timer used for PWM_FAN_E1, PA8 is TIM1_CH1 (the PWM_HEAT_BED timer, unused by Marlin)
+#define BSP_MISC_TIMER_PWM_FAN_E1                   (TIM1)
+/// Channel Timer used for PWM_FAN_E1
+#define BSP_MISC_CHAN_TIMER_PWM_FAN_E1              (TIM_CHANNEL_1)
+/// Timer Clock Enable for PWM_FAN_E1
+#define __BSP_MISC_TIMER_PWM_FAN_E1_CLCK_ENABLE()   __TIM1_CLK_ENABLE()
+/// PWM_FAN_E1 GPIO alternate function
+#define BSP_MISC_AFx_TIMx_PWM_FAN_E1                (GPIO_AF2_TIM1)
+
 
 /* Definition for Servo 0*/
 //TODO: removed unused servo
@@ -123,6 +136,41 @@
 #define BSP_MISC_TICK_IRQn                    (TIM3_IRQn)
 #define BSP_MISC_TICK_IRQHandler			  (TIM3_IRQHandler)
    
+/* Definition for the step bursts of the Tick timer (STEP_BURST) */
+/// Frames (step events) in the circular buffers, refilled by halves
+#ifndef BSP_STEP_BURST_FRAMES
+#define BSP_STEP_BURST_FRAMES                 (16)
+#endif
+/// Step pulse width in Tick timer counts, 2 is 1.3us (the drivers need 1us)
+#define BSP_STEP_BURST_PULSE                  (2)
+/// Tick timer counts needed before the next step to fill its frame and start a burst
+#define BSP_STEP_BURST_LEAD                   (64)
+/// Port of the tower step pins, written through its BSRR
+#define BSP_STEP_BURST_PORT                   (GPIOB)
+/// BSRR set bits of the tower step pins, the reset bits are these << 16
+#define BSP_STEP_BURST_X                      (BSP_MOTOR_CONTROL_BOARD_PWM_X_PIN)
+#define BSP_STEP_BURST_Y                      (BSP_MOTOR_CONTROL_BOARD_PWM_Y_PIN)
+#define BSP_STEP_BURST_Z                      (BSP_MOTOR_CONTROL_BOARD_PWM_Z_PIN)
+/// E step pin number on its port (PA7 is TIM3_CH2), stepped by channel 2 of the Tick timer
+#define BSP_STEP_BURST_E_PORT                 (GPIOA)
+#define BSP_STEP_BURST_E_PIN_NUM              (7)
+#define BSP_STEP_BURST_E_AF                   (GPIO_AF1_TIM3)
+/// Timer writing the tower step pins, started by the Tick timer updates (PWM_HEAT_E1, unused by Marlin)
+#define BSP_STEP_BURST_TIMER                  (TIM15)
+/// Timer Clock Enable for the step bursts
+#define __BSP_STEP_BURST_TIMER_CLCK_ENABLE()  __TIM15_CLK_ENABLE()
+/// Internal trigger of BSP_STEP_BURST_TIMER from the Tick timer (TIM15 ITR1 is TIM3)
+#define BSP_STEP_BURST_TIMER_TS               (TIM_SMCR_TS_0)
+/// DMA channel of TIM3_CH1, the Tick timer registers of the next frame
+#define BSP_STEP_BURST_TICK_DMA               (DMA1_Channel4)
+/// DMA channel of TIM15, the tower step pin words
+#define BSP_STEP_BURST_PINS_DMA               (DMA1_Channel5)
+/// DMA flags of both channels
+#define BSP_STEP_BURST_DMA_FLAGS              (DMA_IFCR_CGIF4 | DMA_IFCR_CGIF5)
+/// DMA channels 4 and 5 global interrupt
+#define BSP_STEP_BURST_DMA_IRQn               (DMA1_Channel4_5_IRQn)
+#define BSP_STEP_BURST_DMA_IRQHandler         (DMA1_CH4_5_IRQHandler)
+
 /* Definition for Tick2 timer  (Marlin Only)*/
 /// Timer used for Tick2
 #define BSP_MISC_TIMER_TICK2                  (TIM14)
@@ -308,9 +356,34 @@
 #define TICK_TIMER_PRESCALER  (32) //48Mhz / 32 = 1.5Mhz
 
 #define EEPROM_ADDRESS		(FLASH_BASE+0x0001F800)
+//Settings store (Marlin/flash_store.h), the pages up to and with the EEPROM page.
+//One, the page LinkerScript.ld has always kept the program out of; with two a
+//full page is moved to the other rather than erased in place, but _RomLen must
+//then be 2K less, which the program has no room for
+#define SETTINGS_FLASH_PAGES	(1)
+#define SETTINGS_FLASH_ADDRESS	(EEPROM_ADDRESS+FLASH_PAGE_SIZE-SETTINGS_FLASH_PAGES*FLASH_PAGE_SIZE)
+
+/* Exported types ------------------------------------------------------------*/
+/// Step pins of a step burst frame, DMA to the BSRR of BSP_STEP_BURST_PORT
+typedef struct {
+  uint32_t set;     // as the frame starts, the tower step pins going up
+  uint32_t reset;   // BSP_STEP_BURST_PULSE later, the same pins down
+} BSP_StepBurstPins_t;
+
+/// Tick timer registers of the frame after a step burst frame, DMA to ARR..CCR2
+/// as the frame starts (they are preloaded, taken at its end)
+typedef struct {
+  uint16_t arr;     // period less one
+  uint16_t rcr;     // no repetition counter on the Tick timer, 0
+  uint16_t ccr1;    // 0 to interrupt as the frame starts and end the burst, else 0xFFFF
+  uint16_t ccr2;    // BSP_STEP_BURST_PULSE for an E step (PWM mode 1), else 0
+} BSP_StepBurstTimer_t;
+
 /* Exported constants --------------------------------------------------------*/
 extern GPIO_TypeDef* gArrayGpioPort[BSP_MISC_MAX_PIN_NUMBER];
 extern uint16_t gArrayGpioPin[BSP_MISC_MAX_PIN_NUMBER];
+extern BSP_StepBurstPins_t bspStepBurstPins[BSP_STEP_BURST_FRAMES];
+extern BSP_StepBurstTimer_t bspStepBurstTimer[BSP_STEP_BURST_FRAMES];
 /* Extern function -----------------------------------------------------------*/
 
 void BSP_MiscOverallInit(uint8_t nbDevices);
@@ -326,6 +399,10 @@ void BSP_MiscTickInit(void);
 void BSP_MiscTickSetFreq(uint32_t newFreq);
 void BSP_MiscTickSetPeriod(uint32_t newTimPeriod);
 void BSP_MiscTickStop(void);
+uint16_t BSP_MiscTickGetCounter(void);
+uint16_t BSP_MiscTickGetCompare(void);
+void BSP_MiscStepBurstStart(void);
+uint8_t BSP_MiscStepBurstStop(uint16_t count);
 void BSP_MiscTick2Init(void);
 void BSP_MiscTick2SetFreq(float newPeriod);
 void BSP_MiscTick2Stop(void);
@@ -339,10 +416,8 @@ void BSP_MotorControlBoard_ServoInit(void);
 void BSP_MotorControlBoard_ServoSetTimerValue(uint32_t value);
 void BSP_MotorControlBoard_ServoStop(void);
 void BSP_MiscUserGpioInit(uint8_t id, uint32_t mode, uint32_t pull);
-void BSP_MiscEEPROMErase();
-void BSP_MiscEEPROMWriteF32(void *destination, float value);
-void BSP_MiscEEPROMWriteU16(void *destination, uint16_t value);
-void BSP_MiscEEPROMWriteU32(void *destination, uint32_t value);
+uint8_t BSP_MiscFlashErase(void *page);
+uint8_t BSP_MiscFlashWrite(void *destination, const uint16_t *source, uint16_t count);
 
 #ifdef __cplusplus
 }
@@ -321,6 +321,7 @@ void BSP_MiscTickInit(void);
 void BSP_MiscTickSetFreq(uint32_t newFreq);
 void BSP_MiscTickSetPeriod(uint32_t newTimPeriod);
 void BSP_MiscTickStop(void);
+uint16_t BSP_MiscTickGetCounter(void);
 void BSP_MiscTick2Init(void);
 void BSP_MiscTick2SetFreq(float newPeriod);
 void BSP_MiscTick2Stop(void);
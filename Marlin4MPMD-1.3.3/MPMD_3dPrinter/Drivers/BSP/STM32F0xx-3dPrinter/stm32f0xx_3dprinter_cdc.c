@@ -50,6 +50,7 @@
 #include "usbd_cdc_interface.h"
 #include "stm32f0xx_mpmd.h"
 /* Private defines -----------------------------------------------------------*/
+#define IS_EOL(c) ((c) == '\n' || (c) == '\r')
 /* Private constant ----------------------------------------------------------*/
 
 
@@ -65,6 +66,11 @@ volatile uint8_t gBspCdcRxBuffer[CDC_RX_BUFFER_SIZE];
 static volatile uint8_t *pRxBuffer = gBspCdcRxBuffer;
 static volatile uint8_t *pRxWriteBuffer;
 static volatile uint8_t *pRxReadBuffer;
+/* Line ends in the Rx ring: counted in by the Rx callback as packets arrive,
+   out as they are read, so the main loop knows there's a complete line
+   without looking */
+static volatile uint32_t rxEolIn;
+static uint32_t rxEolOut;
 uint32_t debugNbRxFrames = 0;
 uint32_t debugNbTxFrames = 0;
 #ifdef USE_XONXOFF
@@ -108,6 +114,7 @@ void BSP_CdcIfStart(void)
   USBD_Start(&USBD_Device);
   pRxWriteBuffer =  pRxBuffer;
   pRxReadBuffer =  pRxBuffer;
+  rxEolIn = rxEolOut = 0;
   debugNbTxFrames = 0;
   debugNbRxFrames = 0;
 //Delay to allow connection before trying to send data
@@ -119,6 +126,7 @@ void BSP_CdcIfStop(void)
 	  USBD_Stop(&USBD_Device);
 	  pRxWriteBuffer =  pRxBuffer;
 	  pRxReadBuffer =  pRxBuffer;
+	  rxEolIn = rxEolOut = 0;
 	  debugNbTxFrames = 0;
 	  debugNbRxFrames = 0;
 	//Delay to allow connection before trying to send data
@@ -190,6 +198,10 @@ void BSP_CDC_RxCpltCallback(uint8_t* Buf, uint32_t *Len)
 				secondBytesToCopy);
 		pRxWriteBuffer = &pRxBuffer[secondBytesToCopy];
 	}
+	uint32_t eol = 0;
+	for (uint32_t i = 0; i < bytesToCopy; i++)
+		if (IS_EOL(writePtr[i])) eol++;
+	rxEolIn += eol;
 	BSP_LED_Off(LED_GREEN);
 //Wait until at least half the buffer is free before signaling to host we are available for reception.	Otherwise check in the timer ISR periodically
 if(CDC_RX_BUFFER_SIZE-BSP_CdcGetNbRxAvailableBytes(0)>CDC_RX_BUFFER_SIZE/2)
@@ -274,10 +286,69 @@ uint32_t BSP_CdcCopyNextRxBytes(uint8_t *buff, uint32_t maxlen)
 				secondBytesToCopy);
 		pRxReadBuffer = &pRxBuffer[secondBytesToCopy];
 	}
+	for (uint32_t i = 0; i < bytesToCopy; i++)
+		if (IS_EOL(buff[i])) rxEolOut++;
 	BSP_LED_Off(LED_BLUE);
 	return bytesToCopy;
 }
 
+/******************************************************//**
+ * @brief  This function returns the number of complete lines received
+ * via the USB CDC (line ends, '\n' or '\r', so "\r\n" counts twice)
+ * @param[in] none
+ * @retval number of line ends in the Rx buffer
+ **********************************************************/
+uint32_t BSP_CdcGetNbRxLines(void)
+{
+  return rxEolIn - rxEolOut;
+}
+
+/******************************************************//**
+ * @brief  Moves the next complete line out of the Rx buffer, the bytes
+ * up to the line end with one memcpy per part of the ring it is in. The
+ * line end is consumed, not copied; the line is nul terminated and bytes
+ * past maxlen - 1 are dropped.
+ * @param[out] buff the line
+ * @param[in] maxlen size of buff
+ * @retval length of the line in buff, -1 if there is no complete line
+ **********************************************************/
+int32_t BSP_CdcCopyNextRxLine(uint8_t *buff, uint32_t maxlen)
+{
+  /* the line ends counted, then the write index: the interrupt moves the
+     index on before it counts, so the bytes of those are all before it */
+  const uint32_t eolIn = rxEolIn;
+  if (eolIn == rxEolOut)
+    return -1;
+  uint8_t *readPtr = (uint8_t *)pRxReadBuffer;
+  uint8_t *writePtr = (uint8_t *)pRxWriteBuffer;
+  uint8_t *ringEnd = (uint8_t *)&pRxBuffer[CDC_RX_BUFFER_SIZE];
+  /* find the line end, up to the write index or the end of the ring, then
+     from its start up to the write index */
+  uint8_t *eol = readPtr;
+  uint8_t *end = (writePtr >= readPtr) ? writePtr : ringEnd;
+  while (eol < end && !IS_EOL(*eol)) eol++;
+  uint32_t firstBytes = eol - readPtr, secondBytes = 0;
+  if (eol == ringEnd) {
+    eol = (uint8_t *)pRxBuffer;
+    while (eol < writePtr && !IS_EOL(*eol)) eol++;
+    secondBytes = eol - pRxBuffer;
+  }
+  if (eol == writePtr) {
+    /* no line end in the bytes received: the count is off (a receive
+       overflow), take it as it is and leave the bytes for the next one */
+    rxEolOut = eolIn;
+    return -1;
+  }
+  uint32_t len = MIN(firstBytes + secondBytes, maxlen - 1);
+  firstBytes = MIN(firstBytes, len);
+  memcpy(buff, readPtr, firstBytes);
+  memcpy(&buff[firstBytes], (uint8_t *)pRxBuffer, len - firstBytes);
+  buff[len] = '\0';
+  pRxReadBuffer = (eol + 1 == ringEnd) ? pRxBuffer : eol + 1;
+  rxEolOut++;
+  return (int32_t)len;
+}
+
 /******************************************************//**
  * @brief  This function returns the first byte available on the USB CDC
  * @param[in] none
@@ -296,6 +367,8 @@ int8_t BSP_CdcGetNextRxByte(void)
   if (pRxReadBuffer != writePtr)  {
     byteValue = (int8_t)(*(pRxReadBuffer));
     pRxReadBuffer++;
+    if (IS_EOL(byteValue))
+      rxEolOut++;
 
     if (pRxReadBuffer >= (pRxBuffer + CDC_RX_BUFFER_SIZE))    {
       pRxReadBuffer = pRxBuffer;
@@ -181,6 +181,22 @@ typedef struct {
 	 uint8_t		activePwm;
 } tFanStruct;
 
+/* The E1 fan PWM from a timer channel instead of the SysTick interrupt */
+#if defined(FAN_TIMER_PWM) && defined(BSP_MISC_TIMER_PWM_FAN_E1)
+#define BSP_FAN_E1_TIMER
+#if (BSP_FAN_PWM_FREQ < 3) || (BSP_FAN_PWM_FREQ > 100000)
+#error "BSP_FAN_PWM_FREQ is out of the range of the fan timer (3Hz to 100kHz)"
+#endif
+#endif
+
+/* Steps played by DMA on the Tick timer updates */
+#if defined(STEP_BURST) && defined(BSP_STEP_BURST_TIMER)
+#define BSP_STEP_BURST
+#if (BSP_STEP_BURST_FRAMES < 4) || (BSP_STEP_BURST_FRAMES & 1)
+#error "BSP_STEP_BURST_FRAMES must be even, and 4 or more"
+#endif
+#endif
+
 
 /* Global variable ------------------------------------------------------------*/
 static tFanStruct fanE1;
@@ -225,6 +241,17 @@ TIM_HandleTypeDef hTimTick2;
 /// Timer handler for servo
 TIM_HandleTypeDef hTimServo;
 
+#ifdef BSP_FAN_E1_TIMER
+/// Timer handler for the E1 fan PWM
+TIM_HandleTypeDef hTimPwmFanE1;
+#endif
+
+#ifdef BSP_STEP_BURST
+/// Step burst buffers, filled by Marlin and played by DMA
+BSP_StepBurstPins_t bspStepBurstPins[BSP_STEP_BURST_FRAMES];
+BSP_StepBurstTimer_t bspStepBurstTimer[BSP_STEP_BURST_FRAMES];
+#endif
+
 /* Private constant ----------------------------------------------------------*/
 static uint8_t bspTickEnabled = 0;
 
@@ -535,6 +562,47 @@ void BSP_MiscFanInit(uint8_t id)
       return;
   }
 
+#ifdef BSP_FAN_E1_TIMER
+  if (id == 0)
+  {
+    TIM_OC_InitTypeDef sConfigOC;
+
+    /* The pin is the timer channel output */
+    GPIO_InitStruct.Pin = gpioPin;
+    GPIO_InitStruct.Mode = GPIO_MODE_AF_PP;
+    GPIO_InitStruct.Pull = GPIO_NOPULL;
+    GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_MEDIUM;
+    GPIO_InitStruct.Alternate = BSP_MISC_AFx_TIMx_PWM_FAN_E1;
+    HAL_GPIO_Init(gpioPort, &GPIO_InitStruct);
+
+    /* 255 counts a period, the compare value is the speed (255 is always on) */
+    __BSP_MISC_TIMER_PWM_FAN_E1_CLCK_ENABLE();
+    hTimPwmFanE1.Instance = BSP_MISC_TIMER_PWM_FAN_E1;
+    hTimPwmFanE1.Init.Prescaler = HAL_RCC_GetSysClockFreq() / (BSP_FAN_PWM_FREQ * 255) - 1;
+    hTimPwmFanE1.Init.CounterMode = TIM_COUNTERMODE_UP;
+    hTimPwmFanE1.Init.Period = 255 - 1;
+    hTimPwmFanE1.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+    hTimPwmFanE1.Init.RepetitionCounter = 0;
+    hTimPwmFanE1.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_ENABLE;
+    HAL_TIM_PWM_Init(&hTimPwmFanE1);
+
+    sConfigOC.OCMode = TIM_OCMODE_PWM1;
+    sConfigOC.Pulse = 0;
+    sConfigOC.OCPolarity = TIM_OCPOLARITY_HIGH;
+    sConfigOC.OCNPolarity = TIM_OCNPOLARITY_HIGH;
+    sConfigOC.OCFastMode = TIM_OCFAST_DISABLE;
+    sConfigOC.OCIdleState = TIM_OCIDLESTATE_RESET;
+    sConfigOC.OCNIdleState = TIM_OCNIDLESTATE_RESET;
+    HAL_TIM_PWM_ConfigChannel(&hTimPwmFanE1, &sConfigOC, BSP_MISC_CHAN_TIMER_PWM_FAN_E1);
+    HAL_TIM_PWM_Start(&hTimPwmFanE1, BSP_MISC_CHAN_TIMER_PWM_FAN_E1);
+
+    pfan->gpioPin  = gpioPin;
+    pfan->gpioPort = gpioPort;
+    pfan->activePwm   = 0;
+    return;
+  }
+#endif
+
   GPIO_InitStruct.Pin = gpioPin;
   GPIO_InitStruct.Mode = GPIO_MODE_OUTPUT_PP;
   GPIO_InitStruct.Pull = GPIO_NOPULL;
@@ -577,6 +645,16 @@ void BSP_MiscFanSetSpeed(uint8_t id,uint8_t speed)
 #endif//BSP_HEAT_E2_PIN
 	else // Error case
 		return;
+
+#ifdef BSP_FAN_E1_TIMER
+  if (id == 0)
+  {
+     /* Taken at the end of the period, the preload is on */
+     __HAL_TIM_SetCompare(&hTimPwmFanE1, BSP_MISC_CHAN_TIMER_PWM_FAN_E1, speed);
+     pfan->speed = speed;
+     return;
+  }
+#endif
   
   if (speed == 0)
   {
@@ -618,6 +696,7 @@ static inline void refresh(void)
 void HAL_SYSTICK_Callback(void)
 {
 	refresh();
+#if !defined(BSP_FAN_E1_TIMER) || defined(BSP_HEAT_E2_PIN)
 	if( fanE1.activePwm)
 	{
 		fanE1.count--;
@@ -678,6 +757,7 @@ void HAL_SYSTICK_Callback(void)
 		}
 	}
 #endif//BSP_HEAT_E2_PIN
+#endif//!BSP_FAN_E1_TIMER || BSP_HEAT_E2_PIN
 
 }
 
@@ -740,6 +820,14 @@ void BSP_MiscTickInit(void)
   sMasterConfig.MasterOutputTrigger = TIM_TRGO_RESET;
   sMasterConfig.MasterSlaveMode = TIM_MASTERSLAVEMODE_DISABLE;
   HAL_TIMEx_MasterConfigSynchronization(&hTimTick, &sMasterConfig);
+
+#ifdef BSP_STEP_BURST
+  // same priority as the Tick interrupt, the refills never preempt it
+  __BSP_STEP_BURST_TIMER_CLCK_ENABLE();
+  __HAL_RCC_DMA1_CLK_ENABLE();
+  HAL_NVIC_SetPriority(BSP_STEP_BURST_DMA_IRQn, 1, 0);
+  HAL_NVIC_EnableIRQ(BSP_STEP_BURST_DMA_IRQn);
+#endif
 #endif //else #ifndef MARLIN
 }
 
@@ -833,6 +921,149 @@ void BSP_MiscTickStop(void)
   bspTickEnabled = 0;
 }
 
+/******************************************************//**
+ * @brief  Read the counter of the tick timer
+ * @param[in] None
+ * @retval Counter value, in ticks of CORE_CPU_FREQ/TICK_TIMER_PRESCALER
+  **********************************************************/
+uint16_t BSP_MiscTickGetCounter(void)
+{
+  return (uint16_t)hTimTick.Instance->CNT;
+}
+
+#ifdef BSP_STEP_BURST
+/******************************************************//**
+ * @brief  Read the compare register of the tick timer
+ * @param[in] None
+ * @retval Counter value the next tick interrupt is due at
+  **********************************************************/
+uint16_t BSP_MiscTickGetCompare(void)
+{
+  return (uint16_t)hTimTick.Instance->CCR1;
+}
+
+/******************************************************//**
+ * @brief  Start playing bspStepBurstPins and bspStepBurstTimer
+ * from their first frame, at the tick interrupt that is due
+ * @param[in] None
+ * @retval None
+ * @note The frames are played by DMA on the Tick timer updates:
+ * each update takes the next period (and channel 2 pulse) from
+ * bspStepBurstTimer into the preload registers of the timer
+ * (DMA burst through TIMx_DMAR, CCDS moves the CC1 request to
+ * the update) and triggers BSP_STEP_BURST_TIMER, a one pulse
+ * timer whose trigger and compare requests write the set then
+ * the reset word of the frame to the BSRR of the tower pins.
+ * The pins DMA interrupts every half of the buffer, the frame
+ * with a compare of 0 interrupts to hand back to the ISR.
+ * The buffers must hold the frames up to the one before last,
+ * the timer registers of the first in the last slot.
+  **********************************************************/
+void BSP_MiscStepBurstStart(void)
+{
+  TIM_TypeDef *tim = hTimTick.Instance;
+  TIM_TypeDef *burst = BSP_STEP_BURST_TIMER;
+  const BSP_StepBurstTimer_t *first = &bspStepBurstTimer[BSP_STEP_BURST_FRAMES - 1];
+  uint16_t due, left;
+
+  // The first update falls where the interrupt was due
+  tim->DIER &= ~TIM_DIER_CC1IE;
+  due = tim->CCR1;
+  tim->CCR1 = 0xFFFF;
+  tim->CCR2 = 0;
+  left = due - tim->CNT;
+  if ((int16_t)left < 2) left = 2;
+  tim->ARR = 0xFFFE;
+  tim->CNT = 0xFFFF - left;
+
+  // Then the registers of the first frame, preloaded
+  tim->CR1 |= TIM_CR1_ARPE;
+  tim->CCMR1 = (tim->CCMR1 & ~(TIM_CCMR1_CC2S | TIM_CCMR1_OC2M))
+             | TIM_CCMR1_OC1PE | TIM_CCMR1_OC2PE | TIM_CCMR1_OC2M_2 | TIM_CCMR1_OC2M_1;
+  tim->ARR = first->arr;
+  tim->CCR1 = first->ccr1;
+  tim->CCR2 = first->ccr2;
+  tim->CCER |= TIM_CCER_CC2E;
+  tim->DCR = (3 << 8) | (uint32_t)(&tim->ARR - &tim->CR1);
+  tim->CR2 = (tim->CR2 & ~TIM_CR2_MMS) | TIM_CR2_CCDS | TIM_CR2_MMS_1;
+
+  DMA1->IFCR = BSP_STEP_BURST_DMA_FLAGS;
+  BSP_STEP_BURST_TICK_DMA->CCR = 0;
+  BSP_STEP_BURST_TICK_DMA->CPAR = (uint32_t)&tim->DMAR;
+  BSP_STEP_BURST_TICK_DMA->CMAR = (uint32_t)bspStepBurstTimer;
+  BSP_STEP_BURST_TICK_DMA->CNDTR = BSP_STEP_BURST_FRAMES * 4;
+  BSP_STEP_BURST_TICK_DMA->CCR = DMA_CCR_PSIZE_0 | DMA_CCR_MSIZE_0 | DMA_CCR_MINC
+                               | DMA_CCR_CIRC | DMA_CCR_DIR | DMA_CCR_PL | DMA_CCR_EN;
+  BSP_STEP_BURST_PINS_DMA->CCR = 0;
+  BSP_STEP_BURST_PINS_DMA->CPAR = (uint32_t)&BSP_STEP_BURST_PORT->BSRR;
+  BSP_STEP_BURST_PINS_DMA->CMAR = (uint32_t)bspStepBurstPins;
+  BSP_STEP_BURST_PINS_DMA->CNDTR = BSP_STEP_BURST_FRAMES * 2;
+  BSP_STEP_BURST_PINS_DMA->CCR = DMA_CCR_PSIZE_1 | DMA_CCR_MSIZE_1 | DMA_CCR_MINC
+                               | DMA_CCR_CIRC | DMA_CCR_DIR | DMA_CCR_HTIE | DMA_CCR_TCIE
+                               | DMA_CCR_PL | DMA_CCR_EN;
+
+  burst->CR1 = 0;
+  burst->PSC = TICK_TIMER_PRESCALER - 1;
+  burst->ARR = BSP_STEP_BURST_PULSE;
+  burst->CCR1 = BSP_STEP_BURST_PULSE;
+  burst->CCMR1 = 0;
+  burst->SMCR = BSP_STEP_BURST_TIMER_TS | TIM_SMCR_SMS_2 | TIM_SMCR_SMS_1;
+  burst->CR1 = TIM_CR1_OPM;
+  burst->EGR = TIM_EGR_UG;
+  burst->SR = 0;
+  burst->DIER = TIM_DIER_TDE | TIM_DIER_CC1DE;
+
+  // E step pin to channel 2 of the Tick timer
+  BSP_STEP_BURST_E_PORT->AFR[0] = (BSP_STEP_BURST_E_PORT->AFR[0] & ~(0xFU << (BSP_STEP_BURST_E_PIN_NUM * 4)))
+                                | (BSP_STEP_BURST_E_AF << (BSP_STEP_BURST_E_PIN_NUM * 4));
+  BSP_STEP_BURST_E_PORT->MODER = (BSP_STEP_BURST_E_PORT->MODER & ~(3U << (BSP_STEP_BURST_E_PIN_NUM * 2)))
+                               | (2U << (BSP_STEP_BURST_E_PIN_NUM * 2));
+
+  tim->SR = ~TIM_SR_CC1IF;
+  tim->DIER |= TIM_DIER_CC1DE | TIM_DIER_CC1IE;
+}
+
+/******************************************************//**
+ * @brief  Stop playing the step burst, back to the tick
+ * interrupt on compare
+ * @param[in] count Counter value the frame being played started
+ * at, the counter goes on from there
+ * @retval Slot of the first frame that wasn't started
+  **********************************************************/
+uint8_t BSP_MiscStepBurstStop(uint16_t count)
+{
+  TIM_TypeDef *tim = hTimTick.Instance;
+  TIM_TypeDef *burst = BSP_STEP_BURST_TIMER;
+  uint16_t words;
+
+  tim->DIER &= ~TIM_DIER_CC1DE;
+  burst->DIER = 0;
+  burst->SMCR = 0;
+  burst->CR1 = 0;
+  words = BSP_STEP_BURST_PINS_DMA->CNDTR;
+  BSP_STEP_BURST_TICK_DMA->CCR = 0;
+  BSP_STEP_BURST_PINS_DMA->CCR = 0;
+  DMA1->IFCR = BSP_STEP_BURST_DMA_FLAGS;
+  HAL_NVIC_ClearPendingIRQ(BSP_STEP_BURST_DMA_IRQn);
+
+  // A pulse cut short is still a step, the drivers only need 1us
+  BSP_STEP_BURST_PORT->BRR = BSP_STEP_BURST_X | BSP_STEP_BURST_Y | BSP_STEP_BURST_Z;
+  BSP_STEP_BURST_E_PORT->BRR = 1U << BSP_STEP_BURST_E_PIN_NUM;
+  BSP_STEP_BURST_E_PORT->MODER = (BSP_STEP_BURST_E_PORT->MODER & ~(3U << (BSP_STEP_BURST_E_PIN_NUM * 2)))
+                               | (1U << (BSP_STEP_BURST_E_PIN_NUM * 2));
+  tim->CCER &= ~TIM_CCER_CC2E;
+
+  tim->CR1 &= ~TIM_CR1_ARPE;
+  tim->CCMR1 &= ~(TIM_CCMR1_OC1PE | TIM_CCMR1_OC2PE);
+  tim->CR2 &= ~(TIM_CR2_CCDS | TIM_CR2_MMS);
+  tim->ARR = 0xFFFF;
+  tim->CNT = (uint16_t)(count + tim->CNT);
+
+  // a frame is started once its set word is written
+  return ((BSP_STEP_BURST_FRAMES * 2 - words + 1) / 2) % BSP_STEP_BURST_FRAMES;
+}
+#endif //BSP_STEP_BURST
+
 /******************************************************//**
  * @brief  Initialisation of the Tick2 timer 
  * @param None
@@ -1335,36 +1566,29 @@ void BSP_MiscUserGpioInit(uint8_t id, uint32_t mode, uint32_t pull)
 }
 #endif
 /**********************************************************
- * @brief  Erases user EEPROM emulated in flash
- * @retval None
- **********************************************************/
-void BSP_MiscEEPROMErase() {
-	FLASH_If_Init();
-	FLASH_If_Erase(EEPROM_ADDRESS,EEPROM_ADDRESS+FLASH_PAGE_SIZE); //Exactly one page reserved for EEPROM
-}
-/**********************************************************
- * @brief  Writes a float value to user EEPROM emulated in flash
- * @retval None
+ * @brief  Erases a page of the settings store in flash
+ * @param[in] page Address of the page
+ * @retval 1 if it was erased, 0 on an error
  **********************************************************/
-void BSP_MiscEEPROMWriteF32(void *destination, float value)
+uint8_t BSP_MiscFlashErase(void *page)
 {
-	FLASH_If_Write((uint32_t)destination,&value,sizeof(float)/sizeof(uint16_t));
-}
-/**********************************************************
- * @brief  Writes a uint16_t value to user EEPROM emulated in flash
- * @retval None
- **********************************************************/
-void BSP_MiscEEPROMWriteU16(void *destination, uint16_t value)
-{
-	FLASH_If_Write((uint32_t)destination,&value,sizeof(uint16_t)/sizeof(uint16_t));
+	FLASH_If_Init();
+	return FLASH_If_Erase((uint32_t)page,(uint32_t)page+FLASH_PAGE_SIZE) == FLASHIF_OK;
 }
 /**********************************************************
- * @brief  Writes a uint32_t value to user EEPROM emulated in flash
- * @retval None
+ * @brief  Programs half-words of the settings store in flash,
+ * in order; each must be erased (0xFFFF) before
+ * @param[in] destination Address of the first, half-word aligned
+ * @param[in] source Half-words to program
+ * @param[in] count Number of half-words
+ * @retval 1 if they read back as written, 0 on an error
  **********************************************************/
-void BSP_MiscEEPROMWriteU32(void *destination, uint32_t value)
+uint8_t BSP_MiscFlashWrite(void *destination, const uint16_t *source, uint16_t count)
 {
-	FLASH_If_Write((uint32_t)destination,&value,sizeof(uint32_t)/sizeof(uint16_t));
+	FLASH_If_Init();
+	uint8_t written = FLASH_If_Write((uint32_t)destination,(uint16_t *)source,count) == FLASHIF_OK;
+	HAL_FLASH_Lock(); //left unlocked on an error
+	return written;
 }
 /**
   * @}
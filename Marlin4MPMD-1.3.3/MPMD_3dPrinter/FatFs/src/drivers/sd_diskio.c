@@ -33,9 +33,50 @@
 /* Private define ------------------------------------------------------------*/
 /* Block Size in Bytes */
 
+/* Sectors read ahead, with one multiple block read, once single sector reads
+   run on from one to the next (a file read a sector at a time), 1: none;
+   with USE_SPI_DMA the stream below reads ahead instead. None by default:
+   CardReader reads the print file ahead into its own ring of sectors
+   (SD_READ_RING_SECTORS), and a second copy of it here would cost
+   SD_READAHEAD_SECTORS * 512 bytes of RAM more */
+#ifndef SD_READAHEAD_SECTORS
+#define SD_READAHEAD_SECTORS 1
+#endif
+
+/* FatFs gets the disk status with each f_read() and f_write(), a byte at a
+   time while printing; the card is asked (CMD13) at most once this often, ms */
+#ifndef SD_STATUS_INTERVAL
+#define SD_STATUS_INTERVAL 100
+#endif
+
 /* Private variables ---------------------------------------------------------*/
 /* Disk status */
 static volatile DSTATUS Stat = STA_NOINIT;
+/* When the card was last asked for it, statusTick valid if statusKnown */
+static uint32_t statusTick;
+static uint8_t statusKnown = 0;
+
+#if defined(USE_SPI_DMA)
+/* Stream of a file read a sector at a time: one multiple block read left
+   open, the card at streamNext, and a double buffer. The sector handed out
+   last is in one half, the DMA reads the one after it into the other half
+   (dmaHalf) while the caller works on it. bufValid has a bit for each half
+   that holds bufSector[half] */
+static uint32_t streamBuff[2][BLOCK_SIZE / 4];
+static DWORD bufSector[2];
+static uint8_t bufValid = 0;
+static int8_t dmaHalf = -1;
+static uint8_t streamOpen = 0;
+static DWORD streamNext;
+static DWORD nextSector = 0;
+#elif SD_READAHEAD_SECTORS > 1
+/* Read-ahead: the sectors from aheadSector on, aheadCount of them (0: none),
+   and the sector after the last one read */
+static uint32_t aheadBuff[SD_READAHEAD_SECTORS * BLOCK_SIZE / 4];
+static DWORD aheadSector;
+static UINT aheadCount = 0;
+static DWORD nextSector = 0;
+#endif
 
 /* Private function prototypes -----------------------------------------------*/
 DSTATUS SD_initialize (BYTE);
@@ -47,6 +88,12 @@ DRESULT SD_read (BYTE, BYTE*, DWORD, UINT);
 #if _USE_IOCTL == 1
   DRESULT SD_ioctl (BYTE, BYTE, void*);
 #endif  /* _USE_IOCTL == 1 */
+#if defined(USE_SPI_DMA)
+static void SD_StreamWait(void);
+static void SD_StreamStop(void);
+static DRESULT SD_StreamFill(DWORD, int8_t);
+static int8_t SD_StreamHalf(DWORD);
+#endif
   
 const Diskio_drvTypeDef  SD_Driver =
 {
@@ -64,6 +111,99 @@ const Diskio_drvTypeDef  SD_Driver =
 
 /* Private functions ---------------------------------------------------------*/
 
+#if defined(USE_SPI_DMA)
+/**
+  * @brief  Waits for the sector the DMA reads, if any
+  * @retval None
+  */
+static void SD_StreamWait(void)
+{
+  if(dmaHalf < 0)
+  {
+    return;
+  }
+  if(BSP_SD_WaitReadBlock() == MSD_OK)
+  {
+    bufValid |= 1 << dmaHalf;
+    /* The card answers, it is as good as a CMD13 */
+    statusTick = HAL_GetTick();
+  }
+  dmaHalf = -1;
+}
+
+/**
+  * @brief  Ends the stream, for the card to take other commands. The
+  *         sectors it read are kept.
+  * @retval None
+  */
+static void SD_StreamStop(void)
+{
+  SD_StreamWait();
+  if(streamOpen)
+  {
+    streamOpen = 0;
+    BSP_SD_StopReadBlocks();
+  }
+}
+
+/**
+  * @brief  Starts reading a sector of the stream into a half of the double
+  *         buffer, the stream starts over if the card isn't at it
+  * @param  sector: Sector address (LBA)
+  * @param  half: of streamBuff
+  * @retval DRESULT: Operation result
+  */
+static DRESULT SD_StreamFill(DWORD sector, int8_t half)
+{
+  SD_StreamWait();
+  bufValid &= ~(1 << half);
+  if(!streamOpen || streamNext != sector)
+  {
+    SD_StreamStop();
+    if(BSP_SD_StartReadBlocks((uint64_t) (sector * BLOCK_SIZE), BLOCK_SIZE) != MSD_OK)
+    {
+      return RES_ERROR;
+    }
+    streamOpen = 1;
+    streamNext = sector;
+  }
+  if(BSP_SD_ReadBlock_DMA(streamBuff[half], BLOCK_SIZE) != MSD_OK)
+  {
+    /* Past the end of the card, or it failed */
+    SD_StreamStop();
+    return RES_ERROR;
+  }
+  streamNext++;
+  bufSector[half] = sector;
+  dmaHalf = half;
+  return RES_OK;
+}
+
+/**
+  * @brief  The half of the double buffer that holds a sector, when the DMA
+  *         reading it is done
+  * @param  sector: Sector address (LBA)
+  * @retval the half, -1: none
+  */
+static int8_t SD_StreamHalf(DWORD sector)
+{
+  int8_t half;
+
+  if(dmaHalf >= 0 && bufSector[dmaHalf] == sector)
+  {
+    SD_StreamWait();
+  }
+  for(half = 0; half < 2; half++)
+  {
+    if((bufValid & (1 << half)) && bufSector[half] == sector)
+    {
+      return half;
+    }
+  }
+  return -1;
+}
+#endif /* USE_SPI_DMA */
+
 /**
   * @brief  Initializes a Drive
   * @param  lun : not used 
@@ -72,6 +212,15 @@ const Diskio_drvTypeDef  SD_Driver =
 DSTATUS SD_initialize(BYTE lun)
 {
   Stat = STA_NOINIT;
+  statusKnown = 0;
+#if defined(USE_SPI_DMA)
+  /* The card starts over, no CMD12 */
+  SD_StreamWait();
+  streamOpen = 0;
+  bufValid = 0;
+#elif SD_READAHEAD_SECTORS > 1
+  aheadCount = 0;
+#endif
   
   /* Configure the uSD device */
   if(BSP_SD_Init() == MSD_OK)
@@ -89,12 +238,22 @@ DSTATUS SD_initialize(BYTE lun)
   */
 DSTATUS SD_status(BYTE lun)
 {
+  if(statusKnown && HAL_GetTick() - statusTick < SD_STATUS_INTERVAL)
+  {
+    return Stat;
+  }
+
   Stat = STA_NOINIT;
 
+#if defined(USE_SPI_DMA)
+  SD_StreamStop();
+#endif
   if(BSP_SD_GetStatus() == MSD_OK)
   {
     Stat &= ~STA_NOINIT;
   }
+  statusTick = HAL_GetTick();
+  statusKnown = 1;
   
   return Stat;
 }
@@ -111,6 +270,66 @@ DRESULT SD_read(BYTE lun, BYTE *buff, DWORD sector, UINT count)
 {
   DRESULT res = RES_OK;
   
+#if defined(USE_SPI_DMA)
+  int8_t half;
+
+  if(count == 1)
+  {
+    /* A sector of the stream, or the next one of a file read a sector at a
+       time. FatFs reads the FAT in between as the file crosses into the
+       next cluster, that read stops the stream, the sector after it is
+       read already */
+    half = SD_StreamHalf(sector);
+    if(half < 0 && sector == nextSector && SD_StreamFill(sector, 0) == RES_OK)
+    {
+      half = SD_StreamHalf(sector);
+    }
+    if(half >= 0)
+    {
+      memcpy(buff, streamBuff[half], BLOCK_SIZE);
+      nextSector = sector + 1;
+      /* The next one, into the other half, while the caller is busy */
+      if(SD_StreamHalf(sector + 1) < 0)
+      {
+        SD_StreamFill(sector + 1, 1 - half);
+      }
+      return res;
+    }
+  }
+  SD_StreamStop();
+  nextSector = sector + count;
+#elif SD_READAHEAD_SECTORS > 1
+  if(count == 1)
+  {
+    /* The next sector of a file read a sector at a time, read ahead. It
+       goes on from the last read or the read-ahead, FatFs reads the FAT
+       in between as the file crosses into the next cluster */
+    if((sector < aheadSector || sector >= aheadSector + aheadCount) &&
+       (sector == nextSector || (aheadCount && sector == aheadSector + aheadCount)))
+    {
+      aheadCount = 0;
+      if(BSP_SD_ReadBlocks(aheadBuff, 
+                           (uint64_t) (sector * BLOCK_SIZE), 
+                           BLOCK_SIZE, 
+                           SD_READAHEAD_SECTORS) == MSD_OK)
+      {
+        aheadSector = sector;
+        aheadCount = SD_READAHEAD_SECTORS;
+      }
+    }
+    nextSector = sector + 1;
+    if(sector >= aheadSector && sector < aheadSector + aheadCount)
+    {
+      memcpy(buff, (BYTE*)aheadBuff + (sector - aheadSector) * BLOCK_SIZE, BLOCK_SIZE);
+      return res;
+    }
+  }
+  else
+  {
+    nextSector = sector + count;
+  }
+#endif
+
   if(BSP_SD_ReadBlocks((uint32_t*)buff, 
                        (uint64_t) (sector * BLOCK_SIZE), 
                        BLOCK_SIZE, 
@@ -135,6 +354,26 @@ DRESULT SD_write(BYTE lun, const BYTE *buff, DWORD sector, UINT count)
 {
   DRESULT res = RES_OK;
   
+#if defined(USE_SPI_DMA)
+  int8_t half;
+
+  /* Drop the sectors of the stream the write changes */
+  SD_StreamStop();
+  for(half = 0; half < 2; half++)
+  {
+    if(bufSector[half] >= sector && bufSector[half] < sector + count)
+    {
+      bufValid &= ~(1 << half);
+    }
+  }
+#elif SD_READAHEAD_SECTORS > 1
+  /* Drop a read-ahead the write changes */
+  if(sector < aheadSector + aheadCount && sector + count > aheadSector)
+  {
+    aheadCount = 0;
+  }
+#endif
+
   if(BSP_SD_WriteBlocks((uint32_t*)buff, 
                         (uint64_t)(sector * BLOCK_SIZE), 
                         BLOCK_SIZE, count) != MSD_OK)
@@ -165,11 +404,14 @@ DRESULT SD_ioctl(BYTE lun, BYTE cmd, void *buff)
   {
   /* Make sure that no pending write process */
   case CTRL_SYNC :
-    res = RES_OK;
+    res = BSP_SD_WaitWriteDone() == MSD_OK ? RES_OK : RES_ERROR;
     break;
   
   /* Get number of sectors on the disk (DWORD) */
   case GET_SECTOR_COUNT :
+#if defined(USE_SPI_DMA)
+    SD_StreamStop();
+#endif
     BSP_SD_GetCardInfo(&CardInfo);
     *(DWORD*)buff = CardInfo.CardCapacity / BLOCK_SIZE;
     res = RES_OK;
@@ -877,6 +877,12 @@
 #define DEFAULT_ZJERK                 20.0     // (mm/sec)
 #define DEFAULT_EJERK                 5.0    // (mm/sec)
 
+// Junction deviation (mm): the speed through the corner of two moves is that of a
+// circle touching both, this far from the corner, at the block's acceleration.
+// Replaces the XY and Z jerk limits (the E jerk limit still holds) and keeps the
+// speed through the shallow corners of tessellated curves. 0 for the jerk limits.
+#define DEFAULT_JUNCTION_DEVIATION    0.0    // (mm) M205 J
+
 
 //=============================================================================
 //============================= Additional Features ===========================
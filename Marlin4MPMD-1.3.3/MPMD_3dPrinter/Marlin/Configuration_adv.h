@@ -550,17 +550,23 @@ const unsigned int dropsegments = 0; //everything with less than this number of
 
 // The number of linear motions that can be in the plan at any give time.
 // THE BLOCK_BUFFER_SIZE NEEDS TO BE A POWER OF 2, i.g. 8,16,32 because shifts and ors are used to do the ring-buffering.
-#if ENABLED(SDSUPPORT)
-  #define BLOCK_BUFFER_SIZE 16   // SD,LCD,Buttons take more memory, block buffer needs to be smaller
-#else
-  #define BLOCK_BUFFER_SIZE 64 // maximize block buffer
+#ifndef BLOCK_BUFFER_SIZE
+  #if ENABLED(SDSUPPORT)
+    #define BLOCK_BUFFER_SIZE 16   // SD,LCD,Buttons take more memory, block buffer needs to be smaller
+  #else
+    #define BLOCK_BUFFER_SIZE 64 // maximize block buffer
+  #endif
 #endif
 
 // @section serial
 
 // The ASCII buffer for serial input
 #define MAX_CMD_SIZE 96
-#define BUFSIZE 4
+// Bytes of the command queue, a ring of commands of their own length (a G1
+// of a print takes 20 to 40 bytes); there must be room for a MAX_CMD_SIZE
+// one to read the next. 384 bytes are the 4 commands of the fixed queue,
+// M932 reports how full it runs.
+#define CMD_QUEUE_SIZE 384
 
 // Transfer Buffer Size
 // To save 386 bytes of PROGMEM (and TX_BUFFER_SIZE+3 bytes of RAM) set to 0.
@@ -95,6 +95,7 @@ void serial_echopair_P(const char* s_P, double v);
 void serial_echopair_P(const char* s_P, unsigned long v);
 FORCE_INLINE void serial_echopair_P(const char* s_P, uint8_t v) { serial_echopair_P(s_P, (int)v); }
 FORCE_INLINE void serial_echopair_P(const char* s_P, uint16_t v) { serial_echopair_P(s_P, (int)v); }
+FORCE_INLINE void serial_echopair_P(const char* s_P, unsigned int v) { serial_echopair_P(s_P, (unsigned long)v); }
 FORCE_INLINE void serial_echopair_P(const char* s_P, bool v) { serial_echopair_P(s_P, (int)v); }
 FORCE_INLINE void serial_echopair_P(const char* s_P, void *v) { serial_echopair_P(s_P, (unsigned long)v); }
 
@@ -109,6 +110,16 @@ void idle(
 
 void manage_inactivity(bool ignore_stepper_queue = false);
 
+#if ENABLED(MPMD_SIM)
+  void sim_idle(); // host simulator (make sim), advances the virtual clock
+  #if ENABLED(STEP_BURST)
+    extern bool sim_no_step_burst; // marlin_sim -I, every step by the interrupt
+  #endif
+  #if ENABLED(SDSUPPORT)
+    extern bool sim_no_read_ahead; // testreadahead, the parser reads every sector
+  #endif
+#endif
+
 #if ENABLED(DUAL_X_CARRIAGE) || ENABLED(DUAL_NOZZLE_DUPLICATION_MODE)
   extern bool extruder_duplication_enabled;
 #endif
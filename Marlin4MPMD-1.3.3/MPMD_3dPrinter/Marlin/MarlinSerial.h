@@ -155,6 +155,14 @@ class MarlinSerial { //: public Stream
     	else
     		return -1;
     }
+    // Next complete line, without its line end, nul terminated and cut to
+    // maxlen - 1; -1 if none has arrived, or the port is read by the byte
+    FORCE_INLINE int32_t readLine(uint8_t *buff, uint32_t maxlen) {
+    	if(type==USB_CDC)
+    		return BSP_CdcCopyNextRxLine(buff,maxlen);
+    	else
+    		return -1;
+    }
     void flush(void);
     FORCE_INLINE int available(uint8_t waitforNewLine) {
     	if(type==UART)
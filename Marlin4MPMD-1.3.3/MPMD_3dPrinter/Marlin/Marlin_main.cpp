@@ -60,6 +60,9 @@
 #include "math.h"
 #include "nozzle.h"
 #include "duration_t.h"
+#include "delta_fixed.h"
+#include "gcode_params.h"
+#include "sd_upload.h"
 
 #if ENABLED(SDSUPPORT)
 #include "ff_gen_drv.h"
@@ -215,7 +218,7 @@ static bool cmdForWifi = false;
  * M205 - Set advanced settings. Current units apply:
             S<print> T<travel> minimum speeds
             B<minimum segment time>
-            X<max xy jerk>, Z<max Z jerk>, E<max E jerk>
+            X<max xy jerk>, Z<max Z jerk>, E<max E jerk>, J<junction deviation>
  * M206 - Set additional homing offset
  * M207 - Set Retract Length: S<length>, Feedrate: F<units/min>, and Z lift: Z<distance>
  * M208 - Set Recover (unretract) Additional (!) Length: S<length> and Feedrate: F<units/min>
@@ -275,6 +278,11 @@ static bool cmdForWifi = false;
  * ************ Custom codes - This can change to suit future G-code regulations
  * M100 - Watch Free Memory (For Debugging Only)
  * M928 - Start SD logging (M928 filename.g) - ended by M29
+ * M930 - Stepper step timeline trace: S1 start, S2 start and stop when the planner runs dry, S0 stop, no S dump (Requires STEPPER_TRACE)
+ * M931 - Delta kinematics benchmark: CPU cycles per segment of fixed point and float inverse kinematics, S<count> positions (Requires DELTA_FIXED_POINT)
+ * M932 - Command queue occupancy: commands taken per eighth of the queue full, most bytes and commands held; S0 clears
+ * M933 - SD read-ahead: sectors read ahead and by the parser, sectors buffered as it started on each one; S0 clears (Requires SDSUPPORT)
+ * M1000 - Resume the SD print the power-loss journal has: heat, home, go back to where it had got to and print on; S0 only reports it (Requires POWER_LOSS_JOURNAL)
  * M999 - Restart after being stopped by error
  *
  * "T" Codes
@@ -307,11 +315,28 @@ bool axis_homed[3] = { false };
 
 static long gcode_N, gcode_LastN, Stopped_gcode_LastN = 0;
 
-static char command_queue[BUFSIZE][MAX_CMD_SIZE];
+/**
+ * The command queue, a ring of CMD_QUEUE_SIZE bytes. Each command is a
+ * header byte, CMD_SEND_OK and the length of the command with its nul,
+ * then the command (binary records too, nuls and all). Commands are read
+ * in place at the write end, so there must be room for a MAX_CMD_SIZE one
+ * there: where there is none before the end of the ring, the next one
+ * starts over at 0.
+ */
+#define CMD_SEND_OK 0x80
+#define CMD_RECORD_MAX (1 + MAX_CMD_SIZE)
+#define CMD_QUEUE_HISTOGRAM_BINS 8
+
+static char command_queue[CMD_QUEUE_SIZE];
 static char* current_command, *current_command_args;
-static uint8_t cmd_queue_index_r = 0,
-               cmd_queue_index_w = 0,
-               commands_in_queue = 0;
+static uint16_t cmd_queue_index_r = 0, // header of the oldest command
+                cmd_queue_index_w = 0; // header of the next one
+static uint8_t commands_in_queue = 0;
+
+// For M932: how full the queue was as each command was taken, and the most it held
+static uint32_t cmd_queue_histogram[CMD_QUEUE_HISTOGRAM_BINS];
+static uint16_t cmd_queue_peak_bytes = 0;
+static uint8_t cmd_queue_peak_commands = 0;
 
 #if ENABLED(INCH_MODE_SUPPORT)
   float linear_unit_factor = 1.0;
@@ -378,9 +403,20 @@ const char axis_codes[NUM_AXIS] = {'X', 'Y', 'Z', 'E'};
 
 static int serial_count = 0;
 
-// GCode parameter pointer used by code_seen(), code_value_float(), etc.
+// GCode parameter found by code_seen(): its index in gcodeParams, and where
+// it is in the arguments (M32 and M33 compare it with the filename's)
+static uint8_t seen_param;
 static char* seen_pointer;
 
+#if ENABLED(SDSUPPORT) && ENABLED(BINGCODE_DIRECT)
+  // Binary command being processed (copied out of the queue for alignment)
+  static binGcodeRecord bin_record;
+  static bool bin_record_active = false;
+  #define BIN_RECORD_ACTIVE bin_record_active
+#else
+  #define BIN_RECORD_ACTIVE false
+#endif
+
 // Next Immediate GCode Command pointer. NULL if none.
 const char* queued_commands_P = NULL;
 
@@ -547,8 +583,6 @@ static uint8_t target_extruder;
   #endif
 #endif
 
-static bool send_ok[BUFSIZE];
-
 #if HAS_SERVOS
   Servo servo[NUM_SERVOS];
   #define MOVE_SERVO(I, P) servo[I].move(P)
@@ -611,6 +645,9 @@ static void report_current_position();
 //This does outputs lowercase xyz, so it is not parsed by pronterface
 static void report_current_position2(float position[],long stepper_position[]);
 static float calc_delta_adjust(const float cartesian[3]);
+#if ENABLED(DELTA_FIXED_POINT)
+  static void inverse_kinematics_float(const float cartesian[3]);
+#endif
 
 #if ENABLED(DEBUG_LEVELING_FEATURE)
   void print_xyz(const char* prefix, const char* suffix, const float x, const float y, const float z) {
@@ -712,18 +749,52 @@ void enqueue_and_echo_commands_P(const char* pgcode) {
   drain_queued_commands_P(); // first command executed asap (when possible)
 }
 
+#if ENABLED(POWER_LOSS_JOURNAL)
+  static PrintJournalRecord resume_record;  // M1000's, its commands are made from it
+  static uint8_t resume_step = 0;           // the next of them to queue, 0 when none remain
+#endif
+
 void clear_command_queue() {
   cmd_queue_index_r = cmd_queue_index_w;
   commands_in_queue = 0;
+  #if ENABLED(POWER_LOSS_JOURNAL)
+    p_card->journal.unmark();
+    resume_step = 0;
+  #endif
+}
+
+// The header after the command with its header at index
+static FORCE_INLINE uint16_t cmd_queue_next(const uint16_t index) {
+  const uint16_t next = index + 1 + ((uint8_t)command_queue[index] & ~CMD_SEND_OK);
+  return next > CMD_QUEUE_SIZE - CMD_RECORD_MAX ? 0 : next;
+}
+
+// Room for a command of MAX_CMD_SIZE at the write end?
+static FORCE_INLINE bool cmd_queue_has_space() {
+  return !commands_in_queue || cmd_queue_index_w > cmd_queue_index_r
+      || cmd_queue_index_r - cmd_queue_index_w >= CMD_RECORD_MAX;
+}
+
+// Where the next command goes, MAX_CMD_SIZE bytes when cmd_queue_has_space()
+static FORCE_INLINE char* cmd_queue_slot() { return &command_queue[cmd_queue_index_w + 1]; }
+
+// Bytes held, with those skipped at the end of the ring
+static uint16_t cmd_queue_bytes() {
+  if (!commands_in_queue) return 0;
+  return cmd_queue_index_w > cmd_queue_index_r ? cmd_queue_index_w - cmd_queue_index_r
+                                               : CMD_QUEUE_SIZE - cmd_queue_index_r + cmd_queue_index_w;
 }
 
 /**
- * Once a new command is in the ring buffer, call this to commit it
+ * Once a new command of length bytes (without its nul) is in the slot
+ * of the ring buffer, call this to commit it
  */
-inline void _commit_command(bool say_ok) {
-  send_ok[cmd_queue_index_w] = say_ok;
-  cmd_queue_index_w = (cmd_queue_index_w + 1) % BUFSIZE;
+inline void _commit_command(bool say_ok, uint8_t length) {
+  command_queue[cmd_queue_index_w] = (say_ok ? CMD_SEND_OK : 0) | (length + 1);
+  cmd_queue_index_w = cmd_queue_next(cmd_queue_index_w);
   commands_in_queue++;
+  NOLESS(cmd_queue_peak_commands, commands_in_queue);
+  NOLESS(cmd_queue_peak_bytes, cmd_queue_bytes());
 }
 
 /**
@@ -731,9 +802,12 @@ inline void _commit_command(bool say_ok) {
  * Returns true if successfully adds the command
  */
 inline bool _enqueuecommand(const char* cmd, bool say_ok=false) {
-  if (*cmd == ';' || commands_in_queue >= BUFSIZE) return false;
-  strcpy(command_queue[cmd_queue_index_w], cmd);
-  _commit_command(say_ok);
+  if (*cmd == ';' || !cmd_queue_has_space()) return false;
+  const uint8_t length = min(strlen(cmd), MAX_CMD_SIZE - 1);
+  char* slot = cmd_queue_slot();
+  memcpy(slot, cmd, length);
+  slot[length] = '\0';
+  _commit_command(say_ok, length);
   return true;
 }
 
@@ -755,6 +829,61 @@ bool enqueue_and_echo_command(const char* cmd, bool say_ok/*=false*/) {
   return false;
 }
 
+#if ENABLED(POWER_LOSS_JOURNAL)
+
+  /**
+   * Queue the next command M1000 resumes the print with, when there is
+   * room. They are made one at a time, from the record; the name of the
+   * file is read from the journal again. Return true if any remain.
+   */
+  static bool drain_resume_commands() {
+    const PrintJournalRecord &r = resume_record;
+    char cmd[MAX_CMD_SIZE];
+    while (resume_step) {
+      cmd[0] = '\0';
+      switch (resume_step) {
+        case 1: if (r.bed > 0) sprintf_P(cmd, PSTR("M190 S%i"), r.bed); break;
+        case 2: if (r.hotend > 0) sprintf_P(cmd, PSTR("M109 S%i"), r.hotend); break;
+        case 3: strcpy_P(cmd, PSTR("G28")); break;
+        case 4: strcpy_P(cmd, PSTR("G90")); break;
+        case 5:
+          sprintf_P(cmd, PSTR("G1 X%.3f Y%.3f Z%.3f F%i"), r.position[X_AXIS], r.position[Y_AXIS],
+                    r.position[Z_AXIS] + PRINT_JOURNAL_CLEARANCE, (int)homing_feedrate_mm_m[X_AXIS]);
+          break;
+        case 6: sprintf_P(cmd, PSTR("G1 Z%.3f"), r.position[Z_AXIS]); break;
+        case 7: sprintf_P(cmd, PSTR("G92 E%.5f"), r.position[E_AXIS]); break;
+        case 8: sprintf_P(cmd, PSTR("M106 S%i"), r.fan); break;
+        case 9: sprintf_P(cmd, PSTR("G1 F%.3f"), r.feedrate_mm_m); break;
+        case 10: if (r.flags & PRINT_JOURNAL_RELATIVE) strcpy_P(cmd, PSTR("G91")); break;
+        case 11: if (r.flags & PRINT_JOURNAL_RELATIVE_E) strcpy_P(cmd, PSTR("M83")); break;
+        case 12: {
+          PrintJournalRecord again;
+          strcpy_P(cmd, PSTR("M23 "));
+          if (!p_card->lastPrint(&again, cmd + 4) || again.sdpos != r.sdpos) {
+            SERIAL_ERROR_START;
+            SERIAL_ERRORLNPGM(MSG_RESUME_NONE);
+            resume_step = 0;
+            return false;
+          }
+        } break;
+        case 13: sprintf_P(cmd, PSTR("M26 S%lu"), (unsigned long)r.sdpos); break;
+        case 14: strcpy_P(cmd, PSTR("M24")); break;
+      }
+      if (cmd[0] && !enqueue_and_echo_command(cmd)) break;  // no room yet
+      resume_step = resume_step < 14 ? resume_step + 1 : 0;
+    }
+    return resume_step;
+  }
+
+  // The state the marked SD command is executed in, for the journal
+  static void journal_take() {
+    p_card->journal.take(planner.block_buffer_head, current_position, feedrate_mm_m,
+                         thermalManager.degTargetHotend(0), thermalManager.degTargetBed(), fanSpeeds[0],
+                         (relative_mode ? PRINT_JOURNAL_RELATIVE : 0) | (axis_relative_modes[E_AXIS] ? PRINT_JOURNAL_RELATIVE_E : 0));
+  }
+
+#endif // POWER_LOSS_JOURNAL
+
 void setup_killpin() {
   #if HAS_KILL
     SET_INPUT(KILL_PIN);
@@ -940,9 +1069,6 @@ void setup() {
     #endif // STRING_CONFIG_H_AUTHOR
   #endif // STRING_DISTRIBUTION_DATE
 
-  // Send "ok" after commands by default
-  for (int8_t i = 0; i < BUFSIZE; i++) send_ok[i] = true;
-
   // Reset parameters to default values
   Config_ResetDefault();
 
@@ -1044,7 +1170,7 @@ void setup() {
  *  - Call LCD update
  */
 void loop() {
-  if (commands_in_queue < BUFSIZE) get_available_commands();
+  if (cmd_queue_has_space()) get_available_commands();
 
   #if ENABLED(SDSUPPORT)
     p_card->checkautostart(false);
@@ -1056,10 +1182,13 @@ void loop() {
   if (commands_in_queue) {
 #endif
 
+    // How full the queue is as the command is taken, for M932
+    cmd_queue_histogram[(uint32_t)cmd_queue_bytes() * CMD_QUEUE_HISTOGRAM_BINS / (CMD_QUEUE_SIZE + 1)]++;
+
     #if ENABLED(SDSUPPORT)
 
       if (p_card->saving) {
-        char* command = command_queue[cmd_queue_index_r];
+        char* command = &command_queue[cmd_queue_index_r + 1];
         if (strstr_P(command, PSTR("M29"))) {
           // M29 closes the file
           p_card->closefile();
@@ -1077,8 +1206,12 @@ void loop() {
             ok_to_send();
         }
       }
-      else
+      else {
+        #if ENABLED(POWER_LOSS_JOURNAL)
+          if (p_card->journal.isMarked(cmd_queue_index_r)) journal_take();
+        #endif
         process_next_command();
+      }
 
     #else
 
@@ -1089,7 +1222,7 @@ void loop() {
     // The queue may be reset by a command handler or by code invoked by idle() within a handler
     if (commands_in_queue) {
       --commands_in_queue;
-      cmd_queue_index_r = (cmd_queue_index_r + 1) % BUFSIZE;
+      cmd_queue_index_r = cmd_queue_next(cmd_queue_index_r);
     }
   }
   endstops.report_state();
@@ -1105,10 +1238,79 @@ void gcode_line_error(const char* err, bool doFlush = true) {
   serial_count = 0;
 }
 
-inline void get_serial_commands() {
-  static char serial_line_buffer[MAX_CMD_SIZE];
-  static boolean serial_comment_mode = false;
+/**
+ * Check the line number and checksum of a command from the host, where
+ * apos is its '*' (or NULL) and checksum the XOR of the bytes before it,
+ * and act on the e-stop commands. Returns false, with the error sent, if
+ * the command must be dropped.
+ */
+static bool check_serial_command(const char* command, const char* apos, byte checksum) {
+  const char* npos = (*command == 'N') ? command : NULL; // Require the N parameter to start the line
+
+  if (npos) {
+
+    boolean M110 = strstr_P(command, PSTR("M110")) != NULL;
+
+    if (M110) {
+      const char* n2pos = strchr(command + 4, 'N');
+      if (n2pos) npos = n2pos;
+    }
+
+    gcode_N = strtol(npos + 1, NULL, 10);
+
+    if (gcode_N != gcode_LastN + 1 && !M110) {
+      gcode_line_error(PSTR(MSG_ERR_LINE_NO));
+      return false;
+    }
+
+    if (apos) {
+      if (strtol(apos + 1, NULL, 10) != checksum) {
+        gcode_line_error(PSTR(MSG_ERR_CHECKSUM_MISMATCH));
+        return false;
+      }
+      // if no errors, continue parsing
+    }
+    else {
+      gcode_line_error(PSTR(MSG_ERR_NO_CHECKSUM));
+      return false;
+    }
+
+    gcode_LastN = gcode_N;
+    // if no errors, continue parsing
+  }
+  else if (apos) { // No '*' without 'N'
+    gcode_line_error(PSTR(MSG_ERR_NO_LINENUMBER_WITH_CHECKSUM), false);
+    return false;
+  }
+
+  // Movement commands alert when stopped
+  if (IsStopped()) {
+    const char* gpos = strchr(command, 'G');
+    if (gpos) {
+      int codenum = strtol(gpos + 1, NULL, 10);
+      switch (codenum) {
+        case 0:
+        case 1:
+        case 2:
+        case 3:
+          SERIAL_ERRORLNPGM(MSG_ERR_STOPPED);
+          LCD_MESSAGEPGM(MSG_STOPPED);
+          break;
+      }
+    }
+  }
+
+  #if DISABLED(EMERGENCY_PARSER)
+    // If command was e-stop process now
+    if (strcmp(command, "M108") == 0) wait_for_heatup = false;
+    if (strcmp(command, "M112") == 0) kill(PSTR(MSG_KILLED));
+    if (strcmp(command, "M410") == 0) { quickstop_stepper(); }
+  #endif
 
+  return true;
+}
+
+inline void get_serial_commands() {
   // If the command buffer is empty for too long,
   // send "wait" to indicate Marlin is still waiting.
   #if defined(NO_TIMEOUTS) && NO_TIMEOUTS > 0
@@ -1120,10 +1322,52 @@ inline void get_serial_commands() {
     }
   #endif
 
+#ifdef STM32_USE_USB_CDC
+
+  /**
+   * The CDC layer counts the line ends as packets arrive: move each
+   * complete line straight into the free slot of the queue, then in one
+   * pass in place skip the leading spaces, take out the escapes and the
+   * comment, and checksum the bytes before the '*'
+   */
+  while (cmd_queue_has_space()) {
+    char* command = cmd_queue_slot();
+    if (MYSERIAL.readLine((uint8_t*)command, MAX_CMD_SIZE) < 0) break;
+
+    const char* r = command;
+    while (*r == ' ') r++;
+    char* w = command;
+    char* apos = NULL;
+    byte checksum = 0;
+    for (char c; (c = *r++) && c != ';';) {
+      if (c == '\\' && !(c = *r++)) break; // an escaped character is taken as it is
+      if (c == '*' && !apos) apos = w;
+      if (!apos) checksum ^= c;
+      *w++ = c;
+    }
+    *w = '\0';
+
+    if (w == command) continue; // skip empty lines
+
+    if (!check_serial_command(command, apos, checksum)) return;
+
+    #if defined(NO_TIMEOUTS) && NO_TIMEOUTS > 0
+      last_command_time = ms;
+    #endif
+
+    // The command is in the queue already
+    _commit_command(true, w - command);
+  }
+
+#else
+
+  static char serial_line_buffer[MAX_CMD_SIZE];
+  static boolean serial_comment_mode = false;
+
   /**
    * Loop while serial characters are incoming and the queue is not full
    */
-  while (commands_in_queue < BUFSIZE && MYSERIAL.available() > 0) {
+  while (cmd_queue_has_space() && MYSERIAL.available() > 0) {
 
     char serial_char = MYSERIAL.read();
 
@@ -1142,71 +1386,11 @@ inline void get_serial_commands() {
       char* command = serial_line_buffer;
 
       while (*command == ' ') command++; // skip any leading spaces
-      char* npos = (*command == 'N') ? command : NULL; // Require the N parameter to start the line
       char* apos = strchr(command, '*');
+      byte checksum = 0;
+      if (apos) for (char* p = command; p < apos; p++) checksum ^= *p;
 
-      if (npos) {
-
-        boolean M110 = strstr_P(command, PSTR("M110")) != NULL;
-
-        if (M110) {
-          char* n2pos = strchr(command + 4, 'N');
-          if (n2pos) npos = n2pos;
-        }
-
-        gcode_N = strtol(npos + 1, NULL, 10);
-
-        if (gcode_N != gcode_LastN + 1 && !M110) {
-          gcode_line_error(PSTR(MSG_ERR_LINE_NO));
-          return;
-        }
-
-        if (apos) {
-          byte checksum = 0, count = 0;
-          while (command[count] != '*') checksum ^= command[count++];
-
-          if (strtol(apos + 1, NULL, 10) != checksum) {
-            gcode_line_error(PSTR(MSG_ERR_CHECKSUM_MISMATCH));
-            return;
-          }
-          // if no errors, continue parsing
-        }
-        else {
-          gcode_line_error(PSTR(MSG_ERR_NO_CHECKSUM));
-          return;
-        }
-
-        gcode_LastN = gcode_N;
-        // if no errors, continue parsing
-      }
-      else if (apos) { // No '*' without 'N'
-        gcode_line_error(PSTR(MSG_ERR_NO_LINENUMBER_WITH_CHECKSUM), false);
-        return;
-      }
-
-      // Movement commands alert when stopped
-      if (IsStopped()) {
-        char* gpos = strchr(command, 'G');
-        if (gpos) {
-          int codenum = strtol(gpos + 1, NULL, 10);
-          switch (codenum) {
-            case 0:
-            case 1:
-            case 2:
-            case 3:
-              SERIAL_ERRORLNPGM(MSG_ERR_STOPPED);
-              LCD_MESSAGEPGM(MSG_STOPPED);
-              break;
-          }
-        }
-      }
-
-      #if DISABLED(EMERGENCY_PARSER)
-        // If command was e-stop process now
-        if (strcmp(command, "M108") == 0) wait_for_heatup = false;
-        if (strcmp(command, "M112") == 0) kill(PSTR(MSG_KILLED));
-        if (strcmp(command, "M410") == 0) { quickstop_stepper(); }
-      #endif
+      if (!check_serial_command(command, apos, checksum)) return;
 
       #if defined(NO_TIMEOUTS) && NO_TIMEOUTS > 0
         last_command_time = ms;
@@ -1233,10 +1417,21 @@ inline void get_serial_commands() {
     }
 
   } // queue has space, serial has data
+
+#endif // STM32_USE_USB_CDC
 }
 
 #if ENABLED(SDSUPPORT)
 
+  // The file can't be read on: the print is stopped as M524 does, not finished
+  static void sd_read_failed() {
+    SERIAL_ERROR_START;
+    SERIAL_ERRORLNPGM(MSG_SD_ERR_GZIP);
+    p_card->stopSDPrint();
+    p_card->isBinaryMode = false;
+    binGcodePar::resetBuff();
+  }
+
   inline void get_sdcard_commands() {
     static bool stop_buffering = false,
                 sd_comment_mode = false;
@@ -1253,11 +1448,22 @@ inline void get_serial_commands() {
     if (commands_in_queue == 0) stop_buffering = false;
 
     uint16_t sd_count = 0;
+    #if ENABLED(POWER_LOSS_JOURNAL)
+      uint32_t sd_command_pos = 0;  // in the file, for the journal
+    #endif
     bool card_eof = p_card->eof();
-    while (commands_in_queue < BUFSIZE && !card_eof && !stop_buffering) {
+    while (cmd_queue_has_space() && !card_eof && !stop_buffering) {
       if(!p_card->isBinaryMode) {
+		  #if ENABLED(POWER_LOSS_JOURNAL)
+		    if (!sd_count) sd_command_pos = p_card->sdpos;
+		  #endif
 		  int16_t n = p_card->get();
 		  char sd_char = (char)n;
+		  if (n == -1 && p_card->failed()) {
+			sd_comment_mode = false;
+			sd_read_failed();  // the line it stopped in is dropped
+			return;
+		  }
 		  card_eof = p_card->eof();
 		  if (card_eof || n == -1
 			  || sd_char == '\n' || sd_char == '\r'
@@ -1279,10 +1485,12 @@ inline void get_serial_commands() {
 
 			if (!sd_count) continue; //skip empty lines
 
-			command_queue[cmd_queue_index_w][sd_count] = '\0'; //terminate string
+			cmd_queue_slot()[sd_count] = '\0'; //terminate string
+			#if ENABLED(POWER_LOSS_JOURNAL)
+			  p_card->journal.mark(sd_command_pos, cmd_queue_index_w);
+			#endif
+			_commit_command(false, sd_count);
 			sd_count = 0; //clear buffer
-
-			_commit_command(false);
 		  } //if(card_eof || n==-1
 		  else if (sd_count >= MAX_CMD_SIZE - 1) {
 			/**
@@ -1292,13 +1500,20 @@ inline void get_serial_commands() {
 		  }
 		  else {
 			if (sd_char == ';') sd_comment_mode = true;
-			if (!sd_comment_mode) command_queue[cmd_queue_index_w][sd_count++] = sd_char;
+			if (!sd_comment_mode) cmd_queue_slot()[sd_count++] = sd_char;
 		  } //else(card_eof || n==-1
       	}// if(!p_card->isBinaryMode)
 		else{
 			char buff[81]="";
 			int bytesCopied = -1;
+			#if ENABLED(POWER_LOSS_JOURNAL)
+			  sd_command_pos = p_card->sdpos;
+			#endif
 			bytesCopied = p_card->read_buff((unsigned char *)buff,80);
+			if(p_card->failed()) {
+			  sd_read_failed();  // the last record read may be cut short
+			  return;
+			}
 			if(bytesCopied==0) {
 			  SERIAL_PROTOCOLLNPGM(MSG_FILE_PRINTED);
 			  p_card->printingHasFinished();
@@ -1314,15 +1529,22 @@ inline void get_serial_commands() {
 				static binGcodeCommand gc2;
 				gc1.decodeBinGcode(rp,gc2);
 				gc2.decodeBinGcode(pStart,gc2);
-				int sd_count = gc1.writeGcode(command_queue[cmd_queue_index_w]);
+				#if ENABLED(BINGCODE_DIRECT)
+				int sd_count = gc1.isDirect() ? gc1.writeRecord(cmd_queue_slot())
+				                              : gc1.writeGcode(cmd_queue_slot());
+				#else
+				int sd_count = gc1.writeGcode(cmd_queue_slot());
+				#endif
 				p_card->push_read_buff(bytesCopied-((char *)rp-buff));
 
-				command_queue[cmd_queue_index_w][sd_count] = '\0'; //terminate string
-				sd_count = 0; //clear buffer
-				_commit_command(false);
+				cmd_queue_slot()[sd_count] = '\0'; //terminate string
+				#if ENABLED(POWER_LOSS_JOURNAL)
+				  p_card->journal.mark(sd_command_pos, cmd_queue_index_w);
+				#endif
+				_commit_command(false, sd_count);
 			}
 		}// else(if(!p_card->isBinaryMode))
-      } //while (commands_in_queue < BUFSIZE && !card_eof && !stop_buffering)
+      } //while (cmd_queue_has_space() && !card_eof && !stop_buffering)
     if(card_eof && p_card->isBinaryMode && p_card->sdprinting) {
 		  SERIAL_PROTOCOLLNPGM(MSG_FILE_PRINTED);
 		  p_card->printingHasFinished();
@@ -1345,6 +1567,10 @@ void get_available_commands() {
   // if any immediate commands remain, don't get other commands yet
   if (drain_queued_commands_P()) return;
 
+  #if ENABLED(POWER_LOSS_JOURNAL)
+    if (drain_resume_commands()) return;
+  #endif
+
   get_serial_commands();
 
   //Kick uart tx queue
@@ -1359,37 +1585,20 @@ void get_available_commands() {
   #endif
 }
 
-inline bool code_has_value() {
-  int i = 1;
-  char c = seen_pointer[i];
-  while (c == ' ') c = seen_pointer[++i];
-  if (c == '-' || c == '+') c = seen_pointer[++i];
-  if (c == '.') c = seen_pointer[++i];
-  return NUMERIC(c);
-}
+inline bool code_has_value() { return TEST(gcodeParams.has_value, seen_param); }
 
-inline float code_value_float() {
-  float ret;
-  char* e = strchr(seen_pointer, 'E');
-  if (e) {
-    *e = 0;
-    ret = strtod(seen_pointer + 1, NULL);
-    *e = 'E';
-  }
-  else
-    ret = strtod(seen_pointer + 1, NULL);
-  return ret;
-}
+inline float code_value_float() { return gcodeParams.value[seen_param]; }
 
-inline unsigned long code_value_ulong() { return strtoul(seen_pointer + 1, NULL, 10); }
+// integers from the text, exact past the 24 bits of a float
+inline long code_value_long() { return BIN_RECORD_ACTIVE ? (long)code_value_float() : gcodeParams.parse_long(seen_pointer + 1); }
 
-inline long code_value_long() { return strtol(seen_pointer + 1, NULL, 10); }
+inline unsigned long code_value_ulong() { return (unsigned long)code_value_long(); }
 
-inline int code_value_int() { return (int)strtol(seen_pointer + 1, NULL, 10); }
+inline int code_value_int() { return (int)code_value_long(); }
 
-inline uint16_t code_value_ushort() { return (uint16_t)strtoul(seen_pointer + 1, NULL, 10); }
+inline uint16_t code_value_ushort() { return (uint16_t)code_value_ulong(); }
 
-inline uint8_t code_value_byte() { return (uint8_t)(constrain(strtol(seen_pointer + 1, NULL, 10), 0, 255)); }
+inline uint8_t code_value_byte() { return (uint8_t)(constrain(code_value_long(), 0, 255)); }
 
 inline bool code_value_bool() { return code_value_byte() > 0; }
 
@@ -1459,8 +1668,10 @@ FORCE_INLINE millis_t code_value_millis() { return code_value_ulong(); }
 inline millis_t code_value_millis_from_seconds() { return code_value_float() * 1000; }
 
 bool code_seen(char code) {
-  seen_pointer = strchr(current_command_args, code);
-  return (seen_pointer != NULL); // Return TRUE if the code-letter was found
+  seen_param = gcodeParams.find(code);
+  if (seen_param == GCODE_PARAM_LETTERS) return false;
+  seen_pointer = current_command_args + gcodeParams.offset[seen_param];
+  return true; // Return TRUE if the code-letter was found
 }
 
 /**
@@ -4422,15 +4633,31 @@ inline void gcode_M17() {
     p_card->release();
   }
 
+  /**
+   * Pick the SD reading mode from the file name, once as M23/M32 open it:
+   *  .bgc*            binary gcode
+   *  .gcode.gz .g.gz  text gcode, inflated while printing (UZLIB)
+   *  .bgc.gz          binary gcode, inflated while printing (UZLIB)
+   */
+  static void set_sd_file_mode(const char *name) {
+    const char *ext = strrchr(name, '.');
+    p_card->isGzip = false;
+    #if ENABLED(UZLIB)
+      if (ext && ext > name && strncasecmp(ext, ".gz", 3) == 0) {
+        p_card->isGzip = true;
+        const char *gz = ext;
+        while (--ext > name && *ext != '.') ;
+        if (*ext != '.') ext = gz;
+      }
+    #endif
+    p_card->isBinaryMode = (ext && strncasecmp(ext + 1, "bgc", 3) == 0);
+  }
+
   /**
    * M23: Open a file
    */
   inline void gcode_M23() {
-	const char *ext  = strrchr(current_command_args,'.')+1;
-	if(strncmp(ext,"bgc",3)==0 || strncmp(ext,"BGC",3)==0)
-		p_card->isBinaryMode = true;
-	else
-		p_card->isBinaryMode = false;
+	set_sd_file_mode(current_command_args);
     p_card->openFile(current_command_args, true);
   }
 
@@ -4438,11 +4665,6 @@ inline void gcode_M17() {
    * M24: Start SD Print
    */
   inline void gcode_M24() {
-	const char *ext  = strrchr(p_card->filename,'.')+1;
-	if(strncmp(ext,"bgc",3)==0 || strncmp(ext,"BGC",3)==0)
-		p_card->isBinaryMode = true;
-	else
-		p_card->isBinaryMode = false;
 #if ENABLED(MALYAN_LCD)
 	lcd_setstatuspgm(PSTR(MSG_RESUME));
     p_card->startFileprint();
@@ -4541,11 +4763,7 @@ inline void gcode_M31() {
       namestartpos = current_command_args; // Default name position, 4 letters after the M
     else
       namestartpos++; //to skip the '!'
-	const char *ext  = strrchr(namestartpos,'.')+1;
-	if(strncmp(ext,"bgc",3)==0 || strncmp(ext,"BGC",3)==0)
-		p_card->isBinaryMode = true;
-	else
-		p_card->isBinaryMode = false;
+	set_sd_file_mode(namestartpos);
     bool call_procedure = code_seen('P') && (seen_pointer < namestartpos);
 
     if (p_card->cardOK) {
@@ -4585,6 +4803,9 @@ inline void gcode_M31() {
      * M34: Start Binary SD Write
      * to mark end of transmission, host must wait 1 second idle, and then send full M29\r\n 
      * string within 1 second
+     *
+     * M34 F S<size> !filename: the file comes in CRC checked frames instead,
+     * the last one empty, see sd_upload.h
      */
     enum M34_state {
     	M34_IDLE, //No M29 reception
@@ -4594,6 +4815,22 @@ inline void gcode_M31() {
 		M34_RX //Matched whole string
     };
 	#define M34_TIMEOUT 1000
+
+    static uint32_t m34_read(uint8_t *buff, uint32_t maxlen) { return MYSERIAL.read(buff, maxlen); }
+    static void m34_reply(const char *msg, const uint8_t seq) { serialprintPGM(msg); SERIAL_PROTOCOLLN((int)seq); }
+    static bool m34_write(const uint8_t *buff, const uint16_t len) { return p_card->write_buff((unsigned char *)buff, len); }
+    static void m34_idle() { lcd_update(); }
+    static millis_t m34_now() { return millis(); }
+
+    static void m34_frames() {
+      const SdUploadIO io = { m34_read, m34_reply, m34_write, m34_idle, m34_now };
+      SdUpload upload;
+      if (upload.receive(io, p_card->saveBuffers()) < 0) {
+        SERIAL_ERROR_START;
+        SERIAL_ERRORLNPGM(MSG_ERR_M34_ABORTED);
+      }
+    }
+
     inline void gcode_M34() {
       unsigned char SDbuff[512] = "";
       int filesize = -1;
@@ -4612,7 +4849,8 @@ inline void gcode_M31() {
     	  lcd_setstatuspgm(PSTR(MSG_RESUMED));    	  
       } //code_seen('S')
 #endif //ENABLED(MALYAN_LCD)
-      uint8_t M34_state = M34_IDLE;
+      const bool framed = code_seen('F') && (seen_pointer < namestartpos);
+      uint8_t M34_state = framed ? M34_RX : M34_IDLE;
       p_card->openFile(namestartpos, false);
       if(!p_card->saving)
     	  return;
@@ -4622,6 +4860,8 @@ inline void gcode_M31() {
       MYSERIAL.flush();
       SERIAL_PROTOCOLPGM(MSG_OK);
       SERIAL_EOL;
+      if (framed)
+        m34_frames();
       uint32_t last_rx = millis();
       uint16_t SD_idx = 0;
       const char M29_CMD[] = "M29\r\n";
@@ -4732,6 +4972,7 @@ inline void gcode_M31() {
     		strncpy(filename,current_command_args,ext-current_command_args);
     		filename[ext-current_command_args] = '\0';
 			decompress_gzip(current_command_args,filename);
+			p_card->dirChanged();  // the file it made
 	//    	unsigned int fsize = p_card->filesize;
 			volatile uint32_t total = millis()-start;
 			SERIAL_PROTOCOLLNPGM("decompression took ");
@@ -6101,6 +6342,7 @@ inline void gcode_M204() {
  *    X = Max XY Jerk (units/sec^2)
  *    Z = Max Z Jerk (units/sec^2)
  *    E = Max E Jerk (units/sec^2)
+ *    J = Junction Deviation (units), 0 for the X and Z jerk limits
  */
 inline void gcode_M205() {
   if (code_seen('S')) planner.min_feedrate_mm_s = code_value_linear_units();
@@ -6109,6 +6351,10 @@ inline void gcode_M205() {
   if (code_seen('X')) planner.max_xy_jerk = code_value_linear_units();
   if (code_seen('Z')) planner.max_z_jerk = code_value_axis_units(Z_AXIS);
   if (code_seen('E')) planner.max_e_jerk = code_value_axis_units(E_AXIS);
+  if (code_seen('J')) {
+    planner.junction_deviation_mm = code_value_linear_units();
+    NOLESS(planner.junction_deviation_mm, 0);
+  }
 }
 
 /**
@@ -6169,6 +6415,12 @@ inline void gcode_M665() {
     if (code_seen('Y')) delta_tower_angle_trim[B_AXIS] = code_value_float();
     if (code_seen('Z')) delta_tower_angle_trim[C_AXIS] = code_value_float();
     recalc_delta_settings(delta_radius, delta_diagonal_rod);
+    #if ENABLED(DELTA_FIXED_POINT)
+      if (!deltaFixed.fits) {
+        SERIAL_ECHO_START;
+        SERIAL_ECHOLNPGM(MSG_DELTA_FLOAT_KINEMATICS);
+      }
+    #endif
   }
   /**
    * M666: Set delta endstop adjustment
@@ -7511,6 +7763,190 @@ inline void gcode_M907() {
 
 #endif // MIXING_EXTRUDER
 
+#if ENABLED(STEPPER_TRACE)
+
+  /**
+   * M930: Stepper step timeline trace
+   *
+   *   S1 Clear the trace and start recording (keeps the newest events)
+   *   S2 Clear and start, stop half a buffer after the planner queue runs dry
+   *   S0 Stop recording
+   *
+   * With no S the recording is stopped and dumped as "trace:" lines,
+   * decoded by sim/trace_analyze.
+   */
+  inline void gcode_M930() {
+    if (code_seen('S')) {
+      const int s = code_value_int();
+      if (s) stepperTrace.start(s == 2); else stepperTrace.stop();
+    }
+    else
+      stepperTrace.report();
+  }
+
+#endif // STEPPER_TRACE
+
+#if ENABLED(DELTA_FIXED_POINT)
+
+  /**
+   * M931: Delta kinematics benchmark
+   *
+   *   S<count> Positions to time, spread over the printable radius (default 100)
+   *
+   * Reports the CPU cycles per segment (inverse_kinematics() and
+   * adjust_delta()) of the fixed point version and of the float version,
+   * counted on the Tick timer with interrupts off. Waits for the moves in
+   * the planner to finish first.
+   */
+  inline void gcode_M931() {
+    const uint16_t count = code_seen('S') ? max(1, code_value_int()) : 100;
+    const float saved[3] = { delta[TOWER_1], delta[TOWER_2], delta[TOWER_3] };
+    uint32_t ticks[2] = { 0, 0 };
+
+    stepper.synchronize();
+    for (uint16_t i = 0; i < count; i++) {
+      // a spiral from the center out to the edge, on a slope
+      const float r = DELTA_PRINTABLE_RADIUS * (i + 1) / count, a = i * 2.4;
+      float cartesian[3] = { LOGICAL_X_POSITION(r * cos(a)), LOGICAL_Y_POSITION(r * sin(a)), LOGICAL_Z_POSITION(r * 0.5) };
+      const float raw[3] = { RAW_X_POSITION(cartesian[X_AXIS]), RAW_Y_POSITION(cartesian[Y_AXIS]), RAW_Z_POSITION(cartesian[Z_AXIS]) };
+      for (uint8_t fixed = 0; fixed < 2; fixed++) {
+        CRITICAL_SECTION_START;
+        const uint16_t start = BSP_MiscTickGetCounter();
+        if (fixed) {
+          inverse_kinematics(cartesian);
+          #if ENABLED(AUTO_BED_LEVELING_FEATURE)
+            adjust_delta(cartesian);
+          #endif
+        }
+        else {
+          // inverse_kinematics() and adjust_delta() without DELTA_FIXED_POINT
+          inverse_kinematics_float(raw);
+          const float offset = calc_delta_adjust(cartesian);
+          if (!isnanf(offset)) {
+            delta[TOWER_1] += offset;
+            delta[TOWER_2] += offset;
+            delta[TOWER_3] += offset;
+          }
+        }
+        ticks[fixed] += (uint16_t)(BSP_MiscTickGetCounter() - start);
+        CRITICAL_SECTION_END;
+      }
+    }
+    delta[TOWER_1] = saved[TOWER_1];
+    delta[TOWER_2] = saved[TOWER_2];
+    delta[TOWER_3] = saved[TOWER_3];
+
+    SERIAL_PROTOCOLPGM("Cycles per segment fixed:");
+    SERIAL_PROTOCOL(ticks[1] * TICK_TIMER_PRESCALER / count);
+    SERIAL_PROTOCOLPGM(" float:");
+    SERIAL_PROTOCOLLN(ticks[0] * TICK_TIMER_PRESCALER / count);
+  }
+
+#endif // DELTA_FIXED_POINT
+
+/**
+ * M932: Command queue occupancy
+ *
+ *   S0 Clear the counts
+ *
+ * Reports how many commands were taken from the queue with it 0 to 12%
+ * full, 12 to 25% and so on in eighths of the CMD_QUEUE_SIZE bytes, and
+ * the most bytes and commands it has held. A print that takes most of
+ * them near the top needs no deeper queue; many near 0 and the host or
+ * the SD card is falling behind.
+ */
+inline void gcode_M932() {
+  if (code_seen('S') && !code_value_int()) {
+    memset(cmd_queue_histogram, 0, sizeof(cmd_queue_histogram));
+    cmd_queue_peak_bytes = cmd_queue_peak_commands = 0;
+    return;
+  }
+  SERIAL_PROTOCOLPGM("Queue size:");
+  SERIAL_PROTOCOL(CMD_QUEUE_SIZE);
+  SERIAL_PROTOCOLPGM(" peak bytes:");
+  SERIAL_PROTOCOL(cmd_queue_peak_bytes);
+  SERIAL_PROTOCOLPGM(" commands:");
+  SERIAL_PROTOCOLLN((int)cmd_queue_peak_commands);
+  SERIAL_PROTOCOLPGM("Queue taken at");
+  for (uint8_t i = 0; i < CMD_QUEUE_HISTOGRAM_BINS; i++) {
+    SERIAL_PROTOCOL(' ');
+    SERIAL_PROTOCOL(i * 100 / CMD_QUEUE_HISTOGRAM_BINS);
+    SERIAL_PROTOCOLPGM("%:");
+    SERIAL_PROTOCOL(cmd_queue_histogram[i]);
+  }
+  SERIAL_EOL;
+}
+
+#if ENABLED(SDSUPPORT)
+
+  /**
+   * M933: SD read-ahead
+   *
+   *   S0 Clear the counts
+   *
+   * Reports how many sectors of the file printed were read ahead, from
+   * idle(), and how many the parser read itself as it found none waiting
+   * (each one holds up the main loop while the planner may be running low),
+   * and how many sectors, 0 to SD_READ_RING_SECTORS, were buffered as it
+   * started on each one. Counts near the top and few parser reads and the
+   * card keeps ahead of the print.
+   */
+  inline void gcode_M933() {
+    if (code_seen('S') && !code_value_int()) {
+      p_card->readAheadSectors = p_card->readStalls = 0;
+      memset(p_card->readRingHistogram, 0, sizeof(p_card->readRingHistogram));
+      return;
+    }
+    SERIAL_PROTOCOLPGM("Read ahead:");
+    SERIAL_PROTOCOL(p_card->readAheadSectors);
+    SERIAL_PROTOCOLPGM(" by parser:");
+    SERIAL_PROTOCOLLN(p_card->readStalls);
+    SERIAL_PROTOCOLPGM("Sectors buffered");
+    for (uint8_t i = 0; i <= SD_READ_RING_SECTORS; i++) {
+      SERIAL_PROTOCOL(' ');
+      SERIAL_PROTOCOL((int)i);
+      SERIAL_PROTOCOL(':');
+      SERIAL_PROTOCOL(p_card->readRingHistogram[i]);
+    }
+    SERIAL_EOL;
+  }
+
+#endif // SDSUPPORT
+
+#if ENABLED(POWER_LOSS_JOURNAL)
+
+  /**
+   * M1000: Resume the SD print the power-loss journal has
+   *
+   *   S0 Only report where it had got to
+   *
+   * The print is taken up at the newest record of the journal (see
+   * print_journal.h): heat the bed and the hotend to the temperatures
+   * it had, home, go over the place at PRINT_JOURNAL_CLEARANCE above it
+   * and down, set E, the fan, the feedrate and the relative modes as
+   * they were, and print the file on from the command that made the
+   * move. Not while a file is printed or written, or after the print
+   * ended.
+   */
+  inline void gcode_M1000() {
+    char name[PRINT_JOURNAL_NAME];
+    if (resume_step || !p_card->lastPrint(&resume_record, name)) {
+      SERIAL_ERROR_START;
+      SERIAL_ERRORLNPGM(MSG_RESUME_NONE);
+      return;
+    }
+    SERIAL_PROTOCOLPGM("Resume ");
+    SERIAL_PROTOCOL(name);
+    SERIAL_PROTOCOLPGM(" at:");
+    SERIAL_PROTOCOL(resume_record.sdpos);
+    SERIAL_PROTOCOLPGM(" Z:");
+    SERIAL_PROTOCOLLN(resume_record.position[Z_AXIS]);
+    if (code_seen('S') && !code_value_int()) return;
+    resume_step = 1;
+  }
+
+#endif // POWER_LOSS_JOURNAL
+
 /**
  * M999: Restart after being stopped
  *
@@ -7881,51 +8317,82 @@ inline void gcode_T(uint8_t tmp_extruder) {
  * This is called from the main loop()
  */
 void process_next_command() {
-  current_command = command_queue[cmd_queue_index_r];
+  current_command = &command_queue[cmd_queue_index_r + 1];
 
-  if (DEBUGGING(ECHO)) {
-    SERIAL_ECHO_START;
-    SERIAL_ECHOLN(current_command);
-  }
-
-  // Sanitize the current command:
-  //  - Skip leading spaces
-  //  - Bypass N[-0-9][0-9]*[ ]*
-  //  - Overwrite * with nul to mark the end
-  while (*current_command == ' ') ++current_command;
-  if (*current_command == 'N' && NUMERIC_SIGNED(current_command[1])) {
-    current_command += 2; // skip N[-0-9]
-    while (NUMERIC(*current_command)) ++current_command; // skip [0-9]*
-    while (*current_command == ' ') ++current_command; // skip [ ]*
-  }
-  char* starpos = strchr(current_command, '*');  // * should always be the last parameter
-  if (starpos) while (*starpos == ' ' || *starpos == '*') *starpos-- = '\0'; // nullify '*' and ' '
+  char command_code;
+  uint16_t codenum = 0; // define ahead of goto
+  bool code_is_good;
+
+  #if ENABLED(SDSUPPORT) && ENABLED(BINGCODE_DIRECT)
+    bin_record_active = (*current_command == BINGCODE_RECORD_MARKER);
+    if (bin_record_active) {
+      // Pre-decoded binary command: no text to sanitize or parse
+      memcpy(&bin_record, current_command, sizeof(bin_record));
+      if (DEBUGGING(ECHO)) {
+        SERIAL_ECHO_START;
+        SERIAL_CHAR(bin_record.cmdPrefix);
+        SERIAL_ECHO(bin_record.cmdCode);
+        for (uint8_t i = 0; i < bin_record.numPar; i++) {
+          SERIAL_CHAR(' ');
+          SERIAL_CHAR(bin_record.parPrefix[i]);
+          if (!isnan(bin_record.parVal[i])) SERIAL_ECHO(bin_record.parVal[i]);
+        }
+        SERIAL_EOL;
+      }
+      command_code = bin_record.cmdPrefix;
+      codenum = bin_record.cmdCode;
+      code_is_good = true;
+      current_command_args = current_command + sizeof(bin_record); // terminating nul
+      gcodeParams.clear();
+      for (uint8_t i = 0; i < bin_record.numPar; i++)
+        gcodeParams.add(bin_record.parPrefix[i], bin_record.parVal[i]);
+    }
+    else
+  #endif
+  {
+    if (DEBUGGING(ECHO)) {
+      SERIAL_ECHO_START;
+      SERIAL_ECHOLN(current_command);
+    }
 
-  char *cmd_ptr = current_command;
+    // Sanitize the current command:
+    //  - Skip leading spaces
+    //  - Bypass N[-0-9][0-9]*[ ]*
+    //  - Overwrite * with nul to mark the end
+    while (*current_command == ' ') ++current_command;
+    if (*current_command == 'N' && NUMERIC_SIGNED(current_command[1])) {
+      current_command += 2; // skip N[-0-9]
+      while (NUMERIC(*current_command)) ++current_command; // skip [0-9]*
+      while (*current_command == ' ') ++current_command; // skip [ ]*
+    }
+    char* starpos = strchr(current_command, '*');  // * should always be the last parameter
+    if (starpos) while (*starpos == ' ' || *starpos == '*') *starpos-- = '\0'; // nullify '*' and ' '
 
-  // Get the command code, which must be G, M, or T
-  char command_code = *cmd_ptr++;
+    char *cmd_ptr = current_command;
 
-  // Skip spaces to get the numeric part
-  while (*cmd_ptr == ' ') cmd_ptr++;
+    // Get the command code, which must be G, M, or T
+    command_code = *cmd_ptr++;
 
-  uint16_t codenum = 0; // define ahead of goto
+    // Skip spaces to get the numeric part
+    while (*cmd_ptr == ' ') cmd_ptr++;
 
-  // Bail early if there's no code
-  bool code_is_good = NUMERIC(*cmd_ptr);
-  if (!code_is_good) goto ExitUnknownCommand;
+    // Bail early if there's no code
+    code_is_good = NUMERIC(*cmd_ptr);
+    if (!code_is_good) goto ExitUnknownCommand;
 
-  // Get and skip the code number
-  do {
-    codenum = (codenum * 10) + (*cmd_ptr - '0');
-    cmd_ptr++;
-  } while (NUMERIC(*cmd_ptr));
+    // Get and skip the code number
+    do {
+      codenum = (codenum * 10) + (*cmd_ptr - '0');
+      cmd_ptr++;
+    } while (NUMERIC(*cmd_ptr));
 
-  // Skip all spaces to get to the first argument, or nul
-  while (*cmd_ptr == ' ') cmd_ptr++;
+    // Skip all spaces to get to the first argument, or nul
+    while (*cmd_ptr == ' ') cmd_ptr++;
 
-  // The command's arguments (if any) start here, for sure!
-  current_command_args = cmd_ptr;
+    // The command's arguments (if any) start here, for sure!
+    current_command_args = cmd_ptr;
+    gcodeParams.parse(current_command_args);
+  }
 
   KEEPALIVE_STATE(IN_HANDLER);
 
@@ -8330,7 +8797,7 @@ void process_next_command() {
       case 204: // M204 acclereration S normal moves T filmanent only moves
         gcode_M204();
         break;
-      case 205: //M205 advanced settings:  minimum travel speed S=while printing T=travel only,  B=minimum segment time X= maximum xy jerk, Z=maximum Z jerk
+      case 205: //M205 advanced settings:  minimum travel speed S=while printing T=travel only,  B=minimum segment time X= maximum xy jerk, Z=maximum Z jerk, J=junction deviation
         gcode_M205();
         break;
       case 206: // M206 additional homing offset
@@ -8574,6 +9041,34 @@ void process_next_command() {
 
       #endif // HAS_MICROSTEPS
 
+      #if ENABLED(STEPPER_TRACE)
+        case 930: // M930: Stepper step timeline trace
+          gcode_M930();
+          break;
+      #endif
+
+      #if ENABLED(DELTA_FIXED_POINT)
+        case 931: // M931: Delta kinematics benchmark
+          gcode_M931();
+          break;
+      #endif
+
+      case 932: // M932: Command queue occupancy
+        gcode_M932();
+        break;
+
+      #if ENABLED(SDSUPPORT)
+        case 933: // M933: SD read-ahead
+          gcode_M933();
+          break;
+      #endif
+
+      #if ENABLED(POWER_LOSS_JOURNAL)
+        case 1000: // M1000: Resume the print after a power loss
+          gcode_M1000();
+          break;
+      #endif
+
       case 999: // M999: Restart after being Stopped
         gcode_M999();
         break;
@@ -8610,10 +9105,10 @@ void FlushSerialRequestResend() {
 void ok_to_send() {
   refresh_cmd_timeout();
 #ifndef STM32_USE_USB_CDC
-  if (!send_ok[cmd_queue_index_r] ||
+  if ((commands_in_queue && !(command_queue[cmd_queue_index_r] & CMD_SEND_OK)) ||
 		  MYSERIAL.available() >= (2*(UART_RX_BUFFER_SIZE-MAX_CMD_SIZE)) ) return;
 #else
-  if (!send_ok[cmd_queue_index_r] /*||
+  if ((commands_in_queue && !(command_queue[cmd_queue_index_r] & CMD_SEND_OK)) /*||
 		  MYSERIAL.available() >= (2*(CDC_RX_BUFFER_SIZE-MAX_CMD_SIZE))*/ )
   {
 	  return;
@@ -8622,7 +9117,7 @@ void ok_to_send() {
     
   SERIAL_PROTOCOLPGM(MSG_OK);
   #if ENABLED(ADVANCED_OK)
-    char* p = command_queue[cmd_queue_index_r];
+    char* p = &command_queue[cmd_queue_index_r + 1];
     if (*p == 'N') {
       SERIAL_PROTOCOL(' ');
       SERIAL_ECHO(*p++);
@@ -8630,7 +9125,7 @@ void ok_to_send() {
         SERIAL_ECHO(*p++);
     }
     SERIAL_PROTOCOLPGM(" P"); SERIAL_PROTOCOL(int(BLOCK_BUFFER_SIZE - planner.movesplanned() - 1));
-    SERIAL_PROTOCOLPGM(" B"); SERIAL_PROTOCOL(BUFSIZE - commands_in_queue);
+    SERIAL_PROTOCOLPGM(" B"); SERIAL_PROTOCOL(int((CMD_QUEUE_SIZE - cmd_queue_bytes()) / CMD_RECORD_MAX));
   #endif
   SERIAL_EOL;
 }
@@ -8660,16 +9155,21 @@ void clamp_to_software_endstops(float target[3]) {
     delta_diagonal_rod_2_tower_1 = sq(diagonal_rod + delta_diagonal_rod_trim_tower_1);
     delta_diagonal_rod_2_tower_2 = sq(diagonal_rod + delta_diagonal_rod_trim_tower_2);
     delta_diagonal_rod_2_tower_3 = sq(diagonal_rod + delta_diagonal_rod_trim_tower_3);
+    #if ENABLED(DELTA_FIXED_POINT)
+      // the float kinematics for a geometry out of the Q16.16 range (a rod over 181mm)
+      deltaFixed.fits = deltaFixed.set_tower(TOWER_1, delta_tower1_x, delta_tower1_y, delta_diagonal_rod_2_tower_1)
+                     && deltaFixed.set_tower(TOWER_2, delta_tower2_x, delta_tower2_y, delta_diagonal_rod_2_tower_2)
+                     && deltaFixed.set_tower(TOWER_3, delta_tower3_x, delta_tower3_y, delta_diagonal_rod_2_tower_3);
+    #endif
     update_software_endstops(Z_AXIS);
   }
 
 
-  void inverse_kinematics(const float in_cartesian[3]) {
-    const float cartesian[3] = {
-      RAW_X_POSITION(in_cartesian[X_AXIS]),
-      RAW_Y_POSITION(in_cartesian[Y_AXIS]),
-      RAW_Z_POSITION(in_cartesian[Z_AXIS])
-    };
+  /**
+   * Carriage heights of a raw cartesian position on soft-float, the
+   * reference for DELTA_FIXED_POINT (and M931)
+   */
+  static void inverse_kinematics_float(const float cartesian[3]) {
 #if 0
     delta[TOWER_1] = sqrt(delta_diagonal_rod_2_tower_1
                           - sq(delta_tower1_x - cartesian[X_AXIS])
@@ -8700,6 +9200,24 @@ void clamp_to_software_endstops(float target[3]) {
                          ),&(delta[TOWER_3]));
     delta[TOWER_3]+=cartesian[Z_AXIS];
 #endif
+  }
+
+  void inverse_kinematics(const float in_cartesian[3]) {
+    const float cartesian[3] = {
+      RAW_X_POSITION(in_cartesian[X_AXIS]),
+      RAW_Y_POSITION(in_cartesian[Y_AXIS]),
+      RAW_Z_POSITION(in_cartesian[Z_AXIS])
+    };
+    #if ENABLED(DELTA_FIXED_POINT)
+      if (deltaFixed.fits) {
+        deltaFixed.inverse_kinematics(cartesian);
+        delta[TOWER_1] = q16_to_float(deltaFixed.carriage[TOWER_1]);
+        delta[TOWER_2] = q16_to_float(deltaFixed.carriage[TOWER_2]);
+        delta[TOWER_3] = q16_to_float(deltaFixed.carriage[TOWER_3]);
+      }
+      else
+    #endif
+        inverse_kinematics_float(cartesian);
     /**
     SERIAL_ECHOPGM("cartesian x="); SERIAL_ECHO(cartesian[X_AXIS]);
     SERIAL_ECHOPGM(" y="); SERIAL_ECHO(cartesian[Y_AXIS]);
@@ -8825,6 +9343,17 @@ void clamp_to_software_endstops(float target[3]) {
     }
     // Adjust print surface height by linear interpolation over the bed_level array.
     void adjust_delta(float cartesian[3]) {
+    #if ENABLED(DELTA_FIXED_POINT)
+      if (deltaFixed.fits) {
+        // on top of the carriage heights inverse_kinematics() left in deltaFixed
+        q16_t offset;
+        if (!deltaFixed.bed_level_offset(RAW_X_POSITION(cartesian[X_AXIS]), RAW_Y_POSITION(cartesian[Y_AXIS]), offset)) return;
+        delta[X_AXIS] = q16_to_float(deltaFixed.carriage[X_AXIS] + offset);
+        delta[Y_AXIS] = q16_to_float(deltaFixed.carriage[Y_AXIS] + offset);
+        delta[Z_AXIS] = q16_to_float(deltaFixed.carriage[Z_AXIS] + offset);
+        return;
+      }
+    #endif
       float offset = calc_delta_adjust(cartesian);
       if(isnanf(offset)) return;
       delta[X_AXIS] += offset;
@@ -8952,6 +9481,15 @@ void mesh_line_to_destination(float fr_mm_m, uint8_t x_splits = 0xff, uint8_t y_
     // SERIAL_ECHOPGM(" seconds="); SERIAL_ECHO(seconds);
     // SERIAL_ECHOPGM(" steps="); SERIAL_ECHOLN(steps);
 
+    #if ENABLED(DELTA) && ENABLED(DELTA_FIXED_POINT)
+      // carriage heights mostly by forward differences, see delta_fixed.h
+      if (deltaFixed.fits) {
+        const float raw_start[3] = { RAW_CURRENT_POSITION(X_AXIS), RAW_CURRENT_POSITION(Y_AXIS), RAW_CURRENT_POSITION(Z_AXIS) },
+                    raw_end[3] = { RAW_X_POSITION(target[X_AXIS]), RAW_Y_POSITION(target[Y_AXIS]), RAW_Z_POSITION(target[Z_AXIS]) };
+        deltaFixed.line_begin(raw_start, raw_end, steps);
+      }
+    #endif
+
     for (int s = 1; s <= steps; s++) {
 
       float fraction = float(s) * inv_steps;
@@ -8959,7 +9497,16 @@ void mesh_line_to_destination(float fr_mm_m, uint8_t x_splits = 0xff, uint8_t y_
       LOOP_XYZE(i)
         target[i] = current_position[i] + difference[i] * fraction;
 
-      inverse_kinematics(target);
+      #if ENABLED(DELTA) && ENABLED(DELTA_FIXED_POINT)
+        if (deltaFixed.fits) {
+          deltaFixed.line_next();
+          delta[TOWER_1] = q16_to_float(deltaFixed.carriage[TOWER_1]);
+          delta[TOWER_2] = q16_to_float(deltaFixed.carriage[TOWER_2]);
+          delta[TOWER_3] = q16_to_float(deltaFixed.carriage[TOWER_3]);
+        }
+        else
+      #endif
+          inverse_kinematics(target);
 
       #if ENABLED(DELTA) && ENABLED(AUTO_BED_LEVELING_FEATURE)
         if (!bed_leveling_in_progress) adjust_delta(target);
@@ -9441,6 +9988,14 @@ void idle(
 
   thermalManager.manage_heater();
 
+  #if ENABLED(SDSUPPORT)
+    p_card->readAhead();
+  #endif
+
+  #if ENABLED(POWER_LOSS_JOURNAL)
+    p_card->journal.update(planner.block_buffer_head, planner.block_buffer_tail);
+  #endif
+
   #if ENABLED(PRINTCOUNTER)
     print_job_timer.tick();
   #endif
@@ -9448,6 +10003,10 @@ void idle(
   #if HAS_BUZZER
     buzzer.tick();
   #endif
+
+  #if ENABLED(MPMD_SIM)
+    sim_idle();
+  #endif
 }
 
 /**
@@ -9469,7 +10028,7 @@ void manage_inactivity(bool ignore_stepper_queue/*=false*/) {
       handle_filament_runout();
   #endif
 
-  if (commands_in_queue < BUFSIZE) get_available_commands();
+  if (cmd_queue_has_space()) get_available_commands();
 
   millis_t ms = millis();
 
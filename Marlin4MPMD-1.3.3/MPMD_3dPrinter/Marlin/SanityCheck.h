@@ -224,6 +224,37 @@
   #error "To use BED_LIMIT_SWITCHING you must disable PIDTEMPBED."
 #endif
 
+/**
+ * Fixed point PID
+ */
+#if ENABLED(PID_FIXED_POINT) && ENABLED(PID_EXTRUSION_SCALING)
+  #error "PID_FIXED_POINT doesn't do PID_EXTRUSION_SCALING. Disable one of them."
+#elif ENABLED(PID_FIXED_POINT) && (PID_MAX > 255 || MAX_BED_POWER > 255)
+  #error "PID_FIXED_POINT needs PID_MAX and MAX_BED_POWER of 255 or less."
+#endif
+
+/**
+ * Step bursts
+ */
+#if ENABLED(STEP_BURST)
+  #if !defined(BSP_STEP_BURST_TIMER)
+    #error "STEP_BURST needs the timers and DMA channels of BSP_STEP_BURST_TIMER (MPMD board)."
+  #elif ENABLED(ADVANCE) || ENABLED(LIN_ADVANCE) || ENABLED(MIXING_EXTRUDER)
+    #error "STEP_BURST doesn't do ADVANCE, LIN_ADVANCE or MIXING_EXTRUDER. Disable one of them."
+  #elif ENABLED(BABYSTEPPING) || ENABLED(Z_DUAL_ENDSTOPS) || ENABLED(DUAL_X_CARRIAGE) || ENABLED(X_DUAL_STEPPER_DRIVERS) || ENABLED(Y_DUAL_STEPPER_DRIVERS) || ENABLED(Z_DUAL_STEPPER_DRIVERS)
+    #error "STEP_BURST only steps one driver for each tower, without BABYSTEPPING."
+  #elif INVERT_E_STEP_PIN
+    #error "STEP_BURST needs INVERT_E_STEP_PIN false, E steps on a timer channel."
+  #endif
+#endif
+
+/**
+ * Power-loss journal
+ */
+#if ENABLED(POWER_LOSS_JOURNAL) && DISABLED(SDSUPPORT)
+  #error "POWER_LOSS_JOURNAL needs SDSUPPORT, it is kept on the card."
+#endif
+
 /**
  * Mesh Bed Leveling
  */
@@ -663,6 +694,16 @@
 #if ENABLED(SD_SETTINGS) && ENABLED(FLASH_SETTINGS)
   #error "Cannot enable SD_SETTINGS and FLASH_SETTINGS at the same time"
 #endif
+
+/**
+ * Command queue
+ */
+#if MAX_CMD_SIZE > 127
+  #error "MAX_CMD_SIZE must be less than 128, a queued command keeps its length in 7 bits."
+#elif CMD_QUEUE_SIZE < 2 * (MAX_CMD_SIZE + 1)
+  #error "CMD_QUEUE_SIZE must hold two commands of MAX_CMD_SIZE."
+#endif
+
  /**
  * Warnings for old configurations
  */
@@ -676,6 +717,8 @@
   #error "Z_LATE_ENABLE can't be used with COREXZ."
 #elif defined(X_HOME_RETRACT_MM)
   #error "[XYZ]_HOME_RETRACT_MM settings have been renamed [XYZ]_HOME_BUMP_MM."
+#elif defined(BUFSIZE)
+  #error "BUFSIZE is now CMD_QUEUE_SIZE, in bytes. Please update your configuration."
 #elif defined(BEEPER)
   #error "BEEPER is now BEEPER_PIN. Please update your pins definitions."
 #elif defined(SDCARDDETECT)
@@ -11,6 +11,7 @@
 #include <stdint.h>
 #include <math.h>
 #include <stdio.h>
+#include <string.h>
 binGcodeCommand::binGcodeCommand() {
 	isBinary = true;
 	usePrevFormat = false;
@@ -83,3 +84,38 @@ int binGcodeCommand::writeGcode(char *buff) {
 	total+=2;
 	return total;
 }
+
+// Only plain motion commands are dispatched directly, everything else
+// still goes through the ASCII parser.
+bool binGcodeCommand::isDirect() {
+	if(!isBinary || cmdPrefix!='G' || cmdCode>3)
+		return false;
+	for(int i=0;i<numPar;i++)
+		if(par[i].parFormat==gcode_string)
+			return false;
+	return true;
+}
+
+// buff may be unaligned, the record is copied byte-wise and terminated
+// so that the queue slot still reads as a (non ASCII) string.
+int binGcodeCommand::writeRecord(char *buff) {
+	binGcodeRecord rec;
+	rec.marker = BINGCODE_RECORD_MARKER;
+	rec.cmdPrefix = cmdPrefix;
+	rec.numPar = numPar;
+	rec.cmdCode = cmdCode;
+	for(int i=0;i<numPar;i++) {
+		rec.parPrefix[i] = par[i].parPrefix;
+		rec.parVal[i] = par[i].parVal;
+	}
+	memcpy(buff,&rec,sizeof(binGcodeRecord));
+	buff[sizeof(binGcodeRecord)] = '\0';
+	return sizeof(binGcodeRecord);
+}
+
+int8_t binGcodeCommand::findPar(const binGcodeRecord &rec, char code) {
+	for(int i=0;i<rec.numPar;i++)
+		if(rec.parPrefix[i]==code)
+			return i;
+	return -1;
+}
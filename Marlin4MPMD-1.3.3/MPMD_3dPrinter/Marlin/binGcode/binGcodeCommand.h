@@ -9,6 +9,21 @@
 #ifndef __BINGCODECOMMAND_H_
 #define __BINGCODECOMMAND_H_
 
+// First byte of a decoded record in the command queue. Never starts ASCII gcode.
+#define BINGCODE_RECORD_MARKER '\x01'
+#define BINGCODE_MAX_PAR 8
+
+// Already decoded command, stored in the command queue in place of the ASCII
+// text so that motion commands skip the sprintf/strtod round trip.
+typedef struct binGcodeRecord {
+	char marker;
+	char cmdPrefix;
+	uint8_t numPar;
+	uint16_t cmdCode;
+	char parPrefix[BINGCODE_MAX_PAR];
+	float parVal[BINGCODE_MAX_PAR];
+} binGcodeRecord;
+
 class binGcodeCommand {
 public:
 	bool isBinary;
@@ -22,6 +37,9 @@ public:
 	bool isEqual(const binGcodeCommand &comm);
 	void decodeBinGcode(uint8_t*& buff, const binGcodeCommand &comm);
 	int writeGcode(char *buff);
+	bool isDirect();
+	int writeRecord(char *buff);
+	static int8_t findPar(const binGcodeRecord &rec, char code);
 
 };
 
@@ -10,6 +10,7 @@
 #include <stdlib.h>
 #include <math.h>
 #include <string.h>
+#include <time.h>
 typedef struct bpartestPar{
     char parPrefix;
     float parVal;
@@ -370,8 +371,90 @@ bool test_case3() {
     return true;
 } 
 
+// Mimics code_seen()/code_value_float() on the ASCII line in Marlin_main.cpp
+static float textParam(char *args, char code, bool &seen) {
+    char *p = strchr(args,code);
+    seen = p!=NULL;
+    return seen ? strtod(p+1,NULL) : NAN;
+}
+static float recordParam(const binGcodeRecord &rec, char code, bool &seen) {
+    int8_t i = binGcodeCommand::findPar(rec,code);
+    seen = i>=0;
+    return seen ? rec.parVal[i] : NAN;
+}
+static const char motionCodes[] = "XYZEF";
+
+// Runs the testData4 vectors through the ASCII round trip (writeGcode and
+// strtod) and through the direct record path, checks both give the same
+// parameters and reports lines per second for each.
+bool test_case4() {
+    const int nVec = sizeof(testData4)/sizeof(bgctestData);
+    const long iterations = 200000;
+    char line[96];
+    binGcodeRecord rec;
+    float sink = 0;
+    bool pass = true;
+    clock_t start;
+    double tText,tRecord;
+
+    for(int pathRecord=0;pathRecord<2;pathRecord++) {
+        start = clock();
+        for(long n=0;n<iterations;n++) {
+            binGcodeCommand gc2;
+            for(int i=0;i<nVec;i++) {
+                uint8_t *pData = testData4[i].inputdata;
+                uint8_t *pStart = pData;
+                binGcodeCommand gc1;
+                gc1.decodeBinGcode(pData,gc2);
+                gc2.decodeBinGcode(pStart,gc2);
+                binGcodePar::resetBuff();
+                float vals[sizeof(motionCodes)];
+                bool seen[sizeof(motionCodes)];
+                if(pathRecord && gc1.isDirect()) {
+                    gc1.writeRecord(line);
+                    memcpy(&rec,line,sizeof(rec));
+                    for(int c=0;c<sizeof(motionCodes)-1;c++)
+                        vals[c] = recordParam(rec,motionCodes[c],seen[c]);
+                }
+                else {
+                    gc1.writeGcode(line);
+                    char *args = line;
+                    strtol(args+1,&args,10);
+                    for(int c=0;c<sizeof(motionCodes)-1;c++)
+                        vals[c] = textParam(args,motionCodes[c],seen[c]);
+                }
+                for(int c=0;c<sizeof(motionCodes)-1;c++) {
+                    if(seen[c] && !isnan(vals[c]))
+                        sink+=vals[c];
+                    if(n==0 && seen[c]) {
+                        int k;
+                        for(k=0;k<testData4[i].numPar;k++)
+                            if(testData4[i].par[k].parPrefix==motionCodes[c])
+                                break;
+                        if(k==testData4[i].numPar || fabs(vals[c]-testData4[i].par[k].parVal)>0.001) {
+                            printf("Mismatch at index %d parameter %c\n",i,motionCodes[c]);
+                            pass = false;
+                        }
+                    }
+                }
+            }
+        }
+        double secs = (double)(clock()-start)/CLOCKS_PER_SEC;
+        if(pathRecord)
+            tRecord = secs;
+        else
+            tText = secs;
+    }
+    double lines = (double)iterations*nVec;
+    printf("ascii round trip: %.0f lines/s\n",lines/tText);
+    printf("direct dispatch:  %.0f lines/s\n",lines/tRecord);
+    printf("(checksum %g) %s\n",sink,pass ? "PASS" : "FAIL");
+    return pass;
+}
+
 int main() {
     // test_case1();
+    test_case4();
     test_case2();
     test_case3();
     return 0;
@@ -4,7 +4,32 @@
 #include <strings.h>
 
 #if ENABLED(SDSUPPORT)
-static unsigned char readBuff[512];
+
+#if SD_READ_RING_SECTORS & (SD_READ_RING_SECTORS - 1)
+  #error "SD_READ_RING_SECTORS must be a power of two"
+#endif
+#if SD_READ_RING_SECTORS < 2
+  #error "SD_READ_RING_SECTORS must be 2 or more, M34 F takes its frame buffers from the ring"
+#endif
+
+/**
+ * The file printed is read a sector at a time into the ring, the sector at
+ * file offset o into readRing[o / 512 % SD_READ_RING_SECTORS]. get() and
+ * read_buff() take the bytes from sdpos up to ringEnd, where the reading
+ * stopped. readAhead(), from idle(), reads the next sector while the ring
+ * has room for it short of the sector sdpos is in, so the card is mostly
+ * read while the planner waits on a full buffer rather than when the
+ * parser wants the next line; if the parser gets to ringEnd first it reads
+ * the sector itself (a stall, for M933). The sectors behind sdpos stay for
+ * push_read_buff() until they are read over.
+ */
+unsigned char CardReader::readRing[SD_READ_RING_SECTORS][512];
+
+#if ENABLED(UZLIB)
+#include "gzstream.h"
+// Inflater for the open .gz file, readRing[0] holds the compressed input
+static struct gzstream gz;
+#endif
 
 CardReader::CardReader()
 {
@@ -22,14 +47,17 @@ CardReader::CardReader()
    file_subcall_ctr=0;
    cardReaderInitialized = false;
    isBinaryMode = false;
-   pReadEnd = readBuff+512;
-   pRead = pReadEnd;
+   isGzip = false;
+   ringEnd = 0;
+   readAheadSectors = readStalls = 0;
+   memset(readRingHistogram, 0, sizeof(readRingHistogram));
 
    curDir = NULL;
    diveDirName = NULL;
    filenameIsDir = false;
    lsAction = LS_SerialPrint;
    nrFiles = 0;
+   dirChanged();
 
    memset(workDirParents, 0, sizeof(workDirParents));
    for(loop = 0; loop < SD_PROCEDURE_DEPTH; loop++)
@@ -102,6 +130,7 @@ void CardReader::initsd()
 		}
 		workDir=root;
 		curDir=&root;
+		dirChanged();
 	  }
 	  else
 	  {
@@ -247,12 +276,12 @@ bool CardReader::testPath( char *name, char **fname)
 	if(name[0]=='/')
 	{
 		dirname_start=strchr(name,'/')+1;
-	    while(dirname_start>0)
+	    while(dirname_start!=NULL)
 	    {
 	    	dirname_end=strchr(dirname_start,'/');
 	    	//SERIAL_ECHO("start:");SERIAL_ECHOLN((int)(dirname_start-name));
 	    	//SERIAL_ECHO("end  :");SERIAL_ECHOLN((int)(dirname_end-name));
-	    	if(dirname_end>0 && dirname_end>dirname_start)
+	    	if(dirname_end!=NULL && dirname_end>dirname_start)
 	    	{
 	    		char subdirname[13];
 	    		strncpy(subdirname, dirname_start, dirname_end-dirname_start);
@@ -319,6 +348,7 @@ void CardReader::setroot()
   }*/
   workDir=root;
   curDir=&root;
+  dirChanged();
 }
 
 void CardReader::release()
@@ -326,13 +356,16 @@ void CardReader::release()
   sdprinting = false;
   updateLCD = false;
   cardOK = false;
+  dirChanged();
+#if ENABLED(POWER_LOSS_JOURNAL)
+  journal.close();
+#endif
   cardReaderInitialized = false;
   rootIsOpened = false;
   disk_deinitialize(fileSystem.drv);
   SERIAL_ECHO_START;
   SERIAL_ECHOLNPGM(MSG_SD_INIT_FAIL);
-  if(isBinaryMode)
-	  flush_buff();
+  flush_buff();
 }
 
 void CardReader::startFileprint()
@@ -548,19 +581,56 @@ void CardReader::openFile(char* name,bool read, bool replace_current/*=true*/)
   if( !testPath(name, &fname))
 	  return;
   
-  strncpy(longFilename, fname, strlen(fname));
+  strncpy(longFilename, fname, LONG_FILENAME_LENGTH - 1);
+  longFilename[LONG_FILENAME_LENGTH - 1] = '\0';
   
+#if ENABLED(POWER_LOSS_JOURNAL)
+  // The journal is found with the FIL the file is opened with, so first; not
+  // for the settings, a sub-file or a .gz, which M26 can't seek in
+  journal.end();
+  bool journaled = false;
+  if(read && file_subcall_ctr == 0 && !isGzip
+  #if ENABLED(SD_SETTINGS)
+     && strcasecmp(fname, CONFIG_FILE_NAME) != 0
+  #endif
+    )
+  {
+    journaled = journal.open(&fileSystem, &file);
+    dirChanged();  // it may have been made
+  }
+#endif
+
   if(read)
   {
 	  if (f_open(&file, name, FA_OPEN_EXISTING | FA_READ) == FR_OK)
     {
       fileOpened[file_subcall_ctr] = 1;
       filesize = f_size(&file);
+#if ENABLED(POWER_LOSS_JOURNAL)
+      if(journaled)
+        journal.start(name, filesize);
+#endif
+#if _USE_FASTSEEK
+      // f_read() and f_lseek() take the clusters from the map, not the FAT:
+      // no FAT read as the print goes on, and M26/M32 S don't walk the chain.
+      // A file in more fragments than it holds is read without it.
+      linkMap[0] = SD_LINKMAP_SIZE;
+      file.cltbl = linkMap;
+      if (f_lseek(&file, CREATE_LINKMAP) != FR_OK)
+        file.cltbl = NULL;
+#endif
       SERIAL_PROTOCOLPGM(MSG_SD_FILE_OPENED);
       SERIAL_PROTOCOL(fname);
       SERIAL_PROTOCOLPGM(MSG_SD_SIZE);
       SERIAL_PROTOCOLLN(filesize);
       sdpos = 0;
+#if ENABLED(UZLIB)
+      if(isGzip && !gz_open())
+      {
+        SERIAL_ERROR_START;
+        SERIAL_ERRORLNPGM(MSG_SD_ERR_GZIP);
+      }
+#endif
       
       SERIAL_PROTOCOLLNPGM(MSG_SD_FILE_SELECTED);
       getfilename(0, fname);
@@ -589,6 +659,7 @@ void CardReader::openFile(char* name,bool read, bool replace_current/*=true*/)
     }
     else
     {
+      dirChanged();
       sdpos = 0;
       saving = true;
       SERIAL_PROTOCOLPGM(MSG_SD_WRITE_TO_FILE);
@@ -599,8 +670,7 @@ void CardReader::openFile(char* name,bool read, bool replace_current/*=true*/)
 #endif
     }
   }
-  if(isBinaryMode)
-	flush_buff();
+  flush_buff();
 }
 
 void CardReader::openAndPrintFile(const char *name) {
@@ -631,11 +701,11 @@ void CardReader::removeFile(char* name)
 
 	if( f_unlink (fname) == FR_OK)
 	{
+		dirChanged();
 		SERIAL_PROTOCOLPGM("File deleted:");
 		SERIAL_PROTOCOLLN(fname);
 		sdpos = 0;
-		if(isBinaryMode)
-			flush_buff();
+		flush_buff();
 	}
 	else
 	{
@@ -659,72 +729,166 @@ void CardReader::getStatus()
   }
 }
 
+// Forget what the ring holds, the file is read again from the sector sdpos is in
 void CardReader::flush_buff() {
-	pReadEnd = readBuff+512;
-	pRead = pReadEnd;
+	ringEnd = sdpos & ~511UL;
+	if(isFileOpen() && !saving && !isGzip)
+		f_lseek(&file, ringEnd);
+}
+
+// Read the next sector of the file into the ring; false at the end of it or on an error
+bool CardReader::fill()
+{
+	UINT bytesRead;
+	if(ringEnd>=filesize)
+		return false;
+	BSP_LED_On(LED_RED);
+	BSP_LED_On(LED_GREEN);
+	BSP_LED_On(LED_BLUE);
+	FRESULT readStatus = f_read(&file, readRing[(ringEnd >> 9) & (SD_READ_RING_SECTORS-1)], 512, &bytesRead);
+	BSP_LED_Off(LED_RED);
+	BSP_LED_Off(LED_GREEN);
+	BSP_LED_Off(LED_BLUE);
+	if(readStatus != FR_OK || !bytesRead)
+	{
+		SERIAL_ERROR_START;
+		SERIAL_ERRORLNPGM(MSG_SD_ERR_READ);
+		return false;
+	}
+	ringEnd += bytesRead;
+	return true;
+}
+
+// At the start of a sector, or past what the ring holds: read it if the ring doesn't have it yet
+bool CardReader::next_sector()
+{
+	if(!(sdpos & 511))
+		readRingHistogram[sdpos < ringEnd ? (ringEnd - sdpos + 511) >> 9 : 0]++;
+	if(sdpos>=ringEnd) {
+		if(!fill())
+			return false;
+		readStalls++;
+	}
+	return sdpos < ringEnd;
+}
+
+void CardReader::readAhead()
+{
+#if ENABLED(MPMD_SIM)
+	if(sim_no_read_ahead)
+		return;
+#endif
+	// the sector after ringEnd goes over the one SD_READ_RING_SECTORS before it
+	if(!sdprinting || saving || isGzip || ringEnd>=filesize
+	   || (ringEnd >> 9) - (sdpos >> 9) >= SD_READ_RING_SECTORS)
+		return;
+	if(fill())
+		readAheadSectors++;
 }
 
+#if ENABLED(POWER_LOSS_JOURNAL)
+bool CardReader::lastPrint(PrintJournalRecord *record, char *name)
+{
+	initsd();
+	if(!cardOK || sdprinting || saving)
+		return false;
+	// open with the file selected by M23, else found with its FIL
+	if(!journal.opened())
+	{
+		if(fileOpened[file_subcall_ctr] || !journal.open(&fileSystem, &file))
+			return false;
+		dirChanged();
+	}
+	return journal.last(record, name);
+}
+#endif
+
 int CardReader::read_buff(unsigned char *buf,uint32_t len)
 {
+#if ENABLED(UZLIB)
+	if(isGzip)
+		return gzstream_read(&gz,buf,len);
+#endif
 	unsigned int bytesCopied = 0;
-    unsigned int bytesRemaining = len;
-	unsigned int bytesRead = -1;
-	FRESULT readStatus;
-
-	while(bytesCopied<len && bytesRead!=0) {
-		if(pRead>=pReadEnd) {
-			BSP_LED_On(LED_RED);
-			BSP_LED_On(LED_GREEN);
-			BSP_LED_On(LED_BLUE);
-			readStatus = f_read(&file, readBuff, 512, &bytesRead);
-		    if(readStatus != FR_OK)
-		    {
-			  SERIAL_ERROR_START;
-			  SERIAL_ERRORLNPGM(MSG_SD_ERR_READ);
-		    }
-			BSP_LED_Off(LED_RED);
-			BSP_LED_Off(LED_GREEN);
-			BSP_LED_Off(LED_BLUE);
-			pRead = readBuff;
-			pReadEnd = readBuff +bytesRead;
-			sdpos += bytesRead;
-		}
-		int bytesAvailable = pReadEnd - pRead;
-		if(bytesAvailable>0) {
-			unsigned int bytestoCopy = min(bytesAvailable,(int)bytesRemaining);
-			memcpy(buf,pRead,bytestoCopy);
-			bytesCopied+=bytestoCopy;
-            pRead+=bytestoCopy;
-            buf+=bytestoCopy;
-            bytesRemaining-=bytestoCopy;
-		}
+
+	while(bytesCopied<len) {
+		if(!((sdpos & 511) && sdpos < ringEnd) && !next_sector())
+			break;
+		unsigned int bytestoCopy = min(min(len-bytesCopied, 512-(sdpos & 511)), ringEnd-sdpos);
+		memcpy(buf,&readRing[(sdpos >> 9) & (SD_READ_RING_SECTORS-1)][sdpos & 511],bytestoCopy);
+		bytesCopied+=bytestoCopy;
+		buf+=bytestoCopy;
+		sdpos+=bytestoCopy;
 	}
-    return bytesCopied;
+	return bytesCopied;
 }
 
 void CardReader::push_read_buff(int len)
 {
-    if((pRead-len)<readBuff) {
-    	unsigned int bytesRead;
-    	FSIZE_t curpos = f_tell(&file);
-        f_lseek(&file,curpos-((pReadEnd)-pRead+len));
-        sdpos-=((pReadEnd)-pRead+len);
-        FRESULT readStatus = f_read(&file, readBuff, 512, &bytesRead);
-	    if(readStatus != FR_OK)
-	    {
-		  SERIAL_ERROR_START;
-		  SERIAL_ERRORLNPGM(MSG_SD_ERR_READ);
-	    }
-        // printf("Rewinding %ld Reading %d bytes, got %d bytes\n",pRead-readBuff-len,512,bytesRead);
-        pRead = readBuff;
-        pReadEnd = readBuff+bytesRead;
-		sdpos += bytesRead;
-    }
-    else
-        pRead = pRead-len;
+#if ENABLED(UZLIB)
+	if(isGzip) {
+		gzstream_unread(&gz,len);
+		return;
+	}
+#endif
+	sdpos-=len;
+	// read again if the sector was read over since
+	if(ringEnd && (sdpos >> 9) + SD_READ_RING_SECTORS <= ((ringEnd - 1) >> 9))
+		flush_buff();
+}
+
+#if ENABLED(UZLIB)
+int CardReader::gz_read(void *ctx, unsigned char *buf, unsigned int len)
+{
+	CardReader *card = (CardReader *)ctx;
+	UINT bytesRead;
+	if(f_read(&card->file, buf, len, &bytesRead) != FR_OK)
+	{
+		SERIAL_ERROR_START;
+		SERIAL_ERRORLNPGM(MSG_SD_ERR_READ);
+		return -1;
+	}
+	card->sdpos += bytesRead; // progress is tracked on the compressed file
+	return bytesRead;
+}
+
+bool CardReader::gz_open()
+{
+	return gzstream_open(&gz, readRing[0], sizeof(readRing[0]), gz_read, this) == TINF_OK;
+}
+
+// The end of the file, not an error in it, see gz_failed()
+bool CardReader::gz_eof()
+{
+	return gz.status == TINF_DONE && gz.pRead >= gz.pReadEnd;
+}
+
+// What was inflated before a data error, a file deflated with a window larger
+// than GZSTREAM_DICT_SIZE among them, is all read
+bool CardReader::gz_failed()
+{
+	return gz.status < 0 && gz.pRead >= gz.pReadEnd;
 }
 
-void CardReader::write_buff(unsigned char *buf,uint32_t len)
+// Compressed files can't be seeked, only restarted from the beginning
+void CardReader::gz_rewind(long index)
+{
+	if(index != 0)
+	{
+		SERIAL_ECHO_START;
+		SERIAL_ECHOLNPGM(MSG_SD_GZIP_NO_SEEK);
+	}
+	sdpos = 0;
+	f_lseek(&file, 0);
+	if(!gz_open())
+	{
+		SERIAL_ERROR_START;
+		SERIAL_ERRORLNPGM(MSG_SD_ERR_GZIP);
+	}
+}
+#endif
+
+bool CardReader::write_buff(unsigned char *buf,uint32_t len)
 {
   if(len==512)
 	  BSP_LED_On(LED_RED);
@@ -735,8 +899,8 @@ void CardReader::write_buff(unsigned char *buf,uint32_t len)
 
   writeStatus = f_write(&file, buf, len, &bytesWritten);
   sdpos+=bytesWritten;
-  if( 	(writeStatus != FR_OK) ||
-		(bytesWritten != len))
+  bool ok = (writeStatus == FR_OK) && (bytesWritten == len);
+  if(!ok)
   {
     SERIAL_ERROR_START;
     SERIAL_ERRORLNPGM(MSG_SD_ERR_WRITE_TO_FILE);
@@ -744,6 +908,7 @@ void CardReader::write_buff(unsigned char *buf,uint32_t len)
   BSP_LED_Off(LED_GREEN);
   BSP_LED_Off(LED_BLUE);
   BSP_LED_Off(LED_RED);
+  return ok;
 }
 
 void CardReader::write_command(char *buf)
@@ -827,6 +992,9 @@ void CardReader::checkautostart(bool force)
 
 void CardReader::closefile(bool store_location)
 {
+#if ENABLED(POWER_LOSS_JOURNAL)
+  journal.end();
+#endif
   f_sync(&file);
   fileOpened[file_subcall_ctr] = 0;
   f_close(&file);
@@ -834,8 +1002,7 @@ void CardReader::closefile(bool store_location)
   logging = false;
   sdpos = 0;
   updateLCD = false;
-  if(isBinaryMode)
-	  flush_buff();
+  flush_buff();
   if(store_location)
   {
     //future: store printer state, filename and position for continuing a stopped print
@@ -846,13 +1013,28 @@ void CardReader::closefile(bool store_location)
   
 }
 
+// With SD_DIR_INDEX the directory is read through once into dirIndex, and after
+// that each file is read from where it is in it, not by reading the directory up to it.
 void CardReader::getfilename(uint16_t nr, const char * const match/*=NULL*/)
 {
   curDir=&workDir;
+#if ENABLED(SD_DIR_INDEX)
+  FILINFO entry;
+  if(!cardOK || (!dirIndex.valid && !dirIndex.build(curDir)))
+    return;
+  bool found = match != NULL ? dirIndex.find(curDir, match, &entry) >= 0 : dirIndex.read(curDir, nr, &entry);
+  // none such: the last one, as lsDive() left it
+  if(!found && (dirIndex.files == 0 || !dirIndex.read(curDir, dirIndex.files - 1, &entry)))
+    return;
+  filenameIsDir=(entry.fattrib & AM_DIR);
+  strcpy(filename,entry.fname);
+  strcpy(longFilename,entry.fname);
+#else
   lsAction=LS_GetFilename;
   nrFiles=nr;
   f_readdir(curDir, 0); // rewind current directory
   lsDive("",curDir,match);
+#endif
 }
 
 uint16_t CardReader::getnrfilenames()
@@ -861,12 +1043,17 @@ uint16_t CardReader::getnrfilenames()
   if(!cardOK)
 	return 0;
   curDir=&workDir;
+#if ENABLED(SD_DIR_INDEX)
+  if(!dirIndex.valid && !dirIndex.build(curDir))
+	return 0;
+  return dirIndex.files;
+#else
   lsAction=LS_Count;
   nrFiles=0;
   f_readdir(curDir, 0); // rewind current directory
   lsDive("",curDir);
-  //SERIAL_ECHOLN(nrFiles);
   return nrFiles;
+#endif
 }
 
 void CardReader::chdir(const char * relpath)
@@ -892,6 +1079,7 @@ void CardReader::chdir(const char * relpath)
 		}
 		workDir = newDir;
 		curDir = &workDir;
+		dirChanged();
 	}
 }
 
@@ -903,6 +1091,7 @@ void CardReader::updir()
     workDir = workDirParents[0];
     for (int d = 0; d < workDirDepth; d++)
       workDirParents[d] = workDirParents[d+1];
+    dirChanged();
   }
 }
 
@@ -926,6 +1115,9 @@ void CardReader::printingHasFinished()
     else
     {
       // quickStop();   -- BDI : no more present in new version
+#if ENABLED(POWER_LOSS_JOURNAL)
+      journal.end();
+#endif
       fileOpened[file_subcall_ctr] = 0;
       f_close(&file);
       sdprinting = false;
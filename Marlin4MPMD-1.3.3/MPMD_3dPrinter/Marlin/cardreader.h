@@ -25,6 +25,8 @@
 #include "language.h"
 #include "configuration_store.h"
 #include "diskio.h"
+#include "sd_dirindex.h"
+#include "print_journal.h"
 
 #include "ff.h"  //for FATFS
 
@@ -59,6 +61,15 @@
 // Number of possible sub-function call (call of a G file by another one)
 #define SD_PROCEDURE_DEPTH (1)
 
+// Size (DWORDs) of the cluster map of the file read (FatFs fast seek), two per
+// fragment of the file and two more: 15 fragments
+#define SD_LINKMAP_SIZE (32)
+
+// Sectors of the print file read ahead of the parser (readAhead()), a power
+// of two and at least 2 (M34 F's frame buffers): 512 bytes of RAM each, and
+// the STM32F070 has 16 KB with 1 KB of it for the stack
+#define SD_READ_RING_SECTORS (2)
+
 /**
   * @}
   */
@@ -99,8 +110,15 @@ public:
 	bool filenameIsDir;
 	int lastnr; //last number of the autostart;
 	bool isBinaryMode;
-	unsigned char *pRead;
-	unsigned char *pReadEnd;
+	bool isGzip; // file is gzip compressed and inflated while printing
+	// For M933: sectors read ahead from idle(), and read by the parser as
+	// it found the ring empty; sectors held as it started on each one
+	uint32_t readAheadSectors;
+	uint32_t readStalls;
+	uint32_t readRingHistogram[SD_READ_RING_SECTORS+1];
+#if ENABLED(POWER_LOSS_JOURNAL)
+	PrintJournal journal;  // of the print, on the card
+#endif
 	unsigned long autostart_atmillis;
 	uint32_t filesize;
 
@@ -128,7 +146,8 @@ public:
 	 * \param buf  Pointer to a char buffer.
 	 */
 	void write_command(char *buf);
-	void write_buff(unsigned char *buf,uint32_t len);
+	// false if the card took fewer bytes than len
+	bool write_buff(unsigned char *buf,uint32_t len);
 
 	/**
 	 * \fn void checkautostart(bool x)
@@ -227,6 +246,18 @@ public:
 	 * \brief pushes the read buffer back len characters to account for discarded characters
 	 */
 	void push_read_buff(int len);
+	/**
+	 * \fn void readAhead()
+	 * \brief reads the next sector of the file printed, if the ring has room for it; called from idle()
+	 */
+	void readAhead();
+#if ENABLED(POWER_LOSS_JOURNAL)
+	/**
+	 * \fn bool lastPrint(PrintJournalRecord *record, char *name)
+	 * \brief where the last print had got to, from the journal (M1000); false if it ended, or a file is printed or written
+	 */
+	bool lastPrint(PrintJournalRecord *record, char *name);
+#endif
 
 
 	uint16_t get_num_Files();
@@ -246,31 +277,53 @@ public:
 	FORCE_INLINE uint32_t fileLength() { return filesize; }
 	FORCE_INLINE bool isFileOpen() { return (bool)file.obj.fs; }
 	FORCE_INLINE bool eof() {
-		if(!isBinaryMode)
-			return sdpos>=filesize ;
-		else {
-			int bytesAvailable = pReadEnd - pRead;
-			return (sdpos-bytesAvailable)>=filesize;
-		}
+#if ENABLED(UZLIB)
+		if(isGzip)
+			return gz_eof();
+#endif
+		return sdpos>=filesize;
+	};
+	// Files of the working directory made or removed, or it changed: its index is read again
+	FORCE_INLINE void dirChanged() {
+#if ENABLED(SD_DIR_INDEX)
+		dirIndex.invalidate();
+#endif
+	};
+	// The file can't be read on, a .gz file the inflater found an error in
+	FORCE_INLINE bool failed() {
+#if ENABLED(UZLIB)
+		if(isGzip)
+			return gz_failed();
+#endif
+		return false;
 	};
 	FORCE_INLINE int16_t get() {
-		UINT readByte;
-		UINT rc;
-		if (f_read(&file, &readByte, 1, &rc) != FR_OK)                     {
-			readByte = -1;
+#if ENABLED(UZLIB)
+		if(isGzip) {
+			unsigned char c;
+			return read_buff(&c,1)==1 ? c : -1;
 		}
-		else
-		{
-			sdpos += rc;
-		}
-		return (int16_t) readByte;
+#endif
+		// in a sector the ring holds, past its first byte, or next_sector() sees to it
+		if(!((sdpos & 511) && sdpos < ringEnd) && !next_sector())
+			return -1;
+		const int16_t c = readRing[(sdpos >> 9) & (SD_READ_RING_SECTORS-1)][sdpos & 511];
+		sdpos++;
+		return c;
 	};
 	FORCE_INLINE void setIndex(long index) {
+#if ENABLED(UZLIB)
+		if(isGzip) {
+			gz_rewind(index);
+			return;
+		}
+#endif
 		sdpos = index;
-		f_lseek(&file, index);
-		if(isBinaryMode)
-			flush_buff();
+		flush_buff();
 	};
+	// The ring, for two sectors' worth of buffers while a file is written (M34 F):
+	// no print reads it then, and the file printed next is read into it afresh
+	FORCE_INLINE unsigned char (*saveBuffers())[512] { return readRing; };
 	FORCE_INLINE uint8_t percentDone(){
 		if(!isFileOpen())
 			return 0;
@@ -295,6 +348,14 @@ private:
 	uint16_t workDirDepth;
 	DIR root, *curDir, workDir, workDirParents[MAX_DIR_DEPTH+1];
 	FIL file;  // Current file
+#if _USE_FASTSEEK
+	DWORD linkMap[SD_LINKMAP_SIZE];  // its clusters, if it is read
+#endif
+#if ENABLED(SD_DIR_INDEX)
+	SdDirIndex dirIndex;  // of workDir, for getfilename() and getnrfilenames()
+#endif
+	static unsigned char readRing[SD_READ_RING_SECTORS][512];  // the file printed, see cardreader.cpp
+	uint32_t ringEnd;     // it is read up to here
 	FATFS fileSystem;
 	char SDPath[4]; /* SD card logical drive path */
 	uint8_t fileOpened[SD_PROCEDURE_DEPTH];
@@ -316,6 +377,15 @@ private:
 	void lsDive(const char *prepend, DIR *parent, const char * const match=NULL);
 	bool testPath( char *name, char **fname);
 	void flush_buff(void);
+	bool next_sector(void);
+	bool fill(void);
+#if ENABLED(UZLIB)
+	bool gz_open();
+	bool gz_eof();
+	bool gz_failed();
+	void gz_rewind(long index);
+	static int gz_read(void *ctx, unsigned char *buf, unsigned int len);
+#endif
 
 
 };
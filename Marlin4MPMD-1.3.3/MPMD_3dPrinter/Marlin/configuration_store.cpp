@@ -571,157 +571,304 @@ void Config_RetrieveSettings() {
 // end EEPROM_SETTINGS
 
 #elif ENABLED(FLASH_SETTINGS)
-volatile ConfigSettings *EEPROMconfig = (ConfigSettings *)EEPROM_ADDRESS; //create pointer to virtual struct so we can save memory
-void Config_StoreSettings() {
-	BSP_MiscEEPROMErase();
-	_EEPROMWrite(&EEPROMconfig->API_MAJOR_VERSION,uint16_t(CONFIG_API_MAJOR_VERSION | CONFIG_API_MINOR_VERSION<<8));
-	_EEPROMWrite(&EEPROMconfig->MAJOR_FW_VERSION,uint16_t(MARLIN_MAJOR_FW_VERSION | MARLIN_MINOR_FW_VERSION<<8));
-	_EEPROMWrite(&EEPROMconfig->MAJOR_FW_SUBVERSION,uint16_t(MARLIN_MAJOR_FW_SUBVERSION | MARLIN_MINOR_FW_SUBVERSION<<8));
-	for(int i=0;i<NUM_AXIS;i++)
-		_EEPROMWrite(&EEPROMconfig->axis_steps_per_mm[i],planner.axis_steps_per_mm[i]);
-	for(int i=0;i<NUM_AXIS;i++)
-			_EEPROMWrite(&EEPROMconfig->max_feedrate_mm_s[i],planner.max_feedrate_mm_s[i]);
-	for(int i=0;i<NUM_AXIS;i++)
-			_EEPROMWrite(&EEPROMconfig->max_acceleration_mm_per_s2[i],planner.max_acceleration_mm_per_s2[i]);
-	_EEPROMWrite(&EEPROMconfig->acceleration,planner.acceleration);
-	_EEPROMWrite(&EEPROMconfig->retract_acceleration,planner.retract_acceleration);
-	_EEPROMWrite(&EEPROMconfig->travel_acceleration,planner.travel_acceleration);
-	_EEPROMWrite(&EEPROMconfig->min_feedrate_mm_s,planner.min_feedrate_mm_s);
-	_EEPROMWrite(&EEPROMconfig->min_travel_feedrate_mm_s,planner.min_travel_feedrate_mm_s);
-	_EEPROMWrite(&EEPROMconfig->min_segment_time,planner.min_segment_time);
-	_EEPROMWrite(&EEPROMconfig->max_xy_jerk,planner.max_xy_jerk);
-	_EEPROMWrite(&EEPROMconfig->max_z_jerk,planner.max_z_jerk);
-	_EEPROMWrite(&EEPROMconfig->max_e_jerk,planner.max_e_jerk);
-	for(int i=0;i<3;i++)
-		_EEPROMWrite(&EEPROMconfig->home_offset[i],home_offset[i]);
-	_EEPROMWrite(&EEPROMconfig->zprobe_zoffset,zprobe_zoffset);
-	for(int i=0;i<3;i++)
-		_EEPROMWrite(&EEPROMconfig->endstop_adj[i],endstop_adj[i]);
-	_EEPROMWrite(&EEPROMconfig->delta_height,delta_height);
-	_EEPROMWrite(&EEPROMconfig->delta_diagonal_rod,delta_diagonal_rod);
-	_EEPROMWrite(&EEPROMconfig->delta_radius,delta_radius);
-	_EEPROMWrite(&EEPROMconfig->delta_segments_per_second,delta_segments_per_second);
-	_EEPROMWrite(&EEPROMconfig->delta_diagonal_rod_trim[A_AXIS],delta_diagonal_rod_trim_tower_1);
-	_EEPROMWrite(&EEPROMconfig->delta_diagonal_rod_trim[B_AXIS],delta_diagonal_rod_trim_tower_2);
-	_EEPROMWrite(&EEPROMconfig->delta_diagonal_rod_trim[C_AXIS],delta_diagonal_rod_trim_tower_3);
-	_EEPROMWrite(&EEPROMconfig->delta_radius_trim[A_AXIS],delta_radius_trim_tower_1);
-	_EEPROMWrite(&EEPROMconfig->delta_radius_trim[B_AXIS],delta_radius_trim_tower_2);
-	_EEPROMWrite(&EEPROMconfig->delta_radius_trim[C_AXIS],delta_radius_trim_tower_3);
-	for(int i=0;i<3;i++)
-		_EEPROMWrite(&EEPROMconfig->delta_angle_trim[i],delta_tower_angle_trim[i]);
 
-#if DISABLED(ULTIPANEL)
-  int preheatHotendTemp1 = PREHEAT_1_TEMP_HOTEND, preheatBedTemp1 = PREHEAT_1_TEMP_BED, preheatFanSpeed1 = PREHEAT_1_FAN_SPEED,
-      preheatHotendTemp2 = PREHEAT_2_TEMP_HOTEND, preheatBedTemp2 = PREHEAT_2_TEMP_BED, preheatFanSpeed2 = PREHEAT_2_FAN_SPEED;
-#endif
-	_EEPROMWrite(&EEPROMconfig->preheatHotendTemp[0],(uint16_t)preheatHotendTemp1);
-	_EEPROMWrite(&EEPROMconfig->preheatHotendTemp[1],(uint16_t)preheatHotendTemp2);
-	_EEPROMWrite(&EEPROMconfig->preheatBedTemp[0],(uint16_t)preheatBedTemp1);
-	_EEPROMWrite(&EEPROMconfig->preheatBedTemp[1],(uint16_t)preheatBedTemp2);
-	_EEPROMWrite(&EEPROMconfig->preheatFanSpeed[0],(uint16_t)preheatFanSpeed1);
-	_EEPROMWrite(&EEPROMconfig->preheatFanSpeed[1],(uint16_t)preheatFanSpeed2);
-#if ENABLED(PIDTEMP)
-	_EEPROMWrite(&EEPROMconfig->kP,PID_PARAM(Kp, e));
-	_EEPROMWrite(&EEPROMconfig->kI,(float)unscalePID_i(PID_PARAM(Ki, e)));
-	_EEPROMWrite(&EEPROMconfig->kD,(float)unscalePID_d(PID_PARAM(Kd, e)));
-#endif
-	_EEPROMWrite(&EEPROMconfig->volumetric_enabled,(uint16_t)volumetric_enabled);
-	for(int i=0;i<EXTRUDERS;i++)
-		_EEPROMWrite(&EEPROMconfig->filament_size[i],filament_size[i]);
-#if ENABLED(AUTO_BED_LEVELING_GRID)
-	for(int i=0;i<2;i++)
-		_EEPROMWrite(&EEPROMconfig->delta_grid_spacing[i],delta_grid_spacing[i]);
-	for(int i=0;i<AUTO_BED_LEVELING_GRID_POINTS;i++)
-		for(int j=0;j<AUTO_BED_LEVELING_GRID_POINTS;j++)
-			_EEPROMWrite(&EEPROMconfig->bed_level[i][j],bed_level[i][j]);
-#endif
+#include <stddef.h>
+#include "flash_store.h"
+
+/**
+ * Keys of the settings in the flash store (flash_store.h). They are never
+ * renumbered, a setting added takes a new key: a value under a key this
+ * firmware doesn't have, or of another size, is left alone. A key's value
+ * is laid out as its fields of ConfigSettings, the one page settings were
+ * written to in place before, which is read when the store has none yet.
+ */
+enum SettingsKey {
+  KEY_FW_VERSION,          // of the firmware that stored them
+  KEY_STEPS_PER_MM,        // M92
+  KEY_MAX_FEEDRATE,        // M203
+  KEY_MAX_ACCELERATION,    // M201
+  KEY_ACCELERATION,        // M204 P R T
+  KEY_MIN_FEEDRATE,        // M205 S T B X Z E
+  KEY_HOME_OFFSET,         // M206
+  KEY_ZPROBE_ZOFFSET,      // M851
+  KEY_ENDSTOP_ADJ,         // M666
+  KEY_DELTA_HEIGHT,        // M665 H
+  KEY_DELTA,               // M665 L R S
+  KEY_DELTA_TRIM,          // diagonal rod, radius and angle trims of the towers
+  KEY_PREHEAT,             // M145
+  KEY_PID,                 // M301, Ki and Kd unscaled
+  KEY_VOLUMETRIC,          // M200 D
+  KEY_FILAMENT_SIZE,       // M200 T D
+  KEY_GRID_SPACING,        // G29
+  KEY_JUNCTION_DEVIATION,  // M205 J
+  KEY_BED_LEVEL,           // G29, a key a row of the grid, MAX_MESH_LEVELING_POINTS of them
+  #if ENABLED(AUTO_BED_LEVELING_GRID)
+    SETTINGS_KEYS = KEY_BED_LEVEL + AUTO_BED_LEVELING_GRID_POINTS
+  #else
+    SETTINGS_KEYS = KEY_BED_LEVEL
+  #endif
+};
+
+#define LEGACY(F)    offsetof(ConfigSettings, F)
+#define LEGACY_NONE  0xFFFF
+
+// Where each key's value is in ConfigSettings
+static const uint16_t legacyOffset[KEY_BED_LEVEL] = {
+  LEGACY(MAJOR_FW_VERSION), LEGACY(axis_steps_per_mm), LEGACY(max_feedrate_mm_s),
+  LEGACY(max_acceleration_mm_per_s2), LEGACY(acceleration), LEGACY(min_feedrate_mm_s),
+  LEGACY(home_offset), LEGACY(zprobe_zoffset), LEGACY(endstop_adj), LEGACY(delta_height),
+  LEGACY(delta_diagonal_rod), LEGACY(delta_diagonal_rod_trim),
+  LEGACY_NONE,  // the preheat settings went in as uint16_t in float fields
+  LEGACY(kP), LEGACY(volumetric_enabled), LEGACY(filament_size), LEGACY(delta_grid_spacing),
+  LEGACY(junction_deviation_mm)
+};
+
+static const ConfigSettings *EEPROMconfig = (const ConfigSettings *)EEPROM_ADDRESS;
+static uint8_t storedVersion[4];  // MAJOR_FW_VERSION to MINOR_FW_SUBVERSION
+
+/**
+ * The value M500 stores under key into data; its size, or 0 if it isn't
+ * a key of this firmware
+ */
+static uint8_t settings_value(const uint8_t key, void *data) {
+  float *f = (float *)data;
+  uint32_t *u = (uint32_t *)data;
+  switch (key) {
+    case KEY_FW_VERSION: {
+      uint8_t *v = (uint8_t *)data;
+      v[0] = MARLIN_MAJOR_FW_VERSION;
+      v[1] = MARLIN_MINOR_FW_VERSION;
+      v[2] = MARLIN_MAJOR_FW_SUBVERSION;
+      v[3] = MARLIN_MINOR_FW_SUBVERSION;
+      return 4;
+    }
+    case KEY_STEPS_PER_MM:
+      memcpy(f, planner.axis_steps_per_mm, sizeof(planner.axis_steps_per_mm));
+      return sizeof(planner.axis_steps_per_mm);
+    case KEY_MAX_FEEDRATE:
+      memcpy(f, planner.max_feedrate_mm_s, sizeof(planner.max_feedrate_mm_s));
+      return sizeof(planner.max_feedrate_mm_s);
+    case KEY_MAX_ACCELERATION:
+      for (uint8_t i = 0; i < NUM_AXIS; i++) u[i] = planner.max_acceleration_mm_per_s2[i];
+      return NUM_AXIS * sizeof(uint32_t);
+    case KEY_ACCELERATION:
+      f[0] = planner.acceleration;
+      f[1] = planner.retract_acceleration;
+      f[2] = planner.travel_acceleration;
+      return 3 * sizeof(float);
+    case KEY_MIN_FEEDRATE:
+      f[0] = planner.min_feedrate_mm_s;
+      f[1] = planner.min_travel_feedrate_mm_s;
+      u[2] = planner.min_segment_time;
+      f[3] = planner.max_xy_jerk;
+      f[4] = planner.max_z_jerk;
+      f[5] = planner.max_e_jerk;
+      return 6 * sizeof(float);
+    case KEY_HOME_OFFSET:
+      memcpy(f, home_offset, sizeof(home_offset));
+      return sizeof(home_offset);
+    case KEY_ZPROBE_ZOFFSET:
+      f[0] = zprobe_zoffset;
+      return sizeof(float);
+    case KEY_ENDSTOP_ADJ:
+      memcpy(f, endstop_adj, sizeof(endstop_adj));
+      return sizeof(endstop_adj);
+    case KEY_DELTA_HEIGHT:
+      f[0] = delta_height;
+      return sizeof(float);
+    case KEY_DELTA:
+      f[0] = delta_diagonal_rod;
+      f[1] = delta_radius;
+      f[2] = delta_segments_per_second;
+      return 3 * sizeof(float);
+    case KEY_DELTA_TRIM:
+      f[0] = delta_diagonal_rod_trim_tower_1;
+      f[1] = delta_diagonal_rod_trim_tower_2;
+      f[2] = delta_diagonal_rod_trim_tower_3;
+      f[3] = delta_radius_trim_tower_1;
+      f[4] = delta_radius_trim_tower_2;
+      f[5] = delta_radius_trim_tower_3;
+      memcpy(&f[6], delta_tower_angle_trim, sizeof(delta_tower_angle_trim));
+      return 9 * sizeof(float);
+    #if ENABLED(ULTIPANEL)
+      case KEY_PREHEAT: {
+        uint16_t *h = (uint16_t *)data;
+        h[0] = preheatHotendTemp1; h[1] = preheatBedTemp1; h[2] = preheatFanSpeed1;
+        h[3] = preheatHotendTemp2; h[4] = preheatBedTemp2; h[5] = preheatFanSpeed2;
+        return 6 * sizeof(uint16_t);
+      }
+    #endif
+    #if ENABLED(PIDTEMP)
+      case KEY_PID:
+        f[0] = PID_PARAM(Kp, 0);
+        f[1] = unscalePID_i(PID_PARAM(Ki, 0));
+        f[2] = unscalePID_d(PID_PARAM(Kd, 0));
+        return 3 * sizeof(float);
+    #endif
+    case KEY_VOLUMETRIC:
+      *(uint16_t *)data = volumetric_enabled;
+      return sizeof(uint16_t);
+    case KEY_FILAMENT_SIZE:
+      memcpy(f, filament_size, sizeof(filament_size));
+      return sizeof(filament_size);
+    #if ENABLED(AUTO_BED_LEVELING_GRID)
+      case KEY_GRID_SPACING:
+        memcpy(f, delta_grid_spacing, sizeof(delta_grid_spacing));
+        return sizeof(delta_grid_spacing);
+    #endif
+    case KEY_JUNCTION_DEVIATION:
+      f[0] = planner.junction_deviation_mm;
+      return sizeof(float);
+  }
+  #if ENABLED(AUTO_BED_LEVELING_GRID)
+    if (key >= KEY_BED_LEVEL && key < KEY_BED_LEVEL + AUTO_BED_LEVELING_GRID_POINTS) {
+      memcpy(f, bed_level[key - KEY_BED_LEVEL], sizeof(bed_level[0]));
+      return sizeof(bed_level[0]);
+    }
+  #endif
+  return 0;
+}
+
+// A value stored under key, back to where M500 took it from
+static void settings_apply(const uint8_t key, const void *data, const uint8_t size, void *arg) {
+  uint32_t value[FLASH_STORE_MAX / sizeof(uint32_t)];
+  if (settings_value(key, value) != size) return;
+  memcpy(value, data, size);  // the store's records are only half-word aligned
+  const float *f = (const float *)value;
+  const uint32_t *u = value;
+  switch (key) {
+    case KEY_FW_VERSION:
+      memcpy(storedVersion, value, sizeof(storedVersion));
+      return;
+    case KEY_STEPS_PER_MM:
+      memcpy(planner.axis_steps_per_mm, f, size);
+      return;
+    case KEY_MAX_FEEDRATE:
+      memcpy(planner.max_feedrate_mm_s, f, size);
+      return;
+    case KEY_MAX_ACCELERATION:
+      for (uint8_t i = 0; i < NUM_AXIS; i++) planner.max_acceleration_mm_per_s2[i] = u[i];
+      return;
+    case KEY_ACCELERATION:
+      planner.acceleration = f[0];
+      planner.retract_acceleration = f[1];
+      planner.travel_acceleration = f[2];
+      return;
+    case KEY_MIN_FEEDRATE:
+      planner.min_feedrate_mm_s = f[0];
+      planner.min_travel_feedrate_mm_s = f[1];
+      planner.min_segment_time = u[2];
+      planner.max_xy_jerk = f[3];
+      planner.max_z_jerk = f[4];
+      planner.max_e_jerk = f[5];
+      return;
+    case KEY_HOME_OFFSET:
+      memcpy(home_offset, f, size);
+      return;
+    case KEY_ZPROBE_ZOFFSET:
+      zprobe_zoffset = f[0];
+      return;
+    case KEY_ENDSTOP_ADJ:
+      memcpy(endstop_adj, f, size);
+      return;
+    case KEY_DELTA_HEIGHT:
+      set_delta_height(f[0]);
+      return;
+    case KEY_DELTA:
+      delta_diagonal_rod = f[0];
+      delta_radius = f[1];
+      delta_segments_per_second = f[2];
+      return;
+    case KEY_DELTA_TRIM:
+      delta_diagonal_rod_trim_tower_1 = f[0];
+      delta_diagonal_rod_trim_tower_2 = f[1];
+      delta_diagonal_rod_trim_tower_3 = f[2];
+      delta_radius_trim_tower_1 = f[3];
+      delta_radius_trim_tower_2 = f[4];
+      delta_radius_trim_tower_3 = f[5];
+      memcpy(delta_tower_angle_trim, &f[6], sizeof(delta_tower_angle_trim));
+      return;
+    #if ENABLED(ULTIPANEL)
+      case KEY_PREHEAT: {
+        const uint16_t *h = (const uint16_t *)value;
+        preheatHotendTemp1 = h[0]; preheatBedTemp1 = h[1]; preheatFanSpeed1 = h[2];
+        preheatHotendTemp2 = h[3]; preheatBedTemp2 = h[4]; preheatFanSpeed2 = h[5];
+        return;
+      }
+    #endif
+    #if ENABLED(PIDTEMP)
+      case KEY_PID:
+        PID_PARAM(Kp, 0) = f[0];
+        PID_PARAM(Ki, 0) = scalePID_i(f[1]);
+        PID_PARAM(Kd, 0) = scalePID_d(f[2]);
+        return;
+    #endif
+    case KEY_VOLUMETRIC:
+      volumetric_enabled = *(const uint16_t *)value;
+      return;
+    case KEY_FILAMENT_SIZE:
+      memcpy(filament_size, f, size);
+      return;
+    #if ENABLED(AUTO_BED_LEVELING_GRID)
+      case KEY_GRID_SPACING:
+        memcpy(delta_grid_spacing, f, size);
+        return;
+    #endif
+    case KEY_JUNCTION_DEVIATION:
+      if (f[0] >= 0) planner.junction_deviation_mm = f[0];  // erased (NaN) if stored before it was one
+      return;
+  }
+  #if ENABLED(AUTO_BED_LEVELING_GRID)
+    memcpy(bed_level[key - KEY_BED_LEVEL], f, size);
+  #endif
+}
+
+/**
+ * M500: only the settings changed since the last are appended to the
+ * store, or they all go to the next page when it is full
+ */
+void Config_StoreSettings() {
+  bool stored = flashStore.open() && flashStore.begin();
+  uint32_t value[FLASH_STORE_MAX / sizeof(uint32_t)];
+  for (uint8_t key = 0; stored && key < SETTINGS_KEYS; key++) {
+    const uint8_t size = settings_value(key, value);
+    if (size) stored = flashStore.put(key, value, size);
+  }
+  if (!(stored && flashStore.commit()) && !flashStore.compact(settings_value, SETTINGS_KEYS)) {
+    SERIAL_ERROR_START;
+    SERIAL_ERRORLNPGM(MSG_ERR_EEPROM_WRITE);
+  }
 }
+
 void Config_RetrieveSettings() {
-	char buff[80];
-	struct { uint8_t api_major_version; uint8_t api_minor_version; } api_version;
-	struct { uint8_t api_major_version; uint8_t api_minor_version; } fw_version;
-	struct { uint8_t api_major_version; uint8_t api_minor_version; } fw_subversion;
-	_EEPROMRead(&EEPROMconfig->API_MAJOR_VERSION,api_version.api_major_version);
-	_EEPROMRead(&EEPROMconfig->API_MINOR_VERSION,api_version.api_minor_version);
-	_EEPROMRead(&EEPROMconfig->MAJOR_FW_VERSION,fw_version.api_major_version);
-	_EEPROMRead(&EEPROMconfig->MINOR_FW_VERSION,fw_version.api_minor_version);
-	_EEPROMRead(&EEPROMconfig->MAJOR_FW_SUBVERSION,fw_subversion.api_major_version);
-	_EEPROMRead(&EEPROMconfig->MINOR_FW_SUBVERSION,fw_subversion.api_minor_version);
-	if(api_version.api_major_version != CONFIG_API_MAJOR_VERSION || api_version.api_minor_version != CONFIG_API_MINOR_VERSION) {
-		sprintf(buff,"config API version does not match Req:%d.%d Got:%d.%d\r\n",
-				CONFIG_API_MAJOR_VERSION,CONFIG_API_MINOR_VERSION,
-				api_version.api_major_version,api_version.api_minor_version);
-		MYSERIAL.write(buff);
-		return;
-	}
-	sprintf(buff,"current FW version:%d.%d.%d\r\n",
-			MARLIN_MAJOR_FW_VERSION,MARLIN_MINOR_FW_VERSION,MARLIN_MAJOR_FW_SUBVERSION);
-	MYSERIAL.write(buff);
-	sprintf(buff,"EEPROM FW version:%d.%d.%d\r\n",
-			fw_version.api_major_version,fw_version.api_minor_version,fw_subversion.api_major_version);
-	MYSERIAL.write(buff);
-	for(int i=0;i<NUM_AXIS;i++)
-		_EEPROMRead(&EEPROMconfig->axis_steps_per_mm[i],planner.axis_steps_per_mm[i]);
-	for(int i=0;i<NUM_AXIS;i++)
-			_EEPROMRead(&EEPROMconfig->max_feedrate_mm_s[i],planner.max_feedrate_mm_s[i]);
-	for(int i=0;i<NUM_AXIS;i++)
-			_EEPROMRead(&EEPROMconfig->max_acceleration_mm_per_s2[i],planner.max_acceleration_mm_per_s2[i]);
-	_EEPROMRead(&EEPROMconfig->acceleration,planner.acceleration);
-	_EEPROMRead(&EEPROMconfig->retract_acceleration,planner.retract_acceleration);
-	_EEPROMRead(&EEPROMconfig->travel_acceleration,planner.travel_acceleration);
-	_EEPROMRead(&EEPROMconfig->min_feedrate_mm_s,planner.min_feedrate_mm_s);
-	_EEPROMRead(&EEPROMconfig->min_travel_feedrate_mm_s,planner.min_travel_feedrate_mm_s);
-	_EEPROMRead(&EEPROMconfig->min_segment_time,planner.min_segment_time);
-	_EEPROMRead(&EEPROMconfig->max_xy_jerk,planner.max_xy_jerk);
-	_EEPROMRead(&EEPROMconfig->max_z_jerk,planner.max_z_jerk);
-	_EEPROMRead(&EEPROMconfig->max_e_jerk,planner.max_e_jerk);
-	for(int i=0;i<3;i++)
-		_EEPROMRead(&EEPROMconfig->home_offset[i],home_offset[i]);
-	_EEPROMRead(&EEPROMconfig->zprobe_zoffset,zprobe_zoffset);
-	for(int i=0;i<3;i++)
-		_EEPROMRead(&EEPROMconfig->endstop_adj[i],endstop_adj[i]);
-	float height;
-	_EEPROMRead(&EEPROMconfig->delta_height,height);
-	set_delta_height(height);
-	_EEPROMRead(&EEPROMconfig->delta_diagonal_rod,delta_diagonal_rod);
-	_EEPROMRead(&EEPROMconfig->delta_radius,delta_radius);
-	_EEPROMRead(&EEPROMconfig->delta_segments_per_second,delta_segments_per_second);
-	_EEPROMRead(&EEPROMconfig->delta_diagonal_rod_trim[A_AXIS],delta_diagonal_rod_trim_tower_1);
-	_EEPROMRead(&EEPROMconfig->delta_diagonal_rod_trim[B_AXIS],delta_diagonal_rod_trim_tower_2);
-	_EEPROMRead(&EEPROMconfig->delta_diagonal_rod_trim[C_AXIS],delta_diagonal_rod_trim_tower_3);
-	_EEPROMRead(&EEPROMconfig->delta_radius_trim[A_AXIS],delta_radius_trim_tower_1);
-	_EEPROMRead(&EEPROMconfig->delta_radius_trim[B_AXIS],delta_radius_trim_tower_2);
-	_EEPROMRead(&EEPROMconfig->delta_radius_trim[C_AXIS],delta_radius_trim_tower_3);
-	for(int i=0;i<3;i++)
-		_EEPROMRead(&EEPROMconfig->delta_angle_trim[i],delta_tower_angle_trim[i]);
-
-#if ENABLED(ULTIPANEL)
-	_EEPROMRead(&EEPROMconfig->preheatHotendTemp[0],preheatHotendTemp1);
-	_EEPROMRead(&EEPROMconfig->preheatHotendTemp[1],preheatHotendTemp2);
-	_EEPROMRead(&EEPROMconfig->preheatBedTemp[0],preheatBedTemp1);
-	_EEPROMRead(&EEPROMconfig->preheatBedTemp[1],preheatBedTemp2);
-	_EEPROMRead(&EEPROMconfig->preheatFanSpeed[0],preheatFanSpeed1);
-	_EEPROMRead(&EEPROMconfig->preheatFanSpeed[1],preheatFanSpeed2);
-#endif//ULTIPANEL
-#if ENABLED(PIDTEMP)
-	_EEPROMRead(&EEPROMconfig->kP,PID_PARAM(Kp, e));
-	_EEPROMRead(&EEPROMconfig->kI,PID_PARAM(Ki, e));
-	PID_PARAM(Ki,e) = scalePID_i(PID_PARAM(Ki, e));
-	_EEPROMRead(&EEPROMconfig->kD,PID_PARAM(Kd, e));
-	PID_PARAM(Kd,e) = scalePID_d(PID_PARAM(Kd, e));
-#endif
-	_EEPROMRead(&EEPROMconfig->volumetric_enabled,volumetric_enabled);
-	for(int i=0;i<EXTRUDERS;i++)
-		_EEPROMRead(&EEPROMconfig->filament_size[i],filament_size[i]);
-#if ENABLED(AUTO_BED_LEVELING_GRID)
-
-	for(int i=0;i<2;i++)
-		_EEPROMRead(&EEPROMconfig->delta_grid_spacing[i],delta_grid_spacing[i]);
-	for(int i=0;i<AUTO_BED_LEVELING_GRID_POINTS;i++)
-		for(int j=0;j<AUTO_BED_LEVELING_GRID_POINTS;j++)
-			_EEPROMRead(&EEPROMconfig->bed_level[i][j],bed_level[i][j]);
-	Config_Postprocess();
-#endif//AUTO_BED_LEVELING_GRID
+  char buff[80];
+  memset(storedVersion, 0, sizeof(storedVersion));
+  if (flashStore.open())
+    flashStore.each(FLASH_STORE_ANY, settings_apply, NULL);
+  else if (EEPROMconfig->API_MAJOR_VERSION == CONFIG_API_MAJOR_VERSION && EEPROMconfig->API_MINOR_VERSION == CONFIG_API_MINOR_VERSION) {
+    // Stored before the store, the next M500 moves them to it
+    uint32_t value[FLASH_STORE_MAX / sizeof(uint32_t)];
+    for (uint8_t key = 0; key < SETTINGS_KEYS; key++) {
+      const uint16_t offset = key < KEY_BED_LEVEL ? legacyOffset[key]
+                            : LEGACY(bed_level) + (key - KEY_BED_LEVEL) * sizeof(EEPROMconfig->bed_level[0]);
+      const uint8_t size = settings_value(key, value);
+      if (size && offset != LEGACY_NONE) settings_apply(key, (const uint8_t *)EEPROMconfig + offset, size, NULL);
+    }
+  }
+  else {
+    sprintf(buff,"config API version does not match Req:%d.%d Got:%d.%d\r\n",
+        CONFIG_API_MAJOR_VERSION,CONFIG_API_MINOR_VERSION,
+        EEPROMconfig->API_MAJOR_VERSION,EEPROMconfig->API_MINOR_VERSION);
+    MYSERIAL.write(buff);
+    return;
+  }
+  sprintf(buff,"current FW version:%d.%d.%d\r\n",
+      MARLIN_MAJOR_FW_VERSION,MARLIN_MINOR_FW_VERSION,MARLIN_MAJOR_FW_SUBVERSION);
+  MYSERIAL.write(buff);
+  sprintf(buff,"EEPROM FW version:%d.%d.%d\r\n",
+      storedVersion[0],storedVersion[1],storedVersion[2]);
+  MYSERIAL.write(buff);
+  Config_Postprocess();
 }
 #elif ENABLED(SD_SETTINGS)
 
@@ -815,6 +962,7 @@ void Config_StoreSettings()
   /* X=maximum XY jerk (mm/s),     */
   /* Z=maximum Z jerk (mm/s),      */
   /* E=maximum E jerk (mm/s)       */
+  /* J=junction deviation (mm)     */
   strcpy(cmdStr,"M205 S");
   sprintf(numStr, "%.2f", planner.min_feedrate_mm_s);
   strcat(cmdStr, numStr);
@@ -833,10 +981,13 @@ void Config_StoreSettings()
   strcat(cmdStr, " E");
   sprintf(numStr, "%.2f", planner.max_e_jerk);
   strcat(cmdStr, numStr);
+  strcat(cmdStr, " J");
+  sprintf(numStr, "%.3f", planner.junction_deviation_mm);
+  strcat(cmdStr, numStr);
   p_card->write_command(cmdStr);
   strcpy(cmdStr, "; S=Min feedrate (mm/s), T=Min travel feedrate (mm/s), B=minimum segment time (ms), ");
   p_card->write_command(cmdStr);
-  strcpy(cmdStr, "; X=maximum XY jerk (mm/s),  Z=maximum Z jerk (mm/s),  E=maximum E jerk (mm/s)");
+  strcpy(cmdStr, "; X=maximum XY jerk (mm/s),  Z=maximum Z jerk (mm/s),  E=maximum E jerk (mm/s),  J=junction deviation (mm)");
   p_card->write_command(cmdStr);
 
   /* Home offset (mm) */
@@ -1197,6 +1348,7 @@ void Config_ResetDefault() {
   planner.max_xy_jerk = DEFAULT_XYJERK;
   planner.max_z_jerk = DEFAULT_ZJERK;
   planner.max_e_jerk = DEFAULT_EJERK;
+  planner.junction_deviation_mm = DEFAULT_JUNCTION_DEVIATION;
   home_offset[X_AXIS] = home_offset[Y_AXIS] = home_offset[Z_AXIS] = 0;
 
   #if ENABLED(MESH_BED_LEVELING)
@@ -1375,7 +1527,7 @@ void Config_PrintSettings(bool forReplay) {
 
   CONFIG_ECHO_START;
   if (!forReplay) {
-    SERIAL_ECHOLNPGM("Advanced variables: S=Min feedrate (mm/s), T=Min travel feedrate (mm/s), B=minimum segment time (ms), X=maximum XY jerk (mm/s),  Z=maximum Z jerk (mm/s),  E=maximum E jerk (mm/s)");
+    SERIAL_ECHOLNPGM("Advanced variables: S=Min feedrate (mm/s), T=Min travel feedrate (mm/s), B=minimum segment time (ms), X=maximum XY jerk (mm/s),  Z=maximum Z jerk (mm/s),  E=maximum E jerk (mm/s),  J=junction deviation (mm)");
     CONFIG_ECHO_START;
   }
   SERIAL_ECHOPAIR("  M205 S", planner.min_feedrate_mm_s);
@@ -1384,6 +1536,7 @@ void Config_PrintSettings(bool forReplay) {
   SERIAL_ECHOPAIR(" X", planner.max_xy_jerk);
   SERIAL_ECHOPAIR(" Z", planner.max_z_jerk);
   SERIAL_ECHOPAIR(" E", planner.max_e_jerk);
+  SERIAL_ECHOPAIR(" J", planner.junction_deviation_mm);
   SERIAL_EOL;
 
   CONFIG_ECHO_START;
@@ -32,7 +32,8 @@
 #endif
 #define CONFIG_API_MAJOR_VERSION 1
 #define CONFIG_API_MINOR_VERSION 0
-//data writes must be 16-bit aligned
+//the settings as written in place to the EEPROM page before the flash store
+//(flash_store.h), read from there until the first M500 with it
 typedef struct ConfigSettings {
 	uint8_t API_MAJOR_VERSION;
 	uint8_t API_MINOR_VERSION;
@@ -72,6 +73,7 @@ typedef struct ConfigSettings {
 	float filament_size[MAX_EXTRUDERS]; //change if number of extruders changes
 	float delta_grid_spacing[2];
 	float bed_level[MAX_MESH_LEVELING_POINTS][MAX_MESH_LEVELING_POINTS]; //leave room for 10x10 mesh grid if we decide to increase number of points
+	float junction_deviation_mm; //added last, erased (NaN) in settings stored before
 } ConfigSettings;
 
 void Config_ResetDefault();
@@ -89,23 +91,4 @@ void Config_ResetDefault();
   FORCE_INLINE void Config_StoreSettings() {}
   FORCE_INLINE void Config_RetrieveSettings() { Config_ResetDefault(); Config_PrintSettings(); }
 #endif
-  static FORCE_INLINE void _EEPROM_erase() {
-  	BSP_MiscEEPROMErase();
-  }
-
-  static FORCE_INLINE void _EEPROMWrite(volatile void *destination, float value)
-  {
-  	BSP_MiscEEPROMWriteF32((void *)destination,value);
-  }
-
-  static FORCE_INLINE void _EEPROMWrite(volatile void *destination, uint32_t value)
-  {
-  	BSP_MiscEEPROMWriteU32((void *)destination,value);
-  }
-
-  static FORCE_INLINE void _EEPROMWrite(volatile void *destination, uint16_t value)
-  {
-  	BSP_MiscEEPROMWriteU16((void *)destination,value);
-  }
-#define _EEPROMRead(src,dest) (dest = *src)
 #endif //CONFIGURATION_STORE_H
@@ -0,0 +1,61 @@
+#!/usr/bin/env python3
+
+""" Generate the stepper delay lookup table for Marlin firmware.
+
+Stepper::calc_timer() turns a step rate into a period of the stepper (Tick)
+timer, F_CPU() / TICK_TIMER_PRESCALER / step_rate - 1, without a division:
+the rate is looked up in one of two tables and interpolated between the
+entries. Each entry holds the period at its rate and the difference to the
+next entry.
+
+  speed_lookuptable_slow  rates from SPEED_LOOKUPTABLE_MIN_RATE, 8 apart
+  speed_lookuptable_fast  rates from SPEED_LOOKUPTABLE_MIN_RATE + 2048, 256 apart
+
+The defaults are for the 48MHz STM32F070 and its prescaler of 32:
+
+  python3 create_speed_lookuptable.py >speed_lookuptable.h
+"""
+
+import argparse
+
+parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+parser.add_argument('-f', '--cpu-freq', type=int, default=48, help='CPU clockrate in MHz (default=48)')
+parser.add_argument('-d', '--divider', type=int, default=32, help='Tick timer pre-scale divider (default=32)')
+args = parser.parse_args()
+
+timer_freq = args.cpu_freq * 1000000 // args.divider
+
+# the lowest rate whose period fits the 16 bit timer, as calc_timer() had it
+min_rate = timer_freq // 0xFFFF + 1
+
+def period(rate):
+    return timer_freq // rate - 1
+
+def table(name, step):
+    a = [period(i * step + min_rate) for i in range(257)]
+    print("const uint16_t %s[256][2] PROGMEM = {" % name)
+    for i in range(32):
+        print("  " + " ".join("{ %d, %d }," % (a[j], a[j] - a[j + 1]) for j in range(8 * i, 8 * i + 8)))
+    print("};")
+    print()
+
+print("/**")
+print(" * speed_lookuptable.h - step rate to Tick timer period, see Stepper::calc_timer()")
+print(" *")
+print(" * Generated by create_speed_lookuptable.py -f %d -d %d, do not edit." % (args.cpu_freq, args.divider))
+print(" */")
+print()
+print("#ifndef SPEED_LOOKUPTABLE_H")
+print("#define SPEED_LOOKUPTABLE_H")
+print()
+print('#include "Marlin.h"')
+print()
+print("#if F_CPU() != %d || TICK_TIMER_PRESCALER != %d" % (args.cpu_freq * 1000000, args.divider))
+print('  #error "speed_lookuptable.h does not match the Tick timer, regenerate it with create_speed_lookuptable.py"')
+print("#endif")
+print()
+print("#define SPEED_LOOKUPTABLE_MIN_RATE %d" % min_rate)
+print()
+table("speed_lookuptable_fast", 256)
+table("speed_lookuptable_slow", 8)
+print("#endif // SPEED_LOOKUPTABLE_H")
@@ -0,0 +1,252 @@
+/**
+ * Marlin 3D Printer Firmware
+ * Copyright (C) 2016 MarlinFirmware [https://github.com/MarlinFirmware/Marlin]
+ *
+ * Based on Sprinter and grbl.
+ * Copyright (C) 2011 Camiel Gubbels / Erik van der Zalm
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * delta_fixed.cpp - delta inverse kinematics in Q16.16 fixed point
+ */
+
+#include "delta_fixed.h"
+
+#if ENABLED(DELTA_FIXED_POINT)
+
+DeltaFixed deltaFixed;
+
+q16_t DeltaFixed::tower_x[3],
+      DeltaFixed::tower_y[3],
+      DeltaFixed::diagonal_rod_2[3],
+      DeltaFixed::diagonal_rod[3],
+      DeltaFixed::carriage[3];
+bool DeltaFixed::fits;
+
+float DeltaFixed::line_start[3],
+      DeltaFixed::line_diff[3],
+      DeltaFixed::line_inv_segments;
+uint16_t DeltaFixed::line_segments,
+         DeltaFixed::line_index;
+uint8_t DeltaFixed::chunk_max,
+        DeltaFixed::chunk_left,
+        DeltaFixed::chunk_shift;
+q16_t DeltaFixed::chunk_from[3];
+int32_t DeltaFixed::chunk_n[3],
+        DeltaFixed::chunk_dn[3],
+        DeltaFixed::chunk_ddn[3];
+
+bool DeltaFixed::set_tower(const uint8_t tower, const float x, const float y, const float rod_2) {
+  tower_x[tower] = float_to_q16(x);
+  tower_y[tower] = float_to_q16(y);
+  diagonal_rod_2[tower] = float_to_q16(rod_2);
+  if (tower_x[tower] == Q16_NAN || tower_y[tower] == Q16_NAN || diagonal_rod_2[tower] == Q16_NAN || diagonal_rod_2[tower] <= 0)
+    return false;
+  diagonal_rod[tower] = sqrt(diagonal_rod_2[tower]);
+  return true;
+}
+
+/**
+ * Digit by digit, two bits of the radicand per bit of the root: the 16
+ * pairs of v give the integer and 8 fraction bits, 8 more pairs of zeros
+ * the other 8 fraction bits. The remainder stays below twice the root, so
+ * it all fits 32 bits.
+ */
+uint32_t DeltaFixed::sqrt(uint32_t v) {
+  uint32_t root = 0, rem = 0;
+  for (uint8_t i = 24; i--;) {
+    rem = (rem << 2) | (v >> 30);
+    v <<= 2;
+    root <<= 1;
+    const uint32_t trial = (root << 1) | 1;
+    if (rem >= trial) {
+      rem -= trial;
+      root |= 1;
+    }
+  }
+  // round to nearest: v >= root^2 + root + 1/4
+  return rem > root ? root + 1 : root;
+}
+
+void DeltaFixed::inverse_kinematics(const float cartesian[3]) {
+  const q16_t x = float_to_q16(cartesian[X_AXIS]),
+              y = float_to_q16(cartesian[Y_AXIS]),
+              z = float_to_q16(cartesian[Z_AXIS]);
+  if (x == Q16_NAN || y == Q16_NAN || z == Q16_NAN) {
+    carriage[A_AXIS] = carriage[B_AXIS] = carriage[C_AXIS] = Q16_NAN;
+    return;
+  }
+  for (uint8_t i = 0; i < 3; i++) {
+    const q16_t dx = tower_x[i] - x, dy = tower_y[i] - y;
+    // a rod's length off on one axis is past its reach, the squares could overflow
+    if (labs(dx) >= diagonal_rod[i] || labs(dy) >= diagonal_rod[i]) {
+      carriage[i] = z;
+      continue;
+    }
+    // below the rod length squared each, their sum may pass 32768 mm^2, read them unsigned
+    const uint32_t reach = (uint32_t)mul(dx, dx) + (uint32_t)mul(dy, dy);
+    // past the rod length the root is 0, as arm_sqrt_f32() of a negative
+    carriage[i] = (reach < (uint32_t)diagonal_rod_2[i] ? sqrt(diagonal_rod_2[i] - reach) : 0) + z;
+  }
+}
+
+// Exact carriage heights at a segment end, the position as prepare_kinematic_move_to() has it
+static void line_solve(const uint16_t index) {
+  const float fraction = float(index) * DeltaFixed::line_inv_segments;
+  float position[3];
+  LOOP_XYZ(i) position[i] = DeltaFixed::line_start[i] + DeltaFixed::line_diff[i] * fraction;
+  DeltaFixed::inverse_kinematics(position);
+}
+
+/**
+ * The quadratic through the heights at the start, middle and end of a
+ * chunk of L is off by at most max|h'''| * L^3 / (72 * sqrt(3)). Per
+ * tower, with t the fraction of the line and r(t) = rod^2 - |XY(t) - tower|^2
+ * = a + b * t + c * t^2 the term under the root (h = sqrt(r) + z):
+ *
+ *   h''' = 3/8 * r'^3 / r^(5/2) - 3/4 * r' * r'' / r^(3/2)
+ *
+ * r is concave, so its least value on the line is at one of the ends, and
+ * |r'| = |b + 2 * c * t| is largest at one of the ends.
+ */
+void DeltaFixed::line_begin(const float start[3], const float end[3], const uint16_t segments) {
+  LOOP_XYZ(i) {
+    line_start[i] = start[i];
+    line_diff[i] = end[i] - start[i];
+  }
+  line_segments = segments;
+  line_inv_segments = 1.0 / segments;
+  line_index = 0;
+  chunk_left = 0;
+  chunk_max = 1;
+
+  // it takes chunks of 4 or more to save solves
+  if (DELTA_SEGMENT_TOLERANCE <= 0 || segments < 8) return;
+
+  q16_t end_carriage[3];
+  inverse_kinematics(end);
+  memcpy(end_carriage, carriage, sizeof(end_carriage));
+  inverse_kinematics(start);
+  if (carriage[A_AXIS] == Q16_NAN || end_carriage[A_AXIS] == Q16_NAN) return;
+
+  const float limit = DELTA_SEGMENT_TOLERANCE * 72 * 1.7320508 * sq((float)segments) * segments,
+              c = -(sq(line_diff[X_AXIS]) + sq(line_diff[Y_AXIS]));
+  uint8_t n = DELTA_CHUNK_MAX;
+  for (uint8_t i = 0; i < 3 && n >= 4; i++) {
+    const float root = min(q16_to_float(carriage[i]) - start[Z_AXIS], q16_to_float(end_carriage[i]) - end[Z_AXIS]);
+    // too close to the rod's reach, the bound is no use
+    if (root < 1.0) return;
+    const float b = 2 * (q16_to_float(tower_x[i]) - start[X_AXIS]) * line_diff[X_AXIS]
+                  + 2 * (q16_to_float(tower_y[i]) - start[Y_AXIS]) * line_diff[Y_AXIS],
+                slope = max(fabs(b), fabs(b + 2 * c)),
+                third = (0.375 * sq(slope) * slope / sq(root) + 1.5 * slope * -c) / (sq(root) * root);
+    while (n >= 4 && third * sq((float)n) * n > limit) n >>= 1;
+  }
+  if (n >= 4) chunk_max = n;
+}
+
+void DeltaFixed::line_next() {
+  if (!chunk_left) {
+    uint8_t n = chunk_max;
+    while (n > line_segments - line_index) n >>= 1;
+    if (n < 2) {
+      line_solve(++line_index);
+      return;
+    }
+    // a new chunk from the exact heights in carriage[]
+    q16_t mid[3];
+    memcpy(chunk_from, carriage, sizeof(chunk_from));
+    line_solve(line_index + n / 2);
+    memcpy(mid, carriage, sizeof(mid));
+    line_solve(line_index + n);
+    chunk_shift = 0;
+    while ((1 << chunk_shift) < n) chunk_shift++;
+    chunk_shift *= 2;
+    for (uint8_t i = 0; i < 3; i++) {
+      // h(k) = from + (a * n * k + b * k^2) / n^2, 0 <= k <= n
+      const int32_t a = 4 * mid[i] - 3 * chunk_from[i] - carriage[i],
+                    b = 2 * (chunk_from[i] - 2 * mid[i] + carriage[i]);
+      if ((uint32_t)(labs(a) + labs(b)) >= (1UL << 31) >> chunk_shift) {
+        // a very long chunk, solve the rest of the line
+        chunk_max = 1;
+        line_solve(++line_index);
+        return;
+      }
+      chunk_n[i] = 0;
+      chunk_dn[i] = a * n + b;
+      chunk_ddn[i] = 2 * b;
+    }
+    chunk_left = n;
+  }
+  // k = n divides exactly and ends the chunk on the solution at its end
+  line_index++;
+  chunk_left--;
+  for (uint8_t i = 0; i < 3; i++) {
+    chunk_n[i] += chunk_dn[i];
+    chunk_dn[i] += chunk_ddn[i];
+    carriage[i] = chunk_from[i] + ((chunk_n[i] + (1L << (chunk_shift - 1))) >> chunk_shift);
+  }
+}
+
+#if ENABLED(AUTO_BED_LEVELING_FEATURE)
+
+  // Q16.16 position times Q8.24 reciprocal spacing, in Q16.16 grid cells
+  static FORCE_INLINE q16_t grid(const q16_t position, const uint32_t inv_spacing) {
+    const q16_t cells = ((uint64_t)(position < 0 ? -position : position) * inv_spacing) >> 24;
+    return position < 0 ? -cells : cells;
+  }
+
+  bool DeltaFixed::bed_level_offset(const float x, const float y, q16_t &offset) {
+    // 1 / delta_grid_spacing[] in Q8.24, redone when G29 or M501 change the
+    // spacing. Rounded up, so a position on a grid line lands on it, not
+    // just short of it in the cell before (0.5 lsb of a Q16.16 position
+    // times the 2^-24 rounding is less than a Q8.24 lsb).
+    static float spacing[2];
+    static uint32_t inv_spacing[2];
+    if (memcmp(spacing, delta_grid_spacing, sizeof(spacing))) {
+      memcpy(spacing, delta_grid_spacing, sizeof(spacing));
+      for (uint8_t i = X_AXIS; i <= Y_AXIS; i++)
+        inv_spacing[i] = spacing[i] < 1.0 / 256 ? 0 : (uint32_t)ceil(16777216.0 / spacing[i]);
+    }
+    if (!inv_spacing[X_AXIS] || !inv_spacing[Y_AXIS]) return false; // G29 not done!
+
+    const int8_t half = (AUTO_BED_LEVELING_GRID_POINTS - 1) / 2;
+    // 0.001 grid cells in from the edge, like calc_delta_adjust()
+    const q16_t h1 = 66 - half * Q16_ONE, h2 = half * Q16_ONE - 66;
+    const q16_t qx = float_to_q16(x), qy = float_to_q16(y);
+    if (qx == Q16_NAN || qy == Q16_NAN) return false;
+    q16_t grid_x = grid(qx, inv_spacing[X_AXIS]),
+          grid_y = grid(qy, inv_spacing[Y_AXIS]);
+    NOLESS(grid_x, h1); NOMORE(grid_x, h2);
+    NOLESS(grid_y, h1); NOMORE(grid_y, h2);
+    // floor and fraction
+    const int8_t floor_x = grid_x >> 16, floor_y = grid_y >> 16;
+    const q16_t ratio_x = grid_x & 0xFFFF, ratio_y = grid_y & 0xFFFF,
+                z1 = float_to_q16(bed_level[floor_x + half][floor_y + half]),
+                z2 = float_to_q16(bed_level[floor_x + half][floor_y + half + 1]),
+                z3 = float_to_q16(bed_level[floor_x + half + 1][floor_y + half]),
+                z4 = float_to_q16(bed_level[floor_x + half + 1][floor_y + half + 1]);
+    if (z1 == Q16_NAN || z2 == Q16_NAN || z3 == Q16_NAN || z4 == Q16_NAN) return false;
+    const q16_t left = z1 + mul(z2 - z1, ratio_y),
+                right = z3 + mul(z4 - z3, ratio_y);
+    offset = left + mul(right - left, ratio_x);
+    return true;
+  }
+
+#endif // AUTO_BED_LEVELING_FEATURE
+
+#endif // DELTA_FIXED_POINT
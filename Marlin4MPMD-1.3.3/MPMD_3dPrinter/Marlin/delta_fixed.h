@@ -0,0 +1,130 @@
+/**
+ * Marlin 3D Printer Firmware
+ * Copyright (C) 2016 MarlinFirmware [https://github.com/MarlinFirmware/Marlin]
+ *
+ * Based on Sprinter and grbl.
+ * Copyright (C) 2011 Camiel Gubbels / Erik van der Zalm
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * delta_fixed.h - delta inverse kinematics in Q16.16 fixed point
+ *
+ * The Cortex-M0 has no FPU, so each float multiply, add and sqrtf of the
+ * float inverse_kinematics() is a library call. With DELTA_FIXED_POINT
+ * inverse_kinematics() and adjust_delta() convert the position to Q16.16
+ * (signed, 16 fraction bits, 1/65536 mm) and do the rest with 32 bit
+ * integer multiplies and a bit-by-bit square root; only the carriage
+ * heights handed to the planner are converted back to float.
+ *
+ * The float settings stay the reference: recalc_delta_settings() passes
+ * the tower positions and rod lengths on through set_tower(), and the
+ * bed_level[] grid is read as it is (see bed_level_offset()). A rod
+ * squared has to fit Q16.16, below 32768 mm^2 (a rod under about 181mm);
+ * with a longer one (M665 L) set_tower() is false and Marlin_main.cpp
+ * keeps to the float kinematics.
+ * sim/testdeltafixed checks the result against the float version, M931
+ * times both on the printer.
+ *
+ * Along a straight line the rod term under each square root is a
+ * quadratic of the distance travelled, and the carriage heights are smooth.
+ * prepare_kinematic_move_to() takes them from line_begin()/line_next(): an
+ * exact solve in the middle and at the end of each chunk of up to
+ * DELTA_CHUNK_MAX segments, the segments in between stepped by forward
+ * differences of the quadratic through the three. The chunk length comes
+ * from a bound on the third derivative over the line, so no segment is
+ * more than DELTA_SEGMENT_TOLERANCE off the exact solution (see
+ * sim/testdeltasegments).
+ */
+
+#ifndef DELTA_FIXED_H
+#define DELTA_FIXED_H
+
+#include "Marlin.h"
+#include "q16.h"
+
+#if ENABLED(DELTA_FIXED_POINT)
+
+// Longest chunk of forward differenced segments, a power of 2 up to 16
+#define DELTA_CHUNK_MAX 16
+
+class DeltaFixed {
+
+  public:
+
+    static q16_t tower_x[3], tower_y[3];  // tower positions
+    static q16_t diagonal_rod_2[3];       // diagonal rod length squared (mm^2)
+    static q16_t diagonal_rod[3];         // and the length
+    static q16_t carriage[3];             // last inverse_kinematics(), before adjust_delta()
+    static bool fits;                     // the geometry fits Q16.16, else the float kinematics are used
+
+    DeltaFixed() {};
+
+    /**
+     * Take over one tower of recalc_delta_settings(). False if it doesn't
+     * fit Q16.16.
+     */
+    static bool set_tower(const uint8_t tower, const float x, const float y, const float rod_2);
+
+    /**
+     * Carriage heights of a (raw) cartesian position, into carriage[]
+     */
+    static void inverse_kinematics(const float cartesian[3]);
+
+    // Forward differencing along a line
+    static float line_start[3], line_diff[3], line_inv_segments;
+    static uint16_t line_segments, line_index;
+    static uint8_t chunk_max;             // segments per chunk on this line, 1 solves each
+    static uint8_t chunk_left, chunk_shift;
+    static q16_t chunk_from[3];           // carriage heights at the chunk start
+    static int32_t chunk_n[3], chunk_dn[3], chunk_ddn[3]; // numerator, scaled by chunk length^2, and its differences
+
+    /**
+     * Split the line between two (raw) cartesian positions into segments for
+     * line_next(), choosing the chunk length
+     */
+    static void line_begin(const float start[3], const float end[3], const uint16_t segments);
+
+    /**
+     * Carriage heights at the end of the next segment, into carriage[]
+     */
+    static void line_next();
+
+    #if ENABLED(AUTO_BED_LEVELING_FEATURE)
+      /**
+       * Height of the bed_level[] grid at a (raw) XY position, bilinear
+       * like calc_delta_adjust(). False before G29 (or with a grid spacing
+       * under 1/256mm) or on an unprobed point.
+       */
+      static bool bed_level_offset(const float x, const float y, q16_t &offset);
+    #endif
+
+    /**
+     * Q16.16 product, rounded. |a * b| must stay below 32768.
+     */
+    static FORCE_INLINE q16_t mul(const q16_t a, const q16_t b) { return q16_mul(a, b); }
+
+    /**
+     * Q16.16 square root of a Q16.16 value, rounded
+     */
+    static uint32_t sqrt(uint32_t v);
+};
+
+extern DeltaFixed deltaFixed;
+
+#endif // DELTA_FIXED_POINT
+
+#endif // DELTA_FIXED_H
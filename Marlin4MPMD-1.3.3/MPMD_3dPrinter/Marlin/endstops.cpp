@@ -45,7 +45,8 @@ bool  Endstops::enabled = true,
         #else
           (false)
         #endif
-      ;
+      ,
+      Endstops::homing = true;
 volatile char Endstops::endstop_hit_bits; // use X_MIN, Y_MIN, Z_MIN and Z_MIN_PROBE as BIT value
 
 #if ENABLED(Z_DUAL_ENDSTOPS)
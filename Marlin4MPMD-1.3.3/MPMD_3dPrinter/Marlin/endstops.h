@@ -34,6 +34,7 @@ class Endstops {
   public:
 
     static bool enabled, enabled_globally;
+    static bool homing; // from enable() to not_homing(), also before the first homing
     static volatile char endstop_hit_bits; // use X_MIN, Y_MIN, Z_MIN and Z_MIN_PROBE as BIT value
 
     #if ENABLED(Z_DUAL_ENDSTOPS)
@@ -69,10 +70,10 @@ class Endstops {
     static void enable_globally(bool onoff=true) { enabled_globally = enabled = onoff; }
 
     // Enable / disable endstop checking
-    static void enable(bool onoff=true) { enabled = onoff; }
+    static void enable(bool onoff=true) { enabled = homing = onoff; }
 
     // Disable / Enable endstops based on ENSTOPS_ONLY_FOR_HOMING and global enable
-    static void not_homing() { enabled = enabled_globally; }
+    static void not_homing() { enabled = enabled_globally; homing = false; }
 
     // Clear endstops (i.e., they were hit intentionally) to suppress the report
     static void hit_on_purpose() { endstop_hit_bits = 0; }
@@ -0,0 +1,169 @@
+/**
+ * Marlin 3D Printer Firmware
+ * Copyright (C) 2016 MarlinFirmware [https://github.com/MarlinFirmware/Marlin]
+ *
+ * Based on Sprinter and grbl.
+ * Copyright (C) 2011 Camiel Gubbels / Erik van der Zalm
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * flash_store.cpp - settings kept in flash as a log of keyed records (M500)
+ */
+
+#include "flash_store.h"
+#include "uzlib.h"
+
+#if ENABLED(FLASH_SETTINGS)
+
+FlashStore flashStore;
+
+#define STORE_PAGE(N) ((uint16_t *)SETTINGS_FLASH_ADDRESS + (N) * FLASH_STORE_PAGE)
+
+// The CRC-32 of the tag and value of a record
+static uint32_t record_crc(const uint16_t *record, const uint8_t halfwords) {
+  return ~uzlib_crc32(record, (1 + halfwords) * sizeof(uint16_t), 0xFFFFFFFF);
+}
+
+// Not written since the erase
+static bool blank(const uint16_t *from, const uint16_t halfwords) {
+  for (uint16_t i = 0; i < halfwords; i++) if (from[i] != FLASH_STORE_FREE) return false;
+  return true;
+}
+
+bool FlashStore::valid(const uint16_t at) {
+  const uint8_t n = page[at] >> 8;
+  if (next(at) > end) return false;
+  const uint32_t crc = record_crc(&page[at], n);
+  return page[at + 1 + n] == (uint16_t)crc && page[at + 2 + n] == (uint16_t)(crc >> 16);
+}
+
+bool FlashStore::open() {
+  page = NULL;
+  for (uint8_t p = 0; p < SETTINGS_FLASH_PAGES; p++) {
+    uint16_t *header = STORE_PAGE(p);
+    if (header[2] != FLASH_STORE_MAGIC || header[0] != (uint16_t)~header[1]) continue;
+    // Both have one if the power went before the old page was erased, the newer counts
+    if (page && (int16_t)(header[0] - seq) < 0) continue;
+    page = header;
+    seq = header[0];
+  }
+  if (!page) return false;
+  // The records run to the first free tag; one torn by the power going is stepped
+  // over by its tag all the same, its CRC failing, or the page is taken as full
+  end = FLASH_STORE_PAGE;
+  uint16_t at = FLASH_STORE_HEADER;
+  while (at < FLASH_STORE_PAGE && page[at] != FLASH_STORE_FREE) at = next(at);
+  if (at < end) end = at;
+  return true;
+}
+
+void FlashStore::each(const uint8_t key, Record fn, void *arg) {
+  if (!page) return;
+  // The records from the last commit on are of an M500 the power went in
+  uint16_t from = FLASH_STORE_HEADER;
+  for (uint16_t at = FLASH_STORE_HEADER; at < end; at = next(at)) {
+    if ((uint8_t)page[at] != FLASH_STORE_COMMIT || (page[at] >> 8) != 1 || !valid(at)) continue;
+    const uint16_t start = page[at + 1];
+    for (uint16_t r = start; start >= from && r < at; r = next(r)) {
+      const uint8_t k = page[r];
+      if ((key == FLASH_STORE_ANY || k == key) && k != FLASH_STORE_COMMIT && valid(r))
+        fn(k, &page[r + 1], (page[r] >> 8) * sizeof(uint16_t), arg);
+    }
+    from = next(at);
+  }
+}
+
+bool FlashStore::append(const uint8_t key, const void *data, const uint8_t size) {
+  const uint8_t n = size / sizeof(uint16_t),
+                room = key == FLASH_STORE_COMMIT ? 0 : 4;  // for the commit after it
+  if (end + 3U + n + room > FLASH_STORE_PAGE || !blank(&page[end], 3 + n)) {
+    end = FLASH_STORE_PAGE;
+    return false;
+  }
+  uint16_t record[1 + FLASH_STORE_MAX / sizeof(uint16_t) + 2];
+  record[0] = key | (uint16_t)n << 8;
+  memcpy(&record[1], data, size);
+  const uint32_t crc = record_crc(record, n);
+  record[1 + n] = crc;
+  record[2 + n] = crc >> 16;
+  // The tag first, so the record is stepped over whatever else of it is written
+  const bool written = BSP_MiscFlashWrite(&page[end], record, 3 + n);
+  end += 3 + n;
+  if (!written) end = FLASH_STORE_PAGE;
+  return written;
+}
+
+bool FlashStore::begin() {
+  if (!page) return false;
+  txStart = end;
+  appended = false;
+  return true;
+}
+
+// The newest value of a key that counts
+typedef struct { const void *data; uint8_t size; } StoredValue;
+static void latest(const uint8_t key, const void *data, const uint8_t size, void *arg) {
+  UNUSED(key);
+  ((StoredValue *)arg)->data = data;
+  ((StoredValue *)arg)->size = size;
+}
+
+bool FlashStore::put(const uint8_t key, const void *data, const uint8_t size) {
+  StoredValue stored = { NULL, 0 };
+  each(key, latest, &stored);
+  if (stored.data && stored.size == size && !memcmp(stored.data, data, size)) return true;
+  if (!append(key, data, size)) return false;
+  appended = true;
+  return true;
+}
+
+bool FlashStore::commit() {
+  if (!appended) return true;  // nothing changed
+  return append(FLASH_STORE_COMMIT, &txStart, sizeof(txStart));
+}
+
+bool FlashStore::compact(Value value, const uint8_t keys) {
+  uint16_t *old = page;
+  const uint8_t p = old ? ((old - STORE_PAGE(0)) / FLASH_STORE_PAGE + 1) % SETTINGS_FLASH_PAGES : 0;
+  page = STORE_PAGE(p);
+  // The page in use if it is the only one, left as it was by the power going
+  // in a compact(), or settings from before the store
+  if (!blank(page, FLASH_STORE_PAGE) && (!BSP_MiscFlashErase(page) || !blank(page, FLASH_STORE_PAGE))) {
+    page = old;
+    return false;
+  }
+
+  end = txStart = FLASH_STORE_HEADER;
+  appended = true;
+  uint32_t data[FLASH_STORE_MAX / sizeof(uint32_t)];
+  bool written = true;
+  for (uint8_t key = 0; written && key < keys; key++) {
+    const uint8_t size = value(key, data);
+    if (size) written = append(key, data, size);
+  }
+  const uint16_t header[3] = { (uint16_t)(old ? seq + 1 : 0), (uint16_t)~(old ? seq + 1 : 0), FLASH_STORE_MAGIC };
+  if (!written || !commit() || !BSP_MiscFlashWrite(page, header, COUNT(header))) {
+    page = old;
+    if (old) open();
+    return false;
+  }
+  seq = header[0];
+  if (old && old != page) BSP_MiscFlashErase(old);  // left for the next compact() if it isn't
+  return true;
+}
+
+#endif // FLASH_SETTINGS
@@ -0,0 +1,103 @@
+/**
+ * Marlin 3D Printer Firmware
+ * Copyright (C) 2016 MarlinFirmware [https://github.com/MarlinFirmware/Marlin]
+ *
+ * Based on Sprinter and grbl.
+ * Copyright (C) 2011 Camiel Gubbels / Erik van der Zalm
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * flash_store.h - settings kept in flash as a log of keyed records (M500)
+ *
+ * The store takes SETTINGS_FLASH_PAGES pages at the top of the flash, the
+ * one EEPROM page the program has always been kept out of. One page at a
+ * time is in use, the one with a header whose seq is the newest;
+ * records are only ever appended to it, each a tag (the key, and the size
+ * of the value in half-words), the value and a CRC-32 of the two. An M500
+ * appends the values that changed since the last, then a commit record
+ * that points back to its first record: a record counts only once the
+ * commit of its M500 is there, so the power going mid-write leaves the
+ * settings as they were, never half of them, and the newest record of a
+ * key counting is its value.
+ *
+ * When the page is full it is erased and the values are all written to it
+ * again, its header last: once in a few dozen M500s rather than on every
+ * one as before, but the power going between the erase and the header
+ * still loses the settings as it did then. With two pages the values go
+ * to the other page instead and the full one is erased after, so the
+ * power going in that leaves the settings as they were, but the program
+ * has no second page of flash to spare (LinkerScript.ld).
+ *
+ * Flash reads as it is mapped, a value is taken from it with memcpy() as
+ * records are only half-word aligned.
+ */
+
+#ifndef FLASH_STORE_H
+#define FLASH_STORE_H
+
+#include "Marlin.h"
+
+#define FLASH_STORE_PAGE     (FLASH_PAGE_SIZE / 2)  // half-words
+#define FLASH_STORE_HEADER   4                      // seq, ~seq, magic and one left
+#define FLASH_STORE_MAGIC    0x5346                 // "FS"
+#define FLASH_STORE_FREE     0xFFFF                 // the tag of no record yet
+#define FLASH_STORE_COMMIT   0xFE                   // the key of the record ending an M500
+#define FLASH_STORE_ANY      0xFF                   // to each(), every key
+#define FLASH_STORE_MAX      64                     // bytes of a value, at most
+
+class FlashStore {
+
+  public:
+
+    typedef void (*Record)(const uint8_t key, const void *data, const uint8_t size, void *arg);
+    // A key's value into data, an even number of bytes, 0 if it isn't one
+    typedef uint8_t (*Value)(const uint8_t key, void *data);
+
+    // Find the page in use; false if there is none
+    bool open();
+
+    // fn for each record of key (FLASH_STORE_ANY, all) that counts, oldest first
+    void each(const uint8_t key, Record fn, void *arg);
+
+    /**
+     * An M500: begin(), put() each value, then commit(). put() appends a
+     * value unless it is the key's already, and is false if the page has
+     * no room for it; the changes then go to the next page with compact().
+     */
+    bool begin();
+    bool put(const uint8_t key, const void *data, const uint8_t size);
+    bool commit();
+
+    // Every key below keys, its value from value(), to the next page
+    bool compact(Value value, const uint8_t keys);
+
+  private:
+
+    uint16_t *page;        // in use, NULL if none
+    uint16_t seq,          // of its header
+             end,          // of its records, where the next goes
+             txStart;      // the first record of the M500 going on
+    bool appended;         // by it
+
+    uint16_t next(const uint16_t at) { return at + 3 + (page[at] >> 8); }
+    bool valid(const uint16_t at);
+    bool append(const uint8_t key, const void *data, const uint8_t size);
+};
+
+extern FlashStore flashStore;
+
+#endif // FLASH_STORE_H
@@ -0,0 +1,147 @@
+/**
+ * Marlin 3D Printer Firmware
+ * Copyright (C) 2016 MarlinFirmware [https://github.com/MarlinFirmware/Marlin]
+ *
+ * Based on Sprinter and grbl.
+ * Copyright (C) 2011 Camiel Gubbels / Erik van der Zalm
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+/**
+ * gcode_params.cpp - the parameters of a G-code command, tokenized once
+ */
+
+#include "gcode_params.h"
+
+GCodeParams gcodeParams;
+
+uint32_t GCodeParams::seen,
+         GCodeParams::has_value;
+float GCodeParams::value[GCODE_PARAM_LETTERS];
+uint8_t GCodeParams::offset[GCODE_PARAM_LETTERS];
+
+static const uint32_t pow10[] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000 };
+#define POW10_MAX (COUNT(pow10) - 1)
+
+/**
+ * m / 10^k, correctly rounded, by long division of 25 quotient bits
+ * (24 and the rounding bit) straight into the IEEE 754 bits; cheaper than
+ * a soft-float divide, which would also round m past 24 bits first
+ */
+static float divide_pow10(uint32_t m, const uint8_t k) {
+  uint32_t d = pow10[k];
+  int16_t e = 0;
+  // make d <= m < 2 * d, the quotient 1.xxx * 2^e
+  while (m < d) { m <<= 1; e--; }
+  while (m >= d << 1) { d <<= 1; e++; }
+  uint32_t q = 0;
+  for (uint8_t i = 25; i--;) {
+    // no branch: as cheap on the M0, and the host would mispredict half the bits
+    const uint32_t bit = m >= d;
+    q = (q << 1) | bit;
+    m = (m - (d & -bit)) << 1;
+  }
+  // round to nearest, ties to even
+  const bool half = q & 1;
+  q >>= 1;
+  if (half && (m || (q & 1))) q++;
+  if (q >> 24) { q >>= 1; e++; }
+  union { uint32_t u; float f; } v = { ((uint32_t)(e + 127) << 23) | (q & 0x7FFFFF) };
+  return v.f;
+}
+
+void GCodeParams::parse(const char* args) {
+  seen = has_value = 0;
+  for (const char* p = args; *p;) {
+    const uint8_t i = *p - 'A';
+    if (i >= GCODE_PARAM_LETTERS || TEST(seen, i)) {
+      p++;
+      continue;
+    }
+    SBI(seen, i);
+    offset[i] = p - args;
+    bool digits;
+    value[i] = parse_float(++p, digits);
+    if (digits) SBI(has_value, i);
+  }
+}
+
+void GCodeParams::add(const char letter, const float v) {
+  const uint8_t i = letter - 'A';
+  if (i >= GCODE_PARAM_LETTERS || TEST(seen, i)) return;
+  SBI(seen, i);
+  offset[i] = 0;
+  // without a number 0, as parse() and code_value_float() give it
+  if (isnan(v))
+    value[i] = 0;
+  else {
+    value[i] = v;
+    SBI(has_value, i);
+  }
+}
+
+float GCodeParams::parse_float(const char* &s, bool &digits) {
+  while (*s == ' ') s++;
+  const bool negative = (*s == '-');
+  if (negative || *s == '+') s++;
+
+  // the significant digits, and the power of ten they are off by
+  uint32_t mantissa = 0;
+  uint8_t significant = 0;
+  int8_t scale = 0;
+  digits = false;
+  for (bool fraction = false;; s++) {
+    if (NUMERIC(*s)) {
+      digits = true;
+      if (significant < 9) {
+        mantissa = mantissa * 10 + (*s - '0');
+        if (mantissa) significant++;
+        if (fraction) scale--;
+      }
+      else if (!fraction && scale < 127)
+        scale++;
+    }
+    else if (*s == '.' && !fraction)
+      fraction = true;
+    else
+      break;
+  }
+
+  // as strtod(), no digits is +0, "-0" is -0
+  if (!mantissa) return digits && negative ? -0.0 : 0.0;
+  float f;
+  if (scale >= 0) {
+    // past 9 digits of an integer, rounded once for each more
+    f = mantissa;
+    while (scale--) f *= 10;
+  }
+  else {
+    f = divide_pow10(mantissa, -scale < (int8_t)POW10_MAX ? -scale : POW10_MAX);
+    // the digits start more than 9 places after the point
+    for (; scale < -(int8_t)POW10_MAX; scale++) f /= 10;
+  }
+  return negative ? -f : f;
+}
+
+long GCodeParams::parse_long(const char* s) {
+  while (*s == ' ') s++;
+  const bool negative = (*s == '-');
+  if (negative || *s == '+') s++;
+  unsigned long n = 0;
+  while (NUMERIC(*s)) n = n * 10 + (*s++ - '0');
+  return negative ? -(long)n : (long)n;
+}
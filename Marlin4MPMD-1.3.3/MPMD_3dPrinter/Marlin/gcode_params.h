@@ -0,0 +1,103 @@
+/**
+ * Marlin 3D Printer Firmware
+ * Copyright (C) 2016 MarlinFirmware [https://github.com/MarlinFirmware/Marlin]
+ *
+ * Based on Sprinter and grbl.
+ * Copyright (C) 2011 Camiel Gubbels / Erik van der Zalm
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+/**
+ * gcode_params.h - the parameters of a G-code command, tokenized once
+ *
+ * code_seen() used to strchr() the command's arguments for every letter it
+ * was asked about, and code_value_float() to strchr() again for an 'E' to
+ * cut off before strtod(). A G1 took five scans and five strtod()s in
+ * double precision soft-float. process_next_command() now hands the
+ * arguments to parse() instead, which goes over them once: the first
+ * occurrence of each letter A-Z, wherever it is (strchr() would find it
+ * there too, even in a filename or a message), gets its value from
+ * parse_float() and its place in the arguments. code_seen() and the
+ * code_value_*() accessors read the table.
+ *
+ * parse_float() takes what code_value_float() did: spaces, a sign and the
+ * decimal digits, no exponent. Up to 9 significant digits are kept in a 32
+ * bit integer, the point in a power of ten to divide by. The divide is a
+ * 25 bit long division straight into the bits of the float, so the value
+ * is the nearest float, as strtod() gives it, without a soft-float call.
+ * sim/benchparse compares it with the strchr()/strtod() version over the
+ * G-code corpus.
+ */
+
+#ifndef GCODE_PARAMS_H
+#define GCODE_PARAMS_H
+
+#include "Marlin.h"
+
+#define GCODE_PARAM_LETTERS 26  // A to Z
+
+class GCodeParams {
+
+  public:
+
+    static uint32_t seen;                        // bit (letter - 'A') of the letters in the command
+    static uint32_t has_value;                   // of those, the ones followed by a number
+    static float value[GCODE_PARAM_LETTERS];     // parse_float() after the letter, 0 without a number
+    static uint8_t offset[GCODE_PARAM_LETTERS];  // of the letter in the arguments
+
+    GCodeParams() {};
+
+    /**
+     * Tokenize the arguments of a text command (at most MAX_CMD_SIZE long)
+     */
+    static void parse(const char* args);
+
+    /**
+     * Clear the table, for a command without text arguments
+     */
+    static FORCE_INLINE void clear() { seen = has_value = 0; }
+
+    /**
+     * Add a letter and its value, unless it is already there; NAN is no
+     * value, which reads 0 as a letter without a number does in the text
+     */
+    static void add(const char letter, const float v);
+
+    /**
+     * Index of a letter in the table, GCODE_PARAM_LETTERS if it isn't there
+     */
+    static FORCE_INLINE uint8_t find(const char letter) {
+      const uint8_t i = letter - 'A';
+      return i < GCODE_PARAM_LETTERS && TEST(seen, i) ? i : GCODE_PARAM_LETTERS;
+    }
+
+    /**
+     * Decimal number at s (leading spaces, a sign, digits and a point), as
+     * strtod() of that much; digits is false if there is no digit. s is
+     * left after the number.
+     */
+    static float parse_float(const char* &s, bool &digits);
+
+    /**
+     * Integer at s (leading spaces, a sign and digits), as strtol()
+     */
+    static long parse_long(const char* s);
+};
+
+extern GCodeParams gcodeParams;
+
+#endif // GCODE_PARAMS_H
@@ -0,0 +1,96 @@
+/**
+ * Marlin 3D Printer Firmware
+ * Copyright (C) 2016 MarlinFirmware [https://github.com/MarlinFirmware/Marlin]
+ *
+ * Based on Sprinter and grbl.
+ * Copyright (C) 2011 Camiel Gubbels / Erik van der Zalm
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * pid_fixed.cpp - the heater PID in Q16.16 fixed point
+ */
+
+#include "pid_fixed.h"
+
+#if ENABLED(PID_FIXED_POINT)
+
+#define PID_FIXED_K1 ((q16_t)((K1) * Q16_ONE + 0.5))
+
+static q16_t pid_fixed_limit(const float f) { return float_to_q16(min(f, (float)PID_FIXED_MAX)); }
+
+void PidFixed::set(const float p, const float i, const float d, const float driveMax) {
+  Kp = pid_fixed_limit(p);
+  Ki = pid_fixed_limit(i);
+  Kd = pid_fixed_limit((1.0 - (K1)) * d);
+  errorMax = pid_fixed_limit(PID_FIXED_MAX / p);
+  iStateMax = pid_fixed_limit(driveMax / i);
+  dMax = pid_fixed_limit(PID_FIXED_MAX / ((1.0 - (K1)) * d));
+}
+
+// dTerm = K2 * Kd * (current - dState) + K1 * dTerm
+void PidFixed::derivative(const q16_t current) {
+  const q16_t d = q16_mul(PID_FIXED_K1, dTerm) + q16_mul(Kd, constrain(current - dState, -dMax, dMax));
+  dTerm = constrain(d, -(PID_FIXED_MAX * Q16_ONE), PID_FIXED_MAX * Q16_ONE);
+  dState = current;
+}
+
+// p + i - d, 0 to max, the sum of the errors taken back when it saturates
+q16_t PidFixed::output(const q16_t error, const int16_t max) {
+  const q16_t e = constrain(error, -errorMax, errorMax);
+  pTerm = q16_mul(Kp, e);
+  iState = constrain(iState + e, 0, iStateMax);
+  iTerm = q16_mul(Ki, iState);
+  const q16_t out = pTerm + iTerm - dTerm;
+  if (out > max * Q16_ONE) {
+    if (e > 0) iState -= e; // conditional un-integration
+    return max * Q16_ONE;
+  }
+  if (out < 0) {
+    if (e < 0) iState -= e;
+    return 0;
+  }
+  return out;
+}
+
+#if ENABLED(PIDTEMP)
+
+q16_t PidFixed::hotend(const q16_t current, const q16_t target) {
+  const q16_t error = target - current;
+  derivative(current);
+  if (error > (PID_FUNCTIONAL_RANGE) * Q16_ONE) {
+    reset = true;
+    return (BANG_MAX) * Q16_ONE;
+  }
+  if (error < -(PID_FUNCTIONAL_RANGE) * Q16_ONE || target == 0) {
+    reset = true;
+    return 0;
+  }
+  if (reset) {
+    iState = 0;
+    reset = false;
+  }
+  return output(error, PID_MAX);
+}
+
+#endif // PIDTEMP
+
+q16_t PidFixed::bed(const q16_t current, const q16_t target) {
+  derivative(current);
+  return output(target - current, MAX_BED_POWER);
+}
+
+#endif // PID_FIXED_POINT
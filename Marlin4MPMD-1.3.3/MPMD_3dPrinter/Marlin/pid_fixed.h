@@ -0,0 +1,93 @@
+/**
+ * Marlin 3D Printer Firmware
+ * Copyright (C) 2016 MarlinFirmware [https://github.com/MarlinFirmware/Marlin]
+ *
+ * Based on Sprinter and grbl.
+ * Copyright (C) 2011 Camiel Gubbels / Erik van der Zalm
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * pid_fixed.h - the heater PID in Q16.16 fixed point
+ *
+ * get_pid_output() and get_pid_output_bed() run every temperature cycle
+ * (PID_dT, about 15 times a second for each heater), in soft-float: a
+ * dozen multiplies, adds and compares, each a library call on the
+ * Cortex-M0. With PID_FIXED_POINT they hand the temperature and the target
+ * to a PidFixed instead, which does the same sums in Q16.16 (q16.h): the
+ * proportional term, the integral with its clamp and the conditional
+ * un-integration, and the derivative with its K1 low-pass filter.
+ *
+ * The float gains stay the settings (M301, M304, M303 U1 and the EEPROM),
+ * updatePID() takes them over with set(), K2 folded into Kd. The integral,
+ * the derivative and the error a product is taken of are kept below
+ * PID_FIXED_MAX, so no product or sum leaves the Q16.16 range; past it the
+ * float output would be saturated anyway. sim/testpid checks the outputs
+ * against the float version, in the loop with the simulator's heaters.
+ */
+
+#ifndef PID_FIXED_H
+#define PID_FIXED_H
+
+#include "Marlin.h"
+#include "q16.h"
+
+#if ENABLED(PID_FIXED_POINT)
+
+// Largest term (and error, integral) the products take, a third of the
+// Q16.16 range so that p + i - d fits
+#define PID_FIXED_MAX 10000
+
+class PidFixed {
+
+  public:
+
+    q16_t Kp, Ki, Kd;     // the gains, Ki and Kd scaled by PID_dT as PID_PARAM(), Kd by K2 too
+    q16_t errorMax,       // of the error the proportional term is taken of
+          iStateMax,      // PID_INTEGRAL_DRIVE_MAX / Ki
+          dMax;           // of the temperature step the derivative term is taken of
+    q16_t iState,         // sum of the errors, 0 to iStateMax
+          dState,         // last temperature
+          pTerm, iTerm, dTerm;
+    bool reset;           // the sum starts over at the next output in the functional range
+
+    /**
+     * Take over the float gains of updatePID(), and the integral drive max
+     */
+    void set(const float p, const float i, const float d, const float driveMax);
+
+    #if ENABLED(PIDTEMP)
+      /**
+       * get_pid_output(): the power of the hotend, 0 to PID_MAX; bang-bang
+       * outside of PID_FUNCTIONAL_RANGE
+       */
+      q16_t hotend(const q16_t current, const q16_t target);
+    #endif
+
+    /**
+     * get_pid_output_bed(): the power of the bed, 0 to MAX_BED_POWER
+     */
+    q16_t bed(const q16_t current, const q16_t target);
+
+  private:
+
+    void derivative(const q16_t current);
+    q16_t output(const q16_t error, const int16_t max);
+};
+
+#endif // PID_FIXED_POINT
+
+#endif // PID_FIXED_H
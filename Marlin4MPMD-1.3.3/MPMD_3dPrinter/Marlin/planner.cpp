@@ -79,6 +79,7 @@ Planner planner;
 block_t Planner::block_buffer[BLOCK_BUFFER_SIZE];
 volatile uint8_t Planner::block_buffer_head = 0;           // Index of the next block to be pushed
 volatile uint8_t Planner::block_buffer_tail = 0;
+uint8_t Planner::block_buffer_planned = 0;
 
 float Planner::max_feedrate_mm_s[NUM_AXIS], // Max speeds in mm per second
       Planner::axis_steps_per_mm[NUM_AXIS],
@@ -95,6 +96,7 @@ float Planner::min_feedrate_mm_s,
       Planner::max_xy_jerk,          // The largest speed change requiring no acceleration
       Planner::max_z_jerk,
       Planner::max_e_jerk,
+      Planner::junction_deviation_mm, // Corner speeds by junction deviation instead of XY/Z jerk, 0 for jerk
       Planner::min_travel_feedrate_mm_s;
 
 #if ENABLED(AUTO_BED_LEVELING_FEATURE)
@@ -113,7 +115,8 @@ float Planner::min_feedrate_mm_s,
 long Planner::position[NUM_AXIS] = { 0 };
 
 float Planner::previous_speed[NUM_AXIS],
-      Planner::previous_nominal_speed;
+      Planner::previous_nominal_speed,
+      Planner::previous_unit_vec[3];
 
 #if ENABLED(DISABLE_INACTIVE_EXTRUDER)
   uint8_t Planner::g_uc_extruder_last_move[EXTRUDERS] = { 0 };
@@ -133,10 +136,11 @@ float Planner::previous_speed[NUM_AXIS],
 Planner::Planner() { init(); }
 
 void Planner::init() {
-  block_buffer_head = block_buffer_tail = 0;
+  block_buffer_head = block_buffer_tail = block_buffer_planned = 0;
   memset(position, 0, sizeof(position)); // clear position
   LOOP_XYZE(i) previous_speed[i] = 0.0;
   previous_nominal_speed = 0.0;
+  LOOP_XYZ(i) previous_unit_vec[i] = 0.0;
   #if ENABLED(AUTO_BED_LEVELING_FEATURE)
     bed_level_matrix.set_to_identity();
   #endif
@@ -171,6 +175,8 @@ void Planner::calculate_trapezoid_for_block(block_t* block, float entry_factor,
     plateau_steps = 0;
   }
 
+  const uint16_t initial_period = Stepper::step_rate_to_timer(initial_rate);
+
   #if ENABLED(ADVANCE)
     volatile long initial_advance = block->advance * sq(entry_factor);
     volatile long final_advance = block->advance * sq(exit_factor);
@@ -183,6 +189,7 @@ void Planner::calculate_trapezoid_for_block(block_t* block, float entry_factor,
     block->accelerate_until = accelerate_steps;
     block->decelerate_after = accelerate_steps + plateau_steps;
     block->initial_rate = initial_rate;
+    block->initial_period = initial_period;
     block->final_rate = final_rate;
     #if ENABLED(ADVANCE)
       block->initial_advance = initial_advance;
@@ -217,7 +224,7 @@ void Planner::reverse_pass_kernel(block_t* previous, block_t* current, block_t*
       // for max allowable speed if block is decelerating and nominal length is false.
       if (!current->nominal_length_flag && max_entry_speed > next->entry_speed) {
         current->entry_speed = min(max_entry_speed,
-                                   max_allowable_speed(-current->acceleration, next->entry_speed, current->millimeters));
+                                   max_allowable_speed(current->acceleration_distance, next->entry_speed));
       }
       else {
         current->entry_speed = max_entry_speed;
@@ -230,21 +237,17 @@ void Planner::reverse_pass_kernel(block_t* previous, block_t* current, block_t*
 
 /**
  * recalculate() needs to go over the current plan twice.
- * Once in reverse and once forward. This implements the reverse pass.
+ * Once in reverse and once forward. This implements the reverse pass,
+ * back to the planned block.
  */
 void Planner::reverse_pass() {
 
-  if (movesplanned() > 3) {
+  if (BLOCK_MOD(block_buffer_head - block_buffer_planned) > 3) {
 
     block_t* block[3] = { NULL, NULL, NULL };
 
-    // Make a local copy of block_buffer_tail, because the interrupt can alter it
-    CRITICAL_SECTION_START;
-      uint8_t tail = block_buffer_tail;
-    CRITICAL_SECTION_END
-
     uint8_t b = BLOCK_MOD(block_buffer_head - 3);
-    while (b != tail) {
+    while (b != block_buffer_planned) {
       b = prev_block_index(b);
       block[2] = block[1];
       block[1] = block[0];
@@ -266,7 +269,7 @@ void Planner::forward_pass_kernel(block_t* previous, block_t* current, block_t*
   if (!previous->nominal_length_flag) {
     if (previous->entry_speed < current->entry_speed) {
       double entry_speed = min(current->entry_speed,
-                               max_allowable_speed(-previous->acceleration, previous->entry_speed, previous->millimeters));
+                               max_allowable_speed(previous->acceleration_distance, previous->entry_speed));
       // Check for junction speed change
       if (current->entry_speed != entry_speed) {
         current->entry_speed = entry_speed;
@@ -278,18 +281,30 @@ void Planner::forward_pass_kernel(block_t* previous, block_t* current, block_t*
 
 /**
  * recalculate() needs to go over the current plan twice.
- * Once in reverse and once forward. This implements the forward pass.
+ * Once in reverse and once forward. This implements the forward pass,
+ * from the planned block on, and moves the planned block up.
+ *
+ * A block at its max entry speed can't go faster, and no block added later
+ * makes the ones before it slower: all of the plan up to it is final. So is
+ * a block whose entry speed is as fast as the (final) block before it can
+ * accelerate to, that block didn't have to slow down for it. Both only hold
+ * once the reverse pass has seen the block, it leaves the last few out.
  */
 void Planner::forward_pass() {
-  block_t* block[3] = { NULL, NULL, NULL };
-
-  for (uint8_t b = block_buffer_tail; b != block_buffer_head; b = next_block_index(b)) {
-    block[0] = block[1];
-    block[1] = block[2];
-    block[2] = &block_buffer[b];
-    forward_pass_kernel(block[0], block[1], block[2]);
+  block_t* previous = NULL;
+
+  for (uint8_t b = block_buffer_planned; b != block_buffer_head; b = next_block_index(b)) {
+    block_t* current = &block_buffer[b];
+    if (previous) {
+      const float entry_speed = current->entry_speed;
+      forward_pass_kernel(previous, current, NULL);
+      const uint8_t ahead = BLOCK_MOD(block_buffer_head - b);
+      if ((ahead >= 4 && current->entry_speed == current->max_entry_speed)
+          || (ahead >= 5 && current->entry_speed < entry_speed && BLOCK_MOD(b - 1) == block_buffer_planned))
+        block_buffer_planned = b;
+    }
+    previous = current;
   }
-  forward_pass_kernel(block[1], block[2], NULL);
 }
 
 /**
@@ -297,8 +312,8 @@ void Planner::forward_pass() {
  * according to the entry_factor for each junction. Must be called by
  * recalculate() after updating the blocks.
  */
-void Planner::recalculate_trapezoids() {
-  int8_t block_index = block_buffer_tail;
+void Planner::recalculate_trapezoids(const uint8_t first) {
+  int8_t block_index = first;
   block_t* current;
   block_t* next = NULL;
 
@@ -349,9 +364,20 @@ void Planner::recalculate_trapezoids() {
  *   3. Recalculate "trapezoids" for all blocks.
  */
 void Planner::recalculate() {
+  // The plan up to the planned block is final, unless the stepper ISR has
+  // moved past it since. Make a local copy of block_buffer_tail, because
+  // the interrupt can alter it.
+  CRITICAL_SECTION_START;
+    uint8_t tail = block_buffer_tail;
+  CRITICAL_SECTION_END
+  if (BLOCK_MOD(block_buffer_planned - tail) >= BLOCK_MOD(block_buffer_head - tail))
+    block_buffer_planned = tail;
+
+  // Trapezoids from the planned block on, its exit speed may change
+  const uint8_t planned = block_buffer_planned;
   reverse_pass();
   forward_pass();
-  recalculate_trapezoids();
+  recalculate_trapezoids(planned);
 }
 
 
@@ -813,8 +839,10 @@ void Planner::check_axes_activity() {
   #endif
   delta_mm[E_AXIS] = 0.01 * (de * steps_to_mm[E_AXIS]) * volumetric_multiplier[extruder] * extruder_multiplier[extruder];
 
-  if (block->steps[X_AXIS] <= (long)dropsegments && block->steps[Y_AXIS] <= (long)dropsegments && block->steps[Z_AXIS] <= (long)dropsegments) {
-    block->millimeters = fabs(delta_mm[E_AXIS]);
+  float millimeters;                                 // The total travel of this block in mm
+  const bool e_only = block->steps[X_AXIS] <= (long)dropsegments && block->steps[Y_AXIS] <= (long)dropsegments && block->steps[Z_AXIS] <= (long)dropsegments;
+  if (e_only) {
+    millimeters = fabs(delta_mm[E_AXIS]);
   }
   else {
 	  arm_sqrt_f32(
@@ -829,9 +857,9 @@ void Planner::check_axes_activity() {
         sq(delta_mm[X_AXIS]) + sq(delta_mm[Y_AXIS]) + sq(delta_mm[Z_AXIS])
       #endif
     )
-	,&(block->millimeters));
+	,&millimeters);
   }
-  float inverse_millimeters = 1.0 / block->millimeters;  // Inverse millimeters to remove multiple divides
+  float inverse_millimeters = 1.0 / millimeters;  // Inverse millimeters to remove multiple divides
 
   // Calculate moves/second for this move. No divide by zero due to previous checks.
   float inverse_mm_s = fr_mm_s * inverse_millimeters;
@@ -859,8 +887,8 @@ void Planner::check_axes_activity() {
     #endif
   #endif
 
-  block->nominal_speed = block->millimeters * inverse_mm_s; // (mm/sec) Always > 0
-  block->nominal_rate = ceil(block->step_event_count * inverse_mm_s); // (step/sec) Always > 0
+  block->nominal_speed = millimeters * inverse_mm_s; // (mm/sec) Always > 0
+  unsigned long nominal_rate = ceil(block->step_event_count * inverse_mm_s); // (step/sec) Always > 0
 
   #if ENABLED(FILAMENT_WIDTH_SENSOR)
     static float filwidth_e_count = 0, filwidth_delay_dist = 0;
@@ -947,71 +975,39 @@ void Planner::check_axes_activity() {
   if (speed_factor < 1.0) {
     LOOP_XYZE(i) current_speed[i] *= speed_factor;
     block->nominal_speed *= speed_factor;
-    block->nominal_rate *= speed_factor;
+    nominal_rate *= speed_factor;
   }
+  // The stepper can't go faster (see Stepper::calc_timer())
+  NOMORE(nominal_rate, MAX_STEP_FREQUENCY);
+  block->nominal_rate = nominal_rate;
+  block->nominal_period = Stepper::step_rate_to_timer(nominal_rate);
 
   // Compute and limit the acceleration rate for the trapezoid generator.
-  float steps_per_mm = block->step_event_count / block->millimeters;
+  float steps_per_mm = block->step_event_count / millimeters;
+  unsigned long acceleration_steps_per_s2;
   if (!block->steps[X_AXIS] && !block->steps[Y_AXIS] && !block->steps[Z_AXIS]) {
-    block->acceleration_steps_per_s2 = ceil(retract_acceleration * steps_per_mm); // convert to: acceleration steps/sec^2
+    acceleration_steps_per_s2 = ceil(retract_acceleration * steps_per_mm); // convert to: acceleration steps/sec^2
   }
   else {
     // Limit acceleration per axis
-    block->acceleration_steps_per_s2 = ceil((block->steps[E_AXIS] ? acceleration : travel_acceleration) * steps_per_mm);
-    if (max_acceleration_steps_per_s2[X_AXIS] < (block->acceleration_steps_per_s2 * block->steps[X_AXIS]) / block->step_event_count)
-      block->acceleration_steps_per_s2 = (max_acceleration_steps_per_s2[X_AXIS] * block->step_event_count) / block->steps[X_AXIS];
-    if (max_acceleration_steps_per_s2[Y_AXIS] < (block->acceleration_steps_per_s2 * block->steps[Y_AXIS]) / block->step_event_count)
-      block->acceleration_steps_per_s2 = (max_acceleration_steps_per_s2[Y_AXIS] * block->step_event_count) / block->steps[Y_AXIS];
-    if (max_acceleration_steps_per_s2[Z_AXIS] < (block->acceleration_steps_per_s2 * block->steps[Z_AXIS]) / block->step_event_count)
-      block->acceleration_steps_per_s2 = (max_acceleration_steps_per_s2[Z_AXIS] * block->step_event_count) / block->steps[Z_AXIS];
-    if (max_acceleration_steps_per_s2[E_AXIS] < (block->acceleration_steps_per_s2 * block->steps[E_AXIS]) / block->step_event_count)
-      block->acceleration_steps_per_s2 = (max_acceleration_steps_per_s2[E_AXIS] * block->step_event_count) / block->steps[E_AXIS];
+    acceleration_steps_per_s2 = ceil((block->steps[E_AXIS] ? acceleration : travel_acceleration) * steps_per_mm);
+    if (max_acceleration_steps_per_s2[X_AXIS] < (acceleration_steps_per_s2 * block->steps[X_AXIS]) / block->step_event_count)
+      acceleration_steps_per_s2 = (max_acceleration_steps_per_s2[X_AXIS] * block->step_event_count) / block->steps[X_AXIS];
+    if (max_acceleration_steps_per_s2[Y_AXIS] < (acceleration_steps_per_s2 * block->steps[Y_AXIS]) / block->step_event_count)
+      acceleration_steps_per_s2 = (max_acceleration_steps_per_s2[Y_AXIS] * block->step_event_count) / block->steps[Y_AXIS];
+    if (max_acceleration_steps_per_s2[Z_AXIS] < (acceleration_steps_per_s2 * block->steps[Z_AXIS]) / block->step_event_count)
+      acceleration_steps_per_s2 = (max_acceleration_steps_per_s2[Z_AXIS] * block->step_event_count) / block->steps[Z_AXIS];
+    if (max_acceleration_steps_per_s2[E_AXIS] < (acceleration_steps_per_s2 * block->steps[E_AXIS]) / block->step_event_count)
+      acceleration_steps_per_s2 = (max_acceleration_steps_per_s2[E_AXIS] * block->step_event_count) / block->steps[E_AXIS];
   }
-  block->acceleration = block->acceleration_steps_per_s2 / steps_per_mm;
-  block->acceleration_rate = (long)(block->acceleration_steps_per_s2 * 16777216.0 / ((F_CPU()) * 0.125));
-
-  #if 0  // Use old jerk for now      --- BDI  : check later
-
-    float junction_deviation = 0.1;
-
-    // Compute path unit vector
-    double unit_vec[3];
-
-    unit_vec[X_AXIS] = delta_mm[X_AXIS] * inverse_millimeters;
-    unit_vec[Y_AXIS] = delta_mm[Y_AXIS] * inverse_millimeters;
-    unit_vec[Z_AXIS] = delta_mm[Z_AXIS] * inverse_millimeters;
-
-    // Compute maximum allowable entry speed at junction by centripetal acceleration approximation.
-    // Let a circle be tangent to both previous and current path line segments, where the junction
-    // deviation is defined as the distance from the junction to the closest edge of the circle,
-    // collinear with the circle center. The circular segment joining the two paths represents the
-    // path of centripetal acceleration. Solve for max velocity based on max acceleration about the
-    // radius of the circle, defined indirectly by junction deviation. This may be also viewed as
-    // path width or max_jerk in the previous grbl version. This approach does not actually deviate
-    // from path, but used as a robust way to compute cornering speeds, as it takes into account the
-    // nonlinearities of both the junction angle and junction velocity.
-    double vmax_junction = MINIMUM_PLANNER_SPEED; // Set default max junction speed
-
-    // Skip first block or when previous_nominal_speed is used as a flag for homing and offset cycles.
-    if ((block_buffer_head != block_buffer_tail) && (previous_nominal_speed > 0.0)) {
-      // Compute cosine of angle between previous and current path. (prev_unit_vec is negative)
-      // NOTE: Max junction velocity is computed without sin() or acos() by trig half angle identity.
-      double cos_theta = - previous_unit_vec[X_AXIS] * unit_vec[X_AXIS]
-                         - previous_unit_vec[Y_AXIS] * unit_vec[Y_AXIS]
-                         - previous_unit_vec[Z_AXIS] * unit_vec[Z_AXIS] ;
-      // Skip and use default max junction speed for 0 degree acute junction.
-      if (cos_theta < 0.95) {
-        vmax_junction = min(previous_nominal_speed, block->nominal_speed);
-        // Skip and avoid divide by zero for straight junctions at 180 degrees. Limit to min() of nominal speeds.
-        if (cos_theta > -0.95) {
-          // Compute maximum junction velocity based on maximum acceleration and junction deviation
-          double sin_theta_d2 = sqrt(0.5 * (1.0 - cos_theta)); // Trig half angle identity. Always positive.
-          vmax_junction = min(vmax_junction,
-                              sqrt(block->acceleration * junction_deviation * sin_theta_d2 / (1.0 - sin_theta_d2)));
-        }
-      }
-    }
-  #endif
+  block->acceleration_steps_per_s2 = acceleration_steps_per_s2;
+  const float block_acceleration = acceleration_steps_per_s2 / steps_per_mm; // acceleration mm/sec^2
+  block->acceleration_distance = 2 * block_acceleration * millimeters;
+  block->acceleration_rate = (long)(acceleration_steps_per_s2 * 16777216.0 / ((F_CPU()) * 0.125));
+
+  // Compute path unit vector, of the carriages on a delta
+  float unit_vec[3];
+  LOOP_XYZ(i) unit_vec[i] = e_only ? 0.0 : delta_mm[i] * inverse_millimeters;
 
   // Start with a safe speed
   float vmax_junction = max_xy_jerk * 0.5,
@@ -1026,26 +1022,55 @@ void Planner::check_axes_activity() {
   float safe_speed = vmax_junction;
 
   if ((moves_queued > 1) && (previous_nominal_speed > 0.0001)) {
-    float dsx = current_speed[X_AXIS] - previous_speed[X_AXIS],
-          dsy = current_speed[Y_AXIS] - previous_speed[Y_AXIS],
-          dsz = fabs(csz - previous_speed[Z_AXIS]),
-          dse = fabs(cse - previous_speed[E_AXIS]);
-    float jerk;
-    ARMHYPOT(dsx,dsy,&jerk);
-
-    //    if ((fabs(previous_speed[X_AXIS]) > 0.0001) || (fabs(previous_speed[Y_AXIS]) > 0.0001)) {
-    vmax_junction = block->nominal_speed;
-    //    }
-    if (jerk > max_xy_jerk) vmax_junction_factor = max_xy_jerk / jerk;
-    if (dsz > max_z_jerk) vmax_junction_factor = min(vmax_junction_factor, max_z_jerk / dsz);
-    if (dse > max_e_jerk) vmax_junction_factor = min(vmax_junction_factor, max_e_jerk / dse);
-
-    vmax_junction = min(previous_nominal_speed, vmax_junction * vmax_junction_factor); // Limit speed to max previous speed
+    float dse = fabs(cse - previous_speed[E_AXIS]);
+    if (dse > max_e_jerk) vmax_junction_factor = max_e_jerk / dse;
+
+    if (junction_deviation_mm > 0 && !e_only && (previous_unit_vec[X_AXIS] || previous_unit_vec[Y_AXIS] || previous_unit_vec[Z_AXIS])) {
+      // Compute maximum allowable entry speed at junction by centripetal acceleration approximation.
+      // Let a circle be tangent to both previous and current path line segments, where the junction
+      // deviation is defined as the distance from the junction to the closest edge of the circle,
+      // collinear with the circle center. The circular segment joining the two paths represents the
+      // path of centripetal acceleration. Solve for max velocity based on max acceleration about the
+      // radius of the circle, defined indirectly by junction deviation. The many short segments of a
+      // delta move or a tessellated curve meet at shallow angles and keep (nearly) their speed,
+      // where each one's small change per axis would count against the jerk limits.
+      // NOTE: Max junction velocity is computed without sin() or acos() by trig half angle identity.
+      float cos_theta = - previous_unit_vec[X_AXIS] * unit_vec[X_AXIS]
+                        - previous_unit_vec[Y_AXIS] * unit_vec[Y_AXIS]
+                        - previous_unit_vec[Z_AXIS] * unit_vec[Z_AXIS];
+      vmax_junction = block->nominal_speed * vmax_junction_factor;
+      // Skip straight junctions (180 degrees), limited to the nominal speeds only.
+      if (cos_theta > -0.999999) {
+        float sin_theta_d2, v;
+        arm_sqrt_f32(0.5 * (1.0 - cos_theta), &sin_theta_d2); // Trig half angle identity. Always positive.
+        // A reversal (0 degrees) comes to 0, the safe speed below
+        arm_sqrt_f32(block_acceleration * junction_deviation_mm * sin_theta_d2 / (1.0 - sin_theta_d2), &v);
+        NOMORE(vmax_junction, v);
+      }
+      // Never slower than the speed to start from a stop
+      NOLESS(vmax_junction, safe_speed);
+      vmax_junction = min(previous_nominal_speed, vmax_junction); // Limit speed to max previous speed
+    }
+    else {
+      float dsx = current_speed[X_AXIS] - previous_speed[X_AXIS],
+            dsy = current_speed[Y_AXIS] - previous_speed[Y_AXIS],
+            dsz = fabs(csz - previous_speed[Z_AXIS]);
+      float jerk;
+      ARMHYPOT(dsx,dsy,&jerk);
+
+      //    if ((fabs(previous_speed[X_AXIS]) > 0.0001) || (fabs(previous_speed[Y_AXIS]) > 0.0001)) {
+      vmax_junction = block->nominal_speed;
+      //    }
+      if (jerk > max_xy_jerk) vmax_junction_factor = min(vmax_junction_factor, max_xy_jerk / jerk);
+      if (dsz > max_z_jerk) vmax_junction_factor = min(vmax_junction_factor, max_z_jerk / dsz);
+
+      vmax_junction = min(previous_nominal_speed, vmax_junction * vmax_junction_factor); // Limit speed to max previous speed
+    }
   }
   block->max_entry_speed = vmax_junction;
 
   // Initialize block entry speed. Compute based on deceleration to user-defined MINIMUM_PLANNER_SPEED.
-  double v_allowable = max_allowable_speed(-block->acceleration, MINIMUM_PLANNER_SPEED, block->millimeters);
+  double v_allowable = max_allowable_speed(block->acceleration_distance, MINIMUM_PLANNER_SPEED);
   block->entry_speed = min(vmax_junction, v_allowable);
 
   // Initialize planner efficiency flags
@@ -1062,6 +1087,7 @@ void Planner::check_axes_activity() {
   // Update previous path unit_vector and nominal speed
   LOOP_XYZE(i) previous_speed[i] = current_speed[i];
   previous_nominal_speed = block->nominal_speed;
+  LOOP_XYZ(i) previous_unit_vec[i] = unit_vec[i];
 
   #if ENABLED(LIN_ADVANCE)
 
@@ -49,63 +49,78 @@ extern Planner planner;
  *
  * The "nominal" values are as-specified by gcode, and
  * may never actually be reached due to acceleration limits.
+ *
+ * The fields are ordered by width, so nothing is padded between them, and
+ * have fixed widths, so the simulator's blocks are laid out as the
+ * printer's. Step rates never pass MAX_STEP_FREQUENCY, 16 bits hold them,
+ * and their Tick timer periods are worked out by the planner. Step counts
+ * keep 32 bits: homing, E only and LCD moves aren't cut into delta segments.
  */
 typedef struct {
 
-  unsigned char active_extruder;            // The extruder to move (if E move)
-
   // Fields used by the bresenham algorithm for tracing the line
-  long steps[NUM_AXIS];                     // Step count along each axis
-  unsigned long step_event_count;           // The number of step events required to complete this block
+  int32_t steps[NUM_AXIS];                  // Step count along each axis
+  uint32_t step_event_count;                // The number of step events required to complete this block
 
   #if ENABLED(MIXING_EXTRUDER)
-    unsigned long mix_event_count[MIXING_STEPPERS]; // Scaled step_event_count for the mixing steppers
+    uint32_t mix_event_count[MIXING_STEPPERS]; // Scaled step_event_count for the mixing steppers
   #endif
 
-  long accelerate_until,                    // The index of the step event on which to stop acceleration
-       decelerate_after,                    // The index of the step event on which to start decelerating
-       acceleration_rate;                   // The acceleration rate used for acceleration calculation
-
-  unsigned char direction_bits;             // The direction bit set for this block (refers to *_DIRECTION_BIT in config.h)
+  int32_t accelerate_until,                 // The index of the step event on which to stop acceleration
+          decelerate_after,                 // The index of the step event on which to start decelerating
+          acceleration_rate;                // The acceleration rate used for acceleration calculation
 
   // Advance extrusion
-  #if ENABLED(LIN_ADVANCE)
-    bool use_advance_lead;
-    int e_speed_multiplier8; // Factorised by 2^8 to avoid float
-  #elif ENABLED(ADVANCE)
-    long advance_rate;
-    volatile long initial_advance;
-    volatile long final_advance;
+  #if ENABLED(ADVANCE)
+    int32_t advance_rate;
+    volatile int32_t initial_advance;
+    volatile int32_t final_advance;
     float advance;
   #endif
 
   // Fields used by the motion planner to manage acceleration
-  float nominal_speed,                               // The nominal speed for this block in mm/sec
-        entry_speed,                                 // Entry speed at previous-current junction in mm/sec
-        max_entry_speed,                             // Maximum allowable junction entry speed in mm/sec
-        millimeters,                                 // The total travel of this block in mm
-        acceleration;                                // acceleration mm/sec^2
-  unsigned char recalculate_flag,                    // Planner flag to recalculate trapezoids on entry junction
-                nominal_length_flag;                 // Planner flag for nominal speed always reached
+  float nominal_speed,                      // The nominal speed for this block in mm/sec
+        entry_speed,                        // Entry speed at previous-current junction in mm/sec
+        max_entry_speed,                    // Maximum allowable junction entry speed in mm/sec
+        acceleration_distance;              // 2 * acceleration * length (mm^2/sec^2), see max_allowable_speed()
+  uint32_t acceleration_steps_per_s2;       // acceleration steps/sec^2
 
   // Settings for the trapezoid generator
-  unsigned long nominal_rate,                        // The nominal step rate for this block in step_events/sec
-                initial_rate,                        // The jerk-adjusted step rate at start of block
-                final_rate,                          // The minimal rate at exit
-                acceleration_steps_per_s2;           // acceleration steps/sec^2
+  uint16_t nominal_rate,                    // The nominal step rate for this block in step_events/sec
+           initial_rate,                    // The jerk-adjusted step rate at start of block
+           final_rate,                      // The minimal rate at exit
+           nominal_period,                  // Tick timer period of nominal_rate, Stepper::step_rate_to_timer()
+           initial_period;                  // Tick timer period of initial_rate
+
+  #if ENABLED(LIN_ADVANCE)
+    int16_t e_speed_multiplier8;            // Factorised by 2^8 to avoid float
+    bool use_advance_lead;
+  #endif
+
+  uint8_t direction_bits,                   // The direction bit set for this block (refers to *_DIRECTION_BIT in config.h)
+          active_extruder;                  // The extruder to move (if E move)
+
+  volatile char busy;
+
+  uint8_t recalculate_flag,                 // Planner flag to recalculate trapezoids on entry junction
+          nominal_length_flag;              // Planner flag for nominal speed always reached
 
   #if FAN_COUNT > 0
-    unsigned long fan_speed[FAN_COUNT];
+    uint8_t fan_speed[FAN_COUNT];
   #endif
 
   #if ENABLED(BARICUDA)
-    unsigned long valve_pressure, e_to_p_pressure;
+    uint8_t valve_pressure, e_to_p_pressure;
   #endif
 
-  volatile char busy;
-
 } block_t;
 
+// The planner buffer is BLOCK_BUFFER_SIZE of these, 88 bytes each before the
+// layout above. Mind the RAM (16K all told) before this grows.
+#if DISABLED(MIXING_EXTRUDER) && DISABLED(LIN_ADVANCE) && DISABLED(ADVANCE) && FAN_COUNT <= 1
+  static_assert(sizeof(block_t) == 68, "block_t isn't 68 bytes, update the planner buffer RAM notes");
+#endif
+
 #define BLOCK_MOD(n) ((n)&(BLOCK_BUFFER_SIZE-1))
 
 class Planner {
@@ -118,6 +133,7 @@ class Planner {
     static block_t block_buffer[BLOCK_BUFFER_SIZE];
     static volatile uint8_t block_buffer_head;           // Index of the next block to be pushed
     static volatile uint8_t block_buffer_tail;
+    static uint8_t block_buffer_planned;                 // Index of the last block whose entry speed is final
 
     static float max_feedrate_mm_s[NUM_AXIS]; // Max speeds in mm per second
     static float axis_steps_per_mm[NUM_AXIS];
@@ -133,6 +149,7 @@ class Planner {
     static float max_xy_jerk;          // The largest speed change requiring no acceleration
     static float max_z_jerk;
     static float max_e_jerk;
+    static float junction_deviation_mm; // Corner speeds by junction deviation instead of XY/Z jerk, 0 for jerk. M205 J
     static float min_travel_feedrate_mm_s;
 
     #if ENABLED(AUTO_BED_LEVELING_FEATURE)
@@ -157,6 +174,11 @@ class Planner {
      */
     static float previous_nominal_speed;
 
+    /**
+     * Unit vector of previous path line segment, all 0 after an E only move
+     */
+    static float previous_unit_vec[3];
+
     #if ENABLED(DISABLE_INACTIVE_EXTRUDER)
       /**
        * Counters to manage disabling inactive extruders
@@ -311,11 +333,11 @@ class Planner {
     /**
      * Calculate the maximum allowable speed at this point, in order
      * to reach 'target_velocity' using 'acceleration' within a given
-     * 'distance'.
+     * 'distance', given 'acceleration_distance' = 2 * acceleration * distance.
      */
-    static float max_allowable_speed(float accel, float target_velocity, float distance) {
+    static float max_allowable_speed(float acceleration_distance, float target_velocity) {
     	float maxspeed;
-    	arm_sqrt_f32((sq(target_velocity) - 2 * accel * distance),&maxspeed);
+    	arm_sqrt_f32((sq(target_velocity) + acceleration_distance),&maxspeed);
     	return maxspeed;
     }
 
@@ -327,7 +349,7 @@ class Planner {
     static void reverse_pass();
     static void forward_pass();
 
-    static void recalculate_trapezoids();
+    static void recalculate_trapezoids(const uint8_t first);
 
     static void recalculate();
 
@@ -0,0 +1,213 @@
+/**
+ * Marlin 3D Printer Firmware
+ * Copyright (C) 2016 MarlinFirmware [https://github.com/MarlinFirmware/Marlin]
+ *
+ * Based on Sprinter and grbl.
+ * Copyright (C) 2011 Camiel Gubbels / Erik van der Zalm
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * print_journal.cpp - where the SD print had got to, for M1000 after a power loss
+ */
+
+#include "print_journal.h"
+#include "diskio.h"
+#include "uzlib.h"
+
+#if ENABLED(POWER_LOSS_JOURNAL)
+
+#if _MAX_SS != _MIN_SS
+  #error "PrintJournal takes the sector size to be fixed"
+#endif
+
+#define JOURNAL_HEADER_MAGIC  0x4A4E5250UL  // "PRNJ"
+#define JOURNAL_RECORD_MAGIC  0x434E5250UL  // "PRNC"
+#define JOURNAL_RECORDS       (PRINT_JOURNAL_SECTORS - 1)
+
+typedef struct {
+  uint32_t magic;
+  uint32_t print;          // numbers the prints, a new file a new one
+  uint32_t size;           // of the file
+  char name[PRINT_JOURNAL_NAME];
+  uint32_t crc;            // CRC-32 of all of it before
+} PrintJournalHeader;
+
+// The CRC-32 of a header or record, the last four bytes being its own
+static uint32_t journal_crc(const void *data, const uint16_t size) {
+  return ~uzlib_crc32(data, size - sizeof(uint32_t), 0xFFFFFFFF);
+}
+#define JOURNAL_SEAL(P)     ((P)->crc = journal_crc(P, sizeof(*(P))))
+#define JOURNAL_SEALED(P,M) ((P)->magic == (M) && (P)->crc == journal_crc(P, sizeof(*(P))))
+
+bool PrintJournal::readSector(const DWORD n, void *data, const uint16_t size) {
+  if (fs->wflag) return false;  // the window holds a change FatFs has yet to write
+  fs->winsect = (DWORD)-1;      // FatFs reads it again for what it needs next
+  if (disk_read(fs->drv, fs->win, sector + n, 1) != RES_OK) return false;
+  memcpy(data, fs->win, size);
+  return true;
+}
+
+bool PrintJournal::writeSector(const DWORD n, const void *data, const uint16_t size) {
+  if (fs->wflag) return false;
+  fs->winsect = (DWORD)-1;
+  memset(fs->win, 0, _MAX_SS);
+  if (size) memcpy(fs->win, data, size);
+  if (disk_write(fs->drv, fs->win, sector + n, 1) != RES_OK) return false;
+  written++;
+  return true;
+}
+
+bool PrintJournal::open(FATFS *fs, FIL *fil) {
+  const FSIZE_t size = (FSIZE_t)PRINT_JOURNAL_SECTORS * _MAX_SS;
+  close();
+  // Made again once if it isn't whole, or is in pieces
+  for (uint8_t tries = 2; tries--;) {
+    const bool made = f_open(fil, PRINT_JOURNAL_FILE, FA_READ | FA_WRITE) != FR_OK;
+    if (made) {
+      if (f_open(fil, PRINT_JOURNAL_FILE, FA_CREATE_NEW | FA_READ | FA_WRITE) != FR_OK) return false;
+      f_lseek(fil, size);  // the clusters are taken, not written
+    }
+    // In one piece if its cluster map is: the size and start of one fragment, and the 0 after
+    DWORD linkMap[4];
+    linkMap[0] = COUNT(linkMap);
+    fil->cltbl = linkMap;
+    const bool whole = f_size(fil) == size && f_lseek(fil, CREATE_LINKMAP) == FR_OK;
+    fil->cltbl = NULL;
+    sector = fs->database + (fil->obj.sclust - 2) * fs->csize;
+    if (f_close(fil) == FR_OK && whole) {
+      this->fs = fs;
+      // what was in the clusters mustn't pass for records
+      if (made) for (DWORD n = 0; n < PRINT_JOURNAL_SECTORS; n++)
+        if (!writeSector(n, NULL, 0)) {
+          this->fs = NULL;
+          return false;
+        }
+      return true;
+    }
+    f_unlink(PRINT_JOURNAL_FILE);
+  }
+  return false;
+}
+
+// The slot of the newest record of the print, 0 if it has none
+uint8_t PrintJournal::newest(const uint32_t print, PrintJournalRecord *record) {
+  PrintJournalRecord r;
+  uint8_t found = 0;
+  for (uint8_t n = 1; n <= JOURNAL_RECORDS; n++) {
+    if (!readSector(n, &r, sizeof(r)) || !JOURNAL_SEALED(&r, JOURNAL_RECORD_MAGIC) || r.print != print) continue;
+    if (!found || (int32_t)(r.seq - record->seq) > 0) {
+      *record = r;
+      found = n;
+    }
+  }
+  return found;
+}
+
+void PrintJournal::start(const char *name, const uint32_t size) {
+  if (!fs) return;
+  print = 0;
+  marked = taken = false;
+  if (strlen(name) >= PRINT_JOURNAL_NAME) return;  // M1000 couldn't open it again
+
+  PrintJournalHeader header;
+  const bool valid = readSector(0, &header, sizeof(header)) && JOURNAL_SEALED(&header, JOURNAL_HEADER_MAGIC);
+  if (!valid || header.size != size || strcmp(header.name, name)) {
+    const uint32_t last = valid ? header.print : 0;
+    memset(&header, 0, sizeof(header));
+    header.magic = JOURNAL_HEADER_MAGIC;
+    header.print = last + 1 ? last + 1 : 1;
+    header.size = size;
+    strcpy(header.name, name);
+    JOURNAL_SEAL(&header);
+    if (!writeSector(0, &header, sizeof(header))) return;
+  }
+
+  // Go on from the newest record of the print, if it has one
+  const uint8_t n = newest(header.print, &pending);
+  seq = n ? pending.seq : 0;
+  slot = n % JOURNAL_RECORDS + 1;
+  print = header.print;
+  lastZ = lastX = lastY = NAN;
+  moved = 0;
+  lastMs = millis() - PRINT_JOURNAL_MS;
+}
+
+void PrintJournal::end() {
+  if (!recording()) return;
+  memset(&pending, 0, sizeof(pending));
+  pending.magic = JOURNAL_RECORD_MAGIC;
+  pending.print = print;
+  pending.seq = seq + 1;
+  pending.flags = PRINT_JOURNAL_DONE;
+  JOURNAL_SEAL(&pending);
+  writeSector(slot, &pending, sizeof(pending));
+  print = 0;
+  marked = taken = false;
+}
+
+void PrintJournal::take(const uint8_t head, const float position[NUM_AXIS], const float feedrate_mm_m,
+                        const int16_t hotend, const int16_t bed, const uint8_t fan, const uint8_t flags) {
+  marked = false;
+  if (!isnan(lastX)) moved += fabs(position[X_AXIS] - lastX) + fabs(position[Y_AXIS] - lastY);
+  lastX = position[X_AXIS];
+  lastY = position[Y_AXIS];
+  if (taken) return;  // the last one is yet to be written
+
+  const millis_t ms = millis();
+  if ((position[Z_AXIS] == lastZ && moved < PRINT_JOURNAL_MM) || PENDING(ms, lastMs + PRINT_JOURNAL_MS)) return;
+  lastZ = position[Z_AXIS];
+  moved = 0;
+  lastMs = ms;
+
+  pending.sdpos = markPos;
+  memcpy(pending.position, position, sizeof(pending.position));
+  pending.feedrate_mm_m = feedrate_mm_m;
+  pending.hotend = hotend;
+  pending.bed = bed;
+  pending.fan = fan;
+  pending.flags = flags;
+  takenHead = head;
+  taken = true;
+}
+
+void PrintJournal::reached(const uint8_t head, const uint8_t tail) {
+  // The block is still ahead of the one moving, or to be planned
+  const uint8_t ahead = (takenHead - tail) & (BLOCK_BUFFER_SIZE - 1),
+                queued = (head - tail) & (BLOCK_BUFFER_SIZE - 1);
+  if (ahead && ahead <= queued) return;
+  taken = false;
+  pending.magic = JOURNAL_RECORD_MAGIC;
+  pending.print = print;
+  pending.seq = seq + 1;
+  pending.reserved = 0;
+  JOURNAL_SEAL(&pending);
+  if (!writeSector(slot, &pending, sizeof(pending))) return;
+  seq++;
+  slot = slot % JOURNAL_RECORDS + 1;
+}
+
+bool PrintJournal::last(PrintJournalRecord *record, char *name) {
+  if (!fs) return false;
+  PrintJournalHeader header;
+  if (!readSector(0, &header, sizeof(header)) || !JOURNAL_SEALED(&header, JOURNAL_HEADER_MAGIC)
+      || !newest(header.print, record) || (record->flags & PRINT_JOURNAL_DONE))
+    return false;
+  strcpy(name, header.name);
+  return true;
+}
+
+#endif // POWER_LOSS_JOURNAL
@@ -0,0 +1,149 @@
+/**
+ * Marlin 3D Printer Firmware
+ * Copyright (C) 2016 MarlinFirmware [https://github.com/MarlinFirmware/Marlin]
+ *
+ * Based on Sprinter and grbl.
+ * Copyright (C) 2011 Camiel Gubbels / Erik van der Zalm
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * print_journal.h - where the SD print had got to, for M1000 after a power loss
+ *
+ * The journal is a file of PRINT_JOURNAL_SECTORS sectors in one piece, made
+ * once, so a record is written straight to its sector and nothing else on
+ * the card changes: no FAT, no directory entry. Sector 0 names the file
+ * printed; the others take the records in turn, one to a sector, the newest
+ * being the one of the print with the highest seq whose CRC-32 checks.
+ *
+ * A record is where the print can be taken up again: the offset in the file
+ * of a command, and the state it was executed in (its move starts there):
+ * the position, the feedrate, the temperatures and the part fan. As the
+ * planner is a few moves ahead of the nozzle, the command is marked as it is
+ * read from the card (mark()), its state taken as it is executed (take()),
+ * and the record written from idle() once the block it made is the oldest in
+ * the planner (update()): the nozzle has got there, and resuming runs that
+ * move again. One is taken on each change of Z and every PRINT_JOURNAL_MM of
+ * X/Y moves, no more often than every PRINT_JOURNAL_MS.
+ *
+ * The sectors are read and written through the FatFs window (FATFS::win),
+ * which a print reads the FAT into at most; the window is marked empty
+ * after, and a record waits while it holds a change FatFs has yet to write.
+ */
+
+#ifndef PRINT_JOURNAL_H
+#define PRINT_JOURNAL_H
+
+#include "Marlin.h"
+#include "ff.h"
+
+#define PRINT_JOURNAL_FILE     "_RESUME.JNL"  // in the root, '_' keeps it off the LCD's listing
+#define PRINT_JOURNAL_SECTORS  64             // the name and 63 records
+#define PRINT_JOURNAL_MM       100            // of X/Y moves, from record to record on a layer
+#define PRINT_JOURNAL_MS       2000           // the least time from record to record
+#define PRINT_JOURNAL_NAME     (MAX_CMD_SIZE - 4)  // of the file, with its nul: "M23 " and the name
+#define PRINT_JOURNAL_CLEARANCE 5             // mm above the print M1000 goes over it at
+
+#define PRINT_JOURNAL_RELATIVE    0x01  // G91
+#define PRINT_JOURNAL_RELATIVE_E  0x02  // M83
+#define PRINT_JOURNAL_DONE        0x80  // the print ended, there is nothing to resume
+
+typedef struct {
+  uint32_t magic;
+  uint32_t print;          // the header's
+  uint32_t seq;            // of the records, the newest has the highest
+  uint32_t sdpos;          // in the file, of the command
+  float position[NUM_AXIS];
+  float feedrate_mm_m;
+  int16_t hotend, bed;     // target temperatures
+  uint8_t fan, flags;
+  uint16_t reserved;
+  uint32_t crc;            // CRC-32 of all of it before
+} PrintJournalRecord;
+
+class PrintJournal {
+
+  public:
+
+    /**
+     * Find the journal on the card, or make it; with fil, which mustn't
+     * be in use. False if there is none, and then nothing is recorded.
+     */
+    bool open(FATFS *fs, FIL *fil);
+
+    /**
+     * A print of the file named starts, or starts again (M1000). The
+     * journal keeps its records if they are of the same file.
+     */
+    void start(const char *name, const uint32_t size);
+
+    // The print ended, or was stopped
+    void end();
+
+    // Stop recording without a word to the card, it is going away
+    void close() { fs = NULL; print = 0; marked = taken = false; }
+
+    bool opened() { return fs != NULL; }
+    bool recording() { return fs && print; }
+
+    // The SD command going in the queue at index starts at sdpos in the file
+    FORCE_INLINE void mark(const uint32_t sdpos, const uint16_t index) {
+      if (!recording() || marked) return;
+      markPos = sdpos;
+      markIndex = index;
+      marked = true;
+    }
+    FORCE_INLINE bool isMarked(const uint16_t index) { return marked && markIndex == index; }
+    void unmark() { marked = false; }
+
+    // The marked command is executed next; its first block will be at head
+    void take(const uint8_t head, const float position[NUM_AXIS], const float feedrate_mm_m,
+              const int16_t hotend, const int16_t bed, const uint8_t fan, const uint8_t flags);
+
+    // From idle(): write the record taken, once the planner has got to it
+    FORCE_INLINE void update(const uint8_t head, const uint8_t tail) { if (taken) reached(head, tail); }
+
+    /**
+     * The newest record, and the name of the file it is of (PRINT_JOURNAL_NAME
+     * long); false if there is none, or the print ended
+     */
+    bool last(PrintJournalRecord *record, char *name);
+
+    uint32_t written;      // sectors, for the tests
+
+  private:
+
+    FATFS *fs;             // the card's, NULL without a journal
+    DWORD sector;          // of the journal, its first
+    uint32_t print,        // of the header, 0 when not recording
+             seq;          // of the last record
+    uint8_t slot;          // the next record goes in, 1 to PRINT_JOURNAL_SECTORS - 1
+    bool marked, taken;
+    uint16_t markIndex;    // of the marked command in the queue
+    uint32_t markPos;
+    uint8_t takenHead;     // block the taken record's command makes first
+    float lastZ, moved;    // of the last record taken, and the X/Y moves since
+    float lastX, lastY;    // the position of the last command taken
+    millis_t lastMs;       // the last record was taken
+    PrintJournalRecord pending;
+
+    void reached(const uint8_t head, const uint8_t tail);
+    uint8_t newest(const uint32_t print, PrintJournalRecord *record);
+    bool readSector(const DWORD n, void *data, const uint16_t size);
+    bool writeSector(const DWORD n, const void *data, const uint16_t size);
+};
+
+#endif // PRINT_JOURNAL_H
@@ -0,0 +1,81 @@
+/**
+ * Marlin 3D Printer Firmware
+ * Copyright (C) 2016 MarlinFirmware [https://github.com/MarlinFirmware/Marlin]
+ *
+ * Based on Sprinter and grbl.
+ * Copyright (C) 2011 Camiel Gubbels / Erik van der Zalm
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * q16.h - Q16.16 fixed point: signed, 16 fraction bits
+ *
+ * The Cortex-M0 has no FPU, and each float multiply or add is a library
+ * call. These are what the fixed point code (delta_fixed.h, pid_fixed.h)
+ * shares: the conversions, done on the IEEE 754 bits, and the product, in
+ * 32 bit multiplies.
+ */
+
+#ifndef Q16_H
+#define Q16_H
+
+#include "Marlin.h"
+
+typedef int32_t q16_t;
+
+#define Q16_ONE  (1L << 16)
+#define Q16_NAN  INT32_MIN  // float_to_q16() of a NaN, an infinity or anything past +-32768
+
+/**
+ * Float to Q16.16, rounded, straight from the IEEE 754 bits (no soft-float
+ * multiply by 65536)
+ */
+FORCE_INLINE q16_t float_to_q16(const float f) {
+  union { float f; uint32_t u; } v = { f };
+  const int16_t e = (int16_t)((v.u >> 23) & 0xFF) - (127 + 23 - 16);
+  if (e > 7) return Q16_NAN;          // |f| >= 32768, infinity or NaN
+  if (e < -24) return 0;              // below half an lsb, or zero
+  uint32_t m = (v.u & 0x7FFFFF) | 0x800000;
+  m = e >= 0 ? m << e : (m + (1UL << (-e - 1))) >> -e;
+  return (v.u & 0x80000000) ? -(q16_t)m : (q16_t)m;
+}
+
+/**
+ * Q16.16 to float: the integer conversion, then 16 off the exponent.
+ * Q16_NAN comes back as NAN.
+ */
+FORCE_INLINE float q16_to_float(const q16_t q) {
+  if (!q) return 0.0;
+  if (q == Q16_NAN) return NAN;
+  union { float f; uint32_t u; } v;
+  v.f = (float)q;
+  v.u -= 16UL << 23;
+  return v.f;
+}
+
+/**
+ * Q16.16 product, rounded. |a * b| must stay below 32768.
+ */
+FORCE_INLINE q16_t q16_mul(const q16_t a, const q16_t b) {
+  // 16x16 bit partial products, every one fits a 32 bit multiply
+  const uint32_t ua = a < 0 ? -a : a, ub = b < 0 ? -b : b,
+                 ah = ua >> 16, al = ua & 0xFFFF,
+                 bh = ub >> 16, bl = ub & 0xFFFF,
+                 r = ((ah * bh) << 16) + ah * bl + al * bh + ((al * bl + 0x8000) >> 16);
+  return (a ^ b) < 0 ? -(q16_t)r : (q16_t)r;
+}
+
+#endif // Q16_H
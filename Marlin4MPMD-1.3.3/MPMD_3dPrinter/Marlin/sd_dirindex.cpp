@@ -0,0 +1,136 @@
+/**
+ * Marlin 3D Printer Firmware
+ * Copyright (C) 2016 MarlinFirmware [https://github.com/MarlinFirmware/Marlin]
+ *
+ * Based on Sprinter and grbl.
+ * Copyright (C) 2011 Camiel Gubbels / Erik van der Zalm
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * sd_dirindex.cpp - where the files of the working directory are in it
+ */
+
+#include "Marlin.h"
+#include "sd_dirindex.h"
+#include <ctype.h>
+#include <string.h>
+#include <strings.h>
+
+#if ENABLED(SD_DIR_INDEX)
+
+#if _MAX_SS != _MIN_SS
+  #error "SdDirIndex takes the sector size to be fixed"
+#endif
+
+#define DIR_ENTRY_SIZE  32  // bytes of a directory entry, FatFs' SZDIRE
+
+static uint8_t name_hash(const char *name) {
+  uint8_t h = 0;
+  while (*name) h = h * 31 + tolower((uint8_t)*name++);
+  return h;
+}
+
+bool SdDirIndex::listed(const FILINFO *entry) {
+  const uint8_t fn0 = entry->fname[0];
+  if (fn0 == 0x00 || fn0 == 0xE5 || fn0 == '.' || fn0 == '_') return false;
+  return (entry->fattrib & AM_DIR) || strchr(entry->fname, '.');
+}
+
+// The next file listed from where the directory object is
+bool SdDirIndex::next(DIR *dir, FILINFO *entry) {
+  do {
+    if (f_readdir(dir, entry) != FR_OK || !entry->fname[0]) return false;
+  } while (!listed(entry));
+  return true;
+}
+
+// Put the directory object on the entry, as dir_sdi() does, with the cluster from the index
+void SdDirIndex::seek(DIR *dir, const uint16_t slot) {
+  const FATFS *fs = dir->obj.fs;
+  const DWORD ofs = (DWORD)slot * DIR_ENTRY_SIZE,
+              clusterSize = (DWORD)fs->csize * _MAX_SS;
+  dir->dptr = ofs;
+  if (clusters[0]) {
+    dir->clust = clusters[ofs / clusterSize];
+    dir->sect = fs->database + (dir->clust - 2) * fs->csize + ofs % clusterSize / _MAX_SS;
+  }
+  else {
+    dir->clust = 0;
+    dir->sect = fs->dirbase + ofs / _MAX_SS;
+  }
+  dir->dir = dir->obj.fs->win + ofs % _MAX_SS;
+}
+
+bool SdDirIndex::build(DIR *dir) {
+  FILINFO entry;
+  valid = false;
+  files = indexed = cursor = 0;
+  memset(dirs, 0, sizeof(dirs));
+  memset(clusters, 0, sizeof(clusters));
+  if (f_readdir(dir, NULL) != FR_OK) return false;  // rewind
+
+  const DWORD clusterSize = (DWORD)dir->obj.fs->csize * _MAX_SS;
+  for (;;) {
+    // where the directory object is before the read, the entry is there or a little after
+    const DWORD ofs = dir->dptr, clust = dir->clust, n = ofs / clusterSize;
+    if (clust && n < SD_DIR_INDEX_CLUSTERS) clusters[n] = clust;
+    if (f_readdir(dir, &entry) != FR_OK) return false;
+    if (!entry.fname[0]) break;
+    if (!listed(&entry)) continue;
+    if (indexed == files && indexed < SD_DIR_INDEX_SIZE && (!clust || n < SD_DIR_INDEX_CLUSTERS)) {
+      entries[indexed].slot = ofs / DIR_ENTRY_SIZE;
+      entries[indexed].nameHash = name_hash(entry.fname);
+      entries[indexed].altHash = name_hash(entry.altname[0] ? entry.altname : entry.fname);
+      if (entry.fattrib & AM_DIR) dirs[indexed >> 3] |= 1 << (indexed & 7);
+      indexed++;
+    }
+    files++;
+  }
+  cursor = files;
+  valid = true;
+  return true;
+}
+
+bool SdDirIndex::read(DIR *dir, const uint16_t nr, FILINFO *entry) {
+  if (nr >= files) return false;
+  // an indexed file, or one past them from the last indexed unless the last read is nearer
+  if (nr < indexed || cursor > nr || cursor < indexed) {
+    const uint16_t from = nr < indexed ? nr : indexed - 1;
+    seek(dir, entries[from].slot);
+    cursor = from;
+  }
+  do {
+    if (!next(dir, entry)) {
+      cursor = 0;
+      return false;
+    }
+  } while (cursor++ < nr);
+  return true;
+}
+
+int16_t SdDirIndex::find(DIR *dir, const char * const name, FILINFO *entry) {
+  const uint8_t h = name_hash(name);
+  for (uint16_t nr = 0; nr < files; nr++) {
+    if (nr < indexed && entries[nr].nameHash != h && entries[nr].altHash != h) continue;
+    if (!read(dir, nr, entry)) break;
+    if (!strcasecmp(name, entry->fname) || (entry->altname[0] && !strcasecmp(name, entry->altname)))
+      return nr;
+  }
+  return -1;
+}
+
+#endif // SD_DIR_INDEX
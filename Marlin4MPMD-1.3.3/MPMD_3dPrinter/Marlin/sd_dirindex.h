@@ -0,0 +1,104 @@
+/**
+ * Marlin 3D Printer Firmware
+ * Copyright (C) 2016 MarlinFirmware [https://github.com/MarlinFirmware/Marlin]
+ *
+ * Based on Sprinter and grbl.
+ * Copyright (C) 2011 Camiel Gubbels / Erik van der Zalm
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * sd_dirindex.h - where the files of the working directory are in it
+ *
+ * CardReader::getfilename(nr) used to rewind the directory and read it up
+ * to the nr'th file on every call, and getnrfilenames() to read all of it,
+ * so the LCD listing a directory of N files read it N times over.
+ *
+ * build() reads the directory once and keeps, for each file it lists (the
+ * ones lsDive() lists: no deleted, hidden '_' or '.' entries, and no file
+ * without an extension), the offset of its first directory entry, a hash
+ * of its long and of its short name and whether it is a directory; and the
+ * clusters the directory is in. read() then puts the directory object on
+ * that entry as FatFs' dir_sdi() would, without following the FAT, and
+ * reads one: a sector or two. find() reads only the entries whose hash
+ * matches the name.
+ *
+ * Files past SD_DIR_INDEX_SIZE, or in a cluster of the directory past
+ * SD_DIR_INDEX_CLUSTERS, are counted but not indexed: they are read on from
+ * the last indexed one, or from where the last read() left off when the
+ * listing goes through them in order. CardReader throws the index away when
+ * the directory changes: chdir(), a file written or removed, a new mount.
+ */
+
+#ifndef SD_DIRINDEX_H
+#define SD_DIRINDEX_H
+
+#include <stdint.h>
+#include "ff.h"
+
+#define SD_DIR_INDEX_SIZE       128  // files with their place kept, 4 bytes each
+#define SD_DIR_INDEX_CLUSTERS   8    // of the directory
+
+class SdDirIndex {
+
+  public:
+
+    bool valid;           // built for the directory, and it hasn't changed since
+    uint16_t files,       // listed
+             indexed;     // of them, with their place kept
+
+    void invalidate() { valid = false; }
+
+    /**
+     * Read the directory through and index it; false if it couldn't be
+     * read, and then it isn't valid
+     */
+    bool build(DIR *dir);
+
+    /**
+     * The nr'th file listed, into entry; false if there are fewer, or the
+     * directory couldn't be read
+     */
+    bool read(DIR *dir, const uint16_t nr, FILINFO *entry);
+
+    /**
+     * The file with the long or the short name given, in any case, into
+     * entry; its number, or -1 if there is none
+     */
+    int16_t find(DIR *dir, const char * const name, FILINFO *entry);
+
+    // Whether it is a directory, for one indexed
+    bool isDir(const uint16_t nr) { return (dirs[nr >> 3] >> (nr & 7)) & 1; }
+
+    // Whether lsDive() lists the entry
+    static bool listed(const FILINFO *entry);
+
+  private:
+
+    struct {
+      uint16_t slot;      // of the first directory entry (32 bytes) of the file, or of a free one before it
+      uint8_t nameHash,   // of the long name
+              altHash;    // of the short name, or the long one again if it has none
+    } entries[SD_DIR_INDEX_SIZE];
+    uint8_t dirs[(SD_DIR_INDEX_SIZE + 7) / 8];
+    DWORD clusters[SD_DIR_INDEX_CLUSTERS];    // of the directory, in order; 0 for the root of FAT12/16
+    uint16_t cursor;      // the file the directory object reads next
+
+    void seek(DIR *dir, const uint16_t slot);
+    bool next(DIR *dir, FILINFO *entry);
+};
+
+#endif // SD_DIRINDEX_H
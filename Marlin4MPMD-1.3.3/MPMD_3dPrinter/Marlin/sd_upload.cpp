@@ -0,0 +1,126 @@
+/**
+ * Marlin 3D Printer Firmware
+ * Copyright (C) 2016 MarlinFirmware [https://github.com/MarlinFirmware/Marlin]
+ *
+ * Based on Sprinter and grbl.
+ * Copyright (C) 2011 Camiel Gubbels / Erik van der Zalm
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * sd_upload.cpp - framed binary upload to the SD card (M34 F)
+ */
+
+#include "sd_upload.h"
+#include "language.h"
+#include "uzlib.h"
+
+// Write the frame waiting for it
+bool SdUpload::flush(const SdUploadIO &io) {
+  const uint16_t n = pendingLen;
+  pendingLen = 0;
+  written += n;
+  return io.write(buffer[rx ^ 1], n);
+}
+
+// Ask for the frame wanted next, and drop the ones after it until it comes
+void SdUpload::resend(const SdUploadIO &io) {
+  io.reply(PSTR(MSG_RESEND), expect);
+  resends++;
+  resending = true;
+}
+
+int32_t SdUpload::receive(const SdUploadIO &io, uint8_t (*frame)[UPLOAD_FRAME_SIZE]) {
+  buffer = frame;
+  frames = resends = written = 0;
+  pendingLen = got = 0;
+  rx = expect = 0;
+  resending = false;
+  state = IN_SYNC1;
+  millis_t last = io.now();
+
+  for (;;) {
+    // where the next bytes go, and how many of them make up the part
+    uint8_t *dst;
+    uint16_t part;
+    switch (state) {
+      case IN_SYNC1:
+      case IN_SYNC2:  dst = head; part = 1; got = 0; break;
+      case IN_HEADER: dst = head; part = sizeof(head); break;
+      case IN_DATA:   dst = buffer[rx]; part = len; break;
+      default:        dst = crc; part = sizeof(crc); break;
+    }
+
+    const uint32_t n = io.read(dst + got, part - got);
+    if (!n) {
+      // the ring has run dry: write the waiting frame while it fills again
+      if (pendingLen) {
+        if (!flush(io)) return -1;
+        continue;
+      }
+      io.idle();
+      if (ELAPSED(io.now(), last + UPLOAD_TIMEOUT)) return -1;
+      continue;
+    }
+    last = io.now();
+    got += n;
+    if (got < part) continue;
+
+    got = 0;
+    switch (state) {
+      case IN_SYNC1:
+        if (head[0] == UPLOAD_SYNC1) state = IN_SYNC2;
+        break;
+
+      case IN_SYNC2:
+        state = head[0] == UPLOAD_SYNC2 ? IN_HEADER : head[0] == UPLOAD_SYNC1 ? IN_SYNC2 : IN_SYNC1;
+        break;
+
+      case IN_HEADER:
+        len = head[1] | (head[2] << 8);
+        state = IN_SYNC1;
+        if (len > UPLOAD_FRAME_SIZE) break;     // not a header after all, look for the next
+        if (head[0] == expect)
+          state = len ? IN_DATA : IN_CRC;
+        else if ((int8_t)(head[0] - expect) > 0 && !resending)
+          resend(io);                           // one or more went missing
+        break;                                  // a frame written already, sent again, is dropped
+
+      case IN_DATA:
+        state = IN_CRC;
+        break;
+
+      case IN_CRC: {
+        state = IN_SYNC1;
+        const uint32_t c = ~uzlib_crc32(buffer[rx], len, uzlib_crc32(head, sizeof(head), 0xFFFFFFFF));
+        if (c != (crc[0] | (crc[1] << 8) | ((uint32_t)crc[2] << 16) | ((uint32_t)crc[3] << 24))) {
+          resend(io);
+          break;
+        }
+        // tell the host at once, so the next frames come in while this one is written
+        io.reply(PSTR(UPLOAD_MSG_ACK), expect);
+        expect++;
+        resending = false;
+        frames++;
+        if (pendingLen && !flush(io)) return -1;
+        if (!len) return written;               // the last frame
+        pendingLen = len;
+        rx ^= 1;
+        break;
+      }
+    }
+  }
+}
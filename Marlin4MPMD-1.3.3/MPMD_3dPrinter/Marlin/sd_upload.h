@@ -0,0 +1,114 @@
+/**
+ * Marlin 3D Printer Firmware
+ * Copyright (C) 2016 MarlinFirmware [https://github.com/MarlinFirmware/Marlin]
+ *
+ * Based on Sprinter and grbl.
+ * Copyright (C) 2011 Camiel Gubbels / Erik van der Zalm
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * sd_upload.h - framed binary upload to the SD card (M34 F)
+ *
+ * Plain M34 takes the raw bytes of the file into one 512 byte buffer,
+ * writes it when it is full, and knows the file has ended when the host
+ * has been quiet for a second and then sends "M29\r\n". Nothing checks the
+ * bytes, and the host has no way to know how far the printer has got.
+ *
+ * With F the host sends the file in frames instead:
+ *
+ *   0xA5 0x5A  seq  len (2 bytes)  data (len bytes)  CRC-32 (4 bytes)
+ *
+ * seq counts the frames, 0 to 255 and over again; len is 1 to
+ * UPLOAD_FRAME_SIZE, 0 in the last frame, which ends the file; the CRC-32
+ * (zlib's, uzlib_crc32()) is of seq, len and the data. Numbers are little
+ * endian. The printer answers "ok <seq>" for every frame in order whose
+ * CRC checks, before it writes the frame, so the host may have up to
+ * UPLOAD_WINDOW frames out that are not answered yet and keeps the USB
+ * busy while the card is written. A frame that fails its CRC, or one that
+ * comes past a frame that went missing, gets "Resend: <seq>" with the
+ * frame that is wanted next, and the frames after it are dropped until it
+ * arrives (go back N); the host starts over from there, and does the same
+ * if no "ok" has come for a while.
+ *
+ * Two frame buffers take turns: the data of a frame is read from the
+ * receive ring straight into one while the other waits for its write, and
+ * the write is put off until the ring has run dry or the next frame is
+ * complete. The ring is as empty as it gets when f_write() starts, so USB
+ * reception (into the ring, from the interrupt) carries on for the longest
+ * through the write.
+ *
+ * receive() talks to the host and the file through an SdUploadIO, MYSERIAL
+ * and CardReader::write_buff() in M34, a mock USB CDC and FatFs on a RAM
+ * card in sim/testupload, which also sends it corrupted frames. The frame
+ * buffers are the caller's: in M34 the SD read ring, which no print needs
+ * while a file is written, rather than 1 KB more of the stack.
+ */
+
+#ifndef SD_UPLOAD_H
+#define SD_UPLOAD_H
+
+#include "Marlin.h"
+
+#define UPLOAD_SYNC1        0xA5
+#define UPLOAD_SYNC2        0x5A
+#define UPLOAD_FRAME_SIZE   512    // most data in a frame, a sector
+#define UPLOAD_WINDOW       8      // frames the host may send ahead of the "ok"s
+#define UPLOAD_TIMEOUT      10000  // ms without a byte from the host to give up after
+#define UPLOAD_MSG_ACK      "ok "
+
+typedef struct {
+  uint32_t (*read)(uint8_t *buff, uint32_t maxlen);     // received bytes, at most maxlen, 0 if none
+  void (*reply)(const char *msg, const uint8_t seq);    // a line to the host: msg and the frame number
+  bool (*write)(const uint8_t *buff, const uint16_t len); // to the file, false if it failed
+  void (*idle)(void);                                   // between reads, the LCD
+  millis_t (*now)(void);
+} SdUploadIO;
+
+class SdUpload {
+
+  public:
+
+    uint32_t frames,     // taken in order
+             resends,    // "Resend:" sent
+             written;    // bytes handed to io.write()
+
+    /**
+     * Receive the frames of a file until the last and write them, with
+     * frame[0] and frame[1] for the two frame buffers; the bytes written,
+     * or -1 if a write failed or the host went quiet
+     */
+    int32_t receive(const SdUploadIO &io, uint8_t (*frame)[UPLOAD_FRAME_SIZE]);
+
+  private:
+
+    enum State { IN_SYNC1, IN_SYNC2, IN_HEADER, IN_DATA, IN_CRC };
+
+    uint8_t (*buffer)[UPLOAD_FRAME_SIZE];  // the two the frames take turns in
+    uint16_t pendingLen;   // of the frame waiting in buffer[rx ^ 1] for its write, 0 if none
+    uint8_t rx,            // buffer the frame being received goes into
+            expect;        // seq of the next frame to write
+    bool resending;        // "Resend: expect" is out, the frames before it arrives are dropped
+    uint8_t head[3];       // seq and len of the frame being received
+    uint8_t crc[4];
+    uint16_t len, got;     // of the frame, and of its header, data or CRC so far
+    State state;
+
+    bool flush(const SdUploadIO &io);
+    void resend(const SdUploadIO &io);
+};
+
+#endif // SD_UPLOAD_H
@@ -0,0 +1,88 @@
+/**
+ * speed_lookuptable.h - step rate to Tick timer period, see Stepper::calc_timer()
+ *
+ * Generated by create_speed_lookuptable.py -f 48 -d 32, do not edit.
+ */
+
+#ifndef SPEED_LOOKUPTABLE_H
+#define SPEED_LOOKUPTABLE_H
+
+#include "Marlin.h"
+
+#if F_CPU() != 48000000 || TICK_TIMER_PRESCALER != 32
+  #error "speed_lookuptable.h does not match the Tick timer, regenerate it with create_speed_lookuptable.py"
+#endif
+
+#define SPEED_LOOKUPTABLE_MIN_RATE 23
+
+const uint16_t speed_lookuptable_fast[256][2] PROGMEM = {
+  { 65216, 59841 }, { 5375, 2573 }, { 2802, 907 }, { 1895, 464 }, { 1431, 281 }, { 1150, 189 }, { 961, 136 }, { 825, 102 },
+  { 723, 80 }, { 643, 64 }, { 579, 52 }, { 527, 44 }, { 483, 37 }, { 446, 32 }, { 414, 27 }, { 387, 24 },
+  { 363, 22 }, { 341, 19 }, { 322, 17 }, { 305, 15 }, { 290, 14 }, { 276, 12 }, { 264, 12 }, { 252, 10 },
+  { 242, 10 }, { 232, 9 }, { 223, 8 }, { 215, 8 }, { 207, 7 }, { 200, 7 }, { 193, 6 }, { 187, 6 },
+  { 181, 5 }, { 176, 6 }, { 170, 5 }, { 165, 4 }, { 161, 5 }, { 156, 4 }, { 152, 4 }, { 148, 3 },
+  { 145, 4 }, { 141, 3 }, { 138, 4 }, { 134, 3 }, { 131, 3 }, { 128, 2 }, { 126, 3 }, { 123, 3 },
+  { 120, 2 }, { 118, 3 }, { 115, 2 }, { 113, 2 }, { 111, 2 }, { 109, 2 }, { 107, 2 }, { 105, 2 },
+  { 103, 2 }, { 101, 2 }, { 99, 1 }, { 98, 2 }, { 96, 2 }, { 94, 1 }, { 93, 2 }, { 91, 1 },
+  { 90, 1 }, { 89, 2 }, { 87, 1 }, { 86, 1 }, { 85, 2 }, { 83, 1 }, { 82, 1 }, { 81, 1 },
+  { 80, 1 }, { 79, 1 }, { 78, 1 }, { 77, 1 }, { 76, 1 }, { 75, 1 }, { 74, 1 }, { 73, 1 },
+  { 72, 1 }, { 71, 1 }, { 70, 1 }, { 69, 1 }, { 68, 1 }, { 67, 0 }, { 67, 1 }, { 66, 1 },
+  { 65, 1 }, { 64, 0 }, { 64, 1 }, { 63, 1 }, { 62, 1 }, { 61, 0 }, { 61, 1 }, { 60, 1 },
+  { 59, 0 }, { 59, 1 }, { 58, 0 }, { 58, 1 }, { 57, 1 }, { 56, 0 }, { 56, 1 }, { 55, 0 },
+  { 55, 1 }, { 54, 0 }, { 54, 1 }, { 53, 0 }, { 53, 1 }, { 52, 0 }, { 52, 1 }, { 51, 0 },
+  { 51, 1 }, { 50, 0 }, { 50, 1 }, { 49, 0 }, { 49, 0 }, { 49, 1 }, { 48, 0 }, { 48, 1 },
+  { 47, 0 }, { 47, 1 }, { 46, 0 }, { 46, 0 }, { 46, 1 }, { 45, 0 }, { 45, 0 }, { 45, 1 },
+  { 44, 0 }, { 44, 0 }, { 44, 1 }, { 43, 0 }, { 43, 0 }, { 43, 1 }, { 42, 0 }, { 42, 0 },
+  { 42, 1 }, { 41, 0 }, { 41, 0 }, { 41, 1 }, { 40, 0 }, { 40, 0 }, { 40, 1 }, { 39, 0 },
+  { 39, 0 }, { 39, 0 }, { 39, 1 }, { 38, 0 }, { 38, 0 }, { 38, 0 }, { 38, 1 }, { 37, 0 },
+  { 37, 0 }, { 37, 0 }, { 37, 1 }, { 36, 0 }, { 36, 0 }, { 36, 0 }, { 36, 1 }, { 35, 0 },
+  { 35, 0 }, { 35, 0 }, { 35, 1 }, { 34, 0 }, { 34, 0 }, { 34, 0 }, { 34, 0 }, { 34, 1 },
+  { 33, 0 }, { 33, 0 }, { 33, 0 }, { 33, 0 }, { 33, 1 }, { 32, 0 }, { 32, 0 }, { 32, 0 },
+  { 32, 0 }, { 32, 1 }, { 31, 0 }, { 31, 0 }, { 31, 0 }, { 31, 0 }, { 31, 0 }, { 31, 1 },
+  { 30, 0 }, { 30, 0 }, { 30, 0 }, { 30, 0 }, { 30, 1 }, { 29, 0 }, { 29, 0 }, { 29, 0 },
+  { 29, 0 }, { 29, 0 }, { 29, 0 }, { 29, 1 }, { 28, 0 }, { 28, 0 }, { 28, 0 }, { 28, 0 },
+  { 28, 0 }, { 28, 1 }, { 27, 0 }, { 27, 0 }, { 27, 0 }, { 27, 0 }, { 27, 0 }, { 27, 0 },
+  { 27, 0 }, { 27, 1 }, { 26, 0 }, { 26, 0 }, { 26, 0 }, { 26, 0 }, { 26, 0 }, { 26, 0 },
+  { 26, 1 }, { 25, 0 }, { 25, 0 }, { 25, 0 }, { 25, 0 }, { 25, 0 }, { 25, 0 }, { 25, 0 },
+  { 25, 0 }, { 25, 1 }, { 24, 0 }, { 24, 0 }, { 24, 0 }, { 24, 0 }, { 24, 0 }, { 24, 0 },
+  { 24, 0 }, { 24, 0 }, { 24, 1 }, { 23, 0 }, { 23, 0 }, { 23, 0 }, { 23, 0 }, { 23, 0 },
+  { 23, 0 }, { 23, 0 }, { 23, 0 }, { 23, 0 }, { 23, 1 }, { 22, 0 }, { 22, 0 }, { 22, 0 },
+  { 22, 0 }, { 22, 0 }, { 22, 0 }, { 22, 0 }, { 22, 0 }, { 22, 0 }, { 22, 1 }, { 21, 0 },
+};
+
+const uint16_t speed_lookuptable_slow[256][2] PROGMEM = {
+  { 65216, 16830 }, { 48386, 9926 }, { 38460, 6547 }, { 31913, 4642 }, { 27271, 3463 }, { 23808, 2683 }, { 21125, 2139 }, { 18986, 1746 },
+  { 17240, 1452 }, { 15788, 1226 }, { 14562, 1050 }, { 13512, 908 }, { 12604, 794 }, { 11810, 700 }, { 11110, 622 }, { 10488, 556 },
+  { 9932, 500 }, { 9432, 451 }, { 8981, 411 }, { 8570, 375 }, { 8195, 343 }, { 7852, 316 }, { 7536, 291 }, { 7245, 270 },
+  { 6975, 250 }, { 6725, 233 }, { 6492, 217 }, { 6275, 204 }, { 6071, 190 }, { 5881, 179 }, { 5702, 168 }, { 5534, 159 },
+  { 5375, 150 }, { 5225, 142 }, { 5083, 134 }, { 4949, 127 }, { 4822, 121 }, { 4701, 115 }, { 4586, 110 }, { 4476, 104 },
+  { 4372, 100 }, { 4272, 95 }, { 4177, 91 }, { 4086, 87 }, { 3999, 84 }, { 3915, 80 }, { 3835, 77 }, { 3758, 74 },
+  { 3684, 71 }, { 3613, 68 }, { 3545, 66 }, { 3479, 64 }, { 3415, 61 }, { 3354, 59 }, { 3295, 57 }, { 3238, 55 },
+  { 3183, 53 }, { 3130, 51 }, { 3079, 50 }, { 3029, 48 }, { 2981, 47 }, { 2934, 45 }, { 2889, 44 }, { 2845, 43 },
+  { 2802, 41 }, { 2761, 40 }, { 2721, 39 }, { 2682, 38 }, { 2644, 37 }, { 2607, 36 }, { 2571, 34 }, { 2537, 34 },
+  { 2503, 33 }, { 2470, 32 }, { 2438, 32 }, { 2406, 30 }, { 2376, 30 }, { 2346, 29 }, { 2317, 28 }, { 2289, 28 },
+  { 2261, 27 }, { 2234, 26 }, { 2208, 26 }, { 2182, 25 }, { 2157, 25 }, { 2132, 24 }, { 2108, 23 }, { 2085, 23 },
+  { 2062, 23 }, { 2039, 22 }, { 2017, 21 }, { 1996, 21 }, { 1975, 21 }, { 1954, 20 }, { 1934, 20 }, { 1914, 19 },
+  { 1895, 19 }, { 1876, 19 }, { 1857, 18 }, { 1839, 18 }, { 1821, 17 }, { 1804, 18 }, { 1786, 17 }, { 1769, 16 },
+  { 1753, 16 }, { 1737, 16 }, { 1721, 16 }, { 1705, 15 }, { 1690, 16 }, { 1674, 14 }, { 1660, 15 }, { 1645, 14 },
+  { 1631, 14 }, { 1617, 14 }, { 1603, 14 }, { 1589, 13 }, { 1576, 13 }, { 1563, 13 }, { 1550, 13 }, { 1537, 13 },
+  { 1524, 12 }, { 1512, 12 }, { 1500, 12 }, { 1488, 12 }, { 1476, 11 }, { 1465, 12 }, { 1453, 11 }, { 1442, 11 },
+  { 1431, 11 }, { 1420, 10 }, { 1410, 11 }, { 1399, 10 }, { 1389, 11 }, { 1378, 10 }, { 1368, 10 }, { 1358, 9 },
+  { 1349, 10 }, { 1339, 10 }, { 1329, 9 }, { 1320, 9 }, { 1311, 9 }, { 1302, 9 }, { 1293, 9 }, { 1284, 9 },
+  { 1275, 9 }, { 1266, 8 }, { 1258, 8 }, { 1250, 9 }, { 1241, 8 }, { 1233, 8 }, { 1225, 8 }, { 1217, 8 },
+  { 1209, 8 }, { 1201, 7 }, { 1194, 8 }, { 1186, 7 }, { 1179, 8 }, { 1171, 7 }, { 1164, 7 }, { 1157, 7 },
+  { 1150, 7 }, { 1143, 7 }, { 1136, 7 }, { 1129, 7 }, { 1122, 7 }, { 1115, 6 }, { 1109, 7 }, { 1102, 6 },
+  { 1096, 7 }, { 1089, 6 }, { 1083, 6 }, { 1077, 6 }, { 1071, 6 }, { 1065, 6 }, { 1059, 6 }, { 1053, 6 },
+  { 1047, 6 }, { 1041, 6 }, { 1035, 6 }, { 1029, 5 }, { 1024, 6 }, { 1018, 5 }, { 1013, 6 }, { 1007, 5 },
+  { 1002, 5 }, { 997, 6 }, { 991, 5 }, { 986, 5 }, { 981, 5 }, { 976, 5 }, { 971, 5 }, { 966, 5 },
+  { 961, 5 }, { 956, 5 }, { 951, 5 }, { 946, 5 }, { 941, 4 }, { 937, 5 }, { 932, 5 }, { 927, 4 },
+  { 923, 5 }, { 918, 4 }, { 914, 5 }, { 909, 4 }, { 905, 5 }, { 900, 4 }, { 896, 4 }, { 892, 4 },
+  { 888, 5 }, { 883, 4 }, { 879, 4 }, { 875, 4 }, { 871, 4 }, { 867, 4 }, { 863, 4 }, { 859, 4 },
+  { 855, 4 }, { 851, 4 }, { 847, 3 }, { 844, 4 }, { 840, 4 }, { 836, 4 }, { 832, 3 }, { 829, 4 },
+  { 825, 4 }, { 821, 3 }, { 818, 4 }, { 814, 3 }, { 811, 4 }, { 807, 3 }, { 804, 4 }, { 800, 3 },
+  { 797, 4 }, { 793, 3 }, { 790, 3 }, { 787, 4 }, { 783, 3 }, { 780, 3 }, { 777, 3 }, { 774, 3 },
+  { 771, 4 }, { 767, 3 }, { 764, 3 }, { 761, 3 }, { 758, 3 }, { 755, 3 }, { 752, 3 }, { 749, 3 },
+  { 746, 3 }, { 743, 3 }, { 740, 3 }, { 737, 3 }, { 734, 3 }, { 731, 3 }, { 728, 2 }, { 726, 3 },
+};
+
+#endif // SPEED_LOOKUPTABLE_H
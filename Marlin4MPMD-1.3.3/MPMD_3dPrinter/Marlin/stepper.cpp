@@ -52,7 +52,6 @@
 #include "ultralcd.h"
 #include "language.h"
 #include "cardreader.h"
-//  #include "speed_lookuptable.h"    BDI :: To supp.
 
 #if HAS_DIGIPOTSS
   #include <SPI.h>
@@ -124,6 +123,13 @@ unsigned long Stepper::acc_step_rate; // needed for deceleration start point
 uint8_t Stepper::step_loops, Stepper::step_loops_nominal;
 unsigned short Stepper::OCR1A_nominal;
 
+#if ENABLED(STEP_BURST)
+  volatile bool Stepper::burst_active = false;
+  bool Stepper::burst_ending;
+  uint8_t Stepper::burst_slot;
+  uint16_t Stepper::burst_time;
+#endif
+
 volatile long Stepper::endstops_trigsteps[3];
 
 #if ENABLED(X_DUAL_STEPPER_DRIVERS)
@@ -250,6 +256,15 @@ volatile long Stepper::endstops_trigsteps[3];
 // Some useful constants
 #define STEPPER_NOMINAL_FREQ				1000
 #define ENABLE_STEPPER_DRIVER_INTERRUPT()   BSP_MiscTickSetFreq(STEPPER_NOMINAL_FREQ)
+
+#if ENABLED(STEPPER_TRACE)
+  #define STEPPER_NOMINAL_PERIOD (CORE_CPU_FREQ / (TICK_TIMER_PRESCALER * STEPPER_NOMINAL_FREQ) - 1)
+  #define TRACE_STEP(AXIS) trace_steps += STEPPER_TRACE_STEP(_AXIS(AXIS))
+  #define TRACE_IDLE() if (stepperTrace.active()) stepperTrace.record(trace_time, STEPPER_NOMINAL_PERIOD, 0, last_direction_bits, STEPPER_TRACE_IDLE)
+#else
+  #define TRACE_STEP(AXIS) NOOP
+  #define TRACE_IDLE() NOOP
+#endif
 #define DISABLE_STEPPER_DRIVER_INTERRUPT() BSP_MiscTickStop()
 /* BDI  -- To suppress :
 #define ENABLE_STEPPER_DRIVER_INTERRUPT()  SBI(TIMSK1, OCIE1A)
@@ -333,6 +348,19 @@ void IsrStepperHandler() { Stepper::StepperHandler(); }
 
 void Stepper::StepperHandler()
 {
+  #if ENABLED(STEP_BURST)
+    // The frame handing the block back, its step is done here
+    if (burst_active) {
+      burst_active = false;
+      BSP_MiscStepBurstStop(burst_time);
+    }
+  #endif
+
+  #if ENABLED(STEPPER_TRACE)
+    const uint16_t trace_time = BSP_MiscTickGetCounter();
+    uint16_t trace_steps = 0;
+  #endif
+
   if (cleaning_buffer_counter) {
     current_block = NULL;
     planner.discard_current_block();
@@ -341,6 +369,7 @@ void Stepper::StepperHandler()
     #endif
     cleaning_buffer_counter--;
     BSP_MiscTickSetFreq(STEPPER_NOMINAL_FREQ); //1ms wait
+    TRACE_IDLE();
     //  BDI  -- OCR1A = 200;
     return;
   }
@@ -354,11 +383,11 @@ void Stepper::StepperHandler()
       trapezoid_generator_reset();
 
       // Initialize Bresenham counters to 1/2 the ceiling
-      counter_X = counter_Y = counter_Z = counter_E = -(current_block->step_event_count >> 1);
+      counter_X = counter_Y = counter_Z = counter_E = -(long)(current_block->step_event_count >> 1);
 
       #if ENABLED(MIXING_EXTRUDER)
         MIXING_STEPPERS_LOOP(i)
-          counter_M[i] = -(current_block->mix_event_count[i] >> 1);
+          counter_M[i] = -(long)(current_block->mix_event_count[i] >> 1);
       #endif
 
       step_events_completed = 0;
@@ -378,6 +407,7 @@ void Stepper::StepperHandler()
     }
     else {
       BSP_MiscTickSetFreq(STEPPER_NOMINAL_FREQ); //1kHz
+      TRACE_IDLE();
     }
   }
 
@@ -498,6 +528,7 @@ void Stepper::StepperHandler()
           _COUNTER(AXIS) -= current_block->step_event_count; \
           count_position[_AXIS(AXIS)] += count_direction[_AXIS(AXIS)]; \
           _APPLY_STEP(AXIS)(_INVERT_STEP_PIN(AXIS),0); \
+          TRACE_STEP(AXIS); \
         }
 
       STEP_IF_COUNTER(X);
@@ -660,14 +691,184 @@ void Stepper::StepperHandler()
 
    // OCR1A = (OCR1A < (TCNT1 + 16)) ? (TCNT1 + 16) : OCR1A;   BDI : To check
 
+    #if ENABLED(STEPPER_TRACE)
+      if (stepperTrace.active()) {
+        uint8_t trace_flags = 0;
+        if (step_events_completed <= (unsigned long)current_block->accelerate_until)
+          trace_flags = STEPPER_TRACE_ACCEL;
+        else if (step_events_completed > (unsigned long)current_block->decelerate_after)
+          trace_flags = STEPPER_TRACE_DECEL;
+        else
+          timer = OCR1A_nominal;
+        if (step_events_completed >= current_block->step_event_count)
+          trace_flags |= STEPPER_TRACE_END;
+        stepperTrace.record(trace_time, timer, trace_steps, last_direction_bits, trace_flags);
+      }
+    #endif
+
     // If current block is finished, reset pointer
     if (step_events_completed >= current_block->step_event_count) {
       current_block = NULL;
       planner.discard_current_block();
     }
+    #if ENABLED(STEP_BURST)
+      // Long enough for a burst, DMA takes the steps up to the last one
+      else if (current_block->step_event_count - step_events_completed > BSP_STEP_BURST_FRAMES
+        && !endstops.homing
+        #if HAS_BED_PROBE
+          && !endstops.z_probe_enabled
+        #endif
+        #if ENABLED(MPMD_SIM)
+          && !sim_no_step_burst
+        #endif
+      ) burst_start();
+    #endif
   }
 }
 
+#if ENABLED(STEP_BURST)
+
+  void IsrStepBurstHandler() { Stepper::StepBurstHandler(); }
+
+  // Half of the frames were played, fill them again
+  void Stepper::StepBurstHandler() {
+    if (burst_active && !burst_ending) burst_fill(BSP_STEP_BURST_FRAMES / 2);
+  }
+
+  /**
+   * Hand the current block to DMA from the step the interrupt was just set
+   * for, if there is the time to fill its frame first. The buffers are kept
+   * filled to the frame before the one being played (BSP_MiscStepBurstStart).
+   */
+  void Stepper::burst_start() {
+    const uint16_t due = BSP_MiscTickGetCompare();
+    if ((int16_t)(due - BSP_MiscTickGetCounter()) < BSP_STEP_BURST_LEAD) return;
+
+    burst_time = due;
+    burst_slot = 0;
+    burst_ending = false;
+    burst_fill(2);
+    BSP_MiscStepBurstStart();
+    burst_active = true;
+    burst_fill(BSP_STEP_BURST_FRAMES - 3); // DMA plays far slower than this fills
+  }
+
+  /**
+   * Fill the next frames with the steps of the current block, as the
+   * interrupt would take them. The last step of the block is left to the
+   * interrupt: its frame hands the block back.
+   */
+  void Stepper::burst_fill(uint8_t frames) {
+    for (; frames; frames--) {
+      BSP_StepBurstPins_t *pins = &bspStepBurstPins[burst_slot];
+      BSP_StepBurstTimer_t *regs = &bspStepBurstTimer[burst_slot ? burst_slot - 1 : BSP_STEP_BURST_FRAMES - 1];
+      if (++burst_slot == BSP_STEP_BURST_FRAMES) burst_slot = 0;
+
+      // The last step is the interrupt's, as is the rest of a block an endstop ended
+      if (step_events_completed + 1 < current_block->step_event_count && endstops.enabled)
+        endstops.update();
+      if (step_events_completed + 1 >= current_block->step_event_count) {
+        pins->set = pins->reset = 0;
+        regs->arr = 0xFFFE;
+        regs->rcr = 0;
+        regs->ccr1 = 0;
+        regs->ccr2 = 0;
+        burst_ending = true;
+        return;
+      }
+
+      #if ENABLED(STEPPER_TRACE)
+        uint16_t trace_steps = 0;
+      #endif
+      uint32_t set = 0;
+      uint16_t pulse = 0;
+
+      #define BURST_STEP(AXIS, BIT) \
+        _COUNTER(AXIS) += current_block->steps[_AXIS(AXIS)]; \
+        if (_COUNTER(AXIS) > 0) { \
+          _COUNTER(AXIS) -= current_block->step_event_count; \
+          count_position[_AXIS(AXIS)] += count_direction[_AXIS(AXIS)]; \
+          set |= _INVERT_STEP_PIN(AXIS) ? (uint32_t)(BIT) << 16 : (BIT); \
+          TRACE_STEP(AXIS); \
+        }
+
+      BURST_STEP(X, BSP_STEP_BURST_X);
+      BURST_STEP(Y, BSP_STEP_BURST_Y);
+      BURST_STEP(Z, BSP_STEP_BURST_Z);
+      counter_E += current_block->steps[E_AXIS];
+      if (counter_E > 0) {
+        counter_E -= current_block->step_event_count;
+        count_position[E_AXIS] += count_direction[E_AXIS];
+        pulse = BSP_STEP_BURST_PULSE;
+        TRACE_STEP(E);
+      }
+      step_events_completed++;
+
+      // Next timer value, as the interrupt works it out (no ADVANCE)
+      unsigned short timer;
+      unsigned long step_rate;
+      if (step_events_completed <= (unsigned long)current_block->accelerate_until) {
+        MultiU24X32toH16(acc_step_rate, acceleration_time, current_block->acceleration_rate);
+        acc_step_rate += current_block->initial_rate;
+        NOMORE(acc_step_rate, current_block->nominal_rate);
+        timer = calc_timer(acc_step_rate);
+        acceleration_time += timer;
+      }
+      else if (step_events_completed > (unsigned long)current_block->decelerate_after) {
+        MultiU24X32toH16(step_rate, deceleration_time, current_block->acceleration_rate);
+        if (step_rate <= acc_step_rate) {
+          step_rate = acc_step_rate - step_rate;
+          NOLESS(step_rate, current_block->final_rate);
+        }
+        else
+          step_rate = current_block->final_rate;
+        timer = calc_timer(step_rate);
+        deceleration_time += timer;
+      }
+      else {
+        timer = OCR1A_nominal;
+        step_loops = step_loops_nominal;
+      }
+
+      #if ENABLED(STEPPER_TRACE)
+        if (stepperTrace.active()) {
+          uint8_t trace_flags = STEPPER_TRACE_BURST;
+          if (step_events_completed <= (unsigned long)current_block->accelerate_until)
+            trace_flags |= STEPPER_TRACE_ACCEL;
+          else if (step_events_completed > (unsigned long)current_block->decelerate_after)
+            trace_flags |= STEPPER_TRACE_DECEL;
+          stepperTrace.record(burst_time, timer, trace_steps, last_direction_bits, trace_flags);
+        }
+      #endif
+
+      pins->set = set;
+      pins->reset = (set << 16) | (set >> 16);
+      regs->arr = timer - 1;
+      regs->rcr = 0;
+      regs->ccr1 = 0xFFFF;
+      regs->ccr2 = pulse;
+      burst_time += timer;
+    }
+  }
+
+  /**
+   * Stop the burst from outside the interrupts, taking the steps of the
+   * frames DMA didn't get to back off the positions
+   */
+  void Stepper::burst_stop() {
+    uint8_t slot = BSP_MiscStepBurstStop(burst_time);
+    burst_active = false;
+    for (; slot != burst_slot; slot = (slot + 1) % BSP_STEP_BURST_FRAMES) {
+      const uint32_t set = bspStepBurstPins[slot].set;
+      if (set & (BSP_STEP_BURST_X | (uint32_t)BSP_STEP_BURST_X << 16)) count_position[X_AXIS] -= count_direction[X_AXIS];
+      if (set & (BSP_STEP_BURST_Y | (uint32_t)BSP_STEP_BURST_Y << 16)) count_position[Y_AXIS] -= count_direction[Y_AXIS];
+      if (set & (BSP_STEP_BURST_Z | (uint32_t)BSP_STEP_BURST_Z << 16)) count_position[Z_AXIS] -= count_direction[Z_AXIS];
+      if (bspStepBurstTimer[slot ? slot - 1 : BSP_STEP_BURST_FRAMES - 1].ccr2) count_position[E_AXIS] -= count_direction[E_AXIS];
+    }
+  }
+
+#endif // STEP_BURST
+
 #if ENABLED(ADVANCE) || ENABLED(LIN_ADVANCE)
 
   // Timer interrupt for E. e_steps is set in the main routine;
@@ -1001,8 +1202,15 @@ void Stepper::finish_and_disable() {
 }
 
 void Stepper::quick_stop() {
+  #if ENABLED(STEP_BURST)
+    CRITICAL_SECTION_START;
+    if (burst_active) burst_stop();
+  #endif
   cleaning_buffer_counter = 5000;
   DISABLE_STEPPER_DRIVER_INTERRUPT();
+  #if ENABLED(STEP_BURST)
+    CRITICAL_SECTION_END;
+  #endif
   while (planner.blocks_queued()) planner.discard_current_block();
   current_block = NULL;
   ENABLE_STEPPER_DRIVER_INTERRUPT();
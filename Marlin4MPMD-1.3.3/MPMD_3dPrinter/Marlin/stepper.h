@@ -44,8 +44,10 @@
 #define STEPPER_H
 
 #include "planner.h"
+#include "speed_lookuptable.h"
 #include "stepper_indirection.h"
 #include "language.h"
+#include "stepper_trace.h"
 
 class Stepper;
 extern Stepper stepper;
@@ -109,6 +111,13 @@ class Stepper {
     static uint8_t step_loops, step_loops_nominal;
     static unsigned short OCR1A_nominal;
 
+    #if ENABLED(STEP_BURST)
+      static volatile bool burst_active; // DMA is playing the frames of the current block
+      static bool burst_ending;          // the frame handing the block back to the interrupt is filled
+      static uint8_t burst_slot;         // the next frame to fill
+      static uint16_t burst_time;        // tick count the next frame to fill starts at
+    #endif
+
     static volatile long endstops_trigsteps[3];
     static volatile long endstops_stepsTotal, endstops_stepsDone;
 
@@ -157,6 +166,10 @@ class Stepper {
 
     static void StepperHandler(void);
 
+    #if ENABLED(STEP_BURST)
+      static void StepBurstHandler(void);
+    #endif
+
     #if ENABLED(ADVANCE) || ENABLED(LIN_ADVANCE)
       static void advance_isr();
     #endif
@@ -247,6 +260,34 @@ class Stepper {
       return endstops_trigsteps[axis] * planner.steps_to_mm[axis];
     }
 
+    //
+    // Step rate (steps/s) to Tick timer period, interpolated (and rounded)
+    // from speed_lookuptable.h: the M0 has no divide instruction. The
+    // planner works out the periods a block starts with.
+    //
+    static FORCE_INLINE unsigned short step_rate_to_timer(unsigned long step_rate) {
+      unsigned short timer;
+
+      NOMORE(step_rate, MAX_STEP_FREQUENCY);
+      NOLESS(step_rate, SPEED_LOOKUPTABLE_MIN_RATE);
+      step_rate -= SPEED_LOOKUPTABLE_MIN_RATE; // Correct for minimal speed
+      if (step_rate >= (8 * 256)) { // higher step rate
+        const uint16_t* table = speed_lookuptable_fast[(uint8_t)(step_rate >> 8)];
+        timer = table[0] - (((uint32_t)(uint8_t)step_rate * table[1] + 128) >> 8);
+      }
+      else { // lower step rate
+        const uint16_t* table = speed_lookuptable_slow[step_rate >> 3];
+        timer = table[0] - ((table[1] * (uint8_t)(step_rate & 0x0007) + 4) >> 3);
+      }
+
+      return timer;
+    }
+
+    static FORCE_INLINE unsigned short calc_timer(unsigned long step_rate) {
+      step_loops = 1;
+      return step_rate_to_timer(step_rate);
+    }
+
     #if ENABLED(LIN_ADVANCE)
       void advance_M905(const float &k);
       FORCE_INLINE int get_advance_k() { return extruder_advance_k; }
@@ -254,17 +295,6 @@ class Stepper {
 
   private:
 
-    static FORCE_INLINE unsigned short calc_timer(unsigned long step_rate) {
-      unsigned short timer;
-
-      NOLESS(step_rate,(uint32_t)((F_CPU()/((uint32_t)0xffff*(uint32_t)TICK_TIMER_PRESCALER)))+1u);
-        step_loops = 1;
-
-      timer = (uint16_t)(F_CPU() / (step_rate * TICK_TIMER_PRESCALER))-1;
-
-      return timer;
-    }
-
     // Initializes the trapezoid generator from the current block. Called whenever a new
     // block begins.
     static FORCE_INLINE void trapezoid_generator_reset() {
@@ -298,15 +328,19 @@ class Stepper {
       #endif
 
       deceleration_time = 0;
-      // step_rate to timer interval
-      OCR1A_nominal = calc_timer(current_block->nominal_rate);
+      // step_rate to timer interval, from the planner
+      OCR1A_nominal = current_block->nominal_period;
       // make a note of the number of step loops required at nominal speed
-      step_loops_nominal = step_loops;
+      step_loops_nominal = step_loops = 1;
       acc_step_rate = current_block->initial_rate;
-      acceleration_time = calc_timer(acc_step_rate);
+      acceleration_time = current_block->initial_period;
 
       BSP_MiscTickSetPeriod(acceleration_time);
 
+      #if ENABLED(STEPPER_TRACE)
+        stepperTrace.flag(STEPPER_TRACE_BLOCK);
+      #endif
+
       
       #if ENABLED(LIN_ADVANCE)
         if (current_block->use_advance_lead) {
@@ -326,6 +360,12 @@ class Stepper {
       // SERIAL_ECHOLN(current_block->final_advance/256.0);
     }
 
+    #if ENABLED(STEP_BURST)
+      static void burst_start();
+      static void burst_fill(uint8_t frames);
+      static void burst_stop();
+    #endif
+
     static void digipot_init();
     static void microstep_init();
 
@@ -0,0 +1,97 @@
+/**
+ * Marlin 3D Printer Firmware
+ * Copyright (C) 2016 MarlinFirmware [https://github.com/MarlinFirmware/Marlin]
+ *
+ * Based on Sprinter and grbl.
+ * Copyright (C) 2011 Camiel Gubbels / Erik van der Zalm
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * stepper_trace.cpp - step timeline recorder for the stepper interrupt
+ */
+
+#include "stepper_trace.h"
+
+#if ENABLED(STEPPER_TRACE)
+
+StepperTrace stepperTrace;
+
+stepper_trace_t StepperTrace::buffer[STEPPER_TRACE_SIZE];
+volatile uint16_t StepperTrace::head = 0,
+                  StepperTrace::count = 0;
+volatile uint32_t StepperTrace::lost = 0;
+uint32_t StepperTrace::lost_read = 0;
+volatile uint8_t StepperTrace::state = STEPPER_TRACE_OFF;
+uint8_t StepperTrace::pending = 0;
+uint16_t StepperTrace::remaining = 0;
+
+void StepperTrace::start(const bool trigger) {
+  CRITICAL_SECTION_START;
+  head = count = 0;
+  lost = lost_read = 0;
+  pending = 0;
+  state = trigger ? STEPPER_TRACE_ARMED : STEPPER_TRACE_RUN;
+  CRITICAL_SECTION_END;
+}
+
+uint16_t StepperTrace::read(stepper_trace_t* dst, uint16_t max) {
+  uint16_t n = 0;
+  for (; n < max && count; n++, count--)
+    dst[n] = buffer[(head - count) & (STEPPER_TRACE_SIZE - 1)];
+  // the timeline has a gap in front of the first event returned
+  if (n && lost != lost_read) {
+    dst[0].flags |= STEPPER_TRACE_LOST;
+    lost_read = lost;
+  }
+  return n;
+}
+
+/**
+ * Dump format, one line each:
+ *   trace:begin <events> <lost> <timer Hz>
+ *   trace:<up to 4 events of 16 hex digits, the event bytes in memory order>
+ *   trace:end
+ */
+void StepperTrace::report() {
+  static const char hex[] = "0123456789abcdef";
+  char line[6 + 4 * 2 * sizeof(stepper_trace_t) + 1];
+  stepper_trace_t e[4];
+  uint16_t n;
+
+  stop();
+  SERIAL_PROTOCOLPGM("trace:begin ");
+  SERIAL_PROTOCOL(count);
+  SERIAL_PROTOCOLPGM(" ");
+  SERIAL_PROTOCOL(lost - lost_read);
+  SERIAL_PROTOCOLPGM(" ");
+  SERIAL_PROTOCOLLN((uint32_t)(CORE_CPU_FREQ / TICK_TIMER_PRESCALER));
+
+  memcpy(line, "trace:", 6);
+  while ((n = read(e, COUNT(e)))) {
+    char* p = line + 6;
+    const uint8_t* b = (const uint8_t*)e;
+    for (uint8_t i = 0; i < n * sizeof(stepper_trace_t); i++) {
+      *p++ = hex[b[i] >> 4];
+      *p++ = hex[b[i] & 0xF];
+    }
+    *p++ = '\n';
+    MYSERIAL.printn((uint8_t*)line, p - line);
+  }
+  SERIAL_PROTOCOLLNPGM("trace:end");
+}
+
+#endif // STEPPER_TRACE
@@ -0,0 +1,149 @@
+/**
+ * Marlin 3D Printer Firmware
+ * Copyright (C) 2016 MarlinFirmware [https://github.com/MarlinFirmware/Marlin]
+ *
+ * Based on Sprinter and grbl.
+ * Copyright (C) 2011 Camiel Gubbels / Erik van der Zalm
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * stepper_trace.h - step timeline recorder for the stepper interrupt
+ *
+ * With STEPPER_TRACE enabled every pass through Stepper::StepperHandler()
+ * appends one 8 byte event to a ring buffer: the tick timer count when the
+ * interrupt started, the timer period programmed for the next one (from
+ * calc_timer()), the steps output on each axis and the direction bits.
+ * With STEP_BURST the steps played by DMA are recorded as their frames are
+ * filled, with the tick count each is due at, so the timeline reads the
+ * same. The ring keeps the newest STEPPER_TRACE_SIZE events. M930 starts,
+ * stops and dumps it; sim/trace_analyze decodes the dump.
+ */
+
+#ifndef STEPPER_TRACE_H
+#define STEPPER_TRACE_H
+
+#include "Marlin.h"
+
+#if ENABLED(STEPPER_TRACE)
+
+#if (STEPPER_TRACE_SIZE & (STEPPER_TRACE_SIZE - 1)) != 0
+  #error "STEPPER_TRACE_SIZE must be a power of 2"
+#endif
+
+// Event flags
+#define STEPPER_TRACE_BLOCK  0x01 // first interrupt of a block (trapezoid_generator_reset)
+#define STEPPER_TRACE_END    0x02 // the block finished in this interrupt
+#define STEPPER_TRACE_IDLE   0x04 // no block to execute, the planner queue is empty
+#define STEPPER_TRACE_ACCEL  0x08 // accelerating
+#define STEPPER_TRACE_DECEL  0x10 // decelerating
+#define STEPPER_TRACE_BURST  0x20 // stepped by DMA (STEP_BURST), recorded as the frame was filled
+#define STEPPER_TRACE_LOST   0x80 // events were dropped before this one
+
+// Steps of one axis in the packed step count, 4 bits per axis from X
+#define STEPPER_TRACE_STEP(AXIS) (1U << ((AXIS) * 4))
+
+typedef struct {
+  uint16_t time;    // tick timer count when the interrupt started
+  uint16_t period;  // timer period programmed for the next interrupt
+  uint16_t steps;   // steps output, 4 bits per axis X, Y, Z, E
+  uint8_t dirs;     // direction bits (Stepper::last_direction_bits)
+  uint8_t flags;    // STEPPER_TRACE_*
+} stepper_trace_t;
+
+enum StepperTraceState {
+  STEPPER_TRACE_OFF,      // not recording, the buffer can be read
+  STEPPER_TRACE_RUN,      // recording, the oldest events are overwritten
+  STEPPER_TRACE_ARMED,    // recording until the planner runs dry...
+  STEPPER_TRACE_TRIGGERED // ...then half a buffer more and stop
+};
+
+class StepperTrace {
+
+  public:
+
+    static stepper_trace_t buffer[STEPPER_TRACE_SIZE];
+    static volatile uint16_t head, count;   // next event written, events held
+    static volatile uint32_t lost;          // events overwritten before they were read
+    static uint32_t lost_read;              // lost count at the last read()
+    static volatile uint8_t state;
+    static uint8_t pending;                 // flags for the next event
+    static uint16_t remaining;              // events left to record once triggered
+
+    StepperTrace() {};
+
+    /**
+     * Clear the buffer and start recording, with trigger set recording
+     * stops half a buffer after the planner queue first runs dry
+     */
+    static void start(const bool trigger);
+
+    /**
+     * Stop recording, the buffer keeps the last events
+     */
+    static FORCE_INLINE void stop() { state = STEPPER_TRACE_OFF; }
+
+    static FORCE_INLINE bool active() { return state != STEPPER_TRACE_OFF; }
+
+    /**
+     * Copy out and remove up to max of the oldest events. Must not race
+     * the interrupt: call it with recording stopped or from the interrupt
+     * context itself (the host simulator).
+     */
+    static uint16_t read(stepper_trace_t* dst, uint16_t max);
+
+    /**
+     * Stop recording and send the buffer to the host as hex text
+     */
+    static void report();
+
+    /**
+     * Set flags to be recorded with the next event
+     */
+    static FORCE_INLINE void flag(const uint8_t f) { pending |= f; }
+
+    /**
+     * Append an event, called by the stepper interrupt when active()
+     */
+    static FORCE_INLINE void record(const uint16_t time, const uint16_t period, const uint16_t steps, const uint8_t dirs, uint8_t flags) {
+      flags |= pending;
+      pending = 0;
+
+      if (state == STEPPER_TRACE_ARMED) {
+        if ((flags & STEPPER_TRACE_IDLE) && count && (buffer[(head - 1) & (STEPPER_TRACE_SIZE - 1)].flags & STEPPER_TRACE_END)) {
+          state = STEPPER_TRACE_TRIGGERED;
+          remaining = STEPPER_TRACE_SIZE / 2;
+        }
+      }
+      else if (state == STEPPER_TRACE_TRIGGERED && !--remaining)
+        state = STEPPER_TRACE_OFF;
+
+      stepper_trace_t* e = &buffer[head];
+      e->time = time;
+      e->period = period;
+      e->steps = steps;
+      e->dirs = dirs;
+      e->flags = flags;
+      head = (head + 1) & (STEPPER_TRACE_SIZE - 1);
+      if (count < STEPPER_TRACE_SIZE) count++; else lost++;
+    }
+};
+
+extern StepperTrace stepperTrace;
+
+#endif // STEPPER_TRACE
+
+#endif // STEPPER_TRACE_H
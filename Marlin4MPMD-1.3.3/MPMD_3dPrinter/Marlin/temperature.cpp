@@ -28,6 +28,7 @@
 #include "ultralcd.h"
 #include "temperature.h"
 #include "thermistortables.h"
+#include "thermistor_lut.h"
 #include "language.h"
 
 #if ENABLED(USE_WATCHDOG)
@@ -38,12 +39,41 @@
   #define K2 (1.0-K1)
 #endif
 
+// The thermistor tables as segments to look up (thermistor_lut.h)
+#ifdef THERMISTORHEATER_0
+  static constexpr thermistor_lut_t<HEATER_0_TEMPTABLE_LEN> heater_0_lut = thermistor_lut(HEATER_0_TEMPTABLE);
+  #define HEATER_0_LUT heater_0_lut.segment
+#else
+  #define HEATER_0_LUT NULL
+#endif
+#ifdef THERMISTORHEATER_1
+  static constexpr thermistor_lut_t<HEATER_1_TEMPTABLE_LEN> heater_1_lut = thermistor_lut(HEATER_1_TEMPTABLE);
+  #define HEATER_1_LUT heater_1_lut.segment
+#else
+  #define HEATER_1_LUT NULL
+#endif
+#ifdef THERMISTORHEATER_2
+  static constexpr thermistor_lut_t<HEATER_2_TEMPTABLE_LEN> heater_2_lut = thermistor_lut(HEATER_2_TEMPTABLE);
+  #define HEATER_2_LUT heater_2_lut.segment
+#else
+  #define HEATER_2_LUT NULL
+#endif
+#ifdef THERMISTORHEATER_3
+  static constexpr thermistor_lut_t<HEATER_3_TEMPTABLE_LEN> heater_3_lut = thermistor_lut(HEATER_3_TEMPTABLE);
+  #define HEATER_3_LUT heater_3_lut.segment
+#else
+  #define HEATER_3_LUT NULL
+#endif
+#if ENABLED(BED_USES_THERMISTOR)
+  static constexpr thermistor_lut_t<BEDTEMPTABLE_LEN> bed_lut = thermistor_lut(BEDTEMPTABLE);
+#endif
+
 #if ENABLED(TEMP_SENSOR_1_AS_REDUNDANT)
-  static void* heater_ttbl_map[2] = {(void*)HEATER_0_TEMPTABLE, (void*)HEATER_1_TEMPTABLE };
-  static uint8_t heater_ttbllen_map[2] = { HEATER_0_TEMPTABLE_LEN, HEATER_1_TEMPTABLE_LEN };
+  static const thermistor_segment_t* const heater_ttbl_map[2] = { HEATER_0_LUT, HEATER_1_LUT };
+  static const uint8_t heater_ttbllen_map[2] = { HEATER_0_TEMPTABLE_LEN, HEATER_1_TEMPTABLE_LEN };
 #else
-  static void* heater_ttbl_map[HOTENDS] = ARRAY_BY_HOTENDS((void*)HEATER_0_TEMPTABLE, (void*)HEATER_1_TEMPTABLE, (void*)HEATER_2_TEMPTABLE, (void*)HEATER_3_TEMPTABLE);
-  static uint8_t heater_ttbllen_map[HOTENDS] = ARRAY_BY_HOTENDS(HEATER_0_TEMPTABLE_LEN, HEATER_1_TEMPTABLE_LEN, HEATER_2_TEMPTABLE_LEN, HEATER_3_TEMPTABLE_LEN);
+  static const thermistor_segment_t* const heater_ttbl_map[HOTENDS] = ARRAY_BY_HOTENDS(HEATER_0_LUT, HEATER_1_LUT, HEATER_2_LUT, HEATER_3_LUT);
+  static const uint8_t heater_ttbllen_map[HOTENDS] = ARRAY_BY_HOTENDS(HEATER_0_TEMPTABLE_LEN, HEATER_1_TEMPTABLE_LEN, HEATER_2_TEMPTABLE_LEN, HEATER_3_TEMPTABLE_LEN);
 #endif
 
 Temperature thermalManager;
@@ -119,7 +149,9 @@ unsigned char Temperature::soft_pwm_bed;
 
 volatile bool Temperature::temp_meas_ready = false;
 
-#if ENABLED(PIDTEMP)
+#if ENABLED(PIDTEMP) && ENABLED(PID_FIXED_POINT)
+  PidFixed Temperature::pid_fixed[HOTENDS];
+#elif ENABLED(PIDTEMP)
   float Temperature::temp_iState[HOTENDS] = { 0 },
         Temperature::temp_dState[HOTENDS] = { 0 },
         Temperature::pTerm[HOTENDS],
@@ -139,7 +171,9 @@ volatile bool Temperature::temp_meas_ready = false;
   bool Temperature::pid_reset[HOTENDS];
 #endif
 
-#if ENABLED(PIDTEMPBED)
+#if ENABLED(PIDTEMPBED) && ENABLED(PID_FIXED_POINT)
+  PidFixed Temperature::pid_fixed_bed;
+#elif ENABLED(PIDTEMPBED)
   float Temperature::temp_iState_bed = { 0 },
         Temperature::temp_dState_bed = { 0 },
         Temperature::pTerm_bed,
@@ -148,7 +182,8 @@ volatile bool Temperature::temp_meas_ready = false;
         Temperature::pid_error_bed,
         Temperature::temp_iState_min_bed,
         Temperature::temp_iState_max_bed;
-#else
+#endif
+#if DISABLED(PIDTEMPBED)
   millis_t Temperature::next_bed_check_ms;
 #endif
 
@@ -432,6 +467,9 @@ unsigned char Temperature::soft_pwm[HOTENDS];
         return;
       }
       lcd_update();
+      #if ENABLED(MPMD_SIM)
+        sim_idle();
+      #endif
     }
     if (!wait_for_heatup) disable_all_heaters();
   }
@@ -450,11 +488,19 @@ void Temperature::updatePID() {
       last_e_position = 0;
     #endif
     HOTEND_LOOP() {
-      temp_iState_max[e] = (PID_INTEGRAL_DRIVE_MAX) / PID_PARAM(Ki, e);
+      #if ENABLED(PID_FIXED_POINT)
+        pid_fixed[e].set(PID_PARAM(Kp, e), PID_PARAM(Ki, e), PID_PARAM(Kd, e), PID_INTEGRAL_DRIVE_MAX);
+      #else
+        temp_iState_max[e] = (PID_INTEGRAL_DRIVE_MAX) / PID_PARAM(Ki, e);
+      #endif
     }
   #endif
   #if ENABLED(PIDTEMPBED)
-    temp_iState_max_bed = (PID_BED_INTEGRAL_DRIVE_MAX) / bedKi;
+    #if ENABLED(PID_FIXED_POINT)
+      pid_fixed_bed.set(bedKp, bedKi, bedKd, PID_BED_INTEGRAL_DRIVE_MAX);
+    #else
+      temp_iState_max_bed = (PID_BED_INTEGRAL_DRIVE_MAX) / bedKi;
+    #endif
   #endif
 }
 
@@ -538,7 +584,9 @@ float Temperature::get_pid_output(int e) {
   #endif
   float pid_output;
   #if ENABLED(PIDTEMP)
-    #if DISABLED(PID_OPENLOOP)
+    #if ENABLED(PID_FIXED_POINT) && DISABLED(PID_OPENLOOP)
+      pid_output = q16_to_float(pid_fixed[HOTEND_INDEX].hotend(float_to_q16(current_temperature[HOTEND_INDEX]), float_to_q16(target_temperature[HOTEND_INDEX])));
+    #elif DISABLED(PID_OPENLOOP)
       pid_error[HOTEND_INDEX] = target_temperature[HOTEND_INDEX] - current_temperature[HOTEND_INDEX];
       dTerm[HOTEND_INDEX] = K2 * PID_PARAM(Kd, HOTEND_INDEX) * (current_temperature[HOTEND_INDEX] - temp_dState[HOTEND_INDEX]) + K1 * dTerm[HOTEND_INDEX];
       temp_dState[HOTEND_INDEX] = current_temperature[HOTEND_INDEX];
@@ -597,9 +645,15 @@ float Temperature::get_pid_output(int e) {
       SERIAL_ECHOPAIR(MSG_PID_DEBUG, HOTEND_INDEX);
       SERIAL_ECHOPAIR(MSG_PID_DEBUG_INPUT, current_temperature[HOTEND_INDEX]);
       SERIAL_ECHOPAIR(MSG_PID_DEBUG_OUTPUT, pid_output);
-      SERIAL_ECHOPAIR(MSG_PID_DEBUG_PTERM, pTerm[HOTEND_INDEX]);
-      SERIAL_ECHOPAIR(MSG_PID_DEBUG_ITERM, iTerm[HOTEND_INDEX]);
-      SERIAL_ECHOPAIR(MSG_PID_DEBUG_DTERM, dTerm[HOTEND_INDEX]);
+      #if ENABLED(PID_FIXED_POINT)
+        SERIAL_ECHOPAIR(MSG_PID_DEBUG_PTERM, q16_to_float(pid_fixed[HOTEND_INDEX].pTerm));
+        SERIAL_ECHOPAIR(MSG_PID_DEBUG_ITERM, q16_to_float(pid_fixed[HOTEND_INDEX].iTerm));
+        SERIAL_ECHOPAIR(MSG_PID_DEBUG_DTERM, q16_to_float(pid_fixed[HOTEND_INDEX].dTerm));
+      #else
+        SERIAL_ECHOPAIR(MSG_PID_DEBUG_PTERM, pTerm[HOTEND_INDEX]);
+        SERIAL_ECHOPAIR(MSG_PID_DEBUG_ITERM, iTerm[HOTEND_INDEX]);
+        SERIAL_ECHOPAIR(MSG_PID_DEBUG_DTERM, dTerm[HOTEND_INDEX]);
+      #endif
       #if ENABLED(PID_EXTRUSION_SCALING)
         SERIAL_ECHOPAIR(MSG_PID_DEBUG_CTERM, cTerm[HOTEND_INDEX]);
       #endif
@@ -616,7 +670,9 @@ float Temperature::get_pid_output(int e) {
 #if ENABLED(PIDTEMPBED)
   float Temperature::get_pid_output_bed() {
     float pid_output;
-    #if DISABLED(PID_OPENLOOP)
+    #if ENABLED(PID_FIXED_POINT) && DISABLED(PID_OPENLOOP)
+      pid_output = q16_to_float(pid_fixed_bed.bed(float_to_q16(current_temperature_bed), float_to_q16(target_temperature_bed)));
+    #elif DISABLED(PID_OPENLOOP)
       pid_error_bed = target_temperature_bed - current_temperature_bed;
       pTerm_bed = bedKp * pid_error_bed;
       temp_iState_bed += pid_error_bed;
@@ -640,6 +696,11 @@ float Temperature::get_pid_output(int e) {
     #endif // PID_OPENLOOP
 
     #if ENABLED(PID_BED_DEBUG)
+      #if ENABLED(PID_FIXED_POINT)
+        const float pTerm_bed = q16_to_float(pid_fixed_bed.pTerm),
+                    iTerm_bed = q16_to_float(pid_fixed_bed.iTerm),
+                    dTerm_bed = q16_to_float(pid_fixed_bed.dTerm);
+      #endif
       SERIAL_ECHO_START;
       SERIAL_ECHOPGM(" PID_BED_DEBUG ");
       SERIAL_ECHOPGM(": Input ");
@@ -814,10 +875,6 @@ void Temperature::manage_heater() {
   #endif //TEMP_SENSOR_BED != 0
 }
 
-#define PGM_RD_W(x)   (short)(x)
-#define PGM_RD_UW(x)  (int)(x)
-// #define PGM_RD_W(x)   (short)pgm_read_word(&x)   -- BDI : To suppress
-
 // Derived from RepRap FiveD extruder::getTemperature()
 // For hot end temperature measurement.
 float Temperature::analog2temp(int raw, uint8_t e) {
@@ -838,26 +895,8 @@ float Temperature::analog2temp(int raw, uint8_t e) {
     if (e == 0) return 0.25 * raw;
   #endif
 
-  if (heater_ttbl_map[e] != NULL) {
-    float celsius = 0;
-    uint8_t i;
-    int(*tt)[][2] = (int(*)[][2])(heater_ttbl_map[e]);
-
-    for (i = 1; i < heater_ttbllen_map[e]; i++) {
-      if (PGM_RD_UW((*tt)[i][0]) > raw) {
-        celsius = PGM_RD_UW((*tt)[i - 1][1]) +
-                  (raw - PGM_RD_UW((*tt)[i - 1][0])) *
-                  (float)(PGM_RD_UW((*tt)[i][1]) - PGM_RD_UW((*tt)[i - 1][1])) /
-                  (float)(PGM_RD_UW((*tt)[i][0]) - PGM_RD_UW((*tt)[i - 1][0]));
-        break;
-      }
-    }
-
-    // Overflow: Set to last value in the table
-    if (i == heater_ttbllen_map[e]) celsius = PGM_RD_UW((*tt)[i - 1][1]);
-
-    return celsius;
-  }
+  if (heater_ttbl_map[e] != NULL)
+    return thermistor_celsius(heater_ttbl_map[e], heater_ttbllen_map[e], raw);
   return ((raw * ((5.0 * 100.0) / 1024.0) / OVERSAMPLENR) * (TEMP_SENSOR_AD595_GAIN)) + TEMP_SENSOR_AD595_OFFSET;
 }
 
@@ -865,24 +904,8 @@ float Temperature::analog2temp(int raw, uint8_t e) {
 // For bed temperature measurement.
 float Temperature::analog2tempBed(int raw) {
   #if ENABLED(BED_USES_THERMISTOR)
-    float celsius = 0;
-    byte i;
-
-    for (i = 1; i < BEDTEMPTABLE_LEN; i++) {
-      if (PGM_RD_UW(BEDTEMPTABLE[i][0]) > raw) {
-        celsius  = PGM_RD_UW(BEDTEMPTABLE[i - 1][1]) +
-                   (raw - PGM_RD_UW(BEDTEMPTABLE[i - 1][0])) *
-                   (float)(PGM_RD_UW(BEDTEMPTABLE[i][1]) - PGM_RD_UW(BEDTEMPTABLE[i - 1][1])) /
-                   (float)(PGM_RD_UW(BEDTEMPTABLE[i][0]) - PGM_RD_UW(BEDTEMPTABLE[i - 1][0]));
-        break;
-      }
-    }
-
-    // Overflow: Set to last value in the table
-    if (i == BEDTEMPTABLE_LEN)
-    	celsius = PGM_RD_UW(BEDTEMPTABLE[i - 1][1]);
 
-    return celsius;
+    return thermistor_celsius(bed_lut.segment, BEDTEMPTABLE_LEN, raw);
 
   #elif defined(BED_USES_AD595)
 
@@ -963,14 +986,18 @@ void Temperature::init() {
   HOTEND_LOOP() {
     // populate with the first value
     maxttemp[e] = maxttemp[0];
-    #if ENABLED(PIDTEMP)
+    #if ENABLED(PIDTEMP) && ENABLED(PID_FIXED_POINT)
+      pid_fixed[e].set(PID_PARAM(Kp, e), PID_PARAM(Ki, e), PID_PARAM(Kd, e), PID_INTEGRAL_DRIVE_MAX);
+    #elif ENABLED(PIDTEMP)
       temp_iState_min[e] = 0.0;
       temp_iState_max[e] = (PID_INTEGRAL_DRIVE_MAX) / PID_PARAM(Ki, e);
       #if ENABLED(PID_EXTRUSION_SCALING)
         last_e_position = 0;
       #endif
     #endif //PIDTEMP
-    #if ENABLED(PIDTEMPBED)
+    #if ENABLED(PIDTEMPBED) && ENABLED(PID_FIXED_POINT)
+      pid_fixed_bed.set(bedKp, bedKi, bedKd, PID_BED_INTEGRAL_DRIVE_MAX);
+    #elif ENABLED(PIDTEMPBED)
       temp_iState_min_bed = 0.0;
       temp_iState_max_bed = (PID_BED_INTEGRAL_DRIVE_MAX) / bedKi;
     #endif //PIDTEMPBED
@@ -30,6 +30,7 @@
 #include "Marlin.h"
 #include "planner.h"
 #include "thermistortables.h"
+#include "pid_fixed.h"
 
 #if ENABLED(PID_EXTRUSION_SCALING) || ENABLED(BABYSTEPPING)
   #include "stepper.h"
@@ -142,7 +143,9 @@ class Temperature {
 
     static volatile bool temp_meas_ready;
 
-    #if ENABLED(PIDTEMP)
+    #if ENABLED(PIDTEMP) && ENABLED(PID_FIXED_POINT)
+      static PidFixed pid_fixed[HOTENDS];
+    #elif ENABLED(PIDTEMP)
       static float temp_iState[HOTENDS],
                    temp_dState[HOTENDS],
                    pTerm[HOTENDS],
@@ -162,7 +165,9 @@ class Temperature {
       static bool pid_reset[HOTENDS];
     #endif
 
-    #if ENABLED(PIDTEMPBED)
+    #if ENABLED(PIDTEMPBED) && ENABLED(PID_FIXED_POINT)
+      static PidFixed pid_fixed_bed;
+    #elif ENABLED(PIDTEMPBED)
       static float temp_iState_bed,
                    temp_dState_bed,
                    pTerm_bed,
@@ -171,7 +176,9 @@ class Temperature {
                    pid_error_bed,
                    temp_iState_min_bed,
                    temp_iState_max_bed;
-    #else
+    #endif
+
+    #if DISABLED(PIDTEMPBED)
       static millis_t next_bed_check_ms;
     #endif
 
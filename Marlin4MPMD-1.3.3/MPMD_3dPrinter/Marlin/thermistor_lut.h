@@ -0,0 +1,113 @@
+/**
+ * Marlin 3D Printer Firmware
+ * Copyright (C) 2016 MarlinFirmware [https://github.com/MarlinFirmware/Marlin]
+ *
+ * Based on Sprinter and grbl.
+ * Copyright (C) 2011 Camiel Gubbels / Erik van der Zalm
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+/**
+ * thermistor_lut.h - the thermistor tables, made ready for a lookup
+ *
+ * analog2temp() and analog2tempBed() used to scan a table of
+ * thermistortables.h from the start for the first entry above the raw
+ * value (past 100 entries for a cold table 75), then divide the steps of
+ * the two entries in soft-float, every conversion of every sensor.
+ *
+ * thermistor_lut() makes a table of segments of it at compile time: the
+ * raw value and the celsius of each entry, and the slope to the next one in
+ * 12.20 fixed point. thermistor_celsius() finds the segment with a binary
+ * search and interpolates in integers, the one float operation left is the
+ * scale of the result. It gives what the scan did to within the rounding
+ * of the slope (about 0.001C), including the extrapolation below the first
+ * entry and the last celsius past the last; sim/testthermistor checks it
+ * against the scan for every raw value. A table with a celsius or a step
+ * of 2048 or more doesn't fit, and doesn't compile.
+ *
+ * The tables are left as they are, the simulator reads them too. Only the
+ * segments are referenced from the firmware, so the tables aren't linked in.
+ */
+
+#ifndef THERMISTOR_LUT_H
+#define THERMISTOR_LUT_H
+
+#include "Marlin.h"
+
+typedef struct {
+  uint16_t raw;      // oversampled ADC value of the entry
+  int16_t celsius;   // at raw
+  int32_t slope;     // celsius per raw unit to the next entry, 12.20 (0 for the last)
+} thermistor_segment_t;
+
+template<uint8_t N> struct thermistor_lut_t {
+  thermistor_segment_t segment[N];
+};
+
+// 0 to N - 1, the entries of a table
+template<int... I> struct thermistor_seq {};
+template<int N, int... I> struct thermistor_make_seq : thermistor_make_seq<N - 1, N - 1, I...> {};
+template<int... I> struct thermistor_make_seq<0, I...> { typedef thermistor_seq<I...> type; };
+
+#define THERMISTOR_FRACTION_BITS 20
+
+// not constexpr: a table it is called for fails to compile
+int thermistor_table_out_of_range();
+
+// celsius or a step of it that fits in the 12 integer bits
+constexpr int thermistor_fits(int celsius) {
+  return celsius > -(1 << (31 - THERMISTOR_FRACTION_BITS)) && celsius < (1 << (31 - THERMISTOR_FRACTION_BITS)) ? celsius : thermistor_table_out_of_range();
+}
+
+// n / d to the nearest, d > 0
+constexpr int32_t thermistor_div(int64_t n, int64_t d) {
+  return (int32_t)((n < 0 ? n - d / 2 : n + d / 2) / d);
+}
+
+template<typename T, uint8_t N>
+constexpr thermistor_segment_t thermistor_segment(const T (&tt)[N][2], int i) {
+  return { (uint16_t)tt[i][0], (int16_t)thermistor_fits(tt[i][1]),
+           i + 1 < N ? thermistor_div((int64_t)thermistor_fits(tt[i + 1][1] - tt[i][1]) * (1L << THERMISTOR_FRACTION_BITS), tt[i + 1][0] - tt[i][0]) : 0 };
+}
+
+template<typename T, uint8_t N, int... I>
+constexpr thermistor_lut_t<N> thermistor_lut(const T (&tt)[N][2], thermistor_seq<I...>) {
+  return { { thermistor_segment(tt, I)... } };
+}
+
+template<typename T, uint8_t N>
+constexpr thermistor_lut_t<N> thermistor_lut(const T (&tt)[N][2]) {
+  return thermistor_lut(tt, typename thermistor_make_seq<N>::type());
+}
+
+/**
+ * Celsius of the raw value, as the scan of the table interpolated it: from
+ * the segment before the first entry above raw (the first segment, if raw
+ * is below the table), the last celsius if no entry is above it
+ */
+FORCE_INLINE float thermistor_celsius(const thermistor_segment_t *tt, uint8_t len, int raw) {
+  uint8_t lo = 1, hi = len;
+  while (lo < hi) {
+    const uint8_t mid = (lo + hi) >> 1;
+    if (tt[mid].raw > raw) hi = mid; else lo = mid + 1;
+  }
+  if (lo == len) return tt[len - 1].celsius;
+  const thermistor_segment_t &s = tt[lo - 1];
+  return ((int32_t)s.celsius * (1L << THERMISTOR_FRACTION_BITS) + (raw - s.raw) * s.slope) * (1.0f / (1L << THERMISTOR_FRACTION_BITS));
+}
+
+#endif // THERMISTOR_LUT_H
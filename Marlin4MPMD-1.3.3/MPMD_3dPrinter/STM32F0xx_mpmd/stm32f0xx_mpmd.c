@@ -142,6 +142,10 @@ static uint8_t SPIx_WriteRead(uint8_t Value);
 static void SPIx_WriteReadData(const uint8_t *DataIn, uint8_t *DataOut, uint16_t DataLegnth);
 static void SPIx_FlushFifo(void);
 static void SPIx_Error(void);
+#ifdef USE_SPI_DMA
+static void SPIx_ReadData_DMA(uint8_t *DataOut, uint16_t DataLength);
+static void SPIx_WaitData_DMA(void);
+#endif
 static void SPIx_MspInit(SPI_HandleTypeDef *hspi);
 
 /* SD IO functions */
@@ -352,6 +356,9 @@ static void SPIx_MspInit(SPI_HandleTypeDef *hspi)
   /*** Configure the SPI peripheral ***/
   /* Enable SPI clock */
   NUCLEO_SPIx_CLK_ENABLE();
+#ifdef USE_SPI_DMA
+  NUCLEO_SPIx_DMA_CLK_ENABLE();
+#endif
 
   /*** Configure the GPIOs ***/
   /* Enable GPIO clock */
@@ -588,6 +595,60 @@ static void SPIx_ReadData(uint8_t *DataOut, uint16_t DataLength) {
 #endif
 }
 
+#ifdef USE_SPI_DMA
+/**
+ * @brief  Starts reading from the device by DMA, the Tx channel clocks out
+ *         SD_DUMMY_BYTE for each byte. It returns at once, nothing else may
+ *         use the bus until SPIx_WaitData_DMA().
+ * @param  DataOut: value to read
+ * @param  DataLength: length of data
+ */
+static void SPIx_ReadData_DMA(uint8_t *DataOut, uint16_t DataLength)
+{
+	static const uint8_t dummy = SD_DUMMY_BYTE;
+	SPI_TypeDef *spi = hnucleo_Spi.Instance;
+
+	/* Set the Rx Fifo threshold, a DMA request for each byte */
+	SET_BIT(spi->CR2, SPI_RXFIFO_THRESHOLD);
+	while (spi->SR & SPI_SR_RXNE) (void)*(__IO uint8_t *)&spi->DR;
+	DMA1->IFCR = NUCLEO_SPIx_DMA_FLAGS;
+
+	/* Rx first and ahead of Tx, so no byte is overrun */
+	NUCLEO_SPIx_RX_DMA_CHANNEL->CPAR = (uint32_t)&spi->DR;
+	NUCLEO_SPIx_RX_DMA_CHANNEL->CMAR = (uint32_t)DataOut;
+	NUCLEO_SPIx_RX_DMA_CHANNEL->CNDTR = DataLength;
+	NUCLEO_SPIx_RX_DMA_CHANNEL->CCR = DMA_CCR_PL_1 | DMA_CCR_MINC | DMA_CCR_EN;
+	SET_BIT(spi->CR2, SPI_CR2_RXDMAEN);
+
+	NUCLEO_SPIx_TX_DMA_CHANNEL->CPAR = (uint32_t)&spi->DR;
+	NUCLEO_SPIx_TX_DMA_CHANNEL->CMAR = (uint32_t)&dummy;
+	NUCLEO_SPIx_TX_DMA_CHANNEL->CNDTR = DataLength;
+	NUCLEO_SPIx_TX_DMA_CHANNEL->CCR = DMA_CCR_DIR | DMA_CCR_EN;
+	SET_BIT(spi->CR2, SPI_CR2_TXDMAEN);
+}
+
+/**
+ * @brief  Waits for the end of SPIx_ReadData_DMA()
+ */
+static void SPIx_WaitData_DMA(void)
+{
+	SPI_TypeDef *spi = hnucleo_Spi.Instance;
+	uint32_t tickstart = HAL_GetTick();
+	uint8_t timeout = 0;
+
+	while (NUCLEO_SPIx_RX_DMA_CHANNEL->CNDTR && !timeout)
+		timeout = HAL_GetTick() - tickstart > SpixTimeout;
+	CLEAR_BIT(spi->CR2, SPI_CR2_TXDMAEN | SPI_CR2_RXDMAEN);
+	NUCLEO_SPIx_RX_DMA_CHANNEL->CCR = 0;
+	NUCLEO_SPIx_TX_DMA_CHANNEL->CCR = 0;
+	if (timeout)
+	{
+		/* Execute user timeout callback */
+		SPIx_Error();
+	}
+}
+#endif /* USE_SPI_DMA */
+
 ///**
 //  * @brief  SPI Write a byte to device
 //  * @param  Value value to be written
@@ -759,6 +820,29 @@ void SD_IO_ReadData(uint8_t *DataOut, uint16_t DataLength)
 	SPIx_ReadData(DataOut,DataLength);
 }
 
+#ifdef USE_SPI_DMA
+/**
+  * @brief  Starts reading an amount of data from the SD by DMA, it goes on
+  *         in the background until SD_IO_WaitData_DMA().
+  * @param  DataOut buffer of the data read
+  * @param  DataLength number of bytes to read
+  * @retval none
+  */
+void SD_IO_ReadData_DMA(uint8_t *DataOut, uint16_t DataLength)
+{
+	SPIx_ReadData_DMA(DataOut,DataLength);
+}
+
+/**
+  * @brief  Waits for the end of SD_IO_ReadData_DMA().
+  * @retval none
+  */
+void SD_IO_WaitData_DMA(void)
+{
+	SPIx_WaitData_DMA();
+}
+#endif /* USE_SPI_DMA */
+
 /**
   * @brief  Write an amount of data on the SD.
   * @param  Data byte to send.
@@ -215,6 +215,12 @@ typedef enum
 #define NUCLEO_SPIx_MISO_MOSI_GPIO_CLK_DISABLE()        __HAL_RCC_GPIOB_CLK_DISABLE()
 #define NUCLEO_SPIx_MISO_PIN                            GPIO_PIN_4
 #define NUCLEO_SPIx_MOSI_PIN                            GPIO_PIN_5
+
+/* DMA of the SD block reads (USE_SPI_DMA), DMA1 channel 1 is the ADC's */
+#define NUCLEO_SPIx_DMA_CLK_ENABLE()                    __HAL_RCC_DMA1_CLK_ENABLE()
+#define NUCLEO_SPIx_RX_DMA_CHANNEL                      DMA1_Channel2
+#define NUCLEO_SPIx_TX_DMA_CHANNEL                      DMA1_Channel3
+#define NUCLEO_SPIx_DMA_FLAGS                           (DMA_IFCR_CGIF2 | DMA_IFCR_CGIF3)
 /* Maximum Timeout values for flags waiting loops. These timeouts are not based
    on accurate values, they just guarantee that the application will not remain
    stuck if the SPI communication is corrupted.
@@ -130,6 +130,8 @@ typedef struct {
 
 #define SD_MAX_TRY                100    /* Number of try */
 
+#define SD_WRITE_TIMEOUT          500    /* ms the card may stay busy with a block written */
+
 #define SD_CSD_STRUCT_V1          0x2    /* CSD struct version V1 */
 #define SD_CSD_STRUCT_V2          0x1    /* CSD struct version V2 */
 
@@ -242,6 +244,15 @@ __IO uint8_t SdStatus = SD_NOT_PRESENT;
 */
 uint16_t flag_SDHC = 0;
 
+/* Block length set with CMD16 (SD_CMD_SET_BLOCKLEN), it holds until the
+   card is initialized again, 0: not set */
+static uint16_t BlockLength = 0;
+
+/* A block written, the card may still be busy programming it: the busy is
+   waited out before the next command instead of after the write, so that
+   the caller gets on with its work in the meantime */
+static uint8_t WritePending = 0;
+
 /**
 * @}
 */
@@ -257,6 +268,10 @@ static uint8_t SD_GoIdleState(void);
 static SD_CmdAnswer_typedef SD_SendCmd(uint8_t Cmd, uint32_t Arg, uint8_t Crc, uint8_t Answer);
 static uint8_t SD_WaitData(uint8_t data);
 static uint8_t SD_ReadData(void);
+static uint8_t SD_WaitDataToken(void);
+static uint8_t SD_SetBlockLength(uint16_t BlockSize);
+static uint8_t SD_StopTransmission(void);
+static uint8_t SD_WaitWriteDone(void);
 /**
 * @}
 */
@@ -288,6 +303,8 @@ uint8_t BSP_SD_Init(void)
   {
     SdStatus = SD_PRESENT;
   }
+  BlockLength = 0;
+  WritePending = 0;
 
   /* SD initialized and set to SPI mode properly */
   return (SD_GoIdleState());
@@ -346,6 +363,7 @@ uint8_t BSP_SD_GetCardInfo(SD_CardInfo *pCardInfo)
 
 /**
   * @brief  Reads block(s) from a specified address in the SD card, in polling mode.
+  *         One block is read with CMD17, more with one CMD18 ended by CMD12.
   * @param  pData Pointer to the buffer that will contain the data to transmit
   * @param  ReadAddr Address from where data is to be read
   * @param  BlockSize SD card data block size, that should be 512
@@ -356,32 +374,31 @@ uint8_t BSP_SD_ReadBlocks(uint32_t* pData, uint32_t ReadAddr, uint16_t BlockSize
 {
   uint32_t offset = 0;
   uint8_t retr = BSP_SD_ERROR;
+  uint8_t multiple = 0;
   SD_CmdAnswer_typedef response;
 
-  /* Send CMD16 (SD_CMD_SET_BLOCKLEN) to set the size of the block and
-     Check if the SD acknowledged the set block length command: R1 response (0x00: no errors) */
-  response = SD_SendCmd(SD_CMD_SET_BLOCKLEN, BlockSize, 0xFF, SD_ANSWER_R1_EXPECTED);
-  SD_IO_CSState(1);
-  SD_IO_WriteDummy();
+  if (SD_SetBlockLength(BlockSize) != BSP_SD_OK)
+  {
+    goto error;
+  }
+
+  /* Send CMD17 (SD_CMD_READ_SINGLE_BLOCK) to read one block or CMD18
+     (SD_CMD_READ_MULT_BLOCK) to read the blocks one after the other */
+  /* Check if the SD acknowledged the read block command: R1 response (0x00: no errors) */
+  response = SD_SendCmd(NumberOfBlocks > 1 ? SD_CMD_READ_MULT_BLOCK : SD_CMD_READ_SINGLE_BLOCK,
+                        ReadAddr/(flag_SDHC == 1 ?BlockSize: 1), 0xFF, SD_ANSWER_R1_EXPECTED);
   if ( response.r1 != SD_R1_NO_ERROR)
   {
-     goto error;
+    goto error;
   }
+  multiple = NumberOfBlocks > 1;
 
   /* Data transfer */
   while (NumberOfBlocks--)
   {
-
-    /* Send CMD17 (SD_CMD_READ_SINGLE_BLOCK) to read one block */
-    /* Check if the SD acknowledged the read block command: R1 response (0x00: no errors) */
-    response = SD_SendCmd(SD_CMD_READ_SINGLE_BLOCK, (ReadAddr + offset)/(flag_SDHC == 1 ?BlockSize: 1), 0xFF, SD_ANSWER_R1_EXPECTED);
-    if ( response.r1 != SD_R1_NO_ERROR)
-    {
-      goto error;
-    }
-
-    /* Now look for the data token to signify the start of the data */
-    if (SD_WaitData(SD_TOKEN_START_DATA_SINGLE_BLOCK_READ) == BSP_SD_OK)
+    /* Now look for the data token to signify the start of the data,
+       the same token starts each block of a multiple block read */
+    if (SD_WaitDataToken() == BSP_SD_OK)
     {
       /* Read the SD block data : read NumByteToRead data */
       SD_IO_ReadData((uint8_t*)pData + offset, BlockSize);
@@ -396,15 +413,17 @@ uint8_t BSP_SD_ReadBlocks(uint32_t* pData, uint32_t ReadAddr, uint16_t BlockSize
     {
       goto error;
     }
-
-    /* End the command data read cycle */
-    SD_IO_CSState(1);
-    SD_IO_WriteDummy();
   }
 
   retr = BSP_SD_OK;
 
 error :
+  /* End a multiple block read, also when it failed part way */
+  if (multiple && SD_StopTransmission() != BSP_SD_OK)
+  {
+    retr = BSP_SD_ERROR;
+  }
+
   /* Send dummy byte: 8 Clock pulses of delay */
   SD_IO_CSState(1);
   SD_IO_WriteDummy();
@@ -413,6 +432,85 @@ error :
   return retr;
 }
 
+#ifdef USE_SPI_DMA
+/**
+  * @brief  Starts a multiple block read (CMD18) at ReadAddr, for the blocks
+  *         to be read one at a time by BSP_SD_ReadBlock_DMA(). The card
+  *         holds each block until it is clocked out, the read goes on until
+  *         BSP_SD_StopReadBlocks(); no other command may be sent meanwhile.
+  * @param  ReadAddr Address from where data is to be read
+  * @param  BlockSize SD card data block size, that should be 512
+  * @retval SD status
+  */
+uint8_t BSP_SD_StartReadBlocks(uint32_t ReadAddr, uint16_t BlockSize)
+{
+  SD_CmdAnswer_typedef response;
+
+  if (SD_SetBlockLength(BlockSize) == BSP_SD_OK)
+  {
+    /* Send CMD18 (SD_CMD_READ_MULT_BLOCK) to read the blocks one after the other */
+    response = SD_SendCmd(SD_CMD_READ_MULT_BLOCK, ReadAddr/(flag_SDHC == 1 ?BlockSize: 1), 0xFF, SD_ANSWER_R1_EXPECTED);
+    if (response.r1 == SD_R1_NO_ERROR)
+    {
+      return BSP_SD_OK;
+    }
+  }
+
+  SD_IO_CSState(1);
+  SD_IO_WriteDummy();
+  return BSP_SD_ERROR;
+}
+
+/**
+  * @brief  Starts reading the next block of BSP_SD_StartReadBlocks() by DMA,
+  *         it waits for the data token and returns as the data starts to
+  *         come in. pData is the DMA's until BSP_SD_WaitReadBlock().
+  * @param  pData Pointer to the buffer that will contain the data
+  * @param  BlockSize SD card data block size, that should be 512
+  * @retval SD status
+  */
+uint8_t BSP_SD_ReadBlock_DMA(uint32_t *pData, uint16_t BlockSize)
+{
+  if (SD_WaitDataToken() != BSP_SD_OK)
+  {
+    return BSP_SD_ERROR;
+  }
+  SD_IO_ReadData_DMA((uint8_t*)pData, BlockSize);
+
+  return BSP_SD_OK;
+}
+
+/**
+  * @brief  Waits for the end of the block of BSP_SD_ReadBlock_DMA().
+  * @retval SD status
+  */
+uint8_t BSP_SD_WaitReadBlock(void)
+{
+  SD_IO_WaitData_DMA();
+  /* get CRC bytes (not really needed by us, but required by SD) */
+  SD_IO_WriteDummy();
+  SD_IO_WriteDummy();
+
+  return BSP_SD_OK;
+}
+
+/**
+  * @brief  Ends the read of BSP_SD_StartReadBlocks(), with no block of it
+  *         being read.
+  * @retval SD status
+  */
+uint8_t BSP_SD_StopReadBlocks(void)
+{
+  uint8_t retr = SD_StopTransmission();
+
+  /* Send dummy byte: 8 Clock pulses of delay */
+  SD_IO_CSState(1);
+  SD_IO_WriteDummy();
+
+  return retr;
+}
+#endif /* USE_SPI_DMA */
+
 /**
   * @brief  Writes block(s) to a specified address in the SD card, in polling mode.
   * @param  pData Pointer to the buffer that will contain the data to transmit
@@ -427,12 +525,7 @@ uint8_t BSP_SD_WriteBlocks(uint32_t* pData, uint32_t WriteAddr, uint16_t BlockSi
   uint8_t retr = BSP_SD_ERROR;
   SD_CmdAnswer_typedef response;
 
-  /* Send CMD16 (SD_CMD_SET_BLOCKLEN) to set the size of the block and
-     Check if the SD acknowledged the set block length command: R1 response (0x00: no errors) */
-  response = SD_SendCmd(SD_CMD_SET_BLOCKLEN, BlockSize, 0xFF, SD_ANSWER_R1_EXPECTED);
-  SD_IO_CSState(1);
-  SD_IO_WriteDummy();
-  if ( response.r1 != SD_R1_NO_ERROR)
+  if (SD_SetBlockLength(BlockSize) != BSP_SD_OK)
   {
     goto error;
   }
@@ -486,6 +579,27 @@ error :
   return retr;
 }
 
+/**
+  * @brief  Waits until the card has programmed the last block written, the
+  *         blocks of BSP_SD_WriteBlocks() are only sure to be on the card
+  *         after it (or after the next command).
+  * @retval SD status
+  */
+uint8_t BSP_SD_WaitWriteDone(void)
+{
+  uint8_t retr;
+
+  if (!WritePending)
+  {
+    return BSP_SD_OK;
+  }
+  SD_IO_CSState(0);
+  retr = SD_WaitWriteDone();
+  SD_IO_CSState(1);
+  SD_IO_WriteDummy();
+  return retr;
+}
+
 /**
   * @brief  Erases the specified memory area of the given SD card.
   * @param  StartAddr Start byte address
@@ -778,6 +892,7 @@ SD_CmdAnswer_typedef SD_SendCmd(uint8_t Cmd, uint32_t Arg, uint8_t Crc, uint8_t
 
   /* Send the command */
   SD_IO_CSState(0);
+  SD_WaitWriteDone();
 //  HAL_Delay(10);
   SD_IO_WriteReadData(frame, frameout, SD_CMD_LENGTH); /* Send the Cmd bytes */
   uint8_t failure=1;
@@ -830,7 +945,8 @@ SD_CmdAnswer_typedef SD_SendCmd(uint8_t Cmd, uint32_t Arg, uint8_t Crc, uint8_t
 }
 
 /**
-  * @brief  Gets the SD card data response and check the busy flag.
+  * @brief  Gets the SD card data response. The busy that follows a block
+  *         accepted is left to the next command (SD_WaitWriteDone()).
   * @retval The SD status: Read data response xxx0<status>1
   *         - status 010: Data accecpted
   *         - status 101: Data rejected due to a crc error
@@ -851,13 +967,8 @@ uint8_t SD_GetDataResponse(void)
   case SD_DATA_OK:
     rvalue = SD_DATA_OK;
 
-    /* Set CS High */
-    SD_IO_CSState(1);
-    /* Set CS Low */
-    SD_IO_CSState(0);
-
-    /* Wait IO line return 0xFF */
-    while (SD_IO_WriteReadDummy() != 0xFF);
+    /* The busy is waited out by the next command, see SD_WaitWriteDone() */
+    WritePending = 1;
     break;
   case SD_DATA_CRC_ERROR:
     rvalue =  SD_DATA_CRC_ERROR;
@@ -975,6 +1086,112 @@ uint8_t SD_GoIdleState(void)
   return BSP_SD_OK;
 }
 
+/**
+  * @brief  Waits the data token that starts a block read, or a data error
+  *         token (0b000xxxxx) in its place: a multiple block read running
+  *         past the end of the card gets one, there is no point waiting on.
+  * @retval BSP_SD_OK, BSP_SD_ERROR or BSP_SD_TIMEOUT
+  */
+uint8_t SD_WaitDataToken(void)
+{
+  uint16_t timeout = 0xFFFF;
+  uint8_t readvalue;
+
+  do {
+    readvalue = SD_IO_WriteReadDummy();
+    timeout--;
+  }while ((readvalue != SD_TOKEN_START_DATA_MULTIPLE_BLOCK_READ) && (readvalue == 0 || (readvalue & 0xE0)) && timeout);
+
+  if (readvalue == SD_TOKEN_START_DATA_MULTIPLE_BLOCK_READ)
+  {
+    return BSP_SD_OK;
+  }
+
+  return timeout ? BSP_SD_ERROR : BSP_SD_TIMEOUT;
+}
+
+/**
+  * @brief  Sets the block length with CMD16 (SD_CMD_SET_BLOCKLEN), unless it
+  *         is already set to BlockSize.
+  * @param  BlockSize SD card data block size, that should be 512
+  * @retval SD status
+  */
+uint8_t SD_SetBlockLength(uint16_t BlockSize)
+{
+  SD_CmdAnswer_typedef response;
+
+  if (BlockLength == BlockSize)
+  {
+    return BSP_SD_OK;
+  }
+
+  /* Send CMD16 (SD_CMD_SET_BLOCKLEN) to set the size of the block and
+     Check if the SD acknowledged the set block length command: R1 response (0x00: no errors) */
+  response = SD_SendCmd(SD_CMD_SET_BLOCKLEN, BlockSize, 0xFF, SD_ANSWER_R1_EXPECTED);
+  SD_IO_CSState(1);
+  SD_IO_WriteDummy();
+  if (response.r1 != SD_R1_NO_ERROR)
+  {
+    BlockLength = 0;
+    return BSP_SD_ERROR;
+  }
+  BlockLength = BlockSize;
+
+  return BSP_SD_OK;
+}
+
+/**
+  * @brief  Ends a multiple block read with CMD12 (SD_CMD_STOP_TRANSMISSION).
+  *         The card is still sending data as the command goes out, so what
+  *         comes back with it is not looked at (SD_SendCmd() would take
+  *         a run of zeros for a failure), and the byte after it is a stuff
+  *         byte. The R1b busy is waited out with a timeout.
+  * @retval SD status
+  */
+uint8_t SD_StopTransmission(void)
+{
+  uint8_t frame[SD_CMD_LENGTH] = { SD_CMD_STOP_TRANSMISSION | 0x40, 0, 0, 0, 0, 0xFF };
+  uint8_t frameout[SD_CMD_LENGTH];
+  uint8_t r1;
+
+  SD_IO_WriteReadData(frame, frameout, SD_CMD_LENGTH);
+  /* Skip the stuff byte */
+  SD_IO_WriteDummy();
+  r1 = SD_ReadData();
+
+  /* Wait IO line return 0xFF */
+  if (SD_WaitData(SD_DUMMY_BYTE) != BSP_SD_OK || r1 != SD_R1_NO_ERROR)
+  {
+    return BSP_SD_ERROR;
+  }
+
+  return BSP_SD_OK;
+}
+
+/**
+  * @brief  With the card selected, waits until it has programmed the last
+  *         block written (the IO line returns 0xFF), if it hasn't yet.
+  * @retval BSP_SD_OK or BSP_SD_TIMEOUT
+  */
+uint8_t SD_WaitWriteDone(void)
+{
+  uint32_t start = HAL_GetTick();
+
+  while (WritePending)
+  {
+    if (SD_IO_WriteReadDummy() == SD_DUMMY_BYTE)
+    {
+      WritePending = 0;
+    }
+    else if (HAL_GetTick() - start > SD_WRITE_TIMEOUT)
+    {
+      WritePending = 0;
+      return BSP_SD_TIMEOUT;
+    }
+  }
+  return BSP_SD_OK;
+}
+
 /**
   * @brief  Waits a data until a value different from SD_DUMMY_BITE
   * @retval the value read
@@ -207,9 +207,16 @@ uint8_t BSP_SD_Init(void);
 uint8_t BSP_SD_IsDetected(void);
 uint8_t BSP_SD_ReadBlocks(uint32_t *pData, uint32_t ReadAddr, uint16_t BlockSize, uint32_t NumberOfBlocks);
 uint8_t BSP_SD_WriteBlocks(uint32_t *pData, uint32_t WriteAddr, uint16_t BlockSize, uint32_t NumberOfBlocks);
+uint8_t BSP_SD_WaitWriteDone(void);
 uint8_t BSP_SD_Erase(uint32_t StartAddr, uint32_t EndAddr);
 uint8_t BSP_SD_GetStatus(void);
 uint8_t BSP_SD_GetCardInfo(SD_CardInfo *pCardInfo);
+#ifdef USE_SPI_DMA
+uint8_t BSP_SD_StartReadBlocks(uint32_t ReadAddr, uint16_t BlockSize);
+uint8_t BSP_SD_ReadBlock_DMA(uint32_t *pData, uint16_t BlockSize);
+uint8_t BSP_SD_WaitReadBlock(void);
+uint8_t BSP_SD_StopReadBlocks(void);
+#endif
    
 /* Link functions for SD Card peripheral */
 void    SD_IO_Init(void);
@@ -219,11 +226,17 @@ void    SD_IO_ReadData(uint8_t *DataOut, uint16_t DataLength);
 void    SD_IO_WriteData(const uint8_t *Data, uint16_t DataLength);
 void	SD_IO_WriteByte(uint8_t Data);
 uint8_t SD_IO_WriteReadByte(uint8_t Data);
+#ifdef USE_SPI_DMA
+void    SD_IO_ReadData_DMA(uint8_t *DataOut, uint16_t DataLength);
+void    SD_IO_WaitData_DMA(void);
+#endif
 extern const uint32_t SpixTimeout; /*<! Value of Timeout when SPI communication fails */
 
+/* The host simulator (make sim) has no SPI registers, it takes the dummies
+   through the link functions */
 static __INLINE void SD_IO_WriteDummy(){
 	extern SPI_HandleTypeDef hnucleo_Spi;
-#ifdef USE_FAST_SPI
+#if defined(USE_FAST_SPI) && !defined(MPMD_SIM)
 	HAL_SPI_Transmit_Dummy(&hnucleo_Spi,SpixTimeout);
 #else
 	SD_IO_WriteByte(SD_DUMMY_BYTE);
@@ -233,7 +246,7 @@ static __INLINE void SD_IO_WriteDummy(){
 static __INLINE uint8_t SD_IO_WriteReadDummy(){
 	extern SPI_HandleTypeDef hnucleo_Spi;
 	uint8_t byte;
-#ifdef USE_FAST_SPI
+#if defined(USE_FAST_SPI) && !defined(MPMD_SIM)
 	HAL_SPI_TransmitReceive_Dummy(&hnucleo_Spi,&byte,SpixTimeout);
 #else
 	byte = SD_IO_WriteReadByte(SD_DUMMY_BYTE);
@@ -36,12 +36,57 @@
 #define MALYAN_LCD
 #define STEPPERS_16X
 //#define STEPPERS_32X
-//Experimental, includes UZLIB for zlib compression support
+//Experimental, includes UZLIB for zlib compression support. .gcode.gz and .bgc.gz
+//files are inflated while printing; they must be deflated with a window of at
+//most 512 bytes (GZSTREAM_DICT_SIZE, e.g. zlib wbits=9)
 //#define UZLIB
+//Experimental, binary gcode motion commands are queued already decoded and
+//dispatched without the round trip through ASCII
+#define BINGCODE_DIRECT
+//Experimental, delta inverse kinematics and bed level grid interpolation in Q16.16
+//fixed point instead of soft-float, see delta_fixed.h; comment out for the float version
+#define DELTA_FIXED_POINT
+//With DELTA_FIXED_POINT, most carriage heights of the segments of a delta move are
+//stepped by forward differences between exact solutions, at most this far (mm) off
+//the exact heights; 0 solves every segment
+#ifndef DELTA_SEGMENT_TOLERANCE
+#define DELTA_SEGMENT_TOLERANCE 0.002
+#endif
+//Experimental, the heater and bed PID in Q16.16 fixed point instead of soft-float,
+//see pid_fixed.h. Only run against the simulator's thermal model so far (make sim
+//builds with it), where its duty differs from the float loop's by a count now and then
+//#define PID_FIXED_POINT
+//Drives the part fan from TIM1 channel 1 on its pin (PA8), 255 steps at BSP_FAN_PWM_FREQ,
+//instead of toggling the pin from the SysTick interrupt (13 steps at 75Hz)
+#define FAN_TIMER_PWM
+//Experimental, the middle of each block is stepped by DMA: the stepper interrupt fills
+//circular buffers of frames (step pins and Tick timer periods) that DMA1 channels 4 and 5
+//play out on TIM3 updates, the towers through TIM15 and GPIOB->BSRR, E on TIM3 channel 2
+//(PA7); a refill every BSP_STEP_BURST_FRAMES/2 steps instead of an interrupt per step.
+//Only run against the simulator's model of the DMA so far (make sim builds with it)
+//#define STEP_BURST
 //Experimental, uses optimized SPI library for faster SD transfers
 #define USE_FAST_SPI
+//Experimental, reads the sectors of a file read one after the other by DMA (SPI1 on DMA1
+//channels 2 and 3), the next one while the last is worked on, see sd_diskio.c; 1 KB of
+//RAM for its double buffer, on top of CardReader's ring. Only run against the mock
+//card of sim/benchsdread so far (make sim builds with it)
+//#define USE_SPI_DMA
+//Keeps a journal of the SD print on the card (_RESUME.JNL, see print_journal.h): the file
+//offset and the state of a command on each layer and every few cm of moves, in a file made
+//once, for M1000 to take the print up again after a power loss
+#define POWER_LOSS_JOURNAL
+//Indexes the working directory (sd_dirindex.h) when the LCD or M23 first look a file up in
+//it, instead of reading it up to the file each time; 572 bytes of RAM for 128 files
+#define SD_DIR_INDEX
 //Experimental, uses fastest possible SPI clock for faster SD transfers, requires removing MISO pulldown
 //#define USE_FAST_SPI_CLK
+//Debug, records the step timeline of the stepper interrupt (steps, directions and
+//timer periods) in a ring buffer of STEPPER_TRACE_SIZE events (8 bytes each), see M930
+//#define STEPPER_TRACE
+#ifndef STEPPER_TRACE_SIZE
+#define STEPPER_TRACE_SIZE 128
+#endif
 /* Exported functions ------------------------------------------------------- */
 /* Exported Variables --------------------------------------------------------*/
 
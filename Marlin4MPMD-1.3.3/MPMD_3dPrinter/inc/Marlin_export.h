@@ -47,6 +47,7 @@
 void setup(void);
 void loop(void);
 void IsrStepperHandler(void);
+void IsrStepBurstHandler(void);
 void IsrTemperatureHandler(void);
 void TimerStService(void);
 
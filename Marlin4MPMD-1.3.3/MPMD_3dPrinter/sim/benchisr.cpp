@@ -0,0 +1,301 @@
+/**
+  ******************************************************************************
+  * @file    sim/benchisr.cpp
+  * @brief   Interrupt load model of the Cortex-M0: the stepper interrupt of a
+  *          step trace against the temperature and SysTick interrupts, with
+  *          the part fan bit-banged by the SysTick (HAL_SYSTICK_Callback())
+  *          and driven by a timer channel (FAN_TIMER_PWM)
+  * @note    build: make sim
+  *          usage: build_sim/benchisr [-s cycles] [-e cycles] [-t cycles]
+  *                     [-k cycles] [-f cycles] [-p priority] [-d duty] trace
+  *            trace  a marlin_sim -T file
+  *            -s  stepper interrupt, cycles (default 600)
+  *            -e  more cycles for each step it outputs (default 80)
+  *            -t  temperature interrupt, cycles (default 450)
+  *            -k  SysTick, cycles without the fan: HAL_IncTick() and the
+  *                watchdog refresh (default 50)
+  *            -f  more SysTick cycles at an edge of the bit-banged fan, a
+  *                HAL_GPIO_WritePin() and the count reloaded (default 45);
+  *                every other tick with the fan on costs FAN_COUNT_CYCLES
+  *            -p  SysTick priority (default 3, TICK_INT_PRIORITY, the
+  *                lowest; the stepper is 1 and the temperature 0)
+  *            -d  fan speed, 50 to 254 (default 128)
+  *          The stepper interrupts come when the trace has them, the
+  *          temperature interrupt (TIM14) and the SysTick every 1ms. Each
+  *          handler takes its cycles at 48MHz plus the 16 of exception
+  *          entry; a pending interrupt starts when nothing of the same or a
+  *          higher priority (a lower number) runs, and preempts anything of
+  *          a lower one, as the NVIC does. "latency" is from when the
+  *          interrupt was due to when its handler started, "load" the share
+  *          of the CPU the handlers take from the main loop, "fan late" how
+  *          far after its tick each bit-banged edge of the fan is (a timer
+  *          channel's edges are on time). The cycle counts are estimates of
+  *          the handlers' Thumb code, for what-ifs set them with the options.
+  ******************************************************************************
+  */
+
+#include <unistd.h>
+#include <vector>
+
+#include "sim.h"
+#include "stepper_trace.h"
+
+/* Private Constants ---------------------------------------------------------*/
+
+#define CPU_FREQ          (CORE_CPU_FREQ)
+#define ENTRY_CYCLES      (16)
+#define MS_CYCLES         (CPU_FREQ / 1000)
+// a tick of the bit-banged fan without an edge: the activePwm test and count--
+#define FAN_COUNT_CYCLES  (15)
+// as stm32f0xx_3dprinter_misc.c
+#define FAN_PWM_COUNTS    ((uint8_t)(1000 / BSP_FAN_PWM_FREQ))
+// the temperature interrupt, this far into each ms of the SysTick
+#define TEMPERATURE_PHASE (MS_CYCLES / 4)
+#define NEVER             (UINT64_MAX)
+
+enum { IRQ_TEMPERATURE, IRQ_STEPPER, IRQ_SYSTICK, IRQS };
+
+/* Private Types -------------------------------------------------------------*/
+
+typedef struct {
+	const char *name;
+	uint8_t priority;
+	uint64_t due;           // next time it comes, in cycles
+	bool pending;
+	uint64_t since;         // when the pending one was due
+	uint32_t cost;          // cycles of the pending one
+	uint64_t runs, cycles, lost;
+	std::vector<uint32_t> latency;   // runs by latency in cycles
+} Irq;
+
+typedef struct {
+	uint8_t irq;
+	uint32_t remaining;
+	uint64_t due;           // of this run
+	bool edge;              // a SysTick that toggles the fan
+} Handler;
+
+typedef struct {
+	double stepperMean, stepperP99, stepperMax;   // latency, us
+	double load[IRQS];                            // %
+	double fanP99, fanMax;                        // fan edges late, us
+	uint64_t edges;
+} Result;
+
+/* Private Variables ---------------------------------------------------------*/
+
+static uint32_t stepperCycles = 600, stepCycles = 80, temperatureCycles = 450;
+static uint32_t sysTickCycles = 50, fanEdgeCycles = 45;
+static uint8_t sysTickPriority = 3, fanSpeed = 128;
+
+static FILE *traceFile;
+static uint32_t traceRate;
+
+/* Private Functions ---------------------------------------------------------*/
+
+static bool open_trace(const char *name)
+{
+	char magic[4];
+	traceFile = fopen(name, "rb");
+	return traceFile && fread(magic, 1, 4, traceFile) == 4 && !memcmp(magic, SIM_TRACE_MAGIC, 4)
+	    && fread(&traceRate, sizeof(traceRate), 1, traceFile) == 1 && traceRate;
+}
+
+// The next stepper interrupt of the trace: when it was due (cycles) and its
+// cost, false at the end
+static bool next_stepper(uint64_t &ticks, bool first, uint64_t &due, uint32_t &cost)
+{
+	static uint16_t last;
+	stepper_trace_t e;
+	if (fread(&e, sizeof(e), 1, traceFile) != 1) return false;
+	if (!first) ticks += (uint16_t)(e.time - last);
+	last = e.time;
+	due = ticks * CPU_FREQ / traceRate;
+	uint8_t steps = 0;
+	for (int axis = 0; axis < SIM_AXES; axis++) steps += (e.steps >> (axis * 4)) & 0xF;
+	cost = stepperCycles + steps * stepCycles;
+	return true;
+}
+
+// The latency below which a share of the runs are
+static double percentile(const std::vector<uint32_t> &latency, uint64_t runs, double share)
+{
+	uint64_t n = 0;
+	for (uint32_t i = 0; i < latency.size(); i++) {
+		n += latency[i];
+		if (n >= share * runs) return i;
+	}
+	return latency.size();
+}
+
+static void count(std::vector<uint32_t> &histogram, uint64_t value)
+{
+	if (value >= histogram.size()) histogram.resize(value + 1);
+	histogram[value]++;
+}
+
+/**
+ * The trace with the fan bit-banged by the SysTick (timer false) or driven
+ * by a timer channel
+ */
+static Result run(bool timer)
+{
+	Irq irq[IRQS] = {
+		{ "temperature", 0, TEMPERATURE_PHASE },
+		{ "stepper", 1, NEVER },
+		{ "SysTick", sysTickPriority, MS_CYCLES },
+	};
+	std::vector<Handler> stack;
+	std::vector<uint32_t> fanLate;
+	uint64_t now = 0, ticks = 0, stepperDue;
+	uint32_t stepperCost;
+
+	// the fan as HAL_SYSTICK_Callback() counts it
+	const uint8_t up = fanSpeed * FAN_PWM_COUNTS / 255;
+	uint8_t fanCount = up, fanLevel = 1;
+	bool fanEdge = false;
+
+	fseek(traceFile, 4 + sizeof(traceRate), SEEK_SET);
+	bool more = next_stepper(ticks, true, stepperDue, stepperCost);
+	irq[IRQ_STEPPER].due = more ? stepperDue : NEVER;
+
+	for (;;) {
+		uint64_t arrival = NEVER;
+		int next = -1;
+		for (int i = 0; i < IRQS; i++) {
+			if (irq[i].due < arrival) {
+				arrival = irq[i].due;
+				next = i;
+			}
+		}
+		if (!stack.empty() && now + stack.back().remaining <= arrival) {
+			// the running handler finishes first
+			const Handler done = stack.back();
+			now += done.remaining;
+			stack.pop_back();
+			if (done.edge) count(fanLate, now - done.due);
+		}
+		else {
+			if (next < 0) break;
+			if (!stack.empty()) stack.back().remaining -= arrival - now;
+			now = arrival;
+			Irq &q = irq[next];
+			if (q.pending)
+				q.lost++;
+			else {
+				q.pending = true;
+				q.since = arrival;
+			}
+			if (next == IRQ_STEPPER) {
+				q.cost = stepperCost;
+				more = more && next_stepper(ticks, false, stepperDue, stepperCost);
+				q.due = more ? stepperDue : NEVER;
+			}
+			else if (next == IRQ_TEMPERATURE) {
+				q.cost = temperatureCycles;
+				q.due += MS_CYCLES;
+				// nothing more once the trace is done
+				if (!more) q.due = NEVER;
+			}
+			else {
+				q.cost = sysTickCycles;
+				fanEdge = false;
+				if (!timer) {
+					q.cost += FAN_COUNT_CYCLES;
+					if (!--fanCount) {
+						fanEdge = true;
+						q.cost += fanEdgeCycles;
+						fanCount = fanLevel ? FAN_PWM_COUNTS - up : up;
+						fanLevel = !fanLevel;
+					}
+				}
+				q.due += MS_CYCLES;
+				if (!more) q.due = NEVER;
+			}
+		}
+
+		// start the pending interrupts that may
+		for (;;) {
+			const uint8_t current = stack.empty() ? 0xFF : irq[stack.back().irq].priority;
+			int start = -1;
+			for (int i = 0; i < IRQS; i++) {
+				if (irq[i].pending && irq[i].priority < current && (start < 0 || irq[i].priority < irq[start].priority))
+					start = i;
+			}
+			if (start < 0) break;
+			Irq &q = irq[start];
+			q.pending = false;
+			q.runs++;
+			q.cycles += q.cost + ENTRY_CYCLES;
+			count(q.latency, now - q.since);
+			const Handler r = { (uint8_t)start, q.cost + ENTRY_CYCLES, q.since, start == IRQ_SYSTICK && fanEdge };
+			stack.push_back(r);
+		}
+	}
+
+	Result result;
+	const Irq &s = irq[IRQ_STEPPER];
+	uint64_t sum = 0;
+	for (uint32_t i = 0; i < s.latency.size(); i++) sum += (uint64_t)i * s.latency[i];
+	const double us = 1e6 / CPU_FREQ;
+	result.stepperMean = s.runs ? (double)sum / s.runs * us : 0;
+	result.stepperP99 = percentile(s.latency, s.runs, 0.99) * us;
+	result.stepperMax = s.latency.size() ? (s.latency.size() - 1) * us : 0;
+	for (int i = 0; i < IRQS; i++) {
+		result.load[i] = now ? 100.0 * irq[i].cycles / now : 0;
+		if (irq[i].lost) printf("lost         %llu %s interrupts, still pending when the next came\n", (unsigned long long)irq[i].lost, irq[i].name);
+	}
+	result.edges = 0;
+	for (uint32_t i = 0; i < fanLate.size(); i++) result.edges += fanLate[i];
+	result.fanP99 = result.edges ? percentile(fanLate, result.edges, 0.99) * us : 0;
+	result.fanMax = fanLate.size() ? (fanLate.size() - 1) * us : 0;
+	if (!timer && !result.edges) printf("note         no fan edges at speed %u\n", fanSpeed);
+	return result;
+}
+
+/* Exported Functions --------------------------------------------------------*/
+
+int main(int argc, char **argv)
+{
+	int opt;
+	while ((opt = getopt(argc, argv, "s:e:t:k:f:p:d:")) != -1) {
+		switch (opt) {
+		case 's': stepperCycles = atol(optarg); break;
+		case 'e': stepCycles = atol(optarg); break;
+		case 't': temperatureCycles = atol(optarg); break;
+		case 'k': sysTickCycles = atol(optarg); break;
+		case 'f': fanEdgeCycles = atol(optarg); break;
+		case 'p': sysTickPriority = atoi(optarg); break;
+		case 'd': fanSpeed = atoi(optarg); break;
+		default: optind = argc; break;
+		}
+	}
+	if (optind != argc - 1 || sysTickPriority > 3 || fanSpeed < 50 || fanSpeed > 254) {
+		fprintf(stderr, "usage: %s [-s cycles] [-e cycles] [-t cycles] [-k cycles] [-f cycles] [-p priority] [-d duty] trace\n", argv[0]);
+		return 2;
+	}
+	if (!open_trace(argv[optind])) {
+		fprintf(stderr, "benchisr: no trace in %s\n", argv[optind]);
+		return 2;
+	}
+
+	printf("cycles       stepper %u + %u a step, temperature %u, SysTick %u, fan %u + %u an edge, entry %u\n",
+			(unsigned)stepperCycles, (unsigned)stepCycles, (unsigned)temperatureCycles, (unsigned)sysTickCycles,
+			(unsigned)FAN_COUNT_CYCLES, (unsigned)fanEdgeCycles, (unsigned)ENTRY_CYCLES);
+	printf("priorities   temperature 0, stepper 1, SysTick %u\n", (unsigned)sysTickPriority);
+	printf("fan          speed %u: bit-banged %u of %u ticks at %.0fHz, timer %u of 255 at %uHz\n", (unsigned)fanSpeed,
+			(unsigned)(fanSpeed * FAN_PWM_COUNTS / 255), (unsigned)FAN_PWM_COUNTS, 1000.0 / FAN_PWM_COUNTS, (unsigned)fanSpeed, (unsigned)BSP_FAN_PWM_FREQ);
+	printf("             stepper latency us      load %%                      fan late us\n");
+	printf("             mean    p99    max      stepper temp  SysTick       p99    max\n");
+	for (int timer = 0; timer < 2; timer++) {
+		const Result r = run(timer);
+		printf("%-12s %5.2f %6.2f %6.2f    %6.2f %6.2f %6.3f", timer ? "timer" : "bit-bang",
+				r.stepperMean, r.stepperP99, r.stepperMax, r.load[IRQ_STEPPER], r.load[IRQ_TEMPERATURE], r.load[IRQ_SYSTICK]);
+		if (timer)
+			printf("          -      -\n");
+		else
+			printf("    %6.2f %6.2f\n", r.fanP99, r.fanMax);
+	}
+	fclose(traceFile);
+	return 0;
+}
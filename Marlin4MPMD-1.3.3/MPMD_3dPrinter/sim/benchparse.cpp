@@ -0,0 +1,254 @@
+/**
+  ******************************************************************************
+  * @file    sim/benchparse.cpp
+  * @brief   Lines per second of the G-code parameter lookup, the strchr()
+  *          and strtod() code_seen()/code_value_float() against the table
+  *          of GCodeParams (Marlin/gcode_params.h)
+  * @note    build: make sim
+  *          usage: build_sim/benchparse file...
+  *            e.g. build_sim/benchparse Marlin4MPMD-1.3.3/SdCardContent/gcodes/*
+  *          The lines of the files are cleaned up as the firmware queues
+  *          and sanitizes them (comments, line numbers and checksums off)
+  *          and cut after the command code. First every letter A to Z of
+  *          every line is looked up both ways: seen, value, integer value
+  *          and code_has_value() must agree, to the bit, or it exits with
+  *          1. The letters are then added to the table again as a binary
+  *          command adds them, NAN for one without a number, which must
+  *          read the same, 0 and no value for it. Then each line is asked for X, Y, Z, E and F, what
+  *          gcode_get_destination() asks a G1 for, the old way and the new
+  *          (tokenize, then read the table). The fastest of RUNS counts.
+  *          The host has an FPU and a fast strtod(), on the printer
+  *          strtod() is a double precision soft-float library call; take
+  *          the rates as a floor of the difference. "scanned" counts the
+  *          characters the strchr()s go over (and strtod() reads) per line,
+  *          which is what the printer pays for either way.
+  ******************************************************************************
+  */
+
+#include <time.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#include "sim.h"
+#include "gcode_params.h"
+
+/* Private Constants ---------------------------------------------------------*/
+
+// the fastest of this many runs counts
+#define RUNS (5)
+
+/* Private Variables ---------------------------------------------------------*/
+
+// the arguments of each command, nul separated, and where each starts
+static std::vector<char> text;
+static std::vector<uint32_t> lines;
+
+static const char lookups[] = "XYZEF";
+// the values looked up go here, so they aren't optimized away
+static volatile float sink;
+
+/* Private Functions ---------------------------------------------------------*/
+
+static double host_seconds(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// get_sdcard_commands() and process_next_command() up to the arguments
+static void add_line(std::string line)
+{
+	size_t end = line.find(';');
+	if (end != std::string::npos) line.erase(end);
+	const char *c = line.c_str();
+	while (*c == ' ') c++;
+	if (*c == 'N' && NUMERIC_SIGNED(c[1])) {
+		c += 2;
+		while (NUMERIC(*c)) c++;
+		while (*c == ' ') c++;
+	}
+	std::string cmd(c);
+	end = cmd.find('*');
+	if (end != std::string::npos) cmd.erase(end);
+	while (!cmd.empty() && (cmd[cmd.size() - 1] == ' ' || cmd[cmd.size() - 1] == '\r')) cmd.erase(cmd.size() - 1);
+	c = cmd.c_str();
+	if (!*c++) return;
+	while (*c == ' ') c++;
+	if (!NUMERIC(*c)) return;
+	while (NUMERIC(*c)) c++;
+	while (*c == ' ') c++;
+	lines.push_back(text.size());
+	text.insert(text.end(), c, c + strlen(c) + 1);
+}
+
+static bool load(const char *name)
+{
+	FILE *f = fopen(name, "r");
+	if (!f) return false;
+	char buf[1024];
+	while (fgets(buf, sizeof(buf), f)) {
+		buf[strcspn(buf, "\n")] = 0;
+		add_line(buf);
+	}
+	fclose(f);
+	return true;
+}
+
+// code_seen() and the code_value_*() as they were
+static char *old_seen(char *args, char code) { return strchr(args, code); }
+
+static float old_value_float(char *seen)
+{
+	float ret;
+	char *e = strchr(seen, 'E');
+	if (e) {
+		*e = 0;
+		ret = strtod(seen + 1, NULL);
+		*e = 'E';
+	}
+	else
+		ret = strtod(seen + 1, NULL);
+	return ret;
+}
+
+static bool old_has_value(const char *seen)
+{
+	int i = 1;
+	char c = seen[i];
+	while (c == ' ') c = seen[++i];
+	if (c == '-' || c == '+') c = seen[++i];
+	if (c == '.') c = seen[++i];
+	return NUMERIC(c);
+}
+
+// characters the old lookups of a line go over
+static uint32_t old_scanned(char *args)
+{
+	uint32_t count = 0;
+	for (const char *c = lookups; *c; c++) {
+		char *seen = old_seen(args, *c);
+		if (!seen) {
+			count += strlen(args) + 1;
+			continue;
+		}
+		count += seen - args + 1;
+		char *e = strchr(seen, 'E');
+		count += (e ? e : seen + strlen(seen)) - seen + 1;
+		char *end;
+		strtod(seen + 1, &end);
+		count += end - seen;
+	}
+	return count;
+}
+
+// The table of a line filled by add(), as for a binary command; the letters
+// and values must be the ones parse() gave
+static bool same_added(void)
+{
+	const uint32_t seen = gcodeParams.seen, has_value = gcodeParams.has_value;
+	float value[GCODE_PARAM_LETTERS];
+	memcpy(value, gcodeParams.value, sizeof(value));
+	gcodeParams.clear();
+	for (uint8_t i = 0; i < GCODE_PARAM_LETTERS; i++)
+		if (TEST(seen, i)) gcodeParams.add('A' + i, TEST(has_value, i) ? value[i] : NAN);
+	if (gcodeParams.seen != seen || gcodeParams.has_value != has_value) return false;
+	for (uint8_t i = 0; i < GCODE_PARAM_LETTERS; i++)
+		if (TEST(seen, i) && memcmp(&gcodeParams.value[i], &value[i], sizeof(value[i]))) return false;
+	return true;
+}
+
+static uint32_t compare(void)
+{
+	uint32_t mismatches = 0, values = 0;
+	uint64_t scanned[2] = { 0, 0 };
+	for (size_t n = 0; n < lines.size(); n++) {
+		char *args = &text[lines[n]];
+		scanned[0] += old_scanned(args);
+		scanned[1] += strlen(args) + 1;
+		gcodeParams.parse(args);
+		for (char code = 'A'; code <= 'Z'; code++) {
+			char *seen = old_seen(args, code);
+			const uint8_t i = gcodeParams.find(code);
+			bool same = (seen != NULL) == (i != GCODE_PARAM_LETTERS);
+			if (same && seen) {
+				values++;
+				const float a = old_value_float(seen), b = gcodeParams.value[i];
+				same = !memcmp(&a, &b, sizeof(a))
+				    && old_has_value(seen) == TEST(gcodeParams.has_value, i)
+				    && args + gcodeParams.offset[i] == seen
+				    && strtol(seen + 1, NULL, 10) == gcodeParams.parse_long(seen + 1);
+			}
+			if (!same) {
+				if (mismatches++ < 10)
+					printf("differ       %c in \"%s\": %.9g against %.9g\n", code, args,
+							seen ? old_value_float(seen) : NAN, i < GCODE_PARAM_LETTERS ? gcodeParams.value[i] : NAN);
+			}
+		}
+		if (!same_added() && mismatches++ < 10)
+			printf("differ       added as a binary command, \"%s\"\n", args);
+	}
+	printf("compared     %u parameters\n", (unsigned)values);
+	printf("scanned      strchr %.1f, table %.1f characters per line\n",
+			(double)scanned[0] / lines.size(), (double)scanned[1] / lines.size());
+	return mismatches;
+}
+
+static double run(bool table)
+{
+	const double start = host_seconds();
+	for (size_t n = 0; n < lines.size(); n++) {
+		char *args = &text[lines[n]];
+		if (table) {
+			gcodeParams.parse(args);
+			for (const char *c = lookups; *c; c++) {
+				const uint8_t i = gcodeParams.find(*c);
+				if (i != GCODE_PARAM_LETTERS) sink += gcodeParams.value[i];
+			}
+		}
+		else {
+			for (const char *c = lookups; *c; c++) {
+				char *seen = old_seen(args, *c);
+				if (seen) sink += old_value_float(seen);
+			}
+		}
+	}
+	return host_seconds() - start;
+}
+
+/* Exported Functions --------------------------------------------------------*/
+
+int main(int argc, char **argv)
+{
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s file...\n", argv[0]);
+		return 2;
+	}
+	for (int i = 1; i < argc; i++) {
+		if (!load(argv[i])) {
+			fprintf(stderr, "%s: can't read %s\n", argv[0], argv[i]);
+			return 2;
+		}
+	}
+	printf("%u commands, %u bytes of arguments\n", (unsigned)lines.size(), (unsigned)text.size());
+	if (lines.empty()) return 2;
+
+	const uint32_t mismatches = compare();
+
+	double seconds[2];
+	for (int table = 0; table < 2; table++) {
+		seconds[table] = run(table);
+		for (int i = 1; i < RUNS; i++) seconds[table] = min(seconds[table], run(table));
+		printf("%-12s %10.0f lines/s, %6.3f us per line\n", table ? "table" : "strchr",
+				lines.size() / seconds[table], seconds[table] * 1e6 / lines.size());
+	}
+	printf("speedup      x%.2f\n", seconds[0] / seconds[1]);
+
+	if (mismatches) {
+		printf("FAIL: %u lookups differ\n", (unsigned)mismatches);
+		return 1;
+	}
+	printf("PASS\n");
+	return 0;
+}
@@ -0,0 +1,175 @@
+/**
+  ******************************************************************************
+  * @file    sim/benchplanner.cpp
+  * @brief   Host time Planner::buffer_line() takes per block against the
+  *          depth of the block buffer
+  * @note    build: make sim
+  *                 make sim BLOCK_BUFFER_SIZE=64 (deeper than the firmware,
+  *                 built in build_sim-b64)
+  *          usage: build_sim/benchplanner [-l layers]
+  *            -l  layers of the test print (default 20)
+  *          The test print is a stream of delta segments, the way
+  *          prepare_kinematic_move_to() cuts them at the default
+  *          delta_segments_per_second: per layer a round perimeter and a
+  *          zig-zag infill across it, so the plan has both smooth runs and
+  *          full stops. It is buffered over and over with the planner
+  *          holding 4, 8, ... up to BLOCK_BUFFER_SIZE - 1 blocks; the
+  *          stepper interrupt does not run, the oldest block is dropped
+  *          when the planner holds that many. The fastest of RUNS counts.
+  *          "plan" hashes the speed profiles of the blocks as they are
+  *          dropped, a change to the look-ahead that shouldn't change the
+  *          plan must leave it as it is.
+  *          The size of block_t is the host's, the same as the printer's
+  *          unless an option puts a pointer or a long in it.
+  *          The host has an FPU, take the rates for how they scale with
+  *          the depth, not for what the printer does.
+  ******************************************************************************
+  */
+
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#include "sim.h"
+#include "planner.h"
+
+/* Private Constants ---------------------------------------------------------*/
+
+#define PERIMETER_RADIUS (30.0f)
+#define INFILL_SPACING   (2.0f)
+#define LAYER_HEIGHT     (0.2f)
+#define PERIMETER_SPEED  (40.0f)   // mm/s
+#define INFILL_SPEED     (60.0f)
+#define E_PER_MM         (0.05f)
+// the fastest of this many runs counts
+#define RUNS             (5)
+
+/* Private Types -------------------------------------------------------------*/
+
+typedef struct {
+	float carriage[3], e, feedrate;
+} Segment;
+
+/* Private Variables ---------------------------------------------------------*/
+
+static std::vector<Segment> segments;
+static float position[4];
+
+/* Private Functions ---------------------------------------------------------*/
+
+static double host_seconds(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// prepare_kinematic_move_to() from position[] to x, y, z
+static void line_to(float x, float y, float z, float feedrate, bool extrude)
+{
+	const float target[3] = { x, y, z };
+	const float length = sqrt(sq(x - position[X_AXIS]) + sq(y - position[Y_AXIS]) + sq(z - position[Z_AXIS]));
+	const int count = max(1, int((DELTA_SEGMENTS_PER_SECOND) * length / feedrate));
+	float e = position[E_AXIS];
+	for (int s = 1; s <= count; s++) {
+		float point[3];
+		for (int i = 0; i < 3; i++) point[i] = position[i] + (target[i] - position[i]) * s / count;
+		if (extrude) e += E_PER_MM * length / count;
+		inverse_kinematics(point);
+		Segment seg = { { delta[A_AXIS], delta[B_AXIS], delta[C_AXIS] }, e, feedrate };
+		segments.push_back(seg);
+	}
+	for (int i = 0; i < 3; i++) position[i] = target[i];
+	position[E_AXIS] = e;
+}
+
+static void make_print(int layers)
+{
+	for (int layer = 1; layer <= layers; layer++) {
+		const float z = layer * LAYER_HEIGHT;
+		line_to(PERIMETER_RADIUS, 0, z, PERIMETER_SPEED, false);
+		for (int a = 1; a <= 120; a++)
+			line_to(PERIMETER_RADIUS * cos(RADIANS(a * 3)), PERIMETER_RADIUS * sin(RADIANS(a * 3)), z, PERIMETER_SPEED, true);
+		// across the disc, every other layer the other way
+		bool up = false;
+		for (float v = INFILL_SPACING - PERIMETER_RADIUS; v < PERIMETER_RADIUS; v += INFILL_SPACING, up = !up) {
+			const float w = sqrt(sq(PERIMETER_RADIUS) - sq(v)), from = up ? w : -w;
+			if (layer & 1) {
+				line_to(v, from, z, INFILL_SPEED, false);
+				line_to(v, -from, z, INFILL_SPEED, true);
+			}
+			else {
+				line_to(from, v, z, INFILL_SPEED, false);
+				line_to(-from, v, z, INFILL_SPEED, true);
+			}
+		}
+	}
+}
+
+// FNV-1a of the speed profile of the oldest block, as the stepper would get it
+static void hash_block(uint32_t &hash)
+{
+	const block_t *block = &planner.block_buffer[planner.block_buffer_tail];
+	const uint32_t profile[5] = { (uint32_t)block->initial_rate, (uint32_t)block->final_rate, (uint32_t)block->nominal_rate,
+	                              (uint32_t)block->accelerate_until, (uint32_t)block->decelerate_after };
+	for (unsigned i = 0; i < sizeof(profile); i++)
+		hash = (hash ^ ((const uint8_t *)profile)[i]) * 16777619u;
+}
+
+static double run(uint8_t depth, uint32_t &hash)
+{
+	while (planner.blocks_queued()) planner.discard_current_block();
+	const Segment &first = segments.front();
+	planner.set_position_mm(first.carriage[A_AXIS], first.carriage[B_AXIS], first.carriage[C_AXIS], first.e);
+	hash = 2166136261u;
+	double seconds = 0;
+	for (size_t i = 1; i < segments.size(); i++) {
+		const Segment &s = segments[i];
+		if (planner.movesplanned() >= depth) {
+			hash_block(hash);
+			planner.discard_current_block();
+		}
+		const double start = host_seconds();
+		planner.buffer_line(s.carriage[A_AXIS], s.carriage[B_AXIS], s.carriage[C_AXIS], s.e, s.feedrate, 0);
+		seconds += host_seconds() - start;
+	}
+	while (planner.blocks_queued()) {
+		hash_block(hash);
+		planner.discard_current_block();
+	}
+	return seconds;
+}
+
+/* Exported Functions --------------------------------------------------------*/
+
+int main(int argc, char **argv)
+{
+	int layers = 20;
+	int opt;
+	while ((opt = getopt(argc, argv, "l:")) != -1) {
+		if (opt == 'l') layers = atoi(optarg);
+		else optind = argc;
+	}
+	if (optind != argc || layers <= 0) {
+		fprintf(stderr, "usage: %s [-l layers]\n", argv[0]);
+		return 2;
+	}
+
+	sim_init();
+	// as marlin_sim, the SD autostart holds setup() for 5s
+	sim_advance((sim_time_t)5000 * SIM_MS_TICKS);
+	setup();
+
+	make_print(layers);
+	printf("%u blocks, BLOCK_BUFFER_SIZE %u\n", (unsigned)segments.size() - 1, (unsigned)BLOCK_BUFFER_SIZE);
+	printf("block_t      %u bytes, %u bytes of block buffer\n", (unsigned)sizeof(block_t), (unsigned)sizeof(planner.block_buffer));
+	for (unsigned depth = 4;; depth = min(depth * 2, BLOCK_BUFFER_SIZE - 1)) {
+		uint32_t hash;
+		double seconds = run(depth, hash);
+		for (int i = 1; i < RUNS; i++) seconds = min(seconds, run(depth, hash));
+		printf("depth %2u     %8.0f blocks/s, %6.2f us per block, plan %08x\n", depth,
+				(segments.size() - 1) / seconds, seconds * 1e6 / (segments.size() - 1), (unsigned)hash);
+		if (depth == BLOCK_BUFFER_SIZE - 1) break;
+	}
+	return 0;
+}
@@ -0,0 +1,547 @@
+/**
+  ******************************************************************************
+  * @file    sim/benchsdread.cpp
+  * @brief   SD commands, SPI bytes and CPU time it takes to read a print
+  *          file, the CMD16 and CMD17 per sector reads against the CMD18
+  *          read-ahead of sd_diskio.c (USE_SPI_DMA: the stream read by DMA
+  *          into a double buffer), through the real FatFs and SD driver
+  * @note    build: make sim
+  *          usage: build_sim/benchsdread [-a us] [-b us] [-w us] file...
+  *            -a  access time of a block read, from the command to the data
+  *                token (default 250us)
+  *            -b  time between the blocks of a multiple block read (default
+  *                25us)
+  *            -w  work of the CPU per byte of the file read, the commands
+  *                parsed and planned (default 4us, 140us per 35 byte line)
+  *            e.g. build_sim/benchsdread Marlin4MPMD-1.3.3/SdCardContent/gcodes/*
+  *          The card is a mock of an SDHC card in SPI mode behind the SD_IO_
+  *          link functions, a RAM image formatted with f_mkfs() and given
+  *          the files. It counts the commands by index and the bytes
+  *          clocked, either way; the card answers a read with 0xFF for as
+  *          many bytes as the access time takes at the SPI clock of
+  *          SPIx_Init(). Each file is read back the way CardReader reads it,
+  *          a byte at a time (get(), the text files) and 512 bytes at a time
+  *          (read_buff(), the binary files), with the sector reads as they
+  *          were (kept here as they were, the same bytes on the SPI bus) and
+  *          as they are. Every file must read back as it was written, the
+  *          read-ahead must not hand out a sector written since, and must
+  *          fall back to a single block read at the end of the card, or it
+  *          exits with 1. The simulated DMA (SD_IO_ReadData_DMA()) clocks
+  *          its bytes from the time it starts, in the background, and gives
+  *          the data to the buffer at SD_IO_WaitData_DMA(); until then the
+  *          buffer holds the complement of what the card sends, so a sector
+  *          handed out before the wait reads back wrong, and any other use
+  *          of the bus meanwhile fails the run. "cpu/512" is the time per
+  *          sector of the file the CPU spends in the reads, clocking bytes
+  *          or waiting for the DMA, in SPI bytes; "rate" is the file bytes
+  *          per second of that. The CPU time of the FatFs calls and the
+  *          memcpy()s is not in either.
+  ******************************************************************************
+  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "ff_gen_drv.h"
+#include "stm32f0xx_mpmd_sd.h"
+
+/* Private Constants ---------------------------------------------------------*/
+
+// SPIx_Init(), SPI_BAUDRATEPRESCALER_32 of the 48MHz PCLK
+#define SPI_CLOCK_HZ  (48000000 / 32)
+// a 64MB card
+#define CARD_SECTORS  (131072)
+// 0x00 bytes of busy after a write and after a CMD12
+#define BUSY_BYTES    (8)
+
+/* Private Types -------------------------------------------------------------*/
+
+typedef struct {
+	uint32_t commands[64];  // by index, an ACMD as its CMD
+	uint64_t bytes;         // clocked
+	uint64_t dmaBytes;      // of those, by DMA
+	double cpu;             // bytes of time in the reads
+	double waited;          // of that, for the DMA
+} Counts;
+
+/* Private Variables ---------------------------------------------------------*/
+
+extern "C" const Diskio_drvTypeDef SD_Driver;
+extern "C" DSTATUS SD_initialize(BYTE);
+extern "C" DSTATUS SD_status(BYTE);
+extern "C" DRESULT SD_read(BYTE, BYTE*, DWORD, UINT);
+extern "C" DRESULT SD_write(BYTE, const BYTE*, DWORD, UINT);
+extern "C" DRESULT SD_ioctl(BYTE, BYTE, void*);
+// HAL_GetTick(), in ms of SPI clock
+extern "C" __IO uint32_t uwTick;
+__IO uint32_t uwTick;
+
+// the card
+static std::vector<uint8_t> image;
+static Counts counts;
+static double clocked;  // bytes of time since the start, the time of uwTick
+static uint32_t accessBytes, nextBlockBytes;
+static double workBytes;  // per byte of a file
+static bool selected, idle, appCmd;
+static std::deque<uint8_t> out;  // what it sends next
+static uint8_t frame[6];         // the command coming in
+static uint8_t framed;
+static int32_t streaming = -1;   // next block of a multiple block read
+static int32_t writing = -1;     // block of a write, waiting for its data
+static std::vector<uint8_t> written;
+static uint32_t busy;
+
+// the DMA under way
+static uint8_t *dmaData;
+static uint16_t dmaLength;
+static double dmaStart;
+static uint32_t dmaMisuse;
+
+// the files, on the card as their base names
+static std::vector<std::string> names, contents;
+static uint64_t totalBytes;
+
+static bool oldReads;
+static uint32_t failed;
+
+/* Private Functions ---------------------------------------------------------*/
+
+static void send_block(const uint8_t *data, uint32_t size, uint32_t latency)
+{
+	out.insert(out.end(), latency, 0xFF);
+	out.push_back(0xFE);
+	out.insert(out.end(), data, data + size);
+	out.push_back(0x00);  // CRC
+	out.push_back(0x00);
+}
+
+static void command(void)
+{
+	static const uint8_t cid[16] = { 0x03, 'S', 'M', 'S', 'I', 'M', 'S', 'D', 0x10, 0, 0, 0, 1, 0x01, 0x41, 0x01 };
+	// CSD 2.0, 512 byte blocks, with C_SIZE + 1 sectors as BSP_SD_GetCardInfo() reads it
+	static const uint8_t csd[16] = { 0x40, 0x0E, 0x00, 0x32, 0x5B, 0x59, 0x00, (CARD_SECTORS - 1) >> 16,
+	                                 ((CARD_SECTORS - 1) >> 8) & 0xFF, (CARD_SECTORS - 1) & 0xFF, 0x7F, 0x80, 0x0A, 0x40, 0x00, 0x01 };
+	const uint8_t cmd = frame[0] & 0x3F;
+	const uint32_t arg = (frame[1] << 24) | (frame[2] << 16) | (frame[3] << 8) | frame[4];
+	const bool app = appCmd;
+	appCmd = false;
+	counts.commands[cmd]++;
+	out.clear();
+
+	if (cmd == 12) {
+		// a stuff byte, that the driver must not take for the R1
+		out.push_back(0xA5);
+		out.push_back(0xFF);
+		out.push_back(0x00);
+		streaming = -1;
+		busy = BUSY_BYTES;
+		return;
+	}
+	streaming = -1;
+	out.push_back(0xFF);  // NCR
+	const uint8_t r1 = idle ? 0x01 : 0x00;
+	switch (cmd) {
+	case 0: idle = true; out.push_back(0x01); break;
+	case 8: out.push_back(r1); out.insert(out.end(), { 0x00, 0x00, 0x01, 0xAA }); break;
+	case 55: appCmd = true; out.push_back(r1); break;
+	case 41:
+		if (app) idle = false;
+		out.push_back(app ? 0x00 : 0x04);
+		break;
+	case 58: out.push_back(r1); out.insert(out.end(), { 0xC0, 0xFF, 0x80, 0x00 }); break;  // CCS, SDHC
+	case 9: out.push_back(r1); send_block(csd, sizeof(csd), accessBytes); break;
+	case 10: out.push_back(r1); send_block(cid, sizeof(cid), accessBytes); break;
+	case 13: out.push_back(r1); out.push_back(0x00); break;
+	case 16: out.push_back(arg == 512 ? r1 : 0x40); break;
+	case 17:
+	case 18:
+		if (arg >= CARD_SECTORS) {
+			out.push_back(0x20);
+			break;
+		}
+		out.push_back(r1);
+		send_block(&image[arg * 512], 512, accessBytes);
+		if (cmd == 18) streaming = arg + 1;
+		break;
+	case 24:
+		if (arg >= CARD_SECTORS) {
+			out.push_back(0x20);
+			break;
+		}
+		out.push_back(r1);
+		writing = arg;
+		written.clear();
+		break;
+	default: out.push_back(0x04); break;
+	}
+}
+
+static uint8_t card_out(void)
+{
+	if (out.empty() && streaming >= 0) {
+		if (streaming < CARD_SECTORS)
+			send_block(&image[streaming++ * 512], 512, nextBlockBytes);
+		else {
+			// out of range data error token, then it waits for the CMD12
+			out.insert(out.end(), nextBlockBytes, 0xFF);
+			out.push_back(0x08);
+			streaming = -1;
+		}
+	}
+	if (!out.empty()) {
+		const uint8_t byte = out.front();
+		out.pop_front();
+		return byte;
+	}
+	if (busy) {
+		busy--;
+		return 0x00;
+	}
+	return 0xFF;
+}
+
+// One byte each way on the SPI bus
+static void set_clock(double bytes)
+{
+	clocked = bytes;
+	uwTick = clocked * 8000 / SPI_CLOCK_HZ;
+}
+
+static void misuse(const char *what)
+{
+	if (dmaMisuse++ < 10)
+		printf("dma          %s\n", what);
+}
+
+static uint8_t exchange(uint8_t in)
+{
+	if (dmaData) misuse("the bus used while a DMA runs");
+	counts.bytes++;
+	set_clock(clocked + 1);
+	if (!selected) return 0xFF;
+	if (writing >= 0) {
+		if (written.empty() && in != 0xFE) return card_out();
+		written.push_back(in);
+		if (written.size() == 1 + 512 + 2) {
+			memcpy(&image[writing * 512], &written[1], 512);
+			writing = -1;
+			out.push_back(0x05);  // data accepted
+			busy = BUSY_BYTES;
+		}
+		return 0xFF;
+	}
+	if (framed || (in & 0xC0) == 0x40) {
+		frame[framed++] = in;
+		const uint8_t byte = card_out();
+		if (framed == sizeof(frame)) {
+			framed = 0;
+			command();
+		}
+		return byte;
+	}
+	return card_out();
+}
+
+// BSP_SD_ReadBlocks() and SD_read() as they were: CMD16, then a CMD17 per sector
+static uint8_t old_command(uint8_t cmd, uint32_t arg)
+{
+	const uint8_t frame[6] = { uint8_t(cmd | 0x40), uint8_t(arg >> 24), uint8_t(arg >> 16), uint8_t(arg >> 8), uint8_t(arg), 0xFF };
+	uint8_t frameout[6], r1;
+	uint8_t timeout = 8;
+	SD_IO_CSState(0);
+	SD_IO_WriteReadData(frame, frameout, sizeof(frame));
+	do r1 = SD_IO_WriteReadByte(0xFF);
+	while ((r1 == 0xFF || r1 == 0xBF) && --timeout);
+	return r1;
+}
+
+static DRESULT old_read(BYTE lun, BYTE *buff, DWORD sector, UINT count)
+{
+	bool ok = old_command(16, 512) == 0;
+	SD_IO_CSState(1);
+	SD_IO_WriteByte(0xFF);
+	for (UINT i = 0; ok && i < count; i++) {
+		ok = old_command(17, sector + i) == 0;
+		uint16_t timeout = 0xFFFF;
+		while (ok && SD_IO_WriteReadByte(0xFF) != 0xFE)
+			ok = --timeout;
+		if (ok) {
+			SD_IO_ReadData(buff + i * 512, 512);
+			SD_IO_WriteByte(0xFF);
+			SD_IO_WriteByte(0xFF);
+			SD_IO_CSState(1);
+			SD_IO_WriteByte(0xFF);
+		}
+	}
+	SD_IO_CSState(1);
+	SD_IO_WriteByte(0xFF);
+	return ok ? RES_OK : RES_ERROR;
+}
+
+static DSTATUS old_status(BYTE lun)
+{
+	const uint8_t r1 = old_command(13, 0), r2 = SD_IO_WriteReadByte(0xFF);
+	SD_IO_CSState(1);
+	SD_IO_WriteByte(0xFF);
+	return r1 == 0 && r2 == 0 ? 0 : STA_NOINIT;
+}
+
+static DSTATUS bench_status(BYTE lun)
+{
+	return oldReads ? old_status(lun) : SD_status(lun);
+}
+
+static DRESULT bench_read(BYTE lun, BYTE *buff, DWORD sector, UINT count)
+{
+	return oldReads ? old_read(lun, buff, sector, count) : SD_read(lun, buff, sector, count);
+}
+
+static Diskio_drvTypeDef BenchDriver = { SD_initialize, bench_status, bench_read, SD_write, SD_ioctl };
+
+static bool load(const char *name)
+{
+	FILE *f = fopen(name, "rb");
+	if (!f) return false;
+	std::string content;
+	char buf[4096];
+	size_t n;
+	while ((n = fread(buf, 1, sizeof(buf), f)) > 0) content.append(buf, n);
+	fclose(f);
+	const char *base = strrchr(name, '/');
+	names.push_back(std::string("0:/") + (base ? base + 1 : name));
+	contents.push_back(content);
+	totalBytes += content.size();
+	return true;
+}
+
+// A fresh mount, so no sector is left in FatFs or the read-ahead
+static bool mount(FATFS &fs)
+{
+	disk_deinitialize(0);
+	return f_mount(&fs, "0:/", 1) == FR_OK;
+}
+
+static void fail(const char *what)
+{
+	printf("FAIL: %s\n", what);
+	failed++;
+}
+
+// Reads every file back, len bytes per f_read()
+static Counts read_files(UINT len)
+{
+	static FATFS fs;
+	static BYTE buf[512];
+	if (!mount(fs)) fail("mount");
+	memset(&counts, 0, sizeof(counts));
+	const double start = clocked;
+	double work = 0;
+	for (size_t n = 0; n < names.size(); n++) {
+		static FIL file;
+		std::string back;
+		UINT got;
+		if (f_open(&file, names[n].c_str(), FA_READ) != FR_OK) {
+			fail("open");
+			continue;
+		}
+		while (f_read(&file, buf, len, &got) == FR_OK && got) {
+			back.append((char *)buf, got);
+			// the CPU works on it, the DMA goes on meanwhile
+			work += got * workBytes;
+			set_clock(clocked + got * workBytes);
+		}
+		f_close(&file);
+		if (back != contents[n]) {
+			printf("differ       %s, %u of %u bytes read\n", names[n].c_str(), (unsigned)back.size(), (unsigned)contents[n].size());
+			fail("a file read back differs");
+		}
+	}
+	counts.cpu = clocked - start - work;
+	return counts;
+}
+
+// The commands of reading a file: status, block length, reads
+static uint32_t read_commands(const Counts &c)
+{
+	return c.commands[13] + c.commands[16] + c.commands[17] + c.commands[18] + c.commands[12];
+}
+
+static void report(const char *what, const Counts &c)
+{
+	const double seconds = c.cpu * 8.0 / SPI_CLOCK_HZ;
+	printf("%-14s %8u %8u %6u %6u %6u %6u %9.1f %7.1f %6.1f kB/s\n", what, (unsigned)read_commands(c), (unsigned)c.commands[13],
+			(unsigned)c.commands[16], (unsigned)c.commands[17], (unsigned)c.commands[18], (unsigned)c.commands[12],
+			(double)c.bytes * 512 / totalBytes, c.cpu * 512 / totalBytes, totalBytes / seconds / 1000);
+	if (c.dmaBytes)
+		printf("               %.1f%% of the bytes by DMA, %.1f%% of those behind the work\n",
+				100.0 * c.dmaBytes / c.bytes, 100.0 * (1 - c.waited / c.dmaBytes));
+}
+
+// A sector the read-ahead holds, written, must read back as written
+static bool write_drops_readahead(void)
+{
+	static BYTE buf[512], pattern[512];
+	const DWORD s = CARD_SECTORS / 2;
+	for (int i = 0; i < 512; i++) pattern[i] = i * 7 + 1;
+	if (disk_read(0, buf, s, 1) != RES_OK || disk_read(0, buf, s + 1, 1) != RES_OK) return false;
+	if (disk_write(0, pattern, s + 2, 1) != RES_OK) return false;
+	return disk_read(0, buf, s + 2, 1) == RES_OK && !memcmp(buf, pattern, 512);
+}
+
+// The read-ahead from the last sector runs off the card, the sector must
+// still be read, without waiting out the data token timeout
+static bool readahead_at_end(void)
+{
+	static BYTE buf[512];
+	const DWORD s = CARD_SECTORS - 1;
+	memset(&image[s * 512], 0x5A, 512);
+	if (disk_read(0, buf, s - 1, 1) != RES_OK) return false;
+	memset(&counts, 0, sizeof(counts));
+	return disk_read(0, buf, s, 1) == RES_OK && buf[0] == 0x5A && buf[511] == 0x5A && counts.bytes < 4 * 600;
+}
+
+/* Exported Functions --------------------------------------------------------*/
+
+// the SD_IO_ link functions, to the card
+extern "C" void SD_IO_Init(void)
+{
+	selected = false;
+	for (int i = 0; i < 10; i++) exchange(0xFF);
+}
+
+extern "C" void SD_IO_CSState(uint8_t state)
+{
+	if (dmaData) misuse("CS changed while a DMA runs");
+	selected = !state;
+	if (!selected) {
+		out.clear();
+		framed = 0;
+		streaming = writing = -1;
+	}
+}
+
+extern "C" void SD_IO_WriteReadData(const uint8_t *DataIn, uint8_t *DataOut, uint16_t DataLength)
+{
+	for (uint16_t i = 0; i < DataLength; i++) DataOut[i] = exchange(DataIn[i]);
+}
+
+extern "C" void SD_IO_ReadData(uint8_t *DataOut, uint16_t DataLength)
+{
+	for (uint16_t i = 0; i < DataLength; i++) DataOut[i] = exchange(0xFF);
+}
+
+extern "C" void SD_IO_WriteData(const uint8_t *Data, uint16_t DataLength)
+{
+	for (uint16_t i = 0; i < DataLength; i++) exchange(Data[i]);
+}
+
+extern "C" void SD_IO_WriteByte(uint8_t Data) { exchange(Data); }
+extern "C" uint8_t SD_IO_WriteReadByte(uint8_t Data) { return exchange(Data); }
+extern "C" void HAL_Delay(uint32_t Delay) { set_clock(clocked + (double)Delay * SPI_CLOCK_HZ / 8000); }
+
+// The DMA, its bytes go out in the background from now on
+extern "C" void SD_IO_ReadData_DMA(uint8_t *DataOut, uint16_t DataLength)
+{
+	if (dmaData) misuse("a DMA started while one runs");
+	for (uint16_t i = 0; i < DataLength; i++) DataOut[i] = ~(i < out.size() ? out[i] : 0xFF);
+	dmaData = DataOut;
+	dmaLength = DataLength;
+	dmaStart = clocked;
+}
+
+extern "C" void SD_IO_WaitData_DMA(void)
+{
+	if (!dmaData) {
+		misuse("a wait with no DMA");
+		return;
+	}
+	uint8_t *data = dmaData;
+	const double now = clocked;
+	dmaData = NULL;
+	set_clock(dmaStart);
+	for (uint16_t i = 0; i < dmaLength; i++) data[i] = exchange(0xFF);
+	counts.dmaBytes += dmaLength;
+	if (clocked > now) counts.waited += clocked - now;
+	else set_clock(now);
+}
+
+int main(int argc, char **argv)
+{
+	double access = 250, nextBlock = 25, workUs = 4;
+	int opt;
+	while ((opt = getopt(argc, argv, "a:b:w:")) != -1) {
+		switch (opt) {
+		case 'a': access = atof(optarg); break;
+		case 'b': nextBlock = atof(optarg); break;
+		case 'w': workUs = atof(optarg); break;
+		default: optind = argc + 1; break;
+		}
+	}
+	if (optind >= argc || access < 0 || nextBlock < 0 || workUs < 0) {
+		fprintf(stderr, "usage: %s [-a us] [-b us] [-w us] file...\n", argv[0]);
+		return 2;
+	}
+	for (int i = optind; i < argc; i++) {
+		if (!load(argv[i])) {
+			fprintf(stderr, "%s: can't read %s\n", argv[0], argv[i]);
+			return 2;
+		}
+	}
+	accessBytes = access * 1e-6 * SPI_CLOCK_HZ / 8 + 0.5;
+	nextBlockBytes = nextBlock * 1e-6 * SPI_CLOCK_HZ / 8 + 0.5;
+	workBytes = workUs * 1e-6 * SPI_CLOCK_HZ / 8;
+
+	image.assign((size_t)CARD_SECTORS * 512, 0xFF);
+	char path[4];
+	FATFS_LinkDriver(&BenchDriver, path);
+	static FATFS fs;
+	static BYTE work[_MAX_SS];
+	if (f_mkfs(path, FM_ANY, 0, work, sizeof(work)) != FR_OK || !mount(fs)) {
+		fprintf(stderr, "%s: can't format the card\n", argv[0]);
+		return 2;
+	}
+	for (size_t n = 0; n < names.size(); n++) {
+		static FIL file;
+		UINT put;
+		if (f_open(&file, names[n].c_str(), FA_WRITE | FA_CREATE_ALWAYS) != FR_OK
+		 || f_write(&file, contents[n].data(), contents[n].size(), &put) != FR_OK || put != contents[n].size()
+		 || f_close(&file) != FR_OK) {
+			fprintf(stderr, "%s: can't write %s to the card\n", argv[0], names[n].c_str());
+			return 2;
+		}
+	}
+
+	printf("%u files, %llu bytes, %u byte clusters, SPI %.2f MHz\n", (unsigned)names.size(),
+			(unsigned long long)totalBytes, (unsigned)fs.csize * 512, SPI_CLOCK_HZ / 1e6);
+	printf("access       %.0f us (%u bytes), next block %.0f us (%u bytes), work %.2f us per byte\n",
+			access, (unsigned)accessBytes, nextBlock, (unsigned)nextBlockBytes, workUs);
+	printf("               commands    CMD13  CMD16  CMD17  CMD18  CMD12 bytes/512 cpu/512   rate\n");
+	static const struct { const char *name; UINT len; } reads[] = { { "get", 1 }, { "read_buff", 512 } };
+	for (unsigned r = 0; r < sizeof(reads) / sizeof(reads[0]); r++) {
+		Counts c[2];
+		for (int mode = 0; mode < 2; mode++) {
+			oldReads = !mode;
+			c[mode] = read_files(reads[r].len);
+			report((std::string(reads[r].name) + (mode ? " new" : " old")).c_str(), c[mode]);
+		}
+		printf("               x%.2f fewer commands, x%.2f fewer bytes, x%.2f less CPU time\n",
+				(double)read_commands(c[0]) / read_commands(c[1]), (double)c[0].bytes / c[1].bytes, c[0].cpu / c[1].cpu);
+		if (read_commands(c[1]) >= read_commands(c[0]) || c[1].bytes >= c[0].bytes || c[1].cpu >= c[0].cpu)
+			fail("no fewer commands, bytes or less CPU time");
+	}
+
+	oldReads = false;
+	if (!mount(fs)) fail("mount");
+	if (!write_drops_readahead()) fail("a read-ahead sector outlived its write");
+	if (!readahead_at_end()) fail("the last sector of the card");
+	if (dmaMisuse) fail("the DMA and the bus");
+
+	if (failed) return 1;
+	printf("PASS\n");
+	return 0;
+}
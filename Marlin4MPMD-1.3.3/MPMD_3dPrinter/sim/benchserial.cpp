@@ -0,0 +1,227 @@
+/**
+  ******************************************************************************
+  * @file    sim/benchserial.cpp
+  * @brief   Sustained lines per second from the USB CDC Rx ring into the
+  *          command queue, the byte at a time framing against the lines
+  *          the CDC layer hands over whole (BSP_CdcCopyNextRxLine())
+  * @note    build: make sim
+  *          usage: build_sim/benchserial file...
+  *            e.g. build_sim/benchserial Marlin4MPMD-1.3.3/SdCardContent/gcodes/*
+  *          The files are sent the way a host sends them: comments off,
+  *          "N<n> <command>*<checksum>", after an M110 N0. The simulated
+  *          USB host sends 64 byte packets as fast as the firmware re-arms
+  *          the endpoint, into the real Rx ring of stm32f0xx_3dprinter_cdc.c.
+  *          "lines" is get_available_commands(), the firmware as it is,
+  *          with the queue emptied as soon as it fills. "bytes" is the
+  *          framing it replaced, MYSERIAL.read() by the byte into a line
+  *          buffer then strcpy() into the queue, kept here as it was but
+  *          for reading whatever the ring holds: waiting, as it did, for a
+  *          line end as the last byte in the ring stalls for good once a
+  *          packet ending mid-line leaves the ring more than half full,
+  *          as the endpoint is not re-armed then.
+  *          Every line must pass the firmware's line number and checksum
+  *          checks and every line the byte framing queues must be the one
+  *          sent, a line with a bad checksum must be caught (its Error: is
+  *          printed), or it exits with 1. The fastest of RUNS counts. The USB interrupt's copy of
+  *          each packet into the ring is in both rates.
+  ******************************************************************************
+  */
+
+#include <time.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#include "sim.h"
+
+/* Private Constants ---------------------------------------------------------*/
+
+// the fastest of this many runs counts
+#define RUNS (5)
+// commands of the fixed queue the byte framing filled
+#define BYTE_QUEUE_SLOTS (4)
+
+/* Private Variables ---------------------------------------------------------*/
+
+// the stream the host sends, and each line of it without its line end
+static std::string stream;
+static std::vector<std::string> sent;
+
+// the command queue of the byte framing
+static char queue[BYTE_QUEUE_SLOTS][MAX_CMD_SIZE];
+static uint8_t queued;
+static uint32_t mismatches;
+
+/* Private Functions ---------------------------------------------------------*/
+
+void get_available_commands();
+
+static double host_seconds(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void send(const std::string &command)
+{
+	char line[MAX_CMD_SIZE + 16];
+	uint8_t checksum = 0;
+	snprintf(line, sizeof(line), "N%u %s", (unsigned)sent.size(), command.c_str());
+	for (const char *c = line; *c; c++) checksum ^= *c;
+	snprintf(line + strlen(line), 8, "*%u", checksum);
+	sent.push_back(line);
+	stream += line;
+	stream += '\n';
+}
+
+static bool load(const char *name)
+{
+	FILE *f = fopen(name, "r");
+	if (!f) return false;
+	char buf[1024];
+	while (fgets(buf, sizeof(buf), f)) {
+		std::string line(buf, strcspn(buf, ";\r\n"));
+		while (!line.empty() && line[line.size() - 1] == ' ') line.erase(line.size() - 1);
+		const size_t start = line.find_first_not_of(' ');
+		// the firmware takes at most MAX_CMD_SIZE - 1 of it
+		if (start != std::string::npos && line.size() - start < MAX_CMD_SIZE - 16)
+			send(line.substr(start));
+	}
+	fclose(f);
+	return true;
+}
+
+// The byte framing of get_serial_commands() as it was, less what it shares
+// with the line framing (the line number and checksum checks)
+static void byte_serial_commands(uint32_t &lineNo)
+{
+	static char serial_line_buffer[MAX_CMD_SIZE];
+	static bool serial_comment_mode = false;
+	static int serial_count = 0;
+
+	while (queued < BYTE_QUEUE_SLOTS && MYSERIAL.available(false) > 0) {
+		char serial_char = MYSERIAL.read();
+		if (serial_char == '\n' || serial_char == '\r') {
+			serial_comment_mode = false;
+			if (!serial_count) continue;
+			serial_line_buffer[serial_count] = 0;
+			serial_count = 0;
+			char *command = serial_line_buffer;
+			while (*command == ' ') command++;
+			char *apos = strchr(command, '*');
+			uint8_t checksum = 0;
+			if (apos) for (char *p = command; p < apos; p++) checksum ^= *p;
+			strcpy(queue[queued++], serial_line_buffer);
+			if (lineNo >= sent.size() || sent[lineNo] != serial_line_buffer || !apos || strtol(apos + 1, NULL, 10) != checksum) {
+				if (mismatches++ < 10)
+					printf("differ       line %u: \"%s\"\n", (unsigned)lineNo, serial_line_buffer);
+			}
+			lineNo++;
+		}
+		else if (serial_count >= MAX_CMD_SIZE - 1) {
+			// past the max length, to the line end
+		}
+		else if (serial_char == '\\') {
+			if (MYSERIAL.available(false) > 0) {
+				serial_char = MYSERIAL.read();
+				if (!serial_comment_mode) serial_line_buffer[serial_count++] = serial_char;
+			}
+		}
+		else {
+			if (serial_char == ';') serial_comment_mode = true;
+			if (!serial_comment_mode) serial_line_buffer[serial_count++] = serial_char;
+		}
+	}
+}
+
+static double run(bool lines)
+{
+	uint32_t lineNo = 0;
+	sim_set_input(stream.data(), stream.size());
+	const double start = host_seconds();
+	while (!sim_input_done()) {
+		sim_advance(0);
+		if (lines) {
+			get_available_commands();
+			clear_command_queue();
+		}
+		else {
+			byte_serial_commands(lineNo);
+			queued = 0;
+		}
+	}
+	const double seconds = host_seconds() - start;
+	if (!lines && lineNo != sent.size()) {
+		printf("differ       %u of %u lines framed\n", (unsigned)lineNo, (unsigned)sent.size());
+		mismatches++;
+	}
+	return seconds;
+}
+
+// After an M110 N0, a line with its checksum off by one must be refused
+static bool bad_checksum_caught(void)
+{
+	char bad[64];
+	uint8_t checksum = 0;
+	const char *line = "N1 G1 X10 Y10";
+	for (const char *c = line; *c; c++) checksum ^= *c;
+	snprintf(bad, sizeof(bad), "%s\n%s*%u\n", sent[0].c_str(), line, checksum ^ 1);
+	const uint32_t errors = sim.serialErrors;
+	sim_set_input(bad, strlen(bad));
+	while (!sim_input_done()) {
+		sim_advance(0);
+		get_available_commands();
+		clear_command_queue();
+	}
+	return sim.serialErrors == errors + 1;
+}
+
+/* Exported Functions --------------------------------------------------------*/
+
+int main(int argc, char **argv)
+{
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s file...\n", argv[0]);
+		return 2;
+	}
+	send("M110 N0");
+	for (int i = 1; i < argc; i++) {
+		if (!load(argv[i])) {
+			fprintf(stderr, "%s: can't read %s\n", argv[0], argv[i]);
+			return 2;
+		}
+	}
+
+	sim_init();
+	// as marlin_sim, the SD autostart holds setup() for 5s
+	sim_advance((sim_time_t)5000 * SIM_MS_TICKS);
+	setup();
+
+	printf("%u lines, %u bytes, Rx ring %u bytes\n", (unsigned)sent.size(), (unsigned)stream.size(), (unsigned)CDC_RX_BUFFER_SIZE);
+	double seconds[2];
+	for (int lines = 0; lines < 2; lines++) {
+		seconds[lines] = run(lines);
+		for (int i = 1; i < RUNS; i++) seconds[lines] = min(seconds[lines], run(lines));
+		printf("%-12s %10.0f lines/s, %6.3f us per line, %6.1f MB/s\n", lines ? "lines" : "bytes",
+				sent.size() / seconds[lines], seconds[lines] * 1e6 / sent.size(), stream.size() / seconds[lines] / 1e6);
+	}
+	printf("speedup      x%.2f\n", seconds[0] / seconds[1]);
+
+	uint32_t failed = 0;
+	if (sim.serialErrors) {
+		printf("FAIL: %u lines refused\n", (unsigned)sim.serialErrors);
+		failed++;
+	}
+	if (mismatches) {
+		printf("FAIL: %u lines differ\n", (unsigned)mismatches);
+		failed++;
+	}
+	if (!bad_checksum_caught()) {
+		printf("FAIL: a bad checksum passed\n");
+		failed++;
+	}
+	if (failed) return 1;
+	printf("PASS\n");
+	return 0;
+}
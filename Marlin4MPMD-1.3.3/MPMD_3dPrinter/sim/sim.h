@@ -0,0 +1,91 @@
+/**
+  ******************************************************************************
+  * @file    sim/sim.h
+  * @brief   Host simulator of the Marlin motion core ("make sim")
+  * @note    The firmware sources are compiled unchanged for the host and
+  *          linked against sim_bsp.cpp, which stands in for the BSP, HAL and
+  *          FatFs. Time is virtual: it is counted in ticks of the stepper
+  *          timer and only advances when the main loop calls idle() (or
+  *          delay()), the stepper, temperature and SysTick interrupts are
+  *          dispatched in timestamp order as the clock passes them.
+  ******************************************************************************
+  */
+#ifndef __SIM_H
+#define __SIM_H
+
+#include "Marlin.h"
+
+/* Exported Constants --------------------------------------------------------*/
+
+// Virtual clock rate, the stepper timer runs at 48MHz/32 = 1.5MHz
+#define SIM_TICK_FREQ  (CORE_CPU_FREQ/TICK_TIMER_PRESCALER)
+#define SIM_MS_TICKS   (SIM_TICK_FREQ/1000)
+
+// Main loop time accounted for each call to idle(), 100us
+#define SIM_IDLE_TICKS (SIM_TICK_FREQ/10000)
+
+// Thermal model (sim_bsp.cpp), heating power (W), heat capacity (J/K) and loss (W/K)
+#define SIM_AMBIENT        (25.0f)
+#define SIM_HOTEND_POWER   (40.0f)
+#define SIM_HOTEND_CAP     (12.0f)
+#define SIM_HOTEND_LOSS    (0.12f)
+#define SIM_HOTEND_FANLOSS (0.06f)   // extra loss with the part fan at full speed
+#define SIM_BED_POWER      (60.0f)
+#define SIM_BED_CAP        (200.0f)
+#define SIM_BED_LOSS       (0.5f)
+
+// Simulated axes: the three tower carriages and the extruder
+#define SIM_AXES       (4)
+
+// Stepper trace file (-T): the magic, the timer rate (Hz) as a uint32_t then
+// the events as recorded, stepper_trace_t in Marlin/stepper_trace.h
+#define SIM_TRACE_MAGIC "STRC"
+
+/* Exported Types ------------------------------------------------------------*/
+
+typedef uint64_t sim_time_t;
+
+typedef struct SimState {
+	sim_time_t now;               // virtual time in SIM_TICK_FREQ ticks
+	uint32_t stepperIsr;          // stepper interrupts dispatched
+	uint32_t temperatureIsr;      // temperature interrupts dispatched
+	int32_t position[SIM_AXES];   // carriage/extruder position in steps, + is up/extrude
+	uint32_t steps[SIM_AXES];     // step pulses seen on each axis
+	float nozzle[3];              // nozzle position, updated by sim_nozzle()
+	float minNozzleZ;             // lowest nozzle height seen by the probe
+	float hotend;                 // hotend temperature (C)
+	float bed;                    // bed temperature (C)
+	uint8_t fanSpeed;             // last part fan speed (0-255)
+	uint32_t serialErrors;        // "Error:" lines sent by the firmware
+	uint32_t burstFrames;         // steps played by DMA (STEP_BURST)
+	uint32_t burstRefills;        // step burst DMA interrupts
+	uint32_t burstErrors;         // frames played that differ from the trace of their fill
+	uint32_t flashErases[SETTINGS_FLASH_PAGES]; // of each page of the settings store
+	uint32_t flashWrites;         // flash half-words programmed
+	uint32_t flashErrors;         // half-words programmed that weren't erased
+} SimState;
+
+/* Exported Variables --------------------------------------------------------*/
+
+extern SimState sim;
+// flash erases and half-words programmed before the power goes, the one then
+// left part done and none after (-2 once it has gone); -1, it doesn't (testflashstore)
+extern int32_t sim_flash_cut;
+
+/* Exported Functions --------------------------------------------------------*/
+
+void sim_init(void);
+void sim_advance(sim_time_t ticks);
+void sim_idle(void);
+void sim_nozzle(void);
+
+bool sim_load_input(const char *path, const char *before);
+void sim_set_input(const char *data, uint32_t size);
+bool sim_input_done(void);
+uint32_t sim_ok_count(void);
+void sim_set_verbose(bool verbose);
+
+bool sim_trace_open(const char *path);
+void sim_trace_close(void);
+
+#endif /* __SIM_H */
@@ -0,0 +1,754 @@
+/**
+  ******************************************************************************
+  * @file    sim/sim_bsp.cpp
+  * @brief   Host stand-ins for the BSP, HAL, CMSIS-DSP and FatFs functions
+  *          used by the Marlin sources
+  * @note    Only what the firmware needs to run a print is modelled:
+  *            - the stepper timer (Tick), temperature timer (Tick2) and
+  *              SysTick interrupts, driven by a virtual clock
+  *            - step/dir pins of the three towers and the extruder
+  *            - the tower max endstops and the bed probe, from the delta
+  *              geometry in Configuration.h
+  *            - a first order thermal model of the hotend and the bed
+  *            - the host end of the USB CDC, feeding a G-code file to the
+  *              firmware's CDC layer (stm32f0xx_3dprinter_cdc.c) a packet
+  *              at a time
+  *            - the flash page used for the settings (FLASH_SETTINGS)
+  *            - a file sink for the stepper trace (STEPPER_TRACE)
+  *            - the DMA playing the step bursts (STEP_BURST), rendered
+  *              into the trace from the buffers as the frames are played
+  *          There is no SD card, FatFs calls fail with FR_NOT_READY.
+  ******************************************************************************
+  */
+
+#include <signal.h>
+#include <stdarg.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "sim.h"
+#include "main.h"
+#include "stepper.h"
+#include "temperature.h"
+#include "cardreader.h"
+#include "ff_gen_drv.h"
+#include "sd_diskio.h"
+#include "arm_math.h"
+#include "usbd_core.h"
+#include "usbd_desc.h"
+#include "usbd_cdc.h"
+#include "usbd_cdc_interface.h"
+
+/* Private Constants ---------------------------------------------------------*/
+
+// Nozzle height over the bed centre at power on (mm)
+#define SIM_START_Z        (10.0f)
+
+// Stepper timer compare register is 16 bits, a missed update waits a wrap
+#define SIM_TICK_WRAP      (0x10000)
+
+#define SIM_FLASH_SIZE     (0x20000)
+
+/* Private Variables ---------------------------------------------------------*/
+
+SimState sim;
+int32_t sim_flash_cut = -1;
+
+volatile uint32_t sim_primask;
+__IO uint32_t uwTick;
+
+// every pin is on the one fake port, gArrayGpioPin[] holds the pin number
+static GPIO_TypeDef simPort;
+GPIO_TypeDef* gArrayGpioPort[BSP_MISC_MAX_PIN_NUMBER];
+uint16_t gArrayGpioPin[BSP_MISC_MAX_PIN_NUMBER];
+static uint8_t pinState[BSP_MISC_MAX_PIN_NUMBER];
+
+Diskio_drvTypeDef SD_Driver;
+
+static const uint8_t stepPin[SIM_AXES] = { X_STEP_PIN, Y_STEP_PIN, Z_STEP_PIN, E0_STEP_PIN };
+static const uint8_t dirPin[SIM_AXES] = { X_DIR_PIN, Y_DIR_PIN, Z_DIR_PIN, E0_DIR_PIN };
+static const uint8_t stepActive[SIM_AXES] = { !INVERT_X_STEP_PIN, !INVERT_Y_STEP_PIN, !INVERT_Z_STEP_PIN, !INVERT_E_STEP_PIN };
+static const uint8_t dirForward[SIM_AXES] = { !INVERT_X_DIR, !INVERT_Y_DIR, !INVERT_Z_DIR, !INVERT_E0_DIR };
+static const float stepsPerMm[SIM_AXES] = DEFAULT_AXIS_STEPS_PER_UNIT;
+
+// tower positions, same convention as recalc_delta_settings()
+static float towerX[3], towerY[3];
+static int32_t carriageTop[3];     // endstop trigger, in steps
+static bool nozzleValid;
+
+static bool inIsr;
+static bool stepperEnabled, tick2Enabled;
+static sim_time_t stepperDue, tick2Due, tick2Period, sysTickDue;
+static sim_time_t plantTime;
+
+static char *rxData;
+static uint32_t rxSize, rxPos;
+static bool usbStarted, rxArmed;
+extern "C" uint8_t rxInProgress;
+extern "C" void BSP_CDC_RxCpltCallback(uint8_t* Buf, uint32_t *Len);
+
+static FILE *traceFile;
+
+#if ENABLED(SDSUPPORT)
+bool sim_no_read_ahead;
+#endif
+
+#if ENABLED(STEP_BURST)
+bool sim_no_step_burst;
+BSP_StepBurstPins_t bspStepBurstPins[BSP_STEP_BURST_FRAMES];
+BSP_StepBurstTimer_t bspStepBurstTimer[BSP_STEP_BURST_FRAMES];
+
+static const uint32_t burstPin[3] = { BSP_STEP_BURST_X, BSP_STEP_BURST_Y, BSP_STEP_BURST_Z };
+
+// the DMA: the next slot it plays, the Tick timer registers it preloaded,
+// and the trace events of the frames filled, waiting for them to be played
+static struct {
+	bool active;
+	uint8_t slot;
+	BSP_StepBurstTimer_t preload;
+	stepper_trace_t filled[BSP_STEP_BURST_FRAMES];
+	uint8_t head, count;
+} burst;
+#endif
+
+static bool verbose;
+static char txLine[MAX_CMD_SIZE*2];
+static uint32_t txLen, okCount;
+
+/* Private Functions ---------------------------------------------------------*/
+
+static void plant_update(void)
+{
+	float dt = (float)(sim.now - plantTime) / SIM_TICK_FREQ;
+	plantTime = sim.now;
+	if (dt <= 0.0f) return;
+	float loss = SIM_HOTEND_LOSS + SIM_HOTEND_FANLOSS * sim.fanSpeed / 255.0f;
+	float p = pinState[HEATER_0_PIN] ? SIM_HOTEND_POWER : 0.0f;
+	sim.hotend += dt * (p - loss * (sim.hotend - SIM_AMBIENT)) / SIM_HOTEND_CAP;
+	p = pinState[HEATER_BED_PIN] ? SIM_BED_POWER : 0.0f;
+	sim.bed += dt * (p - SIM_BED_LOSS * (sim.bed - SIM_AMBIENT)) / SIM_BED_CAP;
+}
+
+// Inverse of Temperature::analog2temp(), per sample ADC value for celsius
+static uint16_t temp2adc(const int (*tt)[2], uint8_t len, float celsius)
+{
+	for (uint8_t i = 1; i < len; i++) {
+		if (tt[i][1] <= celsius) {
+			float t0 = tt[i - 1][1], t1 = tt[i][1];
+			float raw = tt[i - 1][0] + (celsius - t0) * (tt[i][0] - tt[i - 1][0]) / (t1 - t0);
+			return (uint16_t)(raw / OVERSAMPLENR);
+		}
+	}
+	return tt[len - 1][0] / OVERSAMPLENR;
+}
+
+static void step_edge(uint8_t axis)
+{
+	int32_t dir = (pinState[dirPin[axis]] == dirForward[axis]) ? 1 : -1;
+	sim.position[axis] += dir;
+	sim.steps[axis]++;
+	nozzleValid = false;
+}
+
+// drain the trace as it is written, the file gets the whole print
+static void drain_trace(void)
+{
+	if (!traceFile) return;
+	stepper_trace_t e[4];
+	uint16_t n;
+	while ((n = stepperTrace.read(e, COUNT(e)))) {
+#if ENABLED(STEP_BURST)
+		// a frame filled goes in the file as it is played
+		for (uint16_t i = 0; i < n; i++) {
+			if (!(e[i].flags & STEPPER_TRACE_BURST))
+				fwrite(&e[i], sizeof(e[i]), 1, traceFile);
+			else if (burst.count == BSP_STEP_BURST_FRAMES)
+				sim.burstErrors++;
+			else
+				burst.filled[(burst.head + burst.count++) % BSP_STEP_BURST_FRAMES] = e[i];
+		}
+#else
+		fwrite(e, sizeof(e[0]), n, traceFile);
+#endif
+	}
+}
+
+#if ENABLED(STEP_BURST)
+/*
+ * A Tick timer update while the DMA plays a step burst: the registers
+ * preloaded take effect, the next are preloaded, the step pins are pulsed
+ * and the frame is written to the trace as it comes out of the buffers,
+ * checked against what the firmware recorded as it filled it. The frame
+ * that hands back interrupts instead (false).
+ */
+static bool burst_frame(void)
+{
+	const BSP_StepBurstTimer_t regs = burst.preload;
+	const BSP_StepBurstPins_t pins = bspStepBurstPins[burst.slot];
+	burst.preload = bspStepBurstTimer[burst.slot];
+	burst.slot = (burst.slot + 1) % BSP_STEP_BURST_FRAMES;
+	if (regs.ccr1 == 0)
+		return false;
+
+	stepper_trace_t e = { (uint16_t)sim.now, (uint16_t)(regs.arr + 1), 0, 0, 0 };
+	for (uint8_t axis = 0; axis < 3; axis++) {
+		if (pins.set & (burstPin[axis] | burstPin[axis] << 16)) {
+			step_edge(axis);
+			e.steps += STEPPER_TRACE_STEP(axis);
+		}
+	}
+	if (regs.ccr2) {
+		step_edge(E_AXIS);
+		e.steps += STEPPER_TRACE_STEP(E_AXIS);
+	}
+	for (uint8_t axis = 0; axis < SIM_AXES; axis++)
+		if (pinState[dirPin[axis]] != dirForward[axis])
+			e.dirs |= 1 << axis;
+	sim.burstFrames++;
+	stepperDue = sim.now + regs.arr + 1;
+
+	if (traceFile) {
+		if (!burst.count) {
+			sim.burstErrors++;
+		}
+		else {
+			const stepper_trace_t &f = burst.filled[burst.head];
+			burst.head = (burst.head + 1) % BSP_STEP_BURST_FRAMES;
+			burst.count--;
+			if (f.time != e.time || f.period != e.period || f.steps != e.steps || f.dirs != e.dirs)
+				sim.burstErrors++;
+			e.flags = f.flags;
+		}
+		fwrite(&e, sizeof(e), 1, traceFile);
+	}
+
+	// half of the pin words played, the DMA interrupt
+	if (burst.slot == BSP_STEP_BURST_FRAMES / 2 || burst.slot == 0) {
+		sim.burstRefills++;
+		IsrStepBurstHandler();
+		drain_trace();
+	}
+	return true;
+}
+#endif
+
+static void run_stepper(void)
+{
+#if ENABLED(STEP_BURST)
+	if (burst.active && burst_frame())
+		return;
+#endif
+	sim.stepperIsr++;
+	stepperDue = sim.now + SIM_TICK_WRAP;
+	IsrStepperHandler();
+	drain_trace();
+}
+
+static void run_tick2(void)
+{
+	sim.temperatureIsr++;
+	tick2Due += tick2Period;
+	IsrTemperatureHandler();
+}
+
+static void run_systick(void)
+{
+	uwTick++;
+	sysTickDue += SIM_MS_TICKS;
+}
+
+// Dispatch, in timestamp order, every interrupt due up to 'until'
+static void dispatch(sim_time_t until)
+{
+	for (;;) {
+		sim_time_t t = sysTickDue;
+		void (*handler)(void) = run_systick;
+		if (stepperEnabled && stepperDue < t) {
+			t = stepperDue;
+			handler = run_stepper;
+		}
+		if (tick2Enabled && tick2Due < t) {
+			t = tick2Due;
+			handler = run_tick2;
+		}
+		if (t > until || sim_primask || inIsr)
+			break;
+		if (t > sim.now)
+			sim.now = t;
+		inIsr = true;
+		handler();
+		inIsr = false;
+	}
+	if (until > sim.now)
+		sim.now = until;
+}
+
+/*
+ * The USB host: while the firmware has the OUT endpoint armed, send it the
+ * next packet of the input. Like the timer interrupt of
+ * usbd_cdc_interface.c, re-arm it once half the Rx ring is free. The bus
+ * is taken as fast as the firmware can read.
+ */
+static void usb_poll(void)
+{
+	if (!usbStarted || sim_primask || inIsr) return;
+	if (!rxArmed && !rxInProgress && CDC_RX_BUFFER_SIZE - BSP_CdcGetNbRxAvailableBytes(0) > CDC_RX_BUFFER_SIZE / 2)
+		rxArmed = true;
+	while (rxArmed && rxPos < rxSize) {
+		uint8_t packet[CDC_DATA_FS_OUT_PACKET_SIZE];
+		uint32_t len = MIN(rxSize - rxPos, (uint32_t)sizeof(packet));
+		memcpy(packet, &rxData[rxPos], len);
+		rxPos += len;
+		rxArmed = false;
+		inIsr = true;
+		BSP_CDC_RxCpltCallback(packet, &len);
+		inIsr = false;
+	}
+}
+
+static void fault_handler(int sig, siginfo_t *info, void *context)
+{
+	uintptr_t addr = (uintptr_t)info->si_addr;
+	(void)context;
+	if (addr >= PERIPH_BASE && addr < 0xE0100000u) {
+		fprintf(stderr, "sim: peripheral access at %p after %.3fs, firmware reset or an unmodelled register\n",
+				info->si_addr, (double)sim.now / SIM_TICK_FREQ);
+		_exit(3);
+	}
+	signal(sig, SIG_DFL);
+	raise(sig);
+}
+
+/* Exported Functions --------------------------------------------------------*/
+
+void sim_init(void)
+{
+	// settings are read in place from EEPROM_ADDRESS, back the flash with RAM
+	void *flash = mmap((void *)FLASH_BASE, SIM_FLASH_SIZE, PROT_READ | PROT_WRITE,
+#ifdef MAP_FIXED_NOREPLACE
+			MAP_FIXED_NOREPLACE |
+#else
+			MAP_FIXED |
+#endif
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (flash != (void *)FLASH_BASE) {
+		fprintf(stderr, "sim: cannot map the flash at 0x%08x\n", (unsigned)FLASH_BASE);
+		exit(2);
+	}
+	memset(flash, 0xFF, SIM_FLASH_SIZE);
+
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_sigaction = fault_handler;
+	sa.sa_flags = SA_SIGINFO;
+	sigaction(SIGSEGV, &sa, NULL);
+	sigaction(SIGBUS, &sa, NULL);
+
+	for (int i = 0; i < BSP_MISC_MAX_PIN_NUMBER; i++) {
+		gArrayGpioPort[i] = &simPort;
+		gArrayGpioPin[i] = i;
+	}
+
+	const float rod = DELTA_DIAGONAL_ROD, radius = DELTA_RADIUS;
+	const float angle[3] = { 210 - 120, 330 - 120, 90 - 120 };
+	float hStart = SIM_START_Z + sqrtf(sq(rod) - sq(radius));
+	float hTop = MANUAL_Z_HOME_POS + sqrtf(sq(rod) - sq(radius));
+	for (int i = 0; i < 3; i++) {
+		towerX[i] = cosf(RADIANS(angle[i])) * radius;
+		towerY[i] = sinf(RADIANS(angle[i])) * radius;
+		carriageTop[i] = lroundf(hTop * stepsPerMm[i]);
+		sim.position[i] = lroundf(hStart * stepsPerMm[i]);
+	}
+	sim.hotend = sim.bed = SIM_AMBIENT;
+	sim.minNozzleZ = SIM_START_Z;
+	sysTickDue = SIM_MS_TICKS;
+}
+
+void sim_advance(sim_time_t ticks)
+{
+	dispatch(sim.now + ticks);
+	usb_poll();
+}
+
+void sim_idle(void)
+{
+	sim_advance(SIM_IDLE_TICKS);
+}
+
+extern "C" void sim_irq_enabled(void)
+{
+	if (!inIsr)
+		dispatch(sim.now);
+}
+
+// Delta forward kinematics of the simulated machine (trilateration)
+void sim_nozzle(void)
+{
+	if (nozzleValid) return;
+	nozzleValid = true;
+	double p[3][3];
+	for (int i = 0; i < 3; i++) {
+		p[i][0] = towerX[i];
+		p[i][1] = towerY[i];
+		p[i][2] = sim.position[i] / stepsPerMm[i];
+	}
+	double ex[3], ey[3], ez[3], t[3];
+	double d = 0, i_ = 0, j = 0;
+	for (int k = 0; k < 3; k++) ex[k] = p[1][k] - p[0][k];
+	d = sqrt(sq(ex[0]) + sq(ex[1]) + sq(ex[2]));
+	for (int k = 0; k < 3; k++) { ex[k] /= d; t[k] = p[2][k] - p[0][k]; }
+	for (int k = 0; k < 3; k++) i_ += ex[k] * t[k];
+	for (int k = 0; k < 3; k++) ey[k] = t[k] - i_ * ex[k];
+	double eyLen = sqrt(sq(ey[0]) + sq(ey[1]) + sq(ey[2]));
+	for (int k = 0; k < 3; k++) { ey[k] /= eyLen; j += ey[k] * t[k]; }
+	ez[0] = ex[1] * ey[2] - ex[2] * ey[1];
+	ez[1] = ex[2] * ey[0] - ex[0] * ey[2];
+	ez[2] = ex[0] * ey[1] - ex[1] * ey[0];
+	double x = d / 2;
+	double y = ((sq(i_) + sq(j)) / 2 - i_ * x) / j;
+	double z = sqrt(fmax(0.0, sq((double)DELTA_DIAGONAL_ROD) - sq(x) - sq(y)));
+	for (int k = 0; k < 3; k++)
+		sim.nozzle[k] = p[0][k] + x * ex[k] + y * ey[k] - z * ez[k];
+	if (sim.nozzle[Z_AXIS] < sim.minNozzleZ)
+		sim.minNozzleZ = sim.nozzle[Z_AXIS];
+}
+
+// The file, after the lines in before
+bool sim_load_input(const char *path, const char *before)
+{
+	FILE *f = fopen(path, "rb");
+	if (!f) return false;
+	fseek(f, 0, SEEK_END);
+	long size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	const uint32_t prefix = strlen(before);
+	free(rxData);
+	rxData = (char *)malloc(prefix + size + 1);
+	memcpy(rxData, before, prefix);
+	rxSize = prefix + fread(rxData + prefix, 1, size, f);
+	fclose(f);
+	if (rxSize && rxData[rxSize - 1] != '\n')
+		rxData[rxSize++] = '\n';
+	rxPos = 0;
+	return true;
+}
+
+// Replace what is left of the input with size bytes of data
+void sim_set_input(const char *data, uint32_t size)
+{
+	free(rxData);
+	rxData = (char *)malloc(size);
+	memcpy(rxData, data, size);
+	rxSize = size;
+	rxPos = 0;
+}
+
+bool sim_input_done(void) { return rxPos >= rxSize && !BSP_CdcGetNbRxAvailableBytes(0); }
+uint32_t sim_ok_count(void) { return okCount; }
+void sim_set_verbose(bool v) { verbose = v; }
+
+bool sim_trace_open(const char *path)
+{
+	uint32_t rate = SIM_TICK_FREQ;
+	traceFile = fopen(path, "wb");
+	if (!traceFile) return false;
+	fwrite(SIM_TRACE_MAGIC, 1, 4, traceFile);
+	fwrite(&rate, sizeof(rate), 1, traceFile);
+	stepperTrace.start(false);
+	return true;
+}
+
+void sim_trace_close(void)
+{
+	if (!traceFile) return;
+	stepperTrace.stop();
+	fclose(traceFile);
+	traceFile = NULL;
+}
+
+/* HAL -----------------------------------------------------------------------*/
+
+void HAL_Delay(__IO uint32_t Delay)
+{
+	sim_advance((sim_time_t)Delay * SIM_MS_TICKS);
+}
+
+void HAL_GPIO_WritePin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState)
+{
+	if (GPIOx != &simPort || GPIO_Pin >= BSP_MISC_MAX_PIN_NUMBER) return;
+	uint8_t state = (PinState != GPIO_PIN_RESET);
+	if (GPIO_Pin == HEATER_0_PIN || GPIO_Pin == HEATER_BED_PIN)
+		plant_update();
+	for (uint8_t axis = 0; axis < SIM_AXES; axis++)
+		if (GPIO_Pin == stepPin[axis] && state == stepActive[axis] && pinState[GPIO_Pin] != state)
+			step_edge(axis);
+	pinState[GPIO_Pin] = state;
+}
+
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin)
+{
+	if (GPIOx != &simPort || GPIO_Pin >= BSP_MISC_MAX_PIN_NUMBER) return GPIO_PIN_RESET;
+	switch (GPIO_Pin) {
+	case X_MAX_PIN:
+		return (sim.position[A_AXIS] >= carriageTop[A_AXIS]) != X_MAX_ENDSTOP_INVERTING ? GPIO_PIN_SET : GPIO_PIN_RESET;
+	case Y_MAX_PIN:
+		return (sim.position[B_AXIS] >= carriageTop[B_AXIS]) != Y_MAX_ENDSTOP_INVERTING ? GPIO_PIN_SET : GPIO_PIN_RESET;
+	case Z_MAX_PIN:
+		return (sim.position[C_AXIS] >= carriageTop[C_AXIS]) != Z_MAX_ENDSTOP_INVERTING ? GPIO_PIN_SET : GPIO_PIN_RESET;
+	case Z_MIN_PIN:
+		sim_nozzle();
+		return (sim.nozzle[Z_AXIS] <= 0.0f) != Z_MIN_ENDSTOP_INVERTING ? GPIO_PIN_SET : GPIO_PIN_RESET;
+	default:
+		return pinState[GPIO_Pin] ? GPIO_PIN_SET : GPIO_PIN_RESET;
+	}
+}
+
+/* CMSIS-DSP -----------------------------------------------------------------*/
+
+float32_t arm_sin_f32(float32_t x) { return sinf(x); }
+float32_t arm_cos_f32(float32_t x) { return cosf(x); }
+
+/* BSP: timers, motors and misc ----------------------------------------------*/
+
+void BSP_MiscOverallInit(uint8_t nbDevices) { (void)nbDevices; }
+void BSP_MiscSetStepClockToSwMode(void) { }
+void BSP_MiscStopInit(uint8_t id) { (void)id; }
+void BSP_MiscHeatManualInit(uint8_t heatId) { (void)heatId; }
+void BSP_MiscFanInit(uint8_t id) { (void)id; }
+void BSP_MotorControlBoard_Reset(void) { }
+void BSP_MotorControlBoard_ReleaseReset(void) { }
+void BSP_LED_On(Led_TypeDef Led) { (void)Led; }
+void BSP_LED_Off(Led_TypeDef Led) { (void)Led; }
+
+void BSP_MiscFanSetSpeed(uint8_t id, uint8_t speed)
+{
+	if (id == 0) {
+		plant_update();
+		sim.fanSpeed = speed;
+	}
+}
+
+void BSP_MiscTickInit(void) { }
+
+void BSP_MiscTickSetFreq(uint32_t newFreq)
+{
+	uint32_t timPeriod = (CORE_CPU_FREQ / (TICK_TIMER_PRESCALER * newFreq)) - 1;
+	if (timPeriod < 100) timPeriod = 100;
+	if (timPeriod > 0xFFFF) timPeriod = 0xFFFF;
+	stepperDue = sim.now + timPeriod;
+	stepperEnabled = true;
+}
+
+void BSP_MiscTickSetPeriod(uint32_t newTimPeriod)
+{
+	stepperDue = sim.now + newTimPeriod;
+}
+
+void BSP_MiscTickStop(void)
+{
+	stepperEnabled = false;
+}
+
+uint16_t BSP_MiscTickGetCounter(void)
+{
+	return (uint16_t)sim.now;
+}
+
+#if ENABLED(STEP_BURST)
+uint16_t BSP_MiscTickGetCompare(void)
+{
+	return (uint16_t)stepperDue;
+}
+
+// The first frame starts where the interrupt was due
+void BSP_MiscStepBurstStart(void)
+{
+	burst.active = true;
+	burst.slot = 0;
+	burst.preload = bspStepBurstTimer[BSP_STEP_BURST_FRAMES - 1];
+}
+
+// The frames filled and not played never get to the trace
+uint8_t BSP_MiscStepBurstStop(uint16_t count)
+{
+	(void)count;
+	burst.active = false;
+	burst.head = burst.count = 0;
+	return burst.slot;
+}
+#endif
+
+void BSP_MiscTick2Init(void) { }
+
+void BSP_MiscTick2SetFreq(float newPeriod)
+{
+	tick2Period = (uint32_t)(CORE_CPU_FREQ * newPeriod) / TICK_TIMER_PRESCALER;
+	tick2Due = sim.now + tick2Period;
+	tick2Enabled = true;
+}
+
+/* BSP: settings flash -------------------------------------------------------*/
+
+// a flash operation with sim_flash_cut: 1 done, 0 the power goes in it, -1 it has gone
+static int flash_power(void)
+{
+	if (sim_flash_cut == -1) return 1;
+	if (sim_flash_cut > 0) {
+		sim_flash_cut--;
+		return 1;
+	}
+	if (sim_flash_cut == 0) {
+		sim_flash_cut = -2;
+		return 0;
+	}
+	return -1;
+}
+
+static uint16_t flash_noise(void)
+{
+	static uint32_t seed = 1;
+	seed = seed * 1103515245 + 12345;
+	return seed >> 8;
+}
+
+uint8_t BSP_MiscFlashErase(void *page)
+{
+	uint16_t *p = (uint16_t *)page;
+	const int power = flash_power();
+	if (power < 1) {
+		// some bits erased and not others
+		if (!power) for (uint32_t i = 0; i < FLASH_PAGE_SIZE / 2; i++) p[i] |= flash_noise();
+		return 0;
+	}
+	sim.flashErases[((uintptr_t)page - SETTINGS_FLASH_ADDRESS) / FLASH_PAGE_SIZE]++;
+	memset(page, 0xFF, FLASH_PAGE_SIZE);
+	return 1;
+}
+
+uint8_t BSP_MiscFlashWrite(void *destination, const uint16_t *source, uint16_t count)
+{
+	uint16_t *p = (uint16_t *)destination;
+	for (uint16_t i = 0; i < count; i++) {
+		const int power = flash_power();
+		if (power < 1) {
+			// some bits programmed and not others
+			if (!power) p[i] &= source[i] | flash_noise();
+			return 0;
+		}
+		// programming stops at one not erased, as PGERR on the STM32F0
+		if (p[i] != 0xFFFF && source[i]) {
+			sim.flashErrors++;
+			return 0;
+		}
+		sim.flashWrites++;
+		p[i] = source[i];
+	}
+	return 1;
+}
+
+/* BSP: ADC ------------------------------------------------------------------*/
+
+void BSP_AdcHwInit(void) { }
+
+uint16_t BSP_AdcGetValue(uint8_t rankId)
+{
+	plant_update();
+	if (rankId == BSP_ADC_RANK_THERM_BED1 - 1)
+		return temp2adc(BEDTEMPTABLE, BEDTEMPTABLE_LEN, sim.bed);
+	return temp2adc(HEATER_0_TEMPTABLE, HEATER_0_TEMPTABLE_LEN, sim.hotend);
+}
+
+/* USB device library, as far as the CDC layer uses it -----------------------*/
+
+USBD_ClassTypeDef USBD_CDC;
+USBD_CDC_ItfTypeDef USBD_CDC_fops;
+USBD_DescriptorsTypeDef VCP_Desc;
+
+USBD_StatusTypeDef USBD_Init(USBD_HandleTypeDef *pdev, USBD_DescriptorsTypeDef *pdesc, uint8_t id) { return USBD_OK; }
+USBD_StatusTypeDef USBD_DeInit(USBD_HandleTypeDef *pdev) { return USBD_OK; }
+USBD_StatusTypeDef USBD_RegisterClass(USBD_HandleTypeDef *pdev, USBD_ClassTypeDef *pclass) { return USBD_OK; }
+uint8_t USBD_CDC_RegisterInterface(USBD_HandleTypeDef *pdev, USBD_CDC_ItfTypeDef *fops) { return USBD_OK; }
+
+// enumerated, the CDC class arms the OUT endpoint
+USBD_StatusTypeDef USBD_Start(USBD_HandleTypeDef *pdev)
+{
+	usbStarted = rxArmed = true;
+	return USBD_OK;
+}
+
+USBD_StatusTypeDef USBD_Stop(USBD_HandleTypeDef *pdev)
+{
+	usbStarted = rxArmed = false;
+	return USBD_OK;
+}
+
+uint8_t USBD_CDC_ReceivePacket(USBD_HandleTypeDef *pdev)
+{
+	rxInProgress = 1;
+	rxArmed = true;
+	return USBD_OK;
+}
+
+uint8_t CDC_Itf_IsConnected(void) { return 1; }
+uint8_t CDC_Itf_IsTxQueueEmpty(void) { return 1; }
+
+// what the firmware sends, a line at a time
+void CDC_Itf_QueueTxBytes(uint8_t *Buf, uint32_t Len)
+{
+	for (uint32_t i = 0; i < Len; i++) {
+		char c = Buf[i];
+		if (c != '\n') {
+			if (txLen < sizeof(txLine) - 1)
+				txLine[txLen++] = c;
+			continue;
+		}
+		txLine[txLen] = 0;
+		if (!strncmp(txLine, "ok", 2))
+			okCount++;
+		if (!strncmp(txLine, "Error:", 6)) {
+			sim.serialErrors++;
+			if (!verbose)
+				fprintf(stderr, "%s\n", txLine);
+		}
+		if (verbose)
+			printf("%s\n", txLine);
+		txLen = 0;
+	}
+}
+
+void BSP_MiscErrorHandler(uint16_t error)
+{
+	fprintf(stderr, "sim: BSP error 0x%04x after %.3fs\n", error, (double)sim.now / SIM_TICK_FREQ);
+	_exit(3);
+}
+
+/* BSP: UART to the LCD, nothing is connected --------------------------------*/
+
+void BSP_UartHwInit(uint32_t newBaudRate) { (void)newBaudRate; }
+void BSP_UartIfStart(void) { }
+void BSP_UartIfQueueTxData(uint8_t *pBuf, uint32_t nbData) { (void)pBuf; (void)nbData; }
+void BSP_UartIfSendQueuedData(void) { }
+uint32_t BSP_UartGetNbRxAvailableBytes(void) { return 0; }
+uint32_t BSP_UartCopyNextRxBytes(uint8_t *buff, uint32_t maxlen) { (void)buff; (void)maxlen; return 0; }
+int8_t BSP_UartGetNextRxBytes(void) { return -1; }
+
+/* SD card and FatFs, no card is inserted ------------------------------------*/
+
+// weak, a tool that puts a card in links FatFs and a disk driver over them
+__attribute__((weak)) uint8_t BSP_SD_IsDetected(void) { return SD_NOT_PRESENT; }
+__attribute__((weak)) uint8_t FATFS_LinkDriver(Diskio_drvTypeDef *drv, char *path) { (void)drv; (void)path; return 1; }
+__attribute__((weak)) DSTATUS disk_deinitialize(BYTE pdrv) { (void)pdrv; return STA_NOINIT; }
+__attribute__((weak)) DRESULT disk_read(BYTE pdrv, BYTE *buff, DWORD sector, UINT count) { return RES_NOTRDY; }
+__attribute__((weak)) DRESULT disk_write(BYTE pdrv, const BYTE *buff, DWORD sector, UINT count) { return RES_NOTRDY; }
+
+__attribute__((weak)) FRESULT f_mount(FATFS* fs, const TCHAR* path, BYTE opt) { return FR_NOT_READY; }
+__attribute__((weak)) FRESULT f_open(FIL* fp, const TCHAR* path, BYTE mode) { return FR_NOT_READY; }
+__attribute__((weak)) FRESULT f_close(FIL* fp) { return FR_NOT_READY; }
+__attribute__((weak)) FRESULT f_read(FIL* fp, void* buff, UINT btr, UINT* br) { *br = 0; return FR_NOT_READY; }
+__attribute__((weak)) FRESULT f_write(FIL* fp, const void* buff, UINT btw, UINT* bw) { *bw = 0; return FR_NOT_READY; }
+__attribute__((weak)) FRESULT f_lseek(FIL* fp, FSIZE_t ofs) { return FR_NOT_READY; }
+__attribute__((weak)) FRESULT f_sync(FIL* fp) { return FR_NOT_READY; }
+__attribute__((weak)) FRESULT f_opendir(DIR* dp, const TCHAR* path) { return FR_NOT_READY; }
+__attribute__((weak)) FRESULT f_closedir(DIR* dp) { return FR_NOT_READY; }
+__attribute__((weak)) FRESULT f_readdir(DIR* dp, FILINFO* fno) { return FR_NOT_READY; }
+__attribute__((weak)) FRESULT f_unlink(const TCHAR* path) { return FR_NOT_READY; }
@@ -0,0 +1,58 @@
+/**
+  ******************************************************************************
+  * @file    sim/sim_cmsis.h
+  * @brief   Host replacements for the Cortex-M0 core intrinsics
+  * @note    Force-included by the "make sim" build. Claims the cmsis_gcc.h
+  *          include guard so none of its ARM inline assembly is compiled,
+  *          interrupt masking is tracked by the simulator instead.
+  ******************************************************************************
+  */
+#ifndef __SIM_CMSIS_H
+#define __SIM_CMSIS_H
+
+#define __CMSIS_GCC_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* PRIMASK of the simulated core, interrupts are only dispatched while 0 */
+extern volatile uint32_t sim_primask;
+void sim_irq_enabled(void);
+
+static inline void __enable_irq(void) { sim_primask = 0; sim_irq_enabled(); }
+static inline void __disable_irq(void) { sim_primask = 1; }
+static inline uint32_t __get_PRIMASK(void) { return sim_primask; }
+static inline void __set_PRIMASK(uint32_t priMask) { sim_primask = priMask; if (!priMask) sim_irq_enabled(); }
+static inline uint32_t __get_CONTROL(void) { return 0; }
+static inline void __set_CONTROL(uint32_t control) { (void)control; }
+static inline uint32_t __get_IPSR(void) { return 0; }
+static inline uint32_t __get_APSR(void) { return 0; }
+static inline uint32_t __get_xPSR(void) { return 0; }
+static inline uint32_t __get_PSP(void) { return 0; }
+static inline void __set_PSP(uint32_t topOfProcStack) { (void)topOfProcStack; }
+static inline uint32_t __get_MSP(void) { return 0; }
+static inline void __set_MSP(uint32_t topOfMainStack) { (void)topOfMainStack; }
+
+static inline void __NOP(void) { }
+static inline void __WFI(void) { }
+static inline void __WFE(void) { }
+static inline void __SEV(void) { }
+static inline void __ISB(void) { }
+static inline void __DSB(void) { }
+static inline void __DMB(void) { }
+
+static inline uint32_t __REV(uint32_t value) { return __builtin_bswap32(value); }
+static inline uint32_t __REV16(uint32_t value) { return ((value & 0x00ff00ffUL) << 8) | ((value >> 8) & 0x00ff00ffUL); }
+static inline int32_t __REVSH(int32_t value) { return (int16_t)__builtin_bswap16((uint16_t)value); }
+static inline uint32_t __ROR(uint32_t op1, uint32_t op2) { op2 &= 31; return op2 ? (op1 >> op2) | (op1 << (32 - op2)) : op1; }
+#define __BKPT(value) __builtin_trap()
+#define __CLZ __builtin_clz
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SIM_CMSIS_H */
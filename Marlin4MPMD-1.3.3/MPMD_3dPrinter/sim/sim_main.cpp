@@ -0,0 +1,131 @@
+/**
+  ******************************************************************************
+  * @file    sim/sim_main.cpp
+  * @brief   Host simulator entry point, streams a G-code file to the firmware
+  *          over the (simulated) USB CDC and reports the result
+  * @note    build: make sim
+  *          usage: build_sim/marlin_sim [-v] [-I] [-e gcode] [-t seconds]
+  *                     [-T trace] file.gcode
+  *            -v  echo everything the firmware sends back
+  *            -e  send this line ahead of the file, to change settings:
+  *                -e "M205 J0.02" (may be given more than once)
+  *            -t  give up after this much virtual time (default 24h)
+  *            -T  write the stepper step timeline to this file, for
+  *                build_sim/trace_analyze
+  *            -I  every step by the stepper interrupt, no step bursts
+  *                (STEP_BURST)
+  *          Exits with 1 if the firmware reported an error (or a step
+  *          burst played other steps than it recorded), 2 on a bad
+  *          command line and 3 if it ran past the time limit or reset.
+  ******************************************************************************
+  */
+
+#include <time.h>
+#include <unistd.h>
+#include <string>
+
+#include "sim.h"
+#include "planner.h"
+
+static double host_seconds(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char **argv)
+{
+	double limit = 24 * 3600.0;
+	const char *trace = NULL;
+	std::string before;
+	int opt;
+	while ((opt = getopt(argc, argv, "vIe:t:T:")) != -1) {
+		switch (opt) {
+		case 'v':
+			sim_set_verbose(true);
+			break;
+		case 'I':
+#if ENABLED(STEP_BURST)
+			sim_no_step_burst = true;
+#endif
+			break;
+		case 'e':
+			before += optarg;
+			before += '\n';
+			break;
+		case 't':
+			limit = atof(optarg);
+			break;
+		case 'T':
+			trace = optarg;
+			break;
+		default:
+			optind = argc;
+			break;
+		}
+	}
+	if (optind != argc - 1) {
+		fprintf(stderr, "usage: %s [-v] [-I] [-e gcode] [-t seconds] [-T trace] file.gcode\n", argv[0]);
+		return 2;
+	}
+
+	sim_init();
+	if (!sim_load_input(argv[optind], before.c_str())) {
+		fprintf(stderr, "sim: cannot read %s\n", argv[optind]);
+		return 2;
+	}
+	if (trace && !sim_trace_open(trace)) {
+		fprintf(stderr, "sim: cannot write %s\n", trace);
+		return 2;
+	}
+
+	// CardReader() arms the SD autostart 5s after reset and setup() spins
+	// on millis() until then, start the clock there.
+	sim_advance((sim_time_t)5000 * SIM_MS_TICKS);
+	setup();
+
+	sim_time_t start = sim.now;
+	sim_time_t end = start + (sim_time_t)(limit * SIM_TICK_FREQ);
+	double hostStart = host_seconds();
+
+	// run until the input is consumed, the command queue is empty (a pass
+	// through loop() acknowledges nothing) and the planner has drained
+	for (;;) {
+		uint32_t ok = sim_ok_count();
+		loop();
+		if (sim_input_done() && sim_ok_count() == ok && !planner.blocks_queued())
+			break;
+		if (sim.now > end) {
+			fprintf(stderr, "sim: time limit reached\n");
+			return 3;
+		}
+	}
+
+	double hostTime = host_seconds() - hostStart;
+	sim_trace_close();
+	double printTime = (double)(sim.now - start) / SIM_TICK_FREQ;
+	sim_nozzle();
+
+	printf("print time   %.3f s\n", printTime);
+	printf("host time    %.3f s (x%.0f)\n", hostTime, hostTime > 0 ? printTime / hostTime : 0.0);
+	printf("commands     %u\n", (unsigned)sim_ok_count());
+	printf("steps        A %u  B %u  C %u  E %u\n",
+			(unsigned)sim.steps[A_AXIS], (unsigned)sim.steps[B_AXIS],
+			(unsigned)sim.steps[C_AXIS], (unsigned)sim.steps[E_AXIS]);
+	printf("interrupts   stepper %u  temperature %u\n",
+			(unsigned)sim.stepperIsr, (unsigned)sim.temperatureIsr);
+#if ENABLED(STEP_BURST)
+	printf("step bursts  frames %u  refills %u\n",
+			(unsigned)sim.burstFrames, (unsigned)sim.burstRefills);
+#endif
+	printf("nozzle       X %.3f  Y %.3f  Z %.3f  (lowest Z %.3f)\n",
+			sim.nozzle[X_AXIS], sim.nozzle[Y_AXIS], sim.nozzle[Z_AXIS], sim.minNozzleZ);
+	printf("temperature  hotend %.1f  bed %.1f\n", sim.hotend, sim.bed);
+	if (sim.serialErrors)
+		printf("errors       %u\n", (unsigned)sim.serialErrors);
+	if (sim.burstErrors)
+		printf("burst errors %u\n", (unsigned)sim.burstErrors);
+
+	return sim.serialErrors || sim.burstErrors ? 1 : 0;
+}
@@ -0,0 +1,253 @@
+/**
+  ******************************************************************************
+  * @file    sim/testdeltafixed.cpp
+  * @brief   Accuracy and cost of the Q16.16 delta inverse kinematics
+  *          (DELTA_FIXED_POINT, Marlin/delta_fixed.h) against the float
+  *          inverse_kinematics() and calc_delta_adjust() of Marlin_main.cpp
+  * @note    build: make sim
+  *          usage: build_sim/testdeltafixed [-s mm]
+  *            -s  sweep step across the printable disc (default 0.05mm)
+  *          Every point of the DELTA_PRINTABLE_RADIUS disc on a grid of the
+  *          sweep step, at a height that changes from point to point, goes
+  *          through both versions, on the nominal geometry and on one with
+  *          tower angle, radius and rod trims. Points where a rod would be
+  *          (nearly) horizontal are only counted, see MIN_ROD_HEIGHT. A made up bed_level[] grid
+  *          with unprobed (NAN) corners is interpolated on top. Exits with
+  *          1 if a carriage height is more than MAX_ERROR off the float
+  *          version, or the two disagree on whether a point is levelled.
+  *          The double precision error of both is listed for scale.
+  *          A rod too long for Q16.16 must be turned down by set_tower(),
+  *          and points a rod's length or more off a tower must come out
+  *          as the float version has them.
+  *          There are no timings: the host has an FPU, M931 counts the
+  *          cycles of both versions on the printer.
+  ******************************************************************************
+  */
+
+#include <unistd.h>
+
+#include "sim.h"
+#include "delta_fixed.h"
+
+/* Private Constants ---------------------------------------------------------*/
+
+// an eighth of a step of the towers
+#define MAX_ERROR      (0.125 / 114.29)
+// the least height of a carriage over the effector: with the rod closer to
+// horizontal the carriage height is as good as undefined (a change of
+// 1/65536mm at the effector moves it more than a step), the carriage
+// hits the effector anyway
+#define MIN_ROD_HEIGHT (5.0)
+
+/* Private Types -------------------------------------------------------------*/
+
+typedef struct {
+	const char *name;
+	float angleTrim[3], radiusTrim[3], rodTrim[3];
+} Geometry;
+
+typedef struct {
+	double fixedFloat, fixedDouble, floatDouble;  // worst carriage errors (mm)
+	float at[2];                                  // where fixedFloat was worst
+} Errors;
+
+/* Private Variables ---------------------------------------------------------*/
+
+float bed_level[AUTO_BED_LEVELING_GRID_POINTS][AUTO_BED_LEVELING_GRID_POINTS];
+float delta_grid_spacing[2];
+
+static const Geometry geometries[] = {
+	{ "nominal", { 0, 0, 0 }, { 0, 0, 0 }, { 0, 0, 0 } },
+	{ "trimmed", { 0.35, -0.2, 0 }, { 0.25, -0.15, 0.1 }, { 0.2, 0, -0.3 } }
+};
+
+// float version, as recalc_delta_settings() sets it up
+static float towerX[3], towerY[3], rod2[3];
+
+/* Private Functions ---------------------------------------------------------*/
+
+// false if the fixed point version turns it down
+static bool set_geometry(const Geometry &g, float rod = DELTA_DIAGONAL_ROD)
+{
+	static const float angle[3] = { 210 - 120, 330 - 120, 90 - 120 };
+	bool fits = true;
+	for (int i = 0; i < 3; i++) {
+		towerX[i] = cos(RADIANS(angle[i] + g.angleTrim[i])) * (DELTA_RADIUS + g.radiusTrim[i]);
+		towerY[i] = sin(RADIANS(angle[i] + g.angleTrim[i])) * (DELTA_RADIUS + g.radiusTrim[i]);
+		rod2[i] = sq(rod + g.rodTrim[i]);
+		fits &= deltaFixed.set_tower(i, towerX[i], towerY[i], rod2[i]);
+	}
+	return fits;
+}
+
+// inverse_kinematics() without DELTA_FIXED_POINT
+static void float_ik(const float c[3], float delta[3])
+{
+	for (int i = 0; i < 3; i++) {
+		arm_sqrt_f32(rod2[i] - sq(towerX[i] - c[X_AXIS]) - sq(towerY[i] - c[Y_AXIS]), &delta[i]);
+		delta[i] += c[Z_AXIS];
+	}
+}
+
+static void double_ik(const float c[3], double delta[3])
+{
+	for (int i = 0; i < 3; i++)
+		delta[i] = sqrt((double)rod2[i] - sq((double)towerX[i] - c[X_AXIS]) - sq((double)towerY[i] - c[Y_AXIS])) + c[Z_AXIS];
+}
+
+// calc_delta_adjust()
+static float float_adjust(const float c[3])
+{
+	if (delta_grid_spacing[X_AXIS] == 0 || delta_grid_spacing[Y_AXIS] == 0) return NAN;
+	int half = (AUTO_BED_LEVELING_GRID_POINTS - 1) / 2;
+	float h1 = 0.001 - half, h2 = half - 0.001,
+	      grid_x = max(h1, min(h2, c[X_AXIS] / delta_grid_spacing[X_AXIS])),
+	      grid_y = max(h1, min(h2, c[Y_AXIS] / delta_grid_spacing[Y_AXIS]));
+	int floor_x = floor(grid_x), floor_y = floor(grid_y);
+	float ratio_x = grid_x - floor_x, ratio_y = grid_y - floor_y,
+	      z1 = bed_level[floor_x + half][floor_y + half],
+	      z2 = bed_level[floor_x + half][floor_y + half + 1],
+	      z3 = bed_level[floor_x + half + 1][floor_y + half],
+	      z4 = bed_level[floor_x + half + 1][floor_y + half + 1],
+	      left = (1 - ratio_y) * z1 + ratio_y * z2,
+	      right = (1 - ratio_y) * z3 + ratio_y * z4;
+	return (1 - ratio_x) * left + ratio_x * right;
+}
+
+// points out of every rod's reach, the squares of the distances past 32768 mm^2
+static uint32_t out_of_reach(void)
+{
+	static const float points[][3] = { { 300, -250, 10 }, { -200, 190, 0 }, { 0, -400, 50 }, { 260, 0, 5 } };
+	uint32_t wrong = 0;
+	for (unsigned p = 0; p < COUNT(points); p++) {
+		float fl[3];
+		float_ik(points[p], fl);
+		deltaFixed.inverse_kinematics(points[p]);
+		for (int a = 0; a < 3; a++)
+			if (fabs(q16_to_float(deltaFixed.carriage[a]) - fl[a]) > MAX_ERROR) wrong++;
+	}
+	return wrong;
+}
+
+// a tilted, wavy bed with the corners outside the probe radius unprobed
+static void set_bed_level(void)
+{
+	const int half = (AUTO_BED_LEVELING_GRID_POINTS - 1) / 2;
+	delta_grid_spacing[X_AXIS] = (RIGHT_PROBE_BED_POSITION - LEFT_PROBE_BED_POSITION) / (AUTO_BED_LEVELING_GRID_POINTS - 1);
+	delta_grid_spacing[Y_AXIS] = (BACK_PROBE_BED_POSITION - FRONT_PROBE_BED_POSITION) / (AUTO_BED_LEVELING_GRID_POINTS - 1);
+	for (int x = 0; x < AUTO_BED_LEVELING_GRID_POINTS; x++)
+		for (int y = 0; y < AUTO_BED_LEVELING_GRID_POINTS; y++)
+			bed_level[x][y] = sq(x - half) + sq(y - half) > sq(half) + 1 ? NAN
+					: 0.004f * (x - half) * 15 - 0.003f * (y - half) * 15 + 0.08f * sin(x * 1.7 + y * 0.9);
+}
+
+static float sweep_z(uint32_t n)
+{
+	return (n * 2654435761u >> 8) % 120000 / 1000.0f;
+}
+
+static uint32_t sweep(float step, Errors &e, uint32_t &levelled)
+{
+	uint32_t points = 0, shallow = 0, mismatches = 0;
+	const int n = DELTA_PRINTABLE_RADIUS / step;
+	memset(&e, 0, sizeof(e));
+	levelled = 0;
+	for (int i = -n; i <= n; i++) {
+		for (int j = -n; j <= n; j++) {
+			const float c[3] = { i * step, j * step, sweep_z(points) };
+			if (sq(c[X_AXIS]) + sq(c[Y_AXIS]) > sq(DELTA_PRINTABLE_RADIUS)) continue;
+			points++;
+
+			float fl[3], fx[3];
+			double db[3];
+			double_ik(c, db);
+			if (!(min(db[0], min(db[1], db[2])) - c[Z_AXIS] >= MIN_ROD_HEIGHT)) {
+				shallow++;
+				continue;
+			}
+			float_ik(c, fl);
+			deltaFixed.inverse_kinematics(c);
+
+			float offset = float_adjust(c);
+			q16_t qoffset;
+			const bool fixedLevel = deltaFixed.bed_level_offset(c[X_AXIS], c[Y_AXIS], qoffset);
+			if (fixedLevel != !isnan(offset)) mismatches++;
+			if (fixedLevel) levelled++;
+			if (isnan(offset)) offset = 0;
+			if (!fixedLevel) qoffset = 0;
+
+			for (int a = 0; a < 3; a++) {
+				fx[a] = q16_to_float(deltaFixed.carriage[a] + qoffset);
+				fl[a] += offset;
+				double errFixed = fabs(fx[a] - fl[a]);
+				if (errFixed > e.fixedFloat) {
+					e.fixedFloat = errFixed;
+					e.at[0] = c[X_AXIS];
+					e.at[1] = c[Y_AXIS];
+				}
+				NOLESS(e.fixedDouble, fabs(fx[a] - (db[a] + offset)));
+				NOLESS(e.floatDouble, fabs(fl[a] - (db[a] + offset)));
+			}
+		}
+	}
+	printf("%u points, %u out of reach", (unsigned)points, (unsigned)shallow);
+	return mismatches;
+}
+
+/* Exported Functions --------------------------------------------------------*/
+
+int main(int argc, char **argv)
+{
+	float step = 0.05;
+	int opt;
+	while ((opt = getopt(argc, argv, "s:")) != -1) {
+		if (opt == 's') step = atof(optarg);
+		else optind = argc;
+	}
+	if (optind != argc || step <= 0) {
+		fprintf(stderr, "usage: %s [-s mm]\n", argv[0]);
+		return 2;
+	}
+
+	uint32_t failed = 0;
+	set_bed_level();
+	for (unsigned g = 0; g < COUNT(geometries); g++) {
+		Errors e;
+		uint32_t levelled;
+		if (!set_geometry(geometries[g])) {
+			printf("FAIL: %s geometry turned down\n", geometries[g].name);
+			failed++;
+			continue;
+		}
+		printf("%-8s     ", geometries[g].name);
+		uint32_t mismatches = sweep(step, e, levelled);
+		printf(", %u levelled\n", (unsigned)levelled);
+		printf("             fixed-float %.6f mm at X%.2f Y%.2f, fixed-double %.6f mm, float-double %.6f mm\n",
+				e.fixedFloat, e.at[0], e.at[1], e.fixedDouble, e.floatDouble);
+		if (mismatches) {
+			printf("FAIL: %u points levelled by one version only\n", (unsigned)mismatches);
+			failed++;
+		}
+		if (e.fixedFloat > MAX_ERROR) {
+			printf("FAIL: more than %.6f mm off\n", MAX_ERROR);
+			failed++;
+		}
+	}
+
+	// M665 L200: the rod squared is past Q16.16, the float kinematics are used
+	if (set_geometry(geometries[0], 200)) {
+		printf("FAIL: a 200mm rod taken in fixed point\n");
+		failed++;
+	}
+	set_geometry(geometries[0]);
+	const uint32_t wrong = out_of_reach();
+	printf("range        200mm rod turned down, %u of %u heights out of reach wrong\n", (unsigned)wrong, 12u);
+	if (wrong) {
+		printf("FAIL: heights out of reach not as the float version\n");
+		failed++;
+	}
+
+	if (failed) return 1;
+	printf("PASS\n");
+	return 0;
+}
@@ -0,0 +1,160 @@
+/**
+  ******************************************************************************
+  * @file    sim/testdeltasegments.cpp
+  * @brief   Error bound of the forward differenced delta segments
+  *          (DeltaFixed::line_begin()/line_next(), Marlin/delta_fixed.h)
+  *          against an exact solve of every segment
+  * @note    build: make sim
+  *          usage: build_sim/testdeltasegments [-n lines] [-s segments/s]
+  *            -n  random lines per rate (default 10000)
+  *            -s  test this delta_segments_per_second (M665 S) only,
+  *                default 100, 200, 400 and 1000
+  *          Lines run between random points of the printable disc, level or
+  *          sloped, at 5 to 150mm/s, split into segments the way
+  *          prepare_kinematic_move_to() splits them. Every segment end is
+  *          compared with DeltaFixed::inverse_kinematics() of the same
+  *          position, which is what each segment cost before. Exits with 1
+  *          if one is more than DELTA_SEGMENT_TOLERANCE (and the rounding of
+  *          two Q16.16 lsb) off.
+  *          "solves" counts the exact solutions: per segment it is the
+  *          share of the inverse kinematics work that is left.
+  ******************************************************************************
+  */
+
+#include <unistd.h>
+
+#include "sim.h"
+#include "delta_fixed.h"
+
+/* Private Constants ---------------------------------------------------------*/
+
+#define MAX_ERROR (DELTA_SEGMENT_TOLERANCE + 2.0 / Q16_ONE)
+
+/* Private Types -------------------------------------------------------------*/
+
+typedef struct {
+	uint32_t lines, segments, solves, chunked;
+	double worst;
+	float at[6];  // line of the worst segment
+} Result;
+
+/* Private Variables ---------------------------------------------------------*/
+
+float bed_level[AUTO_BED_LEVELING_GRID_POINTS][AUTO_BED_LEVELING_GRID_POINTS];
+float delta_grid_spacing[2];
+
+static uint32_t seed = 1;
+
+/* Private Functions ---------------------------------------------------------*/
+
+static float random_float(float from, float to)
+{
+	seed = seed * 1664525u + 1013904223u;
+	return from + (to - from) * (seed >> 8) / 16777216.0f;
+}
+
+static void random_point(float p[3])
+{
+	do {
+		p[X_AXIS] = random_float(-DELTA_PRINTABLE_RADIUS, DELTA_PRINTABLE_RADIUS);
+		p[Y_AXIS] = random_float(-DELTA_PRINTABLE_RADIUS, DELTA_PRINTABLE_RADIUS);
+	} while (HYPOT(p[X_AXIS], p[Y_AXIS]) > DELTA_PRINTABLE_RADIUS);
+	p[Z_AXIS] = random_float(0, 100);
+}
+
+// Tower positions, as recalc_delta_settings()
+static void set_geometry(void)
+{
+	static const float angle[3] = { 210 - 120, 330 - 120, 90 - 120 };
+	for (int i = 0; i < 3; i++)
+		deltaFixed.set_tower(i, cos(RADIANS(angle[i])) * DELTA_RADIUS, sin(RADIANS(angle[i])) * DELTA_RADIUS, sq(DELTA_DIAGONAL_ROD));
+}
+
+static void run_line(const float start[3], const float end[3], float segmentsPerSecond, Result &r)
+{
+	// prepare_kinematic_move_to()
+	const float length = sqrt(sq(end[X_AXIS] - start[X_AXIS]) + sq(end[Y_AXIS] - start[Y_AXIS]) + sq(end[Z_AXIS] - start[Z_AXIS]));
+	const int segments = max(1, int(segmentsPerSecond * length / random_float(5, 150)));
+	const float inv = 1.0 / segments;
+
+	deltaFixed.line_begin(start, end, segments);
+	r.lines++;
+	if (deltaFixed.chunk_max > 1) {
+		r.chunked++;
+		r.solves += 2;
+	}
+	for (int s = 1; s <= segments; s++) {
+		const bool chunkStart = !deltaFixed.chunk_left;
+		deltaFixed.line_next();
+		if (chunkStart) r.solves += deltaFixed.chunk_left ? 2 : 1;
+		r.segments++;
+
+		q16_t stepped[3];
+		memcpy(stepped, deltaFixed.carriage, sizeof(stepped));
+		float position[3];
+		for (int i = 0; i < 3; i++)
+			position[i] = start[i] + (end[i] - start[i]) * (float(s) * inv);
+		deltaFixed.inverse_kinematics(position);
+		for (int i = 0; i < 3; i++) {
+			const double error = fabs((double)(stepped[i] - deltaFixed.carriage[i]) / Q16_ONE);
+			if (error > r.worst) {
+				r.worst = error;
+				memcpy(r.at, start, sizeof(float) * 3);
+				memcpy(r.at + 3, end, sizeof(float) * 3);
+			}
+		}
+		// line_next() starts the next chunk from carriage[]
+		memcpy(deltaFixed.carriage, stepped, sizeof(stepped));
+	}
+}
+
+/* Exported Functions --------------------------------------------------------*/
+
+int main(int argc, char **argv)
+{
+	static const float defaultRates[] = { 100, 200, 400, 1000 };
+	const float *rates = defaultRates;
+	float rate;
+	unsigned nRates = COUNT(defaultRates);
+	uint32_t lines = 10000;
+	int opt;
+	while ((opt = getopt(argc, argv, "n:s:")) != -1) {
+		switch (opt) {
+		case 'n': lines = atol(optarg); break;
+		case 's': rate = atof(optarg); rates = &rate; nRates = 1; break;
+		default: optind = argc; break;
+		}
+	}
+	if (optind != argc || !lines) {
+		fprintf(stderr, "usage: %s [-n lines] [-s segments/s]\n", argv[0]);
+		return 2;
+	}
+
+	set_geometry();
+	printf("tolerance    %.4f mm\n", (double)DELTA_SEGMENT_TOLERANCE);
+	uint32_t failed = 0;
+	for (unsigned k = 0; k < nRates; k++) {
+		Result r;
+		memset(&r, 0, sizeof(r));
+		for (uint32_t n = 0; n < lines; n++) {
+			float start[3], end[3];
+			random_point(start);
+			random_point(end);
+			// half of them level, like the perimeters and infill of a layer
+			if (n & 1) end[Z_AXIS] = start[Z_AXIS];
+			run_line(start, end, rates[k], r);
+		}
+		printf("%4.0f seg/s   %u lines (%u chunked), %u segments, %.3f solves per segment\n",
+				rates[k], (unsigned)r.lines, (unsigned)r.chunked, (unsigned)r.segments, (double)r.solves / r.segments);
+		printf("             worst %.6f mm, X%.2f Y%.2f Z%.2f to X%.2f Y%.2f Z%.2f\n",
+				r.worst, r.at[0], r.at[1], r.at[2], r.at[3], r.at[4], r.at[5]);
+		if (r.worst > MAX_ERROR) {
+			printf("FAIL: more than %.6f mm off\n", MAX_ERROR);
+			failed++;
+		}
+	}
+
+	if (failed) return 1;
+	printf("PASS\n");
+	return 0;
+}
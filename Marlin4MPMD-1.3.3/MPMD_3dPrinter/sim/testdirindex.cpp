@@ -0,0 +1,296 @@
+/**
+  ******************************************************************************
+  * @file    sim/testdirindex.cpp
+  * @brief   Directory sectors read listing and selecting the files of a
+  *          directory on the LCD, with the index CardReader keeps of the
+  *          working directory (sd_dirindex.h) and by reading it through as
+  *          before, through the real FatFs on a card image
+  * @note    build: make sim
+  *          usage: build_sim/testdirindex [-c bytes] [-n files]
+  *            -c  cluster size of the card (default 4096)
+  *            -n  files in the subdirectory (default 300)
+  *          The card is a RAM image formatted with f_mkfs(). The root
+  *          directory gets a sixth of the files and a subdirectory all of
+  *          them: long names, 8.3 names in upper and in lower case, folders,
+  *          and entries the listing leaves out ('_' names, no extension),
+  *          with every fifth one deleted again. Each directory is paged
+  *          through as the Malyan LCD does it ({S:L}, then "63" for the next
+  *          page: getnrfilenames() and getfilename() for each file of the
+  *          page), then every file is looked up by its long name as M23
+  *          does (getfilename(0, name)). "list" and "find" count the sectors
+  *          read, "most" the most for one indexed file. Then a file is
+  *          written and one removed, the index is thrown away as CardReader
+  *          does, and it all runs again. Every file must come out as it did
+  *          before, files up to SD_DIR_INDEX_SIZE must be indexed unless the
+  *          directory has more than SD_DIR_INDEX_CLUSTERS clusters, an
+  *          indexed one may cost two sectors at most, and a short name must
+  *          find its file too, or it exits with 1.
+  ******************************************************************************
+  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "ff_gen_drv.h"
+#include "sd_dirindex.h"
+
+/* Private Constants ---------------------------------------------------------*/
+
+// a 64MB card
+#define CARD_SECTORS   (131072)
+// files to a page of the Malyan LCD, LCD_MAX_FILES - 1
+#define PAGE_FILES     (63)
+
+/* Private Variables ---------------------------------------------------------*/
+
+static std::vector<uint8_t> image;
+static uint32_t reads;
+static uint32_t failed;
+
+static SdDirIndex dirIndex;
+
+/* Private Functions ---------------------------------------------------------*/
+
+static DSTATUS ram_initialize(BYTE lun) { return 0; }
+static DSTATUS ram_status(BYTE lun) { return 0; }
+
+static DRESULT ram_read(BYTE lun, BYTE *buff, DWORD sector, UINT count)
+{
+	if (sector + count > CARD_SECTORS) return RES_PARERR;
+	reads += count;
+	memcpy(buff, &image[(size_t)sector * 512], count * 512);
+	return RES_OK;
+}
+
+static DRESULT ram_write(BYTE lun, const BYTE *buff, DWORD sector, UINT count)
+{
+	if (sector + count > CARD_SECTORS) return RES_PARERR;
+	memcpy(&image[(size_t)sector * 512], buff, count * 512);
+	return RES_OK;
+}
+
+static DRESULT ram_ioctl(BYTE lun, BYTE cmd, void *buff)
+{
+	switch (cmd) {
+	case CTRL_SYNC: return RES_OK;
+	case GET_SECTOR_COUNT: *(DWORD *)buff = CARD_SECTORS; return RES_OK;
+	case GET_SECTOR_SIZE: *(WORD *)buff = 512; return RES_OK;
+	case GET_BLOCK_SIZE: *(DWORD *)buff = 1; return RES_OK;
+	}
+	return RES_PARERR;
+}
+
+static Diskio_drvTypeDef RamDriver = { ram_initialize, ram_status, ram_read, ram_write, ram_ioctl };
+
+static void fail(const char *what, const char *dir)
+{
+	printf("FAIL: %s, in %s\n", what, dir);
+	failed++;
+}
+
+static bool write_file(const std::string &name)
+{
+	static FIL file;
+	UINT put;
+	return f_open(&file, name.c_str(), FA_WRITE | FA_CREATE_ALWAYS) == FR_OK
+	    && f_write(&file, name.data(), name.size(), &put) == FR_OK && f_close(&file) == FR_OK;
+}
+
+// n entries of every kind, every fifth deleted again
+static bool fill(const char *dir, uint32_t n)
+{
+	static const char *const words[] = { "benchy", "calibration cube", "frog", "Nautilus shell", "spool holder v2", "x" };
+	char name[96];
+	std::vector<std::string> made;
+	for (uint32_t i = 0; i < n; i++) {
+		switch (i % 10) {
+		case 0: snprintf(name, sizeof(name), "%s/J%05u.G", dir, (unsigned)i); break;           // 8.3, no long name
+		case 1: snprintf(name, sizeof(name), "%s/j%u.gco", dir, (unsigned)i); break;           // 8.3 in lower case
+		case 2: snprintf(name, sizeof(name), "%s/_tmp%u.g", dir, (unsigned)i); break;          // left out
+		case 3: snprintf(name, sizeof(name), "%s/NOEXT%u", dir, (unsigned)i); break;           // left out
+		case 4: snprintf(name, sizeof(name), "%s/Folder %u", dir, (unsigned)i); break;         // a directory
+		default: snprintf(name, sizeof(name), "%s/%s %03u.gcode", dir, words[i % 6], (unsigned)i); break;
+		}
+		if (i % 10 == 4 ? f_mkdir(name) != FR_OK : !write_file(name)) return false;
+		made.push_back(name);
+	}
+	for (uint32_t i = 3; i < made.size(); i += 5)
+		if (f_unlink(made[i].c_str()) != FR_OK) return false;
+	return true;
+}
+
+// CardReader::lsDive() as getfilename() and getnrfilenames() ran it: the
+// directory read from the start up to the file, or the last one
+static uint16_t old_walk(DIR *dir, uint16_t nr, const char *match, FILINFO *out)
+{
+	FILINFO entry;
+	uint16_t cnt = 0;
+	f_readdir(dir, 0);
+	while (f_readdir(dir, &entry) == FR_OK && entry.fname[0] != '\0') {
+		const uint8_t fn0 = entry.fname[0];
+		if (fn0 == 0xE5 || fn0 == '.' || fn0 == '_') continue;
+		if (!(entry.fattrib & AM_DIR) && !strchr(entry.fname, '.')) continue;
+		if (out) *out = entry;
+		if (match) {
+			if (strcasecmp(match, entry.fname) == 0) return cnt;
+		}
+		else if (out && cnt == nr) return cnt;
+		cnt++;
+	}
+	return cnt;
+}
+
+// CardReader::getfilename(), with the index or without it
+static bool getfilename(DIR *dir, bool withIndex, uint16_t nr, const char *match, FILINFO *out)
+{
+	if (!withIndex) {
+		out->fname[0] = 0;
+		old_walk(dir, nr, match, out);
+		return out->fname[0] != 0;
+	}
+	if (!dirIndex.valid && !dirIndex.build(dir)) return false;
+	const bool found = match ? dirIndex.find(dir, match, out) >= 0 : dirIndex.read(dir, nr, out);
+	return found || (dirIndex.files && dirIndex.read(dir, dirIndex.files - 1, out));
+}
+
+// CardReader::getnrfilenames()
+static uint16_t getnrfilenames(DIR *dir, bool withIndex)
+{
+	if (!withIndex) return old_walk(dir, 0, NULL, NULL);
+	if (!dirIndex.valid && !dirIndex.build(dir)) return 0;
+	return dirIndex.files;
+}
+
+// The LCD's pages of the directory, and the files one by one by name
+static void run(const char *path, const char *label, FATFS &fs)
+{
+	static DIR dir;
+	std::vector<FILINFO> listed[2];
+	uint32_t list[2], find[2], most = 0, dirClusters = 0;
+	uint16_t files[2];
+
+	// the clusters of the directory, none for the root of FAT12/16
+	FILINFO entry;
+	if (f_opendir(&dir, path) != FR_OK) {
+		fail("can't open the directory", label);
+		return;
+	}
+	DWORD end = 0;
+	while (f_readdir(&dir, &entry) == FR_OK && entry.fname[0]) end = dir.dptr;
+	if (dir.obj.sclust || fs.fs_type == FS_FAT32) dirClusters = end / (fs.csize * 512) + 1;
+
+	for (int withIndex = 0; withIndex < 2; withIndex++) {
+		f_opendir(&dir, path);
+		dirIndex.invalidate();
+		reads = 0;
+		fs.winsect = (DWORD)-1;   // as after the last file read
+		for (uint16_t first = 0; ; first += PAGE_FILES) {
+			files[withIndex] = getnrfilenames(&dir, withIndex);
+			if (first >= files[withIndex]) break;
+			for (uint16_t i = first; i < files[withIndex] && i < first + PAGE_FILES; i++) {
+				FILINFO entry;
+				const uint32_t before = reads;
+				if (!getfilename(&dir, withIndex, i, NULL, &entry)) {
+					fail("a file not found by its number", label);
+					break;
+				}
+				if (withIndex && i < dirIndex.indexed) {
+					if (reads - before > most) most = reads - before;
+					if (dirIndex.isDir(i) != !!(entry.fattrib & AM_DIR)) fail("a folder indexed as a file, or the other way", label);
+				}
+				listed[withIndex].push_back(entry);
+			}
+		}
+		list[withIndex] = reads;
+
+		reads = 0;
+		for (size_t i = 0; i < listed[0].size(); i++) {
+			FILINFO entry;
+			if (!getfilename(&dir, withIndex, 0, listed[0][i].fname, &entry) || strcmp(entry.fname, listed[0][i].fname))
+				fail("a file not found by its long name", label);
+		}
+		find[withIndex] = reads;
+	}
+	if (files[0] != files[1] || listed[0].size() != listed[1].size()) {
+		fail("the file counts differ", label);
+		return;
+	}
+	for (size_t i = 0; i < listed[0].size(); i++) {
+		if (strcmp(listed[0][i].fname, listed[1][i].fname) || strcmp(listed[0][i].altname, listed[1][i].altname)
+		 || listed[0][i].fattrib != listed[1][i].fattrib) {
+			fail("a file listed differently", label);
+			break;
+		}
+	}
+	for (size_t i = 0; i < listed[1].size(); i++) {
+		if (listed[1][i].altname[0] && (dirIndex.find(&dir, listed[1][i].altname, &entry) != (int16_t)i || strcmp(entry.fname, listed[1][i].fname)))
+			fail("a file not found by its short name", label);
+	}
+	const uint16_t shouldIndex = std::min((uint32_t)files[1], (uint32_t)SD_DIR_INDEX_SIZE);
+	if (dirIndex.indexed != shouldIndex && (!dirClusters || dirClusters <= SD_DIR_INDEX_CLUSTERS))
+		fail("files not indexed", label);
+	if (most > 2) fail("an indexed file read from more than two sectors", label);
+
+	printf("%-22.22s %5u %7u %8u %6u %8u %6u %4u\n", label, (unsigned)files[1], (unsigned)dirIndex.indexed,
+			(unsigned)list[0], (unsigned)list[1], (unsigned)find[0], (unsigned)find[1], (unsigned)most);
+}
+
+/* Exported Functions --------------------------------------------------------*/
+
+int main(int argc, char **argv)
+{
+	uint32_t clusterBytes = 4096, files = 300;
+	int opt;
+	while ((opt = getopt(argc, argv, "c:n:")) != -1) {
+		switch (opt) {
+		case 'c': clusterBytes = atol(optarg); break;
+		case 'n': files = atol(optarg); break;
+		default: optind = argc + 1; break;
+		}
+	}
+	if (optind != argc || clusterBytes < 512 || (clusterBytes & (clusterBytes - 1)) || !files) {
+		fprintf(stderr, "usage: %s [-c bytes] [-n files]\n", argv[0]);
+		return 2;
+	}
+
+	image.assign((size_t)CARD_SECTORS * 512, 0xFF);
+	char path[4];
+	FATFS_LinkDriver(&RamDriver, path);
+	static FATFS fs;
+	static BYTE work[_MAX_SS];
+	if (f_mkfs(path, FM_ANY, clusterBytes, work, sizeof(work)) != FR_OK || f_mount(&fs, path, 1) != FR_OK) {
+		fprintf(stderr, "%s: can't format the card\n", argv[0]);
+		return 2;
+	}
+	if (f_mkdir("0:/jobs") != FR_OK || !fill("0:", files / 6) || !fill("0:/jobs", files)) {
+		fprintf(stderr, "%s: can't fill the card\n", argv[0]);
+		return 2;
+	}
+
+	static const char *const fatNames[] = { "", "FAT12", "FAT16", "FAT32", "exFAT" };
+	printf("%s, %u byte clusters, index of %u files in %u clusters\n", fatNames[fs.fs_type], (unsigned)fs.csize * 512,
+			(unsigned)SD_DIR_INDEX_SIZE, (unsigned)SD_DIR_INDEX_CLUSTERS);
+	printf("                                          list            find\n");
+	printf("directory              files indexed      old    new      old    new most\n");
+	run("0:/", "/", fs);
+	run("0:/jobs", "/jobs", fs);
+
+	// a file written and one removed (M28/M34 and M30), then the listing again
+	if (!write_file("0:/jobs/new upload.gcode") || f_unlink("0:/jobs/Nautilus shell 009.gcode") != FR_OK
+	 || !write_file("0:/new upload.gcode")) {
+		fprintf(stderr, "%s: can't change the card\n", argv[0]);
+		return 2;
+	}
+	run("0:/", "/ after M28, M30", fs);
+	run("0:/jobs", "/jobs after M28, M30", fs);
+
+	if (failed) return 1;
+	printf("PASS\n");
+	return 0;
+}
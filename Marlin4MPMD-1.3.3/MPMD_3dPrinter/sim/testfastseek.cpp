@@ -0,0 +1,300 @@
+/**
+  ******************************************************************************
+  * @file    sim/testfastseek.cpp
+  * @brief   Sector reads of a print file with and without the cluster map
+  *          CardReader::openFile() gives it (FatFs fast seek, linkMap),
+  *          through the real FatFs on a card image
+  * @note    build: make sim
+  *          usage: build_sim/testfastseek [-c bytes] [-n seeks] file...
+  *            -c  cluster size of the card (default 4096)
+  *            -n  seeks per file (default 200)
+  *            e.g. build_sim/testfastseek Marlin4MPMD-1.3.3/SdCardContent/gcodes/*
+  *          The card is a RAM image formatted with f_mkfs(). It is filled
+  *          with files of 32 to 512KB, every other one of them deleted, so
+  *          the print files written after them are in pieces, as on a card
+  *          in use for a while. Each file is read the way CardReader reads
+  *          it, 512 bytes at a time, and resumed at random offsets (M23,
+  *          then M26 S or M32 S: an open and an f_lseek()), with a map of
+  *          SD_LINKMAP_SIZE as openFile() makes it and without one. "open"
+  *          counts the FAT sectors read to open the file (and make the
+  *          map), "read" the FAT and the data sectors of reading it through,
+  *          "seek" the FAT sectors of a resume and the clusters its
+  *          f_lseek() follows through the FAT without the map (with it, it
+  *          looks the offset up in the fragments). Every read must give the
+  *          bytes of the file, with the map no FAT sector may be read after
+  *          the open, and a file in more fragments than the map holds must
+  *          be read without it, or it exits with 1.
+  ******************************************************************************
+  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#include "ff_gen_drv.h"
+#include "cardreader.h"
+
+/* Private Constants ---------------------------------------------------------*/
+
+// a 64MB card
+#define CARD_SECTORS   (131072)
+// share of the card the filler files take, before every other one goes
+#define FILLER_SHARE   (0.5)
+
+/* Private Types -------------------------------------------------------------*/
+
+typedef struct {
+	uint32_t fat, data;  // sectors read
+} Counts;
+
+/* Private Variables ---------------------------------------------------------*/
+
+static std::vector<uint8_t> image;
+static Counts counts;
+static DWORD fatStart, fatEnd;  // the FAT sectors, both copies
+
+static std::vector<std::string> names, contents;
+static uint32_t seed = 1;
+static uint32_t failed;
+
+/* Private Functions ---------------------------------------------------------*/
+
+static DSTATUS ram_initialize(BYTE lun) { return 0; }
+static DSTATUS ram_status(BYTE lun) { return 0; }
+
+static DRESULT ram_read(BYTE lun, BYTE *buff, DWORD sector, UINT count)
+{
+	if (sector + count > CARD_SECTORS) return RES_PARERR;
+	for (UINT i = 0; i < count; i++) {
+		if (sector + i >= fatStart && sector + i < fatEnd) counts.fat++;
+		else counts.data++;
+	}
+	memcpy(buff, &image[(size_t)sector * 512], count * 512);
+	return RES_OK;
+}
+
+static DRESULT ram_write(BYTE lun, const BYTE *buff, DWORD sector, UINT count)
+{
+	if (sector + count > CARD_SECTORS) return RES_PARERR;
+	memcpy(&image[(size_t)sector * 512], buff, count * 512);
+	return RES_OK;
+}
+
+static DRESULT ram_ioctl(BYTE lun, BYTE cmd, void *buff)
+{
+	switch (cmd) {
+	case CTRL_SYNC: return RES_OK;
+	case GET_SECTOR_COUNT: *(DWORD *)buff = CARD_SECTORS; return RES_OK;
+	case GET_SECTOR_SIZE: *(WORD *)buff = 512; return RES_OK;
+	case GET_BLOCK_SIZE: *(DWORD *)buff = 1; return RES_OK;
+	}
+	return RES_PARERR;
+}
+
+static Diskio_drvTypeDef RamDriver = { ram_initialize, ram_status, ram_read, ram_write, ram_ioctl };
+
+static uint32_t random_below(uint32_t n)
+{
+	seed = seed * 1664525u + 1013904223u;
+	return (seed >> 8) % n;
+}
+
+static bool load(const char *name)
+{
+	FILE *f = fopen(name, "rb");
+	if (!f) return false;
+	std::string content;
+	char buf[4096];
+	size_t n;
+	while ((n = fread(buf, 1, sizeof(buf), f)) > 0) content.append(buf, n);
+	fclose(f);
+	const char *base = strrchr(name, '/');
+	names.push_back(std::string("0:/") + (base ? base + 1 : name));
+	contents.push_back(content);
+	return true;
+}
+
+static void fail(const char *what)
+{
+	printf("FAIL: %s\n", what);
+	failed++;
+}
+
+static bool write_file(const char *name, const char *data, UINT size)
+{
+	static FIL file;
+	UINT put;
+	return f_open(&file, name, FA_WRITE | FA_CREATE_ALWAYS) == FR_OK
+	    && f_write(&file, data, size, &put) == FR_OK && put == size
+	    && f_close(&file) == FR_OK;
+}
+
+// Files of 32 to 512KB over part of the card, then every other one deleted
+static bool make_holes(FATFS &fs)
+{
+	const std::vector<char> filler(512 * 1024, 'x');
+	const uint64_t total = (uint64_t)fs.n_fatent * fs.csize * 512 * FILLER_SHARE;
+	uint64_t used = 0;
+	uint32_t n = 0;
+	char name[16];
+	while (used < total) {
+		const UINT size = (32 + random_below(512 - 32 + 1)) * 1024;
+		snprintf(name, sizeof(name), "0:/F%u", (unsigned)n++);
+		if (!write_file(name, &filler[0], size)) return false;
+		used += size;
+	}
+	for (uint32_t i = 0; i < n; i += 2) {
+		snprintf(name, sizeof(name), "0:/F%u", (unsigned)i);
+		if (f_unlink(name) != FR_OK) return false;
+	}
+	// a fresh mount allocates from the start of the card again, into the holes
+	return f_mount(&fs, "0:/", 1) == FR_OK;
+}
+
+// CardReader::openFile(), with the map or without it; the FAT sectors it read
+static bool open_file(FIL &file, DWORD *linkMap, size_t n, uint32_t &fatReads)
+{
+	memset(&counts, 0, sizeof(counts));
+	if (f_open(&file, names[n].c_str(), FA_OPEN_EXISTING | FA_READ) != FR_OK) return false;
+	if (linkMap) {
+		linkMap[0] = SD_LINKMAP_SIZE;
+		file.cltbl = linkMap;
+		if (f_lseek(&file, CREATE_LINKMAP) != FR_OK)
+			file.cltbl = NULL;
+	}
+	fatReads = counts.fat;
+	return true;
+}
+
+// Fragments of the file, from a map big enough for all of them
+static uint32_t fragments(size_t n)
+{
+	static FIL file;
+	std::vector<DWORD> table(2 * (contents[n].size() / 512 + 2));
+	if (f_open(&file, names[n].c_str(), FA_OPEN_EXISTING | FA_READ) != FR_OK) return 0;
+	table[0] = table.size();
+	file.cltbl = &table[0];
+	const bool ok = f_lseek(&file, CREATE_LINKMAP) == FR_OK;
+	f_close(&file);
+	return ok ? (table[0] - 2) / 2 : 0;
+}
+
+/* Exported Functions --------------------------------------------------------*/
+
+int main(int argc, char **argv)
+{
+	uint32_t clusterBytes = 4096, seeks = 200;
+	int opt;
+	while ((opt = getopt(argc, argv, "c:n:")) != -1) {
+		switch (opt) {
+		case 'c': clusterBytes = atol(optarg); break;
+		case 'n': seeks = atol(optarg); break;
+		default: optind = argc + 1; break;
+		}
+	}
+	if (optind >= argc || clusterBytes < 512 || (clusterBytes & (clusterBytes - 1)) || !seeks) {
+		fprintf(stderr, "usage: %s [-c bytes] [-n seeks] file...\n", argv[0]);
+		return 2;
+	}
+	for (int i = optind; i < argc; i++) {
+		if (!load(argv[i])) {
+			fprintf(stderr, "%s: can't read %s\n", argv[0], argv[i]);
+			return 2;
+		}
+	}
+
+	image.assign((size_t)CARD_SECTORS * 512, 0xFF);
+	char path[4];
+	FATFS_LinkDriver(&RamDriver, path);
+	static FATFS fs;
+	static BYTE work[_MAX_SS];
+	if (f_mkfs(path, FM_ANY, clusterBytes, work, sizeof(work)) != FR_OK || f_mount(&fs, path, 1) != FR_OK) {
+		fprintf(stderr, "%s: can't format the card\n", argv[0]);
+		return 2;
+	}
+	fatStart = fs.fatbase;
+	fatEnd = fs.fatbase + fs.fsize * fs.n_fats;
+	if (!make_holes(fs)) {
+		fprintf(stderr, "%s: can't fill the card\n", argv[0]);
+		return 2;
+	}
+	for (size_t n = 0; n < names.size(); n++) {
+		if (!write_file(names[n].c_str(), contents[n].data(), contents[n].size())) {
+			fprintf(stderr, "%s: can't write %s to the card\n", argv[0], names[n].c_str());
+			return 2;
+		}
+	}
+
+	static const char *const fatNames[] = { "", "FAT12", "FAT16", "FAT32", "exFAT" };
+	printf("%u files, %s, %u byte clusters, map of %u DWORDs (%u fragments), %u seeks per file\n", (unsigned)names.size(),
+			fatNames[fs.fs_type], (unsigned)fs.csize * 512, (unsigned)SD_LINKMAP_SIZE, (unsigned)(SD_LINKMAP_SIZE - 2) / 2, (unsigned)seeks);
+	printf("                                   open      read FAT    read data   seek FAT  clusters\n");
+	printf("file              size pieces    old new    old    new      old/new    old  new   followed\n");
+	uint32_t mismatches = 0;
+	for (size_t n = 0; n < names.size(); n++) {
+		const std::string &content = contents[n];
+		const uint32_t pieces = fragments(n);
+		uint32_t open[2], readFat[2], readData[2], seekFat[2];
+		uint64_t followed = 0;
+		bool mapped = false;
+		for (int withMap = 0; withMap < 2; withMap++) {
+			static FIL file;
+			static DWORD linkMap[SD_LINKMAP_SIZE];
+			static BYTE buf[512];
+			UINT got;
+
+			// printed through
+			if (!open_file(file, withMap ? linkMap : NULL, n, open[withMap])) {
+				fail("open");
+				break;
+			}
+			if (withMap) mapped = file.cltbl != NULL;
+			memset(&counts, 0, sizeof(counts));
+			std::string back;
+			while (f_read(&file, buf, sizeof(buf), &got) == FR_OK && got) back.append((char *)buf, got);
+			readFat[withMap] = counts.fat;
+			readData[withMap] = counts.data;
+			f_close(&file);
+			if (back != content) mismatches++;
+
+			// resumed, from the same offsets either way
+			seed = n + 1;
+			seekFat[withMap] = 0;
+			for (uint32_t i = 0; i < seeks; i++) {
+				const FSIZE_t ofs = random_below(content.size());
+				uint32_t fat;
+				if (!open_file(file, withMap ? linkMap : NULL, n, fat)) {
+					fail("open");
+					break;
+				}
+				memset(&counts, 0, sizeof(counts));
+				const FRESULT res = f_lseek(&file, ofs);
+				seekFat[withMap] += counts.fat;
+				if (!withMap) followed += ofs / (fs.csize * 512);
+				if (res != FR_OK || f_read(&file, buf, sizeof(buf), &got) != FR_OK
+				 || got != min((FSIZE_t)sizeof(buf), content.size() - ofs) || memcmp(buf, content.data() + ofs, got))
+					mismatches++;
+				f_close(&file);
+			}
+		}
+		const char *base = names[n].c_str() + 3;
+		printf("%-14.14s %7u %6u %6u %3u %6u %6u %6u/%-6u %6.1f %4.1f %8.1f%s\n", base, (unsigned)content.size(), (unsigned)pieces,
+				(unsigned)open[0], (unsigned)open[1], (unsigned)readFat[0], (unsigned)readFat[1], (unsigned)readData[0], (unsigned)readData[1],
+				(double)seekFat[0] / seeks, (double)seekFat[1] / seeks, (double)followed / seeks, mapped ? "" : "  (no map)");
+		if (mapped != (pieces <= (SD_LINKMAP_SIZE - 2) / 2))
+			fail("the map, against the fragments of the file");
+		if (mapped && (readFat[1] || seekFat[1]))
+			fail("a FAT sector read with the map");
+	}
+
+	if (mismatches) {
+		printf("FAIL: %u reads differ\n", (unsigned)mismatches);
+		failed++;
+	}
+	if (failed) return 1;
+	printf("PASS\n");
+	return 0;
+}
@@ -0,0 +1,366 @@
+/**
+  ******************************************************************************
+  * @file    sim/testflashstore.cpp
+  * @brief   The settings kept in flash as a log of keyed records (M500, M501,
+  *          Marlin/flash_store.h), against the one page erased and written
+  *          in place on every M500 before
+  * @note    build: make sim
+  *          usage: build_sim/testflashstore [-n stores] [-c cuts] [-k changes]
+  *            -n  M500s, a few settings changed before each (default 4000)
+  *            -c  M500s the power goes in (default 4000)
+  *            -k  settings changed before an M500, at most (default 3)
+  *          Settings are first written to the EEPROM page as the old
+  *          firmware wrote them, and must be read from there, and then from
+  *          the store after the next M500. Then for -n M500s, each after
+  *          1 to -k settings are changed: the settings must read back as
+  *          stored (Config_RetrieveSettings() with every setting scrambled
+  *          before), and an M500 with nothing changed must write nothing.
+  *          The erases of each page are counted against the one erase an
+  *          M500 was. Then -c M500s with the power going at a random one
+  *          of the half-words programmed and pages erased by each, one in
+  *          4 at the last of them, leaving it part programmed or erased;
+  *          one in 8 changes the whole bed level grid as G29 does, so the
+  *          page fills often. After it the settings read must be all the
+  *          ones before the M500 or all the ones after, or with one page,
+  *          if it went in the erase and rewrite of a full page, none (the
+  *          loss counted), and an M500 after it must store. A half-word may not be programmed twice between
+  *          erases. It exits with 1 on a failure.
+  ******************************************************************************
+  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <math.h>
+#include <vector>
+
+#include "sim.h"
+#include "planner.h"
+#include "temperature.h"
+#include "configuration_store.h"
+
+/* Private Variables ---------------------------------------------------------*/
+
+static std::vector<float *> floats;   // the float settings
+static std::vector<float> defaults;   // of each, after Config_ResetDefault()
+static uint32_t failed;
+static uint32_t seed = 1;
+
+/* Private Functions ---------------------------------------------------------*/
+
+static uint32_t random_below(uint32_t n)
+{
+	seed = seed * 1103515245 + 12345;
+	return (seed >> 8) % n;
+}
+
+static float random_unit(void)
+{
+	return random_below(1000001) / 1000000.0f;
+}
+
+static void fail(const char *what)
+{
+	printf("FAIL: %s\n", what);
+	failed++;
+}
+
+static void add(float *value, int count)
+{
+	for (int i = 0; i < count; i++) floats.push_back(value + i);
+}
+
+// Every setting M500 stores, Ki and Kd unscaled as they are stored
+static std::vector<double> settings(void)
+{
+	std::vector<double> s;
+	for (size_t i = 0; i < floats.size(); i++) s.push_back(*floats[i]);
+	for (int i = 0; i < NUM_AXIS; i++) s.push_back(planner.max_acceleration_mm_per_s2[i]);
+	s.push_back(planner.min_segment_time);
+	s.push_back(volumetric_enabled);
+	s.push_back(unscalePID_i(PID_PARAM(Ki, 0)));
+	s.push_back(unscalePID_d(PID_PARAM(Kd, 0)));
+	return s;
+}
+
+// Ki and Kd may come back a rounding off, scaled as they are
+static bool same(const std::vector<double> &a, const std::vector<double> &b)
+{
+	for (size_t i = 0; i < a.size(); i++) {
+		if (i < a.size() - 2 ? a[i] != b[i] : fabs(a[i] - b[i]) > fabs(a[i]) * 1e-6) return false;
+	}
+	return true;
+}
+
+// One setting to a new value, near its default
+static void change(uint32_t n)
+{
+	const uint32_t others = NUM_AXIS + 4;
+	if (n < floats.size()) {
+		const float base = defaults[n];
+		*floats[n] = base * (0.9f + 0.2f * random_unit()) + random_unit() - 0.5f;
+		if (floats[n] == &planner.junction_deviation_mm) planner.junction_deviation_mm = fabs(planner.junction_deviation_mm);
+		return;
+	}
+	n = (n - floats.size()) % others;
+	if (n < NUM_AXIS) planner.max_acceleration_mm_per_s2[n] = 1000 + random_below(9000);
+	else if (n == NUM_AXIS) planner.min_segment_time = random_below(50000);
+	else if (n == NUM_AXIS + 1) volumetric_enabled = !volumetric_enabled;
+	else if (n == NUM_AXIS + 2) PID_PARAM(Ki, 0) = scalePID_i(random_unit() * 2);
+	else PID_PARAM(Kd, 0) = scalePID_d(random_unit() * 100);
+}
+
+static void change_some(uint32_t most)
+{
+	for (uint32_t k = 1 + random_below(most); k; k--) change(random_below(floats.size() + NUM_AXIS + 4));
+}
+
+// G29: the whole grid
+static void change_grid(void)
+{
+	for (int i = 0; i < AUTO_BED_LEVELING_GRID_POINTS; i++)
+		for (int j = 0; j < AUTO_BED_LEVELING_GRID_POINTS; j++)
+			bed_level[i][j] = random_unit() - 0.5f;
+}
+
+// M501 on power up: every setting scrambled, then read from the flash
+static std::vector<double> retrieve(void)
+{
+	for (size_t i = 0; i < floats.size(); i++) *floats[i] = -12345.0f;
+	for (int i = 0; i < NUM_AXIS; i++) planner.max_acceleration_mm_per_s2[i] = 1;
+	planner.min_segment_time = 1;
+	volumetric_enabled = !volumetric_enabled;
+	PID_PARAM(Ki, 0) = PID_PARAM(Kd, 0) = 0;
+	Config_RetrieveSettings();
+	return settings();
+}
+
+// The firmware's replies (its errors) left out, or not
+static void quiet(bool on)
+{
+	static int out = -1;
+	fflush(stderr);
+	if (on) {
+		out = dup(STDERR_FILENO);
+		const int null = open("/dev/null", O_WRONLY);
+		dup2(null, STDERR_FILENO);
+		close(null);
+	} else if (out >= 0) {
+		dup2(out, STDERR_FILENO);
+		close(out);
+		out = -1;
+	}
+}
+
+static uint32_t erases(void)
+{
+	uint32_t n = 0;
+	for (int p = 0; p < SETTINGS_FLASH_PAGES; p++) n += sim.flashErases[p];
+	return n;
+}
+
+// The settings as the firmware before the store wrote them
+static void store_legacy(void)
+{
+	ConfigSettings c;
+	memset(&c, 0xFF, sizeof(c));
+	c.API_MAJOR_VERSION = CONFIG_API_MAJOR_VERSION;
+	c.API_MINOR_VERSION = CONFIG_API_MINOR_VERSION;
+	c.MAJOR_FW_VERSION = MARLIN_MAJOR_FW_VERSION;
+	c.MINOR_FW_VERSION = MARLIN_MINOR_FW_VERSION;
+	c.MAJOR_FW_SUBVERSION = MARLIN_MAJOR_FW_SUBVERSION;
+	c.MINOR_FW_SUBVERSION = MARLIN_MINOR_FW_SUBVERSION;
+	for (int i = 0; i < NUM_AXIS; i++) {
+		c.axis_steps_per_mm[i] = planner.axis_steps_per_mm[i];
+		c.max_feedrate_mm_s[i] = planner.max_feedrate_mm_s[i];
+		c.max_acceleration_mm_per_s2[i] = planner.max_acceleration_mm_per_s2[i];
+	}
+	c.acceleration = planner.acceleration;
+	c.retract_acceleration = planner.retract_acceleration;
+	c.travel_acceleration = planner.travel_acceleration;
+	c.min_feedrate_mm_s = planner.min_feedrate_mm_s;
+	c.min_travel_feedrate_mm_s = planner.min_travel_feedrate_mm_s;
+	c.min_segment_time = planner.min_segment_time;
+	c.max_xy_jerk = planner.max_xy_jerk;
+	c.max_z_jerk = planner.max_z_jerk;
+	c.max_e_jerk = planner.max_e_jerk;
+	memcpy(c.home_offset, home_offset, sizeof(c.home_offset));
+	c.zprobe_zoffset = zprobe_zoffset;
+	memcpy(c.endstop_adj, endstop_adj, sizeof(c.endstop_adj));
+	c.delta_height = delta_height;
+	c.delta_diagonal_rod = delta_diagonal_rod;
+	c.delta_radius = delta_radius;
+	c.delta_segments_per_second = delta_segments_per_second;
+	c.delta_diagonal_rod_trim[0] = delta_diagonal_rod_trim_tower_1;
+	c.delta_diagonal_rod_trim[1] = delta_diagonal_rod_trim_tower_2;
+	c.delta_diagonal_rod_trim[2] = delta_diagonal_rod_trim_tower_3;
+	c.delta_radius_trim[0] = delta_radius_trim_tower_1;
+	c.delta_radius_trim[1] = delta_radius_trim_tower_2;
+	c.delta_radius_trim[2] = delta_radius_trim_tower_3;
+	memcpy(c.delta_angle_trim, delta_tower_angle_trim, sizeof(c.delta_angle_trim));
+	c.kP = PID_PARAM(Kp, 0);
+	c.kI = unscalePID_i(PID_PARAM(Ki, 0));
+	c.kD = unscalePID_d(PID_PARAM(Kd, 0));
+	c.volumetric_enabled = volumetric_enabled;
+	c.filament_size[0] = filament_size[0];
+	memcpy(c.delta_grid_spacing, delta_grid_spacing, sizeof(c.delta_grid_spacing));
+	for (int i = 0; i < AUTO_BED_LEVELING_GRID_POINTS; i++)
+		memcpy(c.bed_level[i], bed_level[i], sizeof(bed_level[i]));
+	c.junction_deviation_mm = planner.junction_deviation_mm;
+	memcpy((void *)EEPROM_ADDRESS, &c, sizeof(c));
+}
+
+/* Exported Functions --------------------------------------------------------*/
+
+int main(int argc, char **argv)
+{
+	uint32_t stores = 4000, cuts = 4000, most = 3;
+	int opt;
+	while ((opt = getopt(argc, argv, "n:c:k:")) != -1) {
+		switch (opt) {
+		case 'n': stores = atol(optarg); break;
+		case 'c': cuts = atol(optarg); break;
+		case 'k': most = atol(optarg); break;
+		default: optind = argc + 1; break;
+		}
+	}
+	if (optind != argc || !most) {
+		fprintf(stderr, "usage: %s [-n stores] [-c cuts] [-k changes]\n", argv[0]);
+		return 2;
+	}
+
+	// as marlin_sim, the SD autostart holds setup() for 5s
+	sim_init();
+	sim_advance((sim_time_t)5000 * SIM_MS_TICKS);
+	setup();
+
+	add(planner.axis_steps_per_mm, NUM_AXIS);
+	add(planner.max_feedrate_mm_s, NUM_AXIS);
+	add(&planner.acceleration, 1);
+	add(&planner.retract_acceleration, 1);
+	add(&planner.travel_acceleration, 1);
+	add(&planner.min_feedrate_mm_s, 1);
+	add(&planner.min_travel_feedrate_mm_s, 1);
+	add(&planner.max_xy_jerk, 1);
+	add(&planner.max_z_jerk, 1);
+	add(&planner.max_e_jerk, 1);
+	add(&planner.junction_deviation_mm, 1);
+	add(home_offset, 3);
+	add(&zprobe_zoffset, 1);
+	add(endstop_adj, 3);
+	add(&delta_height, 1);
+	add(&delta_diagonal_rod, 1);
+	add(&delta_radius, 1);
+	add(&delta_segments_per_second, 1);
+	add(&delta_diagonal_rod_trim_tower_1, 1);
+	add(&delta_diagonal_rod_trim_tower_2, 1);
+	add(&delta_diagonal_rod_trim_tower_3, 1);
+	add(&delta_radius_trim_tower_1, 1);
+	add(&delta_radius_trim_tower_2, 1);
+	add(&delta_radius_trim_tower_3, 1);
+	add(delta_tower_angle_trim, 3);
+	add(&PID_PARAM(Kp, 0), 1);
+	add(filament_size, EXTRUDERS);
+	add(delta_grid_spacing, 2);
+	add(&bed_level[0][0], AUTO_BED_LEVELING_GRID_POINTS * AUTO_BED_LEVELING_GRID_POINTS);
+	for (size_t i = 0; i < floats.size(); i++) defaults.push_back(*floats[i]);
+
+	// Settings of the firmware before, read from the EEPROM page and moved to the store
+	change_some(floats.size());
+	change_grid();
+	std::vector<double> stored = settings();
+	store_legacy();
+	if (!same(retrieve(), stored)) fail("the settings of the EEPROM page didn't read back");
+	Config_StoreSettings();
+	if (SETTINGS_FLASH_PAGES > 1) memset((void *)EEPROM_ADDRESS, 0xFF, 4);  // it mustn't be read any more
+	if (!same(retrieve(), stored)) fail("the settings moved to the store didn't read back");
+
+	// M500s of a few changes
+	const uint32_t erasesBefore = erases();
+	uint32_t pageBefore[SETTINGS_FLASH_PAGES];
+	memcpy(pageBefore, sim.flashErases, sizeof(pageBefore));
+	uint32_t written = 0, rewritten = 0;
+	for (uint32_t n = 0; n < stores && !failed; n++) {
+		change_some(most);
+		stored = settings();
+		uint32_t before = sim.flashWrites;
+		Config_StoreSettings();
+		written += sim.flashWrites - before;
+		before = sim.flashWrites;
+		const uint32_t e = erases();
+		Config_StoreSettings();
+		if (sim.flashWrites != before || erases() != e) rewritten++;
+		if (!same(retrieve(), stored)) fail("an M500 didn't read back");
+	}
+	if (rewritten) fail("an M500 with nothing changed wrote to the flash");
+	uint32_t most_erased = 0;
+	for (int p = 0; p < SETTINGS_FLASH_PAGES; p++)
+		if (sim.flashErases[p] - pageBefore[p] > most_erased) most_erased = sim.flashErases[p] - pageBefore[p];
+	printf("%u M500s of 1 to %u changes: %u half-words written, %u erases, of a page %u at most (one page %u before)\n",
+			(unsigned)stores, (unsigned)most, (unsigned)written, (unsigned)(erases() - erasesBefore),
+			(unsigned)most_erased, (unsigned)stores);
+	if (stores >= 100 && most_erased * 20 > stores) fail("a page was erased more than once in 20 M500s");
+
+	if (sim.serialErrors) fail("the firmware reported errors");
+
+	// M500s the power goes in, at any of their flash operations
+	static uint16_t pages[SETTINGS_FLASH_PAGES * FLASH_PAGE_SIZE / 2];
+	uint32_t cut = 0, asBefore = 0, asAfter = 0, compacts = 0, lost = 0;
+	for (uint32_t n = 0; n < cuts && !failed; n++) {
+		stored = settings();
+		if (random_below(8)) change_some(most);
+		else change_grid();
+		const std::vector<double> next = settings();
+
+		// the operations it takes, then the flash as it was
+		memcpy(pages, (void *)SETTINGS_FLASH_ADDRESS, sizeof(pages));
+		const SimState counts = sim;
+		const uint32_t e = erases();
+		sim_flash_cut = 0x40000000;
+		Config_StoreSettings();
+		const uint32_t ops = 0x40000000 - sim_flash_cut;
+		const bool compacting = erases() != e;
+		memcpy((void *)SETTINGS_FLASH_ADDRESS, pages, sizeof(pages));
+		memcpy(sim.flashErases, counts.flashErases, sizeof(sim.flashErases));
+		sim.flashWrites = counts.flashWrites;
+		if (!ops) {
+			sim_flash_cut = -1;
+			continue;
+		}
+
+		// one in 4 the last: the commit, or the erase of the page a compact left
+		sim_flash_cut = random_below(4) ? random_below(ops) : ops - 1;
+		quiet(true);  // it reports an error
+		Config_StoreSettings();
+		quiet(false);
+		sim_flash_cut = -1;
+		sim.serialErrors = counts.serialErrors;
+		cut++;
+		compacts += compacting;
+		const std::vector<double> got = retrieve();
+		if (same(got, stored)) asBefore++;
+		else if (same(got, next)) asAfter++;
+		else if (compacting && SETTINGS_FLASH_PAGES == 1) {
+			// the page erased in place, and the settings with it, as before the store
+			lost++;
+			Config_ResetDefault();
+		}
+		else fail("the power going in an M500 left settings neither before nor after it");
+
+		// and it stores after
+		change_some(most);
+		stored = settings();
+		Config_StoreSettings();
+		if (sim.serialErrors != counts.serialErrors || !same(retrieve(), stored))
+			fail("an M500 after the power went didn't read back");
+	}
+	printf("%u M500s the power went in, %u of them in a compact: %u as before, %u as after, %u lost\n",
+			(unsigned)cut, (unsigned)compacts, (unsigned)asBefore, (unsigned)asAfter, (unsigned)lost);
+	if (sim.flashErrors) fail("a half-word was programmed that wasn't erased");
+
+	if (failed) return 1;
+	printf("PASS\n");
+	return 0;
+}
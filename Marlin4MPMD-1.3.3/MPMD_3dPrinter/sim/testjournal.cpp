@@ -0,0 +1,385 @@
+/**
+  ******************************************************************************
+  * @file    sim/testjournal.cpp
+  * @brief   The power-loss journal of the SD print (POWER_LOSS_JOURNAL,
+  *          print_journal.h) and M1000, on the simulator with the real FatFs
+  *          on a card image
+  * @note    build: make sim
+  *          usage: build_sim/testjournal [-w us] [-z mm] file
+  *            e.g. build_sim/testjournal Marlin4MPMD-1.3.3/SdCardContent/gcodes/benchy.gcode
+  *            -w  time the card takes to write a sector (default 1000us)
+  *            -z  the power is lost at the first record this high, up to
+  *                1mm above (default 10mm)
+  *          The file is copied to a RAM card image, which the firmware
+  *          mounts as it would the SD card, and printed, M23 and M24. Each
+  *          write to the card while it prints must be to a sector of the
+  *          journal, and the card outside the journal the same at the end as
+  *          after the M23 that made it; each record must be of the start of
+  *          a line of the file, and hold the position, E and feedrate the
+  *          lines before it leave (a G-code reading of the file), and the
+  *          last one must say the print ended. The journal as it was at the
+  *          first record at -z is then put back on the card, as if the
+  *          power had gone there, and M1000 must take the print up from that
+  *          line and end it where the whole print ended, extruding what the
+  *          file has from there. "ran dry" counts the records the planner
+  *          ran out of moves while writing.
+  ******************************************************************************
+  */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "sim.h"
+#include "planner.h"
+#include "cardreader.h"
+#include "ff_gen_drv.h"
+
+/* Private Constants ---------------------------------------------------------*/
+
+// a 64MB card
+#define CARD_SECTORS   (131072)
+// the card's write time is taken in steps this long, so the planner is seen to run dry
+#define WRITE_STEP     (SIM_TICK_FREQ / 100000)
+// how far a record may be from the reading of the file (mm)
+#define TOLERANCE      (0.001f)
+
+/* Private Types -------------------------------------------------------------*/
+
+// The state a line of the file is executed in
+typedef struct {
+	float position[NUM_AXIS];   // NAN where homing left it unknown
+	float feedrate;
+	bool relative, relativeE;
+} LineState;
+
+/* Private Variables ---------------------------------------------------------*/
+
+static std::vector<uint8_t> image;
+static sim_time_t writeTicks;
+static DWORD journalSector;         // its first, 0 until it is made
+static bool printing;               // writes are checked
+static float lossZ = 10;
+static uint32_t records, foreignWrites, headerWrites, dryWrites;
+static std::vector<PrintJournalRecord> written;
+static std::vector<uint8_t> lossJournal;   // the journal as the power went
+static PrintJournalRecord lossRecord;
+static uint32_t failed;
+
+/* Private Functions ---------------------------------------------------------*/
+
+uint8_t BSP_SD_IsDetected(void) { return SD_PRESENT; }
+
+static DSTATUS ram_initialize(BYTE lun) { return 0; }
+static DSTATUS ram_status(BYTE lun) { return 0; }
+
+static DRESULT ram_read(BYTE lun, BYTE *buff, DWORD sector, UINT count)
+{
+	if (sector + count > CARD_SECTORS) return RES_PARERR;
+	memcpy(buff, &image[(size_t)sector * 512], count * 512);
+	return RES_OK;
+}
+
+static DRESULT ram_write(BYTE lun, const BYTE *buff, DWORD sector, UINT count)
+{
+	if (sector + count > CARD_SECTORS) return RES_PARERR;
+	memcpy(&image[(size_t)sector * 512], buff, count * 512);
+	if (!printing) return RES_OK;
+
+	if (!journalSector || sector < journalSector || sector + count > journalSector + PRINT_JOURNAL_SECTORS) {
+		foreignWrites += count;
+		return RES_OK;
+	}
+	const DWORD n = sector - journalSector;
+	if (!n) {
+		headerWrites++;
+		return RES_OK;
+	}
+	// the write takes its time, the interrupts running on meanwhile
+	const bool moving = planner.blocks_queued();
+	bool ranDry = false;
+	for (sim_time_t t = writeTicks, step; t; t -= step) {
+		step = t < WRITE_STEP ? t : WRITE_STEP;
+		sim_advance(step);
+		ranDry |= moving && !planner.blocks_queued();
+	}
+	dryWrites += ranDry;
+
+	PrintJournalRecord r;
+	memcpy(&r, buff, sizeof(r));
+	written.push_back(r);
+	records++;
+	if (lossJournal.empty() && !(r.flags & PRINT_JOURNAL_DONE) && r.position[Z_AXIS] >= lossZ && r.position[Z_AXIS] < lossZ + 1) {
+		lossJournal.assign(&image[(size_t)journalSector * 512], &image[(size_t)(journalSector + PRINT_JOURNAL_SECTORS) * 512]);
+		lossRecord = r;
+	}
+	return RES_OK;
+}
+
+static DRESULT ram_ioctl(BYTE lun, BYTE cmd, void *buff)
+{
+	switch (cmd) {
+	case CTRL_SYNC: return RES_OK;
+	case GET_SECTOR_COUNT: *(DWORD *)buff = CARD_SECTORS; return RES_OK;
+	case GET_SECTOR_SIZE: *(WORD *)buff = 512; return RES_OK;
+	case GET_BLOCK_SIZE: *(DWORD *)buff = 1; return RES_OK;
+	}
+	return RES_PARERR;
+}
+
+static Diskio_drvTypeDef RamDriver = { ram_initialize, ram_status, ram_read, ram_write, ram_ioctl };
+
+static void fail(const char *what)
+{
+	printf("FAIL: %s\n", what);
+	failed++;
+}
+
+static bool load(const char *path, std::string &data)
+{
+	FILE *f = fopen(path, "rb");
+	if (!f) return false;
+	char buf[65536];
+	size_t n;
+	data.clear();
+	while ((n = fread(buf, 1, sizeof(buf), f)) > 0) data.append(buf, n);
+	fclose(f);
+	return true;
+}
+
+static bool copy_to_card(const char *name, const std::string &data)
+{
+	static FIL file;
+	UINT put;
+	return f_open(&file, name, FA_WRITE | FA_CREATE_ALWAYS) == FR_OK
+	    && f_write(&file, data.data(), data.size(), &put) == FR_OK && put == data.size() && f_close(&file) == FR_OK;
+}
+
+// Where the journal is on the card, 0 if it isn't there in one piece
+static DWORD journal_sector()
+{
+	static FIL file;
+	if (f_open(&file, "0:/" PRINT_JOURNAL_FILE, FA_READ) != FR_OK) return 0;
+	const FATFS *fs = file.obj.fs;
+	const DWORD sector = fs->database + (file.obj.sclust - 2) * fs->csize;
+	DWORD linkMap[4] = { 4 };
+	file.cltbl = linkMap;
+	const bool whole = f_size(&file) == PRINT_JOURNAL_SECTORS * 512 && f_lseek(&file, CREATE_LINKMAP) == FR_OK;
+	f_close(&file);
+	return whole ? sector : 0;
+}
+
+// Each line sent and acknowledged
+static void run_until_ok(const char *gcode)
+{
+	uint32_t ok = sim_ok_count();
+	for (const char *c = gcode; *c; c++) ok += *c == '\n';
+	sim_set_input(gcode, strlen(gcode));
+	while (!sim_input_done() || sim_ok_count() < ok) loop();
+}
+
+static float param(const char *line, char letter, bool &seen)
+{
+	for (const char *p = line; *p && *p != ';'; p++)
+		if (*p == letter) {
+			seen = true;
+			return strtof(p + 1, NULL);
+		}
+	seen = false;
+	return 0;
+}
+
+// The state each line starts in, by its offset, reading the moves as Marlin does
+static void read_gcode(const std::string &data, std::map<uint32_t, LineState> &lines)
+{
+	LineState s;
+	for (int i = 0; i < NUM_AXIS; i++) s.position[i] = 0;
+	s.feedrate = 1500;
+	s.relative = s.relativeE = false;
+	const char axes[NUM_AXIS] = { 'X', 'Y', 'Z', 'E' };
+	for (size_t pos = 0; pos < data.size();) {
+		size_t end = data.find('\n', pos);
+		if (end == std::string::npos) end = data.size();
+		const std::string line = data.substr(pos, end - pos);
+		lines[pos] = s;
+		const char *l = line.c_str();
+		while (*l == ' ') l++;
+		bool seen;
+		if (!strncmp(l, "G0", 2) || !strncmp(l, "G1", 2)) {
+			if (isdigit(l[2])) { pos = end + 1; continue; }
+			for (int i = 0; i < NUM_AXIS; i++) {
+				const float v = param(l + 2, axes[i], seen);
+				if (seen) s.position[i] = (i == E_AXIS ? s.relativeE || s.relative : s.relative) ? s.position[i] + v : v;
+			}
+			const float f = param(l + 2, 'F', seen);
+			if (seen && f > 0) s.feedrate = f;
+		}
+		else if (!strncmp(l, "G28", 3) || !strncmp(l, "G29", 3))
+			for (int i = 0; i < E_AXIS; i++) s.position[i] = NAN;
+		else if (!strncmp(l, "G90", 3)) s.relative = false;
+		else if (!strncmp(l, "G91", 3)) s.relative = true;
+		else if (!strncmp(l, "M82", 3)) s.relativeE = false;
+		else if (!strncmp(l, "M83", 3)) s.relativeE = true;
+		else if (!strncmp(l, "G92", 3))
+			for (int i = 0; i < NUM_AXIS; i++) {
+				const float v = param(l + 3, axes[i], seen);
+				if (seen) s.position[i] = v;
+			}
+		pos = end + 1;
+	}
+}
+
+// A record as the reading of the file has it
+static bool check_record(const PrintJournalRecord &r, const std::map<uint32_t, LineState> &lines)
+{
+	const std::map<uint32_t, LineState>::const_iterator line = lines.find(r.sdpos);
+	if (line == lines.end()) return false;
+	const LineState &s = line->second;
+	for (int i = 0; i < NUM_AXIS; i++)
+		if (!isnan(s.position[i]) && fabsf(s.position[i] - r.position[i]) > TOLERANCE) return false;
+	return fabsf(s.feedrate - r.feedrate_mm_m) <= TOLERANCE
+	    && !!(r.flags & PRINT_JOURNAL_RELATIVE) == s.relative && !!(r.flags & PRINT_JOURNAL_RELATIVE_E) == s.relativeE;
+}
+
+// The print on to its end
+static void finish_print()
+{
+	while (card.sdprinting) loop();
+	run_until_ok("M400\n");
+	sim_nozzle();
+}
+
+/* Exported Functions --------------------------------------------------------*/
+
+int main(int argc, char **argv)
+{
+	uint32_t writeUs = 1000;
+	int opt;
+	while ((opt = getopt(argc, argv, "w:z:")) != -1) {
+		switch (opt) {
+		case 'w': writeUs = atol(optarg); break;
+		case 'z': lossZ = atof(optarg); break;
+		default: optind = argc + 1; break;
+		}
+	}
+	if (optind != argc - 1) {
+		fprintf(stderr, "usage: %s [-w us] [-z mm] file\n", argv[0]);
+		return 2;
+	}
+
+	image.assign((size_t)CARD_SECTORS * 512, 0xFF);
+	char path[4];
+	FATFS_LinkDriver(&RamDriver, path);
+	static FATFS fs;
+	static BYTE work[_MAX_SS];
+	if (f_mkfs(path, FM_ANY, 4096, work, sizeof(work)) != FR_OK || f_mount(&fs, path, 1) != FR_OK) {
+		fprintf(stderr, "%s: can't format the card\n", argv[0]);
+		return 2;
+	}
+	std::string data;
+	const char *name = strrchr(argv[optind], '/') ? strrchr(argv[optind], '/') + 1 : argv[optind];
+	if (!load(argv[optind], data) || !copy_to_card(("0:/" + std::string(name)).c_str(), data)) {
+		fprintf(stderr, "%s: can't copy %s to the card\n", argv[0], argv[optind]);
+		return 2;
+	}
+	std::map<uint32_t, LineState> lines;
+	read_gcode(data, lines);
+
+	// as marlin_sim, the SD autostart holds setup() for 5s, and mounts the card
+	sim_init();
+	sim_advance((sim_time_t)5000 * SIM_MS_TICKS);
+	setup();
+	if (!card.cardOK) {
+		fprintf(stderr, "%s: the firmware didn't mount the card\n", argv[0]);
+		return 2;
+	}
+	writeTicks = (sim_time_t)writeUs * SIM_TICK_FREQ / 1000000;
+
+	// The print, with the journal M23 made
+	char gcode[64];
+	snprintf(gcode, sizeof(gcode), "M23 %s\n", name);
+	run_until_ok(gcode);
+	journalSector = journal_sector();
+	if (!journalSector || !card.journal.recording()) {
+		fail("M23 made no journal in one piece");
+		return 1;
+	}
+	const std::vector<uint8_t> before(image);
+	const sim_time_t start = sim.now;
+	printing = true;
+	run_until_ok("M24\n");
+	finish_print();
+	printing = false;
+	const float end[3] = { sim.nozzle[0], sim.nozzle[1], sim.nozzle[2] };
+	const float endE = current_position[E_AXIS];
+
+	uint32_t wrong = 0, layers = 0;
+	float z = NAN;
+	for (size_t i = 0; i + 1 < written.size(); i++) {
+		if (written[i].position[Z_AXIS] != z) layers++;
+		z = written[i].position[Z_AXIS];
+		if (!check_record(written[i], lines)) {
+			if (!wrong++) printf("record %u: line at %u, X%.3f Y%.3f Z%.3f E%.5f F%.1f\n", (unsigned)written[i].seq,
+					(unsigned)written[i].sdpos, written[i].position[X_AXIS], written[i].position[Y_AXIS],
+					written[i].position[Z_AXIS], written[i].position[E_AXIS], written[i].feedrate_mm_m);
+		}
+	}
+	size_t changed = 0;
+	for (size_t s = 0; s < CARD_SECTORS; s++)
+		if ((s < journalSector || s >= journalSector + PRINT_JOURNAL_SECTORS) && memcmp(&before[s * 512], &image[s * 512], 512)) changed++;
+
+	printf("print        %.1f s, %u records (%u layers), %u sectors written outside the journal, %u changed\n",
+			(double)(sim.now - start) / SIM_TICK_FREQ, (unsigned)records, (unsigned)layers,
+			(unsigned)(foreignWrites + headerWrites), (unsigned)changed);
+	printf("records      %u not as the file reads, ran dry writing %u\n", (unsigned)wrong, (unsigned)dryWrites);
+	if (foreignWrites || headerWrites || changed) fail("the print wrote to the card outside the journal's records");
+	if (written.size() < 2) fail("the print wrote no records");
+	else if (!(written.back().flags & PRINT_JOURNAL_DONE)) fail("the last record doesn't say the print ended");
+	if (wrong) fail("records not as the file reads");
+	PrintJournalRecord r;
+	char last[PRINT_JOURNAL_NAME];
+	if (card.lastPrint(&r, last)) fail("M1000 would resume a print that ended");
+	if (lossJournal.empty()) {
+		fail("no record as high as -z");
+		return 1;
+	}
+
+	// The power goes at the record; M1000
+	memcpy(&image[(size_t)journalSector * 512], &lossJournal[0], lossJournal.size());
+	if (!card.lastPrint(&r, last) || strcmp(last, name) || memcmp(&r, &lossRecord, sizeof(r))) {
+		fail("M1000 doesn't find the record the power went at");
+		return 1;
+	}
+	run_until_ok("M1000\n");
+	uint32_t resumedAt;
+	do {
+		resumedAt = card.sdpos;  // as M24 takes it up
+		loop();
+	} while (!card.sdprinting);
+	const int32_t resumeE = sim.position[E_AXIS];
+	finish_print();
+	const int32_t extruded = sim.position[E_AXIS] - resumeE,
+	              want = lroundf(endE * planner.axis_steps_per_mm[E_AXIS]) - lroundf(r.position[E_AXIS] * planner.axis_steps_per_mm[E_AXIS]);
+	printf("resume       at %u of %u, Z%.3f, extruded %d steps of %d, ends X%.3f Y%.3f Z%.3f\n",
+			(unsigned)resumedAt, (unsigned)data.size(), r.position[Z_AXIS], (int)extruded, (int)want,
+			sim.nozzle[0], sim.nozzle[1], sim.nozzle[2]);
+	if (resumedAt != r.sdpos) fail("M1000 didn't print on from the record's line");
+	if (abs(extruded - want) > 2 || fabsf(current_position[E_AXIS] - endE) > TOLERANCE)
+		fail("the resumed print didn't extrude what the file has from the record");
+	for (int i = 0; i < 3; i++)
+		if (fabsf(sim.nozzle[i] - end[i]) > 0.01f) {
+			fail("the resumed print ended elsewhere");
+			break;
+		}
+	if (sim.serialErrors) fail("the firmware reported errors");
+
+	if (failed) return 1;
+	printf("PASS\n");
+	return 0;
+}
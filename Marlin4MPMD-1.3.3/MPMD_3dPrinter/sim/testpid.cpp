@@ -0,0 +1,387 @@
+/**
+  ******************************************************************************
+  * @file    sim/testpid.cpp
+  * @brief   The heater PID in fixed point (PidFixed, pid_fixed.h) against
+  *          get_pid_output() and get_pid_output_bed() in float as they
+  *          were, and M303 autotune and step responses of the firmware on
+  *          the simulator's heaters
+  * @note    build: make sim
+  *          usage: build_sim/testpid
+  *          Each heater is run through a list of targets (and the part fan
+  *          on, for the hotend) on the thermal model of sim_bsp.cpp, with
+  *          the gains of Configuration.h, then with the gains M303 finds:
+  *          once with the float PID in the loop, once with the fixed, the
+  *          other one fed the same temperatures alongside. Every cycle the
+  *          two duties (soft_pwm, 0 to 127) may differ by DUTY_SLACK at most,
+  *          and the rise time (to 90% of the step), the peak past the
+  *          target (or off it, for the fan) and the settling time (the last
+  *          time it was more than SETTLE_BAND off) of each step by
+  *          RESPONSE_SLACK_C and RESPONSE_SLACK_S at most, or it exits with
+  *          1. The measured temperature has NOISE on it, the same for both.
+  *          The firmware itself (built with PID_FIXED_POINT) runs the first
+  *          step on the simulator, its soft PWM and thermistors in the loop,
+  *          then "M303 E0 S200 C8 U1" and "M303 E-1 S60 C8 U1"; its steps
+  *          must settle. The fastest of RUNS counts; the host has an FPU, on
+  *          the printer every float operation is a soft-float call.
+  ******************************************************************************
+  */
+
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#include "sim.h"
+#include "temperature.h"
+#include "pid_fixed.h"
+
+/* Private Constants ---------------------------------------------------------*/
+
+// of the duty of the fixed PID from the float, in a cycle
+#define DUTY_SLACK       (1)
+// of the step responses of the fixed PID from the float
+#define RESPONSE_SLACK_C (0.2f)
+#define RESPONSE_SLACK_S (2.0f)
+// of the target, settled (C)
+#define SETTLE_BAND      (1.0f)
+// peak of the noise on the measured temperature (C)
+#define NOISE            (0.25f)
+// the fastest of this many runs counts, each over the cycles PASSES times
+#define RUNS             (5)
+#define PASSES           (64)
+
+// as temperature.cpp
+#define K2               (1.0 - K1)
+
+/* Private Types -------------------------------------------------------------*/
+
+typedef struct {
+	int target;       // C
+	float seconds;    // it is held
+	float fan;        // part fan, 0 to 1
+} Step;
+
+typedef struct {
+	float rise, peak, settle;   // s, C, s; rise -1 for no step
+} Response;
+
+typedef struct {
+	float p, i, d;    // as M301 and M304 take them
+} Gains;
+
+/* Private Variables ---------------------------------------------------------*/
+
+static const Step hotendSteps[] = { { 200, 300, 0 }, { 230, 150, 0 }, { 230, 150, 1 }, { 180, 200, 1 }, { 0, 60, 0 } };
+static const Step bedSteps[] = { { 60, 900, 0 }, { 80, 600, 0 }, { 50, 900, 0 }, { 0, 60, 0 } };
+
+// the temperatures and targets of the cycles, for the timing
+static std::vector<float> cycleTemp, cycleTarget;
+static std::vector<bool> cycleBed;
+static volatile float sink;
+
+static uint32_t seed;
+static uint32_t failed;
+
+/* Private Functions ---------------------------------------------------------*/
+
+static double host_seconds(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static float noise(void)
+{
+	seed = seed * 1664525u + 1013904223u;
+	return NOISE * ((int32_t)(seed >> 8) - (1 << 23)) / (1 << 23);
+}
+
+// get_pid_output() and get_pid_output_bed() as they were, but for
+// PID_EXTRUSION_SCALING
+struct PidFloat {
+	float Kp, Ki, Kd, iStateMax;
+	float iState, dState, pTerm, iTerm, dTerm;
+	bool reset;
+
+	void set(const float p, const float i, const float d, const float driveMax) {
+		Kp = p;
+		Ki = i;
+		Kd = d;
+		iStateMax = driveMax / i;
+	}
+
+	float hotend(const float current, const float target) {
+		float pid_output;
+		const float pid_error = target - current;
+		dTerm = K2 * Kd * (current - dState) + K1 * dTerm;
+		dState = current;
+		if (pid_error > PID_FUNCTIONAL_RANGE) {
+			pid_output = BANG_MAX;
+			reset = true;
+		}
+		else if (pid_error < -(PID_FUNCTIONAL_RANGE) || target == 0) {
+			pid_output = 0;
+			reset = true;
+		}
+		else {
+			if (reset) {
+				iState = 0.0;
+				reset = false;
+			}
+			pTerm = Kp * pid_error;
+			iState += pid_error;
+			iState = constrain(iState, 0.0, iStateMax);
+			iTerm = Ki * iState;
+			pid_output = pTerm + iTerm - dTerm;
+			if (pid_output > PID_MAX) {
+				if (pid_error > 0) iState -= pid_error; // conditional un-integration
+				pid_output = PID_MAX;
+			}
+			else if (pid_output < 0) {
+				if (pid_error < 0) iState -= pid_error; // conditional un-integration
+				pid_output = 0;
+			}
+		}
+		return pid_output;
+	}
+
+	float bed(const float current, const float target) {
+		const float pid_error = target - current;
+		pTerm = Kp * pid_error;
+		iState += pid_error;
+		iState = constrain(iState, 0.0, iStateMax);
+		iTerm = Ki * iState;
+		dTerm = K2 * Kd * (current - dState) + K1 * dTerm;
+		dState = current;
+		float pid_output = pTerm + iTerm - dTerm;
+		if (pid_output > MAX_BED_POWER) {
+			if (pid_error > 0) iState -= pid_error; // conditional un-integration
+			pid_output = MAX_BED_POWER;
+		}
+		else if (pid_output < 0) {
+			if (pid_error < 0) iState -= pid_error; // conditional un-integration
+			pid_output = 0;
+		}
+		return pid_output;
+	}
+};
+
+// updatePID(), the gains scaled by PID_dT as the settings keep them
+static void set_gains(PidFloat &f, PidFixed &x, bool bed, const Gains &g)
+{
+	const float driveMax = bed ? PID_BED_INTEGRAL_DRIVE_MAX : PID_INTEGRAL_DRIVE_MAX;
+	f = PidFloat();
+	x = PidFixed();
+	f.set(g.p, scalePID_i(g.i), scalePID_d(g.d), driveMax);
+	x.set(g.p, scalePID_i(g.i), scalePID_d(g.d), driveMax);
+}
+
+// The temperature after a cycle at duty (soft_pwm, on for duty of 128
+// counts), on the thermal model of sim_bsp.cpp
+static float plant(bool bed, float temp, int duty, float fan)
+{
+	const int substeps = 16;
+	const float dt = PID_dT / substeps;
+	for (int i = 0; i < substeps; i++) {
+		if (bed)
+			temp += dt * (SIM_BED_POWER * duty / 128 - SIM_BED_LOSS * (temp - SIM_AMBIENT)) / SIM_BED_CAP;
+		else
+			temp += dt * (SIM_HOTEND_POWER * duty / 128 - (SIM_HOTEND_LOSS + SIM_HOTEND_FANLOSS * fan) * (temp - SIM_AMBIENT)) / SIM_HOTEND_CAP;
+	}
+	return temp;
+}
+
+// Of the temperatures of a step, one every PID_dT from its start
+static Response response(const std::vector<float> &temp, float from, float to)
+{
+	Response r = { -1, 0, 0 };
+	const float dir = to >= from ? 1 : -1;
+	for (uint32_t i = 0; i < temp.size(); i++) {
+		if (r.rise < 0 && from != to && dir * (temp[i] - from) >= 0.9f * dir * (to - from))
+			r.rise = i * PID_dT;
+		r.peak = max(r.peak, from != to ? dir * (temp[i] - to) : (float)fabs(temp[i] - to));
+		if (fabs(temp[i] - to) > SETTLE_BAND) r.settle = (i + 1) * PID_dT;
+	}
+	return r;
+}
+
+static void print_response(const char *name, const Response &r)
+{
+	if (r.rise < 0)
+		printf("  %-9s     -  %7.2f %8.1f", name, r.peak, r.settle);
+	else
+		printf("  %-9s %5.1f  %7.2f %8.1f", name, r.rise, r.peak, r.settle);
+}
+
+/**
+ * The steps with the float PID in the loop (fixed 0) or the fixed, the other
+ * one alongside; the responses of the steps, the duties compared
+ */
+static void run_steps(bool bed, bool fixed, const Gains &g, std::vector<Response> &out, uint32_t counts[3])
+{
+	const Step *steps = bed ? bedSteps : hotendSteps;
+	const int n = bed ? COUNT(bedSteps) : COUNT(hotendSteps);
+	PidFloat f;
+	PidFixed x;
+	set_gains(f, x, bed, g);
+	seed = 1;
+	float temp = SIM_AMBIENT, from = SIM_AMBIENT;
+	for (int s = 0; s < n; s++) {
+		std::vector<float> temps;
+		const float target = steps[s].target;
+		for (uint32_t c = 0; c < steps[s].seconds / PID_dT; c++) {
+			const float measured = temp + noise();
+			const float a = bed ? f.bed(measured, target) : f.hotend(measured, target);
+			const float b = q16_to_float(bed ? x.bed(float_to_q16(measured), float_to_q16(target)) : x.hotend(float_to_q16(measured), float_to_q16(target)));
+			const int duty[2] = { (int)a >> 1, (int)b >> 1 };
+			const int off = abs(duty[0] - duty[1]);
+			counts[min(off, 2)]++;
+			if (off > DUTY_SLACK && counts[2] <= 10) {
+				printf("differ       %s at %.1f of %d: %.3f against %.3f\n", bed ? "bed" : "hotend", measured, (int)target, a, b);
+				failed++;
+			}
+			if (!fixed) {
+				cycleTemp.push_back(measured);
+				cycleTarget.push_back(target);
+				cycleBed.push_back(bed);
+			}
+			temp = plant(bed, temp, duty[fixed], steps[s].fan);
+			temps.push_back(temp);
+		}
+		if (target) out.push_back(response(temps, from, target));
+		from = target;
+	}
+}
+
+static void compare(bool bed, const Gains &g, const char *source)
+{
+	printf("%-12s Kp %.2f Ki %.2f Kd %.2f (%s)\n", bed ? "bed" : "hotend", g.p, g.i, g.d, source);
+	std::vector<Response> r[2];
+	uint32_t counts[3] = { 0, 0, 0 };
+	for (int fixed = 0; fixed < 2; fixed++) run_steps(bed, fixed, g, r[fixed], counts);
+	printf("  step       rise s   peak C  settle s    float | fixed\n");
+	const Step *steps = bed ? bedSteps : hotendSteps;
+	int from = SIM_AMBIENT;
+	for (uint32_t s = 0; s < r[0].size(); s++) {
+		char name[16];
+		snprintf(name, sizeof(name), "%d%s", steps[s].target, steps[s].target == from ? "+fan" : "");
+		print_response(name, r[0][s]);
+		print_response("|", r[1][s]);
+		printf("\n");
+		if (fabs(r[0][s].rise - r[1][s].rise) > RESPONSE_SLACK_S || fabs(r[0][s].settle - r[1][s].settle) > RESPONSE_SLACK_S
+		 || fabs(r[0][s].peak - r[1][s].peak) > RESPONSE_SLACK_C) {
+			printf("differ       the response of the step to %d\n", steps[s].target);
+			failed++;
+		}
+		from = steps[s].target;
+	}
+	printf("  cycles     %u, duty the same in %u, off by one in %u, more in %u\n",
+			(unsigned)(counts[0] + counts[1] + counts[2]), (unsigned)counts[0], (unsigned)counts[1], (unsigned)counts[2]);
+}
+
+// The firmware run until gcode is done
+static void firmware(const char *gcode)
+{
+	sim_set_input(gcode, strlen(gcode));
+	for (;;) {
+		const uint32_t ok = sim_ok_count();
+		loop();
+		if (sim_input_done() && sim_ok_count() == ok) break;
+	}
+}
+
+// The firmware's heater held at target for seconds, from where it is
+static Response firmware_step(bool bed, int target, float seconds)
+{
+	char gcode[16];
+	const float from = bed ? sim.bed : sim.hotend;
+	snprintf(gcode, sizeof(gcode), "%s S%d\n", bed ? "M140" : "M104", target);
+	firmware(gcode);
+	std::vector<float> temps;
+	sim_time_t next = sim.now;
+	for (uint32_t c = 0; c < seconds / PID_dT; c++) {
+		next += (sim_time_t)(PID_dT * SIM_TICK_FREQ);
+		while (sim.now < next) loop();
+		temps.push_back(bed ? sim.bed : sim.hotend);
+	}
+	const Response r = response(temps, from, target);
+	print_response("firmware", r);
+	printf("\n");
+	if (r.settle >= seconds) {
+		printf("differ       the firmware's %s didn't settle at %d\n", bed ? "bed" : "hotend", target);
+		failed++;
+	}
+	return r;
+}
+
+static double run(bool fixed)
+{
+	PidFloat f[2];
+	PidFixed x[2];
+	const Gains g[2] = { { DEFAULT_Kp, DEFAULT_Ki, DEFAULT_Kd }, { DEFAULT_bedKp, DEFAULT_bedKi, DEFAULT_bedKd } };
+	const double start = host_seconds();
+	for (int pass = 0; pass < PASSES; pass++) {
+		for (int bed = 0; bed < 2; bed++) set_gains(f[bed], x[bed], bed, g[bed]);
+		for (uint32_t c = 0; c < cycleTemp.size(); c++) {
+			const bool bed = cycleBed[c];
+			if (fixed)
+				sink += q16_to_float(bed ? x[1].bed(float_to_q16(cycleTemp[c]), float_to_q16(cycleTarget[c]))
+				                         : x[0].hotend(float_to_q16(cycleTemp[c]), float_to_q16(cycleTarget[c])));
+			else
+				sink += bed ? f[1].bed(cycleTemp[c], cycleTarget[c]) : f[0].hotend(cycleTemp[c], cycleTarget[c]);
+		}
+	}
+	return host_seconds() - start;
+}
+
+/* Exported Functions --------------------------------------------------------*/
+
+int main(int argc, char **argv)
+{
+	if (argc != 1) {
+		fprintf(stderr, "usage: %s\n", argv[0]);
+		return 2;
+	}
+	printf("PID_dT %.4f s, K1 %.2f, noise %.2f C\n", PID_dT, K1, NOISE);
+
+	const Gains defaults[2] = { { DEFAULT_Kp, DEFAULT_Ki, DEFAULT_Kd }, { DEFAULT_bedKp, DEFAULT_bedKi, DEFAULT_bedKd } };
+	for (int bed = 0; bed < 2; bed++) compare(bed, defaults[bed], "Configuration.h");
+
+	double seconds[2];
+	for (int fixed = 0; fixed < 2; fixed++) {
+		seconds[fixed] = run(fixed);
+		for (int i = 1; i < RUNS; i++) seconds[fixed] = min(seconds[fixed], run(fixed));
+		printf("%-12s %6.2f ns per cycle\n", fixed ? "fixed" : "float", seconds[fixed] * 1e9 / cycleTemp.size() / PASSES);
+	}
+	printf("speedup      x%.2f\n", seconds[0] / seconds[1]);
+
+	// as marlin_sim, the SD autostart holds setup() for 5s
+	sim_init();
+	sim_advance((sim_time_t)5000 * SIM_MS_TICKS);
+	setup();
+	for (int bed = 0; bed < 2; bed++) {
+		const Step &first = bed ? bedSteps[0] : hotendSteps[0];
+		printf("%-12s the firmware, a step to %d then M303\n", bed ? "bed" : "hotend", first.target);
+		firmware_step(bed, first.target, first.seconds);
+		firmware(bed ? "M303 E-1 S60 C8 U1\n" : "M303 E0 S200 C8 U1\n");
+		firmware(bed ? "M140 S0\n" : "M104 S0\n");
+	}
+	const Gains tuned[2] = {
+		{ PID_PARAM(Kp, 0), unscalePID_i(PID_PARAM(Ki, 0)), unscalePID_d(PID_PARAM(Kd, 0)) },
+		{ Temperature::bedKp, unscalePID_i(Temperature::bedKi), unscalePID_d(Temperature::bedKd) }
+	};
+	for (int bed = 0; bed < 2; bed++) {
+		if (tuned[bed].p == defaults[bed].p && tuned[bed].i == defaults[bed].i) {
+			printf("differ       M303 left the %s gains as they were\n", bed ? "bed" : "hotend");
+			failed++;
+		}
+		compare(bed, tuned[bed], "M303");
+	}
+
+	if (failed) {
+		printf("FAIL: %u differences\n", (unsigned)failed);
+		return 1;
+	}
+	printf("PASS\n");
+	return 0;
+}
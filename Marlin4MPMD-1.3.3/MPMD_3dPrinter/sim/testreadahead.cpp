@@ -0,0 +1,308 @@
+/**
+  ******************************************************************************
+  * @file    sim/testreadahead.cpp
+  * @brief   The print file read into CardReader's ring of sectors from idle()
+  *          ahead of the parser (readAhead(), M933), against the parser
+  *          reading each sector as it gets to it, on the simulator with the
+  *          real FatFs on a card image
+  * @note    build: make sim
+  *          usage: build_sim/testreadahead [-r us] [-s ms] [-n reads] file...
+  *            e.g. build_sim/testreadahead Marlin4MPMD-1.3.3/SdCardContent/gcodes/benchy.gcode
+  *            -r  time the card takes to read a sector (default 600us)
+  *            -s  time a slow read takes (default 10ms), one in
+  *            -n  reads (default 64)
+  *          The files are copied to a RAM card image, which the firmware
+  *          mounts as it would the SD card. Each file is first read through
+  *          with get(), and with read_buff() and push_read_buff() as a .bgc
+  *          is, with readAhead() called at random in between, and then in
+  *          pieces from random offsets (setIndex(), as M26 does); every byte
+  *          must be the file's. Then it is printed, M23 and M24, with the
+  *          card's reads taking virtual time, the interrupts running on
+  *          meanwhile: without the read-ahead (sim_no_read_ahead) and with
+  *          it. "ahead" counts the sectors readAhead() read, "parser" the
+  *          ones the parser read itself, "ran dry" the reads the planner ran
+  *          out of moves in, and "dry (s)" for how long, and "sectors
+  *          buffered" the M933 counts. Both prints must extrude the same and
+  *          end in the same place, the file must be read to its end, and
+  *          with the read-ahead the parser may read a tenth of the sectors
+  *          at most, or it exits with 1.
+  ******************************************************************************
+  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#include "sim.h"
+#include "planner.h"
+#include "cardreader.h"
+#include "ff_gen_drv.h"
+
+/* Private Constants ---------------------------------------------------------*/
+
+// a 64MB card
+#define CARD_SECTORS   (131072)
+// the card's read time is taken in steps this long, so the planner is seen to run dry
+#define READ_STEP      (SIM_TICK_FREQ / 100000)
+// random reads and seeks of the first part, per file and mode
+#define SEEKS          (40)
+
+/* Private Variables ---------------------------------------------------------*/
+
+static std::vector<uint8_t> image;
+static sim_time_t readTicks, slowTicks;
+static uint32_t slowEvery = 64;
+static uint32_t reads;
+static sim_time_t dryTicks;
+static uint32_t dryReads;
+static uint32_t failed;
+static uint32_t seed = 1;
+
+/* Private Functions ---------------------------------------------------------*/
+
+static uint32_t random_below(uint32_t n)
+{
+	seed = seed * 1103515245 + 12345;
+	return (seed >> 8) % n;
+}
+
+uint8_t BSP_SD_IsDetected(void) { return SD_PRESENT; }
+
+static DSTATUS ram_initialize(BYTE lun) { return 0; }
+static DSTATUS ram_status(BYTE lun) { return 0; }
+
+static DRESULT ram_read(BYTE lun, BYTE *buff, DWORD sector, UINT count)
+{
+	if (sector + count > CARD_SECTORS) return RES_PARERR;
+	// the planner running out of moves it had as the read started
+	const bool moving = planner.blocks_queued();
+	bool ranDry = false;
+	for (UINT i = 0; i < count; i++) {
+		for (sim_time_t t = ++reads % slowEvery ? readTicks : slowTicks, step; t; t -= step) {
+			step = t < READ_STEP ? t : READ_STEP;
+			sim_advance(step);
+			if (moving && !planner.blocks_queued()) {
+				dryTicks += step;
+				ranDry = true;
+			}
+		}
+	}
+	dryReads += ranDry;
+	memcpy(buff, &image[(size_t)sector * 512], count * 512);
+	return RES_OK;
+}
+
+static DRESULT ram_write(BYTE lun, const BYTE *buff, DWORD sector, UINT count)
+{
+	if (sector + count > CARD_SECTORS) return RES_PARERR;
+	memcpy(&image[(size_t)sector * 512], buff, count * 512);
+	return RES_OK;
+}
+
+static DRESULT ram_ioctl(BYTE lun, BYTE cmd, void *buff)
+{
+	switch (cmd) {
+	case CTRL_SYNC: return RES_OK;
+	case GET_SECTOR_COUNT: *(DWORD *)buff = CARD_SECTORS; return RES_OK;
+	case GET_SECTOR_SIZE: *(WORD *)buff = 512; return RES_OK;
+	case GET_BLOCK_SIZE: *(DWORD *)buff = 1; return RES_OK;
+	}
+	return RES_PARERR;
+}
+
+static Diskio_drvTypeDef RamDriver = { ram_initialize, ram_status, ram_read, ram_write, ram_ioctl };
+
+static void fail(const char *what, const char *name)
+{
+	printf("FAIL: %s, %s\n", what, name);
+	failed++;
+}
+
+static bool load(const char *path, std::string &data)
+{
+	FILE *f = fopen(path, "rb");
+	if (!f) return false;
+	char buf[65536];
+	size_t n;
+	data.clear();
+	while ((n = fread(buf, 1, sizeof(buf), f)) > 0) data.append(buf, n);
+	fclose(f);
+	return true;
+}
+
+static bool copy_to_card(const char *name, const std::string &data)
+{
+	static FIL file;
+	UINT put;
+	return f_open(&file, name, FA_WRITE | FA_CREATE_ALWAYS) == FR_OK
+	    && f_write(&file, data.data(), data.size(), &put) == FR_OK && put == data.size() && f_close(&file) == FR_OK;
+}
+
+// Each line sent and acknowledged
+static void run_until_ok(const char *gcode)
+{
+	uint32_t ok = sim_ok_count();
+	for (const char *c = gcode; *c; c++) ok += *c == '\n';
+	sim_set_input(gcode, strlen(gcode));
+	while (!sim_input_done() || sim_ok_count() < ok) loop();
+}
+
+// The file read through from random offsets, as the parser of a text and of a .bgc file does
+static void check_reads(const char *name, const std::string &data, bool binary)
+{
+	const char *mode = binary ? "read_buff()" : "get()";
+	card.isBinaryMode = binary;
+	card.isGzip = false;
+	card.openFile((char *)name, true);
+	if (!card.isFileOpen() || card.fileLength() != data.size()) {
+		fail("can't open it", name);
+		return;
+	}
+	card.sdprinting = true;   // for readAhead()
+	for (int seek = 0; seek <= SEEKS; seek++) {
+		uint32_t pos = seek ? random_below(data.size()) : 0;
+		const uint32_t end = seek ? pos + random_below(8192) : data.size();
+		card.setIndex(pos);
+		while (pos < end && pos < data.size()) {
+			for (uint32_t n = random_below(3) ? 0 : random_below(6); n; n--) card.readAhead();
+			if (!binary) {
+				if (card.eof()) break;
+				if (card.get() != (uint8_t)data[pos++]) {
+					fail("a byte not the file's", mode);
+					return;
+				}
+				continue;
+			}
+			unsigned char buf[80];
+			const int got = card.read_buff(buf, sizeof(buf)), want = data.size() - pos < sizeof(buf) ? data.size() - pos : sizeof(buf);
+			if (got != want || memcmp(buf, &data[pos], got)) {
+				fail("bytes not the file's", mode);
+				return;
+			}
+			// a command takes some of them, the rest go back
+			const int used = got ? 1 + random_below(got) : 0;
+			card.push_read_buff(got - used);
+			pos += used;
+			if (!got) break;
+		}
+		if (!seek && (pos != data.size() || !card.eof() || card.get() != -1)) {
+			fail("not read to its end", mode);
+			return;
+		}
+	}
+	card.sdprinting = false;
+	card.closefile();
+	card.isBinaryMode = false;
+}
+
+// The file printed; false if the print didn't read it to the end
+static bool print(const char *name, bool readAhead, uint32_t &eSteps, float nozzle[3])
+{
+	char gcode[64];
+	sim_no_read_ahead = !readAhead;
+	card.readAheadSectors = card.readStalls = 0;
+	memset(card.readRingHistogram, 0, sizeof(card.readRingHistogram));
+	dryTicks = 0;
+	dryReads = 0;
+	const uint32_t before = sim.steps[E_AXIS];
+
+	snprintf(gcode, sizeof(gcode), "M23 %s\nM24\n", name);
+	run_until_ok(gcode);
+	const uint32_t size = card.fileLength();
+	bool read = false;
+	while (card.sdprinting) {
+		loop();
+		if (card.sdpos >= size) read = true;
+	}
+	run_until_ok("M400\n");
+
+	eSteps = sim.steps[E_AXIS] - before;
+	sim_nozzle();
+	memcpy(nozzle, sim.nozzle, sizeof(sim.nozzle));
+	return read;
+}
+
+/* Exported Functions --------------------------------------------------------*/
+
+int main(int argc, char **argv)
+{
+	uint32_t readUs = 600, slowMs = 10;
+	int opt;
+	while ((opt = getopt(argc, argv, "r:s:n:")) != -1) {
+		switch (opt) {
+		case 'r': readUs = atol(optarg); break;
+		case 's': slowMs = atol(optarg); break;
+		case 'n': slowEvery = atol(optarg); break;
+		default: optind = argc + 1; break;
+		}
+	}
+	if (optind >= argc || !slowEvery) {
+		fprintf(stderr, "usage: %s [-r us] [-s ms] [-n reads] file...\n", argv[0]);
+		return 2;
+	}
+
+	image.assign((size_t)CARD_SECTORS * 512, 0xFF);
+	char path[4];
+	FATFS_LinkDriver(&RamDriver, path);
+	static FATFS fs;
+	static BYTE work[_MAX_SS];
+	if (f_mkfs(path, FM_ANY, 4096, work, sizeof(work)) != FR_OK || f_mount(&fs, path, 1) != FR_OK) {
+		fprintf(stderr, "%s: can't format the card\n", argv[0]);
+		return 2;
+	}
+	std::vector<std::string> names, files;
+	for (int i = optind; i < argc; i++) {
+		std::string data;
+		const char *base = strrchr(argv[i], '/') ? strrchr(argv[i], '/') + 1 : argv[i];
+		if (!load(argv[i], data) || !copy_to_card(("0:/" + std::string(base)).c_str(), data)) {
+			fprintf(stderr, "%s: can't copy %s to the card\n", argv[0], argv[i]);
+			return 2;
+		}
+		names.push_back(base);
+		files.push_back(data);
+	}
+
+	// as marlin_sim, the SD autostart holds setup() for 5s, and mounts the card
+	sim_init();
+	sim_advance((sim_time_t)5000 * SIM_MS_TICKS);
+	setup();
+	if (!card.cardOK) {
+		fprintf(stderr, "%s: the firmware didn't mount the card\n", argv[0]);
+		return 2;
+	}
+
+	printf("%u sector ring, reads %uus, one in %u %ums\n", (unsigned)SD_READ_RING_SECTORS,
+			(unsigned)readUs, (unsigned)slowEvery, (unsigned)slowMs);
+	printf("file                 read-ahead   ahead  parser  ran dry   dry (s)  sectors buffered\n");
+	for (size_t f = 0; f < names.size(); f++) {
+		const char *name = names[f].c_str();
+		readTicks = slowTicks = 0;
+		check_reads(name, files[f], false);
+		check_reads(name, files[f], true);
+
+		readTicks = (sim_time_t)readUs * SIM_TICK_FREQ / 1000000;
+		slowTicks = (sim_time_t)slowMs * SIM_MS_TICKS;
+		uint32_t parser[2], eSteps[2];
+		float nozzle[2][3];
+		for (int ahead = 0; ahead < 2; ahead++) {
+			if (!print(name, ahead, eSteps[ahead], nozzle[ahead])) fail("the print didn't read the file through", name);
+			parser[ahead] = card.readStalls;
+			printf("%-20.20s %-10s %7u %7u %8u %9.3f ", ahead ? "" : name, ahead ? "on" : "off",
+					(unsigned)card.readAheadSectors, (unsigned)card.readStalls, (unsigned)dryReads,
+					(double)dryTicks / SIM_TICK_FREQ);
+			for (int i = 0; i <= SD_READ_RING_SECTORS; i++) printf(" %d:%u", i, (unsigned)card.readRingHistogram[i]);
+			printf("\n");
+		}
+		if (eSteps[0] != eSteps[1] || memcmp(nozzle[0], nozzle[1], sizeof(nozzle[0])))
+			fail("the prints extruded or ended differently", name);
+		if (parser[1] * 10 > parser[0]) fail("the parser read more than a tenth of the sectors itself", name);
+	}
+	if (sim.serialErrors) fail("the firmware reported errors", "Error:");
+
+	if (failed) return 1;
+	printf("PASS\n");
+	return 0;
+}
@@ -0,0 +1,113 @@
+/**
+  ******************************************************************************
+  * @file    sim/testspeedlookup.cpp
+  * @brief   Accuracy and cost of Stepper::calc_timer(), the interpolated
+  *          speed_lookuptable.h, against the exact division it replaced
+  * @note    build: make sim
+  *          usage: build_sim/testspeedlookup
+  *          Every step rate up to MAX_STEP_FREQUENCY is compared. Exits with
+  *          1 if a rate the planner can ask for (120 steps/s and up, see
+  *          calculate_trapezoid_for_block()) is off by more than a timer
+  *          tick and more than 0.5%.
+  *          The timings are host nanoseconds per call; on the M0 the
+  *          division is a call to the __aeabi_uidiv shift-subtract loop and
+  *          the gap is much wider.
+  ******************************************************************************
+  */
+
+#include <time.h>
+
+#include "sim.h"
+#include "stepper.h"
+
+/* Private Constants ---------------------------------------------------------*/
+
+#define PLANNER_MIN_RATE (120)
+#define MAX_ERROR        (0.005)
+#define TIMED_CALLS      (20000000)
+
+/* Private Variables ---------------------------------------------------------*/
+
+uint8_t Stepper::step_loops;
+
+static volatile uint32_t sink;
+
+/* Private Functions ---------------------------------------------------------*/
+
+// calc_timer() before speed_lookuptable.h
+static unsigned short exact_timer(unsigned long step_rate)
+{
+	NOMORE(step_rate, MAX_STEP_FREQUENCY);
+	NOLESS(step_rate, (uint32_t)((F_CPU() / ((uint32_t)0xffff * (uint32_t)TICK_TIMER_PRESCALER))) + 1u);
+	return (uint16_t)(F_CPU() / (step_rate * TICK_TIMER_PRESCALER)) - 1;
+}
+
+static double host_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// ns per call over the same pseudo random rates
+static double time_calls(unsigned short (*fn)(unsigned long))
+{
+	uint32_t seed = 1, sum = 0;
+	double start = host_ns();
+	for (uint32_t i = 0; i < TIMED_CALLS; i++) {
+		seed = seed * 1664525u + 1013904223u;
+		sum += fn(PLANNER_MIN_RATE + (seed >> 8) % (MAX_STEP_FREQUENCY - PLANNER_MIN_RATE));
+	}
+	sink = sum;
+	return (host_ns() - start) / TIMED_CALLS;
+}
+
+static unsigned short table_timer(unsigned long step_rate)
+{
+	return Stepper::calc_timer(step_rate);
+}
+
+/* Exported Functions --------------------------------------------------------*/
+
+int main(void)
+{
+	double worst = 0, worstAll = 0, sumError = 0;
+	uint32_t worstRate = 0, worstRateAll = 0, maxTicks = 0, maxTicksRate = 0, n = 0, failed = 0;
+
+	for (uint32_t rate = 0; rate <= MAX_STEP_FREQUENCY; rate++) {
+		int32_t exact = exact_timer(rate), table = Stepper::calc_timer(rate);
+		uint32_t ticks = labs(table - exact);
+		// relative error of the step rate actually produced
+		double error = (double)ticks / (exact + 1);
+		if (error > worstAll) {
+			worstAll = error;
+			worstRateAll = rate;
+		}
+		if (rate < PLANNER_MIN_RATE) continue;
+		sumError += error;
+		n++;
+		if (ticks > maxTicks) {
+			maxTicks = ticks;
+			maxTicksRate = rate;
+		}
+		if (ticks > 1 && error > MAX_ERROR) failed++;
+		if (error > worst) {
+			worst = error;
+			worstRate = rate;
+		}
+	}
+
+	printf("rates %u-%u    worst %.3f%% at %u steps/s, mean %.4f%%, max %u ticks at %u steps/s\n",
+			PLANNER_MIN_RATE, MAX_STEP_FREQUENCY, worst * 100, (unsigned)worstRate, sumError / n * 100, (unsigned)maxTicks, (unsigned)maxTicksRate);
+	printf("rates 0-%u      worst %.3f%% at %u steps/s\n", MAX_STEP_FREQUENCY, worstAll * 100, (unsigned)worstRateAll);
+
+	double divide = time_calls(exact_timer), lookup = time_calls(table_timer);
+	printf("host time    division %.2f ns, table %.2f ns per call\n", divide, lookup);
+
+	if (failed) {
+		printf("FAIL: %u rates more than a tick and %.1f%% off\n", (unsigned)failed, MAX_ERROR * 100);
+		return 1;
+	}
+	printf("PASS\n");
+	return 0;
+}
@@ -0,0 +1,150 @@
+/**
+  ******************************************************************************
+  * @file    sim/testthermistor.cpp
+  * @brief   Temperature::analog2temp() and analog2tempBed(), the binary
+  *          search of the segments of thermistor_lut.h, against the scan of
+  *          the thermistor table they replaced, for every raw value
+  * @note    build: make sim
+  *          usage: build_sim/testthermistor
+  *          Every oversampled raw value, 0 to 65535, is converted both ways
+  *          for the hotend and the bed: the new celsius must be within
+  *          TOLERANCE of the old, and the raw limits Temperature::init()
+  *          works out for the min and max temperatures (a conversion per
+  *          OVERSAMPLENR step from the end of the range) must be the same,
+  *          or it exits with 1. "steps" counts the entries the scan looked
+  *          at and the halvings of the search, per conversion, over the
+  *          whole range. The fastest of RUNS counts; the host has an FPU,
+  *          on the printer the scan's divide and multiply are soft-float
+  *          calls, the search has none but the scale of the result.
+  ******************************************************************************
+  */
+
+#include <time.h>
+#include <unistd.h>
+
+#include "sim.h"
+#include "temperature.h"
+#include "thermistortables.h"
+
+/* Private Constants ---------------------------------------------------------*/
+
+// of the new celsius from the old
+#define TOLERANCE (0.001f)
+// the fastest of this many runs counts, each over the range PASSES times
+#define RUNS (5)
+#define PASSES (64)
+#define RAW_VALUES (65536)
+
+/* Private Variables ---------------------------------------------------------*/
+
+// the values converted go here, so they aren't optimized away
+static volatile float sink;
+static uint64_t scanSteps;
+
+/* Private Functions ---------------------------------------------------------*/
+
+static double host_seconds(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// analog2temp() and analog2tempBed() as they were
+template<typename T, uint8_t N>
+static float old_celsius(const T (&tt)[N][2], int raw)
+{
+	float celsius = 0;
+	uint8_t i;
+	for (i = 1; i < N; i++) {
+		if (tt[i][0] > raw) {
+			celsius = tt[i - 1][1] + (raw - tt[i - 1][0]) * (float)(tt[i][1] - tt[i - 1][1]) / (float)(tt[i][0] - tt[i - 1][0]);
+			break;
+		}
+	}
+	scanSteps += i;
+	if (i == N) celsius = tt[i - 1][1];
+	return celsius;
+}
+
+static float old_temp(bool bed, int raw) { return bed ? old_celsius(BEDTEMPTABLE, raw) : old_celsius(HEATER_0_TEMPTABLE, raw); }
+static float new_temp(bool bed, int raw) { return bed ? Temperature::analog2tempBed(raw) : Temperature::analog2temp(raw, 0); }
+
+// Temperature::init(), the raw limits of mintemp and maxttemp
+static void limits(bool bed, bool scan, int &minRaw, int &maxRaw)
+{
+	float (*temp)(bool, int) = scan ? old_temp : new_temp;
+	const int lo = bed ? HEATER_BED_RAW_LO_TEMP : HEATER_0_RAW_LO_TEMP, hi = bed ? HEATER_BED_RAW_HI_TEMP : HEATER_0_RAW_HI_TEMP;
+	const int mintemp = bed ? BED_MINTEMP : HEATER_0_MINTEMP, maxtemp = bed ? BED_MAXTEMP : HEATER_0_MAXTEMP;
+	const int step = lo < hi ? OVERSAMPLENR : -OVERSAMPLENR;
+	for (minRaw = lo; temp(bed, minRaw) < mintemp; minRaw += step);
+	for (maxRaw = hi; temp(bed, maxRaw) > maxtemp; maxRaw -= step);
+}
+
+static uint32_t compare(bool bed)
+{
+	uint32_t mismatches = 0;
+	float worst = 0;
+	int worstRaw = 0;
+	scanSteps = 0;
+	for (int raw = 0; raw < RAW_VALUES; raw++) {
+		const float a = old_temp(bed, raw), b = new_temp(bed, raw);
+		if (fabs(a - b) > worst) {
+			worst = fabs(a - b);
+			worstRaw = raw;
+		}
+		if (fabs(a - b) > TOLERANCE && mismatches++ < 10)
+			printf("differ       raw %u: %.4f against %.4f\n", raw, a, b);
+	}
+	const char *name = bed ? "bed" : "hotend";
+	printf("%-12s worst %.5f C at raw %u (%.3f C)\n", name, worst, worstRaw, old_temp(bed, worstRaw));
+	printf("steps        scan %.1f, search %.1f per conversion\n", (double)scanSteps / RAW_VALUES, ceil(log2(bed ? BEDTEMPTABLE_LEN : HEATER_0_TEMPTABLE_LEN)));
+
+	int limit[2][2];
+	for (int scan = 0; scan < 2; scan++) limits(bed, scan, limit[scan][0], limit[scan][1]);
+	printf("limits       raw %d to %d, scan %d to %d\n", limit[0][0], limit[0][1], limit[1][0], limit[1][1]);
+	if (limit[0][0] != limit[1][0] || limit[0][1] != limit[1][1]) {
+		printf("differ       the raw limits of the %s\n", name);
+		mismatches++;
+	}
+	return mismatches;
+}
+
+static double run(bool search)
+{
+	const double start = host_seconds();
+	for (int pass = 0; pass < PASSES; pass++) {
+		for (int raw = 0; raw < RAW_VALUES; raw++)
+			sink += search ? new_temp(false, raw) : old_temp(false, raw);
+	}
+	return host_seconds() - start;
+}
+
+/* Exported Functions --------------------------------------------------------*/
+
+int main(int argc, char **argv)
+{
+	if (argc != 1) {
+		fprintf(stderr, "usage: %s\n", argv[0]);
+		return 2;
+	}
+	printf("table %u, %u entries, bed table %u, %u entries\n", (unsigned)THERMISTORHEATER_0, (unsigned)HEATER_0_TEMPTABLE_LEN,
+			(unsigned)THERMISTORBED, (unsigned)BEDTEMPTABLE_LEN);
+	uint32_t mismatches = 0;
+	for (int bed = 0; bed < 2; bed++) mismatches += compare(bed);
+
+	double seconds[2];
+	for (int search = 0; search < 2; search++) {
+		seconds[search] = run(search);
+		for (int i = 1; i < RUNS; i++) seconds[search] = min(seconds[search], run(search));
+		printf("%-12s %6.2f ns per conversion\n", search ? "search" : "scan", seconds[search] * 1e9 / RAW_VALUES / PASSES);
+	}
+	printf("speedup      x%.2f\n", seconds[0] / seconds[1]);
+
+	if (mismatches) {
+		printf("FAIL: %u conversions differ\n", (unsigned)mismatches);
+		return 1;
+	}
+	printf("PASS\n");
+	return 0;
+}
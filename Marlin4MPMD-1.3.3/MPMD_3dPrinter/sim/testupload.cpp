@@ -0,0 +1,603 @@
+/**
+  ******************************************************************************
+  * @file    sim/testupload.cpp
+  * @brief   Uploads to the SD card, plain M34 against the CRC checked frames
+  *          of M34 F (sd_upload.h), through the real USB CDC Rx ring and
+  *          FatFs on a card image, in MB/s of a simulated clock
+  * @note    build: make sim
+  *          usage: build_sim/testupload [-u KB/s] [-w us] [-p us] [-b] [-l us] [-e n] file...
+  *            -u  rate of the USB bus to the printer (default 1000 KB/s)
+  *            -w  time to send a sector to the card (default 600 us)
+  *            -p  time the card is busy programming it (default 500 us)
+  *            -b  wait for the programming after each write, as the SD
+  *                driver did, not before the next command
+  *            -l  from a line the printer sends to the host acting on it
+  *                (default 2000 us)
+  *            -e  one frame sent in this many is corrupted in the last run
+  *                (default 50)
+  *            e.g. build_sim/testupload Marlin4MPMD-1.3.3/SdCardContent/gcodes/*
+  *          The mock host sends 64 byte packets at the rate of the bus while
+  *          the firmware has the OUT endpoint armed, into the Rx ring of
+  *          stm32f0xx_3dprinter_cdc.c, from the USB interrupt: during the
+  *          card writes too. Like the timer interrupt of
+  *          usbd_cdc_interface.c, a 1ms tick re-arms the endpoint once half
+  *          the ring is free. The card is a RAM image formatted with
+  *          f_mkfs(), every sector read or written costs its time, and
+  *          the card takes no command while it programs one. The
+  *          firmware side is charged for its reads of the ring, by the byte
+  *          (and for the CRC, framed), for the lines it sends and for its
+  *          polls of the LCD; the USB interrupt's time is taken from it.
+  *          "plain" is the loop of M34 as it was, kept here: the host sends
+  *          the file as fast as the USB takes it (ignoring "busy:"), then
+  *          waits a second and a bit and sends "M29". "framed" is
+  *          SdUpload::receive() as M34 F runs it, the host keeping
+  *          UPLOAD_WINDOW frames out, going back on "Resend:" and when no
+  *          "ok" has come for HOST_TIMEOUT. In the last run one frame in -e,
+  *          at random, is corrupted on the way: a bit of its data, header or
+  *          CRC flipped, its length made too long or a byte of it left out.
+  *          Every file on the card must be the file sent, every corrupted
+  *          frame must have been sent again, or it exits with 1.
+  ******************************************************************************
+  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "ff_gen_drv.h"
+#include "sd_upload.h"
+#include "language.h"
+#include "usbd_core.h"
+#include "usbd_desc.h"
+#include "usbd_cdc.h"
+#include "usbd_cdc_interface.h"
+
+/* Private Constants ---------------------------------------------------------*/
+
+// a 64MB card
+#define CARD_SECTORS      (131072)
+// what the firmware side is charged, us
+#define READ_CALL_US      (1.0)    // a call of MYSERIAL.read()
+#define COPY_US           (0.1)    // a byte out of the ring
+#define CRC_US            (0.35)   // a byte through uzlib_crc32(), 16 cycles
+#define REPLY_US          (5.0)    // a line queued to the host
+#define IDLE_US           (5.0)    // lcd_update() with nothing to do
+#define ISR_US            (6.0)    // the USB interrupt, a packet into the ring
+#define SECTOR_READ_US    (600.0)
+#define TICK_US           (1000.0) // re-arm check of the USB timer interrupt
+// the host sends frames again from the oldest not answered after this long
+#define HOST_TIMEOUT_US   (100000.0)
+// plain M34: the host's wait before "M29"
+#define M29_WAIT_US       (1100000.0)
+// the host gives up on a frame sent this many times, the firmware then times out
+#define MAX_SENDS         (32)
+
+/* Private Types -------------------------------------------------------------*/
+
+typedef struct {
+	double at;       // when the host acts on it
+	std::string line;
+} Reply;
+
+typedef struct {
+	double seconds;
+	uint32_t frames, resends, timeouts, corrupted, resent;
+	bool ok;
+} Result;
+
+/* Private Variables ---------------------------------------------------------*/
+
+// settings
+static double packetUs = 64.0, writeUs = 600.0, programUs = 500.0, latencyUs = 2000.0;
+static uint32_t errorEvery = 50;
+static bool busyAfterWrite;
+
+// the card
+static std::vector<uint8_t> image;
+static FIL file;
+static double cardBusyUntil;
+
+// the clock, the bus and the lines on their way to the host
+static double now, nextTick, busFree;
+static bool rxArmed;
+static std::string wire;   // bytes the host has sent, not yet on the bus
+static size_t wirePos;
+static std::deque<Reply> replies;
+static bool crcCharged;
+
+// the host, framed: frames from base are not answered, next is the next to send
+static const std::string *content;
+static uint32_t base, next, last, timeouts;
+static double lastProgress;
+static std::vector<uint8_t> corruptedAt;  // times each frame was corrupted
+static std::vector<uint16_t> sentAt;      // times each frame was sent
+static bool framedHost, corrupt;
+// the host, plain: when "M29" goes
+static double m29At;
+
+static std::vector<std::string> names, contents;
+static uint32_t seed = 1;
+static uint32_t failed;
+
+/* Private Functions ---------------------------------------------------------*/
+
+static void advance(double us);
+
+/* The card: FatFs on a RAM image, every sector costs its time */
+
+// What the SD driver waits for before a command (SD_WaitWriteDone())
+static void card_ready(void)
+{
+	if (now < cardBusyUntil) advance(cardBusyUntil - now);
+}
+
+static DSTATUS ram_initialize(BYTE lun) { return 0; }
+static DSTATUS ram_status(BYTE lun) { return 0; }
+
+static DRESULT ram_read(BYTE lun, BYTE *buff, DWORD sector, UINT count)
+{
+	if (sector + count > CARD_SECTORS) return RES_PARERR;
+	card_ready();
+	memcpy(buff, &image[(size_t)sector * 512], count * 512);
+	advance(count * SECTOR_READ_US);
+	return RES_OK;
+}
+
+static DRESULT ram_write(BYTE lun, const BYTE *buff, DWORD sector, UINT count)
+{
+	if (sector + count > CARD_SECTORS) return RES_PARERR;
+	card_ready();
+	memcpy(&image[(size_t)sector * 512], buff, count * 512);
+	advance(count * writeUs + (count - 1) * programUs);
+	cardBusyUntil = now + programUs;
+	if (busyAfterWrite) card_ready();
+	return RES_OK;
+}
+
+static DRESULT ram_ioctl(BYTE lun, BYTE cmd, void *buff)
+{
+	switch (cmd) {
+	case CTRL_SYNC: card_ready(); return RES_OK;
+	case GET_SECTOR_COUNT: *(DWORD *)buff = CARD_SECTORS; return RES_OK;
+	case GET_SECTOR_SIZE: *(WORD *)buff = 512; return RES_OK;
+	case GET_BLOCK_SIZE: *(DWORD *)buff = 1; return RES_OK;
+	}
+	return RES_PARERR;
+}
+
+static Diskio_drvTypeDef RamDriver = { ram_initialize, ram_status, ram_read, ram_write, ram_ioctl };
+
+/* The USB device stack around the CDC layer, and the rest it calls */
+
+extern "C" uint8_t rxInProgress;
+extern "C" void BSP_CDC_RxCpltCallback(uint8_t* Buf, uint32_t *Len);
+
+extern "C" {
+__IO uint32_t uwTick;
+USBD_ClassTypeDef USBD_CDC;
+USBD_CDC_ItfTypeDef USBD_CDC_fops;
+USBD_DescriptorsTypeDef VCP_Desc;
+
+USBD_StatusTypeDef USBD_Init(USBD_HandleTypeDef *pdev, USBD_DescriptorsTypeDef *pdesc, uint8_t id) { return USBD_OK; }
+USBD_StatusTypeDef USBD_DeInit(USBD_HandleTypeDef *pdev) { return USBD_OK; }
+USBD_StatusTypeDef USBD_RegisterClass(USBD_HandleTypeDef *pdev, USBD_ClassTypeDef *pclass) { return USBD_OK; }
+uint8_t USBD_CDC_RegisterInterface(USBD_HandleTypeDef *pdev, USBD_CDC_ItfTypeDef *fops) { return USBD_OK; }
+USBD_StatusTypeDef USBD_Start(USBD_HandleTypeDef *pdev) { rxArmed = true; return USBD_OK; }
+USBD_StatusTypeDef USBD_Stop(USBD_HandleTypeDef *pdev) { rxArmed = false; return USBD_OK; }
+
+uint8_t USBD_CDC_ReceivePacket(USBD_HandleTypeDef *pdev)
+{
+	rxInProgress = 1;
+	rxArmed = true;
+	return USBD_OK;
+}
+
+uint8_t CDC_Itf_IsTxQueueEmpty(void) { return 1; }
+void CDC_Itf_QueueTxBytes(uint8_t *Buf, uint32_t Len) { }
+void HAL_Delay(__IO uint32_t Delay) { }
+void BSP_LED_On(Led_TypeDef Led) { }
+void BSP_LED_Off(Led_TypeDef Led) { }
+
+void BSP_MiscErrorHandler(uint16_t error)
+{
+	printf("FAIL: CDC error %u\n", (unsigned)error);
+	exit(1);
+}
+}
+
+/* The host */
+
+static uint32_t random_below(uint32_t n)
+{
+	seed = seed * 1664525u + 1013904223u;
+	return (seed >> 8) % n;
+}
+
+static uint32_t crc32(const std::string &s, size_t from)
+{
+	uint32_t crc = 0xFFFFFFFF;
+	for (size_t i = from; i < s.size(); i++) {
+		crc ^= (uint8_t)s[i];
+		for (int b = 0; b < 8; b++) crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+	}
+	return ~crc;
+}
+
+// Frame n of the file, the one after the last of its data empty
+static std::string frame(uint32_t n)
+{
+	const size_t at = (size_t)n * UPLOAD_FRAME_SIZE;
+	const uint16_t len = n < last ? min((size_t)UPLOAD_FRAME_SIZE, content->size() - at) : 0;
+	std::string f;
+	f += (char)UPLOAD_SYNC1;
+	f += (char)UPLOAD_SYNC2;
+	f += (char)n;
+	f += (char)len;
+	f += (char)(len >> 8);
+	if (len) f.append(*content, at, len);
+	const uint32_t crc = crc32(f, 2);
+	for (int i = 0; i < 4; i++) f += (char)(crc >> (8 * i));
+	return f;
+}
+
+// Send frames while the window has room, one in errorEvery corrupted
+static void host_send(void)
+{
+	while (next <= last && next < base + UPLOAD_WINDOW) {
+		if (sentAt[next] == MAX_SENDS) return;
+		std::string f = frame(next);
+		sentAt[next]++;
+		if (corrupt && !random_below(errorEvery)) {
+			const size_t len = f.size() - 9;
+			switch (len ? random_below(5) : 4) {
+			case 0: f[5 + len / 2] ^= 0x10; break;            // a bit of the data
+			case 1: f[2] ^= 0x01; break;                      // seq
+			case 2: f.erase(5 + len / 3, 1); break;           // a byte left out
+			case 3: f[4] |= 0x80; break;                      // the length, too long
+			default: f[f.size() - 2] ^= 0x40; break;          // the CRC
+			}
+			corruptedAt[next]++;
+		}
+		wire += f;
+		next++;
+	}
+}
+
+// The frame of base to next whose seq is s, -1 if none
+static int32_t host_frame(unsigned s, uint32_t to)
+{
+	for (uint32_t n = base; n <= to && n <= last; n++)
+		if ((n & 0xFF) == s) return n;
+	return -1;
+}
+
+static void host_reply(const std::string &line)
+{
+	unsigned s;
+	if (!framedHost) return;
+	if (sscanf(line.c_str(), UPLOAD_MSG_ACK "%u", &s) == 1) {
+		const int32_t n = host_frame(s, next - 1);
+		if (n < 0) return;
+		base = n + 1;
+		lastProgress = now;
+	}
+	else if (sscanf(line.c_str(), MSG_RESEND "%u", &s) == 1) {
+		const int32_t n = host_frame(s, next);
+		if (n < 0) return;
+		base = next = n;
+		lastProgress = now;
+	}
+	host_send();
+}
+
+/* The clock: the USB interrupt, its timer and the host in the background */
+
+static void advance(double us)
+{
+	double end = now + us;
+	for (;;) {
+		double t = end;
+		int what = 0;
+		if (rxArmed && wirePos < wire.size() && max(busFree, now) < t) { t = max(busFree, now); what = 1; }
+		if (nextTick < t) { t = nextTick; what = 2; }
+		if (!replies.empty() && replies.front().at < t) { t = replies.front().at; what = 3; }
+		if (framedHost && base < next && lastProgress + HOST_TIMEOUT_US < t) { t = lastProgress + HOST_TIMEOUT_US; what = 4; }
+		if (m29At && m29At < t) { t = m29At; what = 5; }
+		if (!what) break;
+		now = t;
+		switch (what) {
+		case 1: {
+			// the USB interrupt, its time taken from the main loop
+			uint8_t packet[CDC_DATA_FS_OUT_PACKET_SIZE];
+			uint32_t len = min(wire.size() - wirePos, sizeof(packet));
+			memcpy(packet, wire.data() + wirePos, len);
+			wirePos += len;
+			busFree = now + packetUs * len / sizeof(packet);
+			rxArmed = false;
+			BSP_CDC_RxCpltCallback(packet, &len);
+			end += ISR_US;
+			if (!framedHost && wirePos == wire.size() && !m29At && wire.size() == content->size())
+				m29At = now + M29_WAIT_US;
+			break;
+		}
+		case 2:
+			if (!rxInProgress && CDC_RX_BUFFER_SIZE - BSP_CdcGetNbRxAvailableBytes(0) > CDC_RX_BUFFER_SIZE / 2)
+				USBD_CDC_ReceivePacket(&USBD_Device);
+			nextTick += TICK_US;
+			uwTick++;
+			break;
+		case 3: {
+			const std::string line = replies.front().line;
+			replies.pop_front();
+			host_reply(line);
+			break;
+		}
+		case 4:
+			timeouts++;
+			next = base;
+			lastProgress = now;
+			host_send();
+			break;
+		case 5:
+			wire += "M29\r\n";
+			m29At = 0;
+			break;
+		}
+	}
+	now = end;
+}
+
+/* The firmware side */
+
+static uint32_t fw_read(uint8_t *buff, uint32_t maxlen)
+{
+	advance(READ_CALL_US);
+	const uint32_t n = BSP_CdcCopyNextRxBytes(buff, maxlen);
+	advance(n * (COPY_US + (crcCharged ? CRC_US : 0)));
+	return n;
+}
+
+static void fw_line(const std::string &line)
+{
+	advance(REPLY_US);
+	Reply r = { now + latencyUs, line };
+	replies.push_back(r);
+}
+
+static void fw_reply(const char *msg, const uint8_t seq)
+{
+	char line[32];
+	snprintf(line, sizeof(line), "%s%u", msg, (unsigned)seq);
+	fw_line(line);
+}
+
+static bool fw_write(const uint8_t *buff, const uint16_t len)
+{
+	UINT put;
+	return f_write(&file, buff, len, &put) == FR_OK && put == len;
+}
+
+static void fw_idle(void) { advance(IDLE_US); }
+static millis_t fw_now(void) { return (millis_t)(now / 1000); }
+
+// The loop of M34 as it was, less the LCD's progress
+enum M34_state { M34_IDLE, M34_M, M34_M2, M34_M29, M34_RX };
+#define M34_TIMEOUT 1000
+
+static void plain_m34(void)
+{
+	unsigned char SDbuff[512] = "";
+	uint8_t M34_state = M34_IDLE;
+	uint32_t last_rx = fw_now();
+	uint16_t SD_idx = 0;
+	const char M29_CMD[] = "M29\r\n";
+	bool CTS = true;
+	while (M34_state != M34_RX) {
+		advance(READ_CALL_US);
+		if (BSP_CdcGetNbRxAvailableBytes(0) > 0) {
+			SD_idx += fw_read(&SDbuff[SD_idx], 512 - SD_idx);
+			switch (M34_state) {
+			case M34_IDLE:
+				if (PENDING(fw_now(), last_rx + M34_TIMEOUT))
+					last_rx = fw_now();
+				else if (SD_idx < sizeof(M29_CMD) - 1 && memcmp(SDbuff, M29_CMD, SD_idx) == 0) {
+					last_rx = fw_now();
+					M34_state = M34_M29;
+				}
+				else if (SD_idx == sizeof(M29_CMD) - 1 && memcmp(SDbuff, M29_CMD, SD_idx) == 0)
+					M34_state = M34_RX;
+				else
+					last_rx = fw_now();
+				break;
+			case M34_M29:
+				if (PENDING(fw_now(), last_rx + M34_TIMEOUT)) {
+					if (SD_idx < sizeof(M29_CMD) - 1 && memcmp(SDbuff, M29_CMD, SD_idx) == 0) { }
+					else if (SD_idx == sizeof(M29_CMD) - 1 && memcmp(SDbuff, M29_CMD, SD_idx) == 0)
+						M34_state = M34_RX;
+					else
+						M34_state = M34_IDLE;
+				}
+				else
+					M34_state = M34_IDLE;
+				break;
+			}
+		}
+		fw_idle();
+		if (M34_state == M34_M29 && fw_now() - last_rx > M34_TIMEOUT)
+			M34_state = M34_IDLE;
+		advance(READ_CALL_US);
+		if (CTS && BSP_CdcGetNbRxAvailableBytes(0) >= CDC_RX_BUFFER_SIZE / 2) {
+			CTS = false;
+			fw_line(MSG_BUSY_PROCESSING);
+		}
+		advance(READ_CALL_US);
+		if (!CTS && BSP_CdcGetNbRxAvailableBytes(0) < CDC_RX_BUFFER_SIZE / 2) {
+			CTS = true;
+			fw_line(MSG_OK);
+		}
+		if (M34_state == M34_IDLE && ((SD_idx > 0) && (SD_idx == sizeof(SDbuff) || fw_now() - last_rx > M34_TIMEOUT))) {
+			fw_write(SDbuff, SD_idx);
+			SD_idx = 0;
+		}
+	}
+}
+
+// Upload file n to the card, plain or framed; the time it took
+static Result upload(size_t n, bool framed, bool corrupted)
+{
+	static const SdUploadIO io = { fw_read, fw_reply, fw_write, fw_idle, fw_now };
+	static SdUpload receiver;
+	static uint8_t frame[2][UPLOAD_FRAME_SIZE];
+	Result r;
+	memset(&r, 0, sizeof(r));
+
+	content = &contents[n];
+	now = busFree = cardBusyUntil = 0;
+	nextTick = TICK_US;
+	wire.clear();
+	wirePos = 0;
+	replies.clear();
+	m29At = 0;
+	framedHost = crcCharged = framed;
+	corrupt = corrupted;
+	base = next = timeouts = 0;
+	seed = n + 1;
+	last = (content->size() + UPLOAD_FRAME_SIZE - 1) / UPLOAD_FRAME_SIZE;
+	lastProgress = 0;
+	corruptedAt.assign(last + 1, 0);
+	sentAt.assign(last + 1, 0);
+
+	BSP_CdcIfStart();
+	if (f_open(&file, names[n].c_str(), FA_WRITE | FA_CREATE_ALWAYS) != FR_OK) return r;
+	bool ok;
+	if (framed) {
+		host_send();
+		ok = receiver.receive(io, frame) == (int32_t)content->size();
+		r.frames = receiver.frames;
+		r.resends = receiver.resends;
+	}
+	else {
+		wire = *content;
+		plain_m34();
+		ok = true;
+	}
+	ok = f_close(&file) == FR_OK && ok;
+	r.seconds = now * 1e-6;
+	BSP_CdcIfStop();
+
+	// the file on the card
+	static BYTE buf[4096];
+	UINT got;
+	std::string back;
+	if (f_open(&file, names[n].c_str(), FA_OPEN_EXISTING | FA_READ) != FR_OK) return r;
+	while (f_read(&file, buf, sizeof(buf), &got) == FR_OK && got) back.append((char *)buf, got);
+	f_close(&file);
+	r.ok = ok && back == *content;
+
+	r.timeouts = timeouts;
+	for (uint32_t i = 0; i <= last; i++) {
+		r.corrupted += corruptedAt[i];
+		if (corruptedAt[i]) {
+			r.resent++;
+			if (sentAt[i] <= corruptedAt[i]) r.ok = false;
+		}
+	}
+	return r;
+}
+
+static bool load(const char *name)
+{
+	FILE *f = fopen(name, "rb");
+	if (!f) return false;
+	std::string content;
+	char buf[4096];
+	size_t n;
+	while ((n = fread(buf, 1, sizeof(buf), f)) > 0) content.append(buf, n);
+	fclose(f);
+	const char *base = strrchr(name, '/');
+	std::string name83 = base ? base + 1 : name;
+	names.push_back("0:/" + name83);
+	contents.push_back(content);
+	return true;
+}
+
+static void fail(const char *what, const std::string &name)
+{
+	printf("FAIL: %s %s\n", what, name.c_str() + 3);
+	failed++;
+}
+
+/* Exported Functions --------------------------------------------------------*/
+
+int main(int argc, char **argv)
+{
+	double usbKBs = 1000;
+	int opt;
+	while ((opt = getopt(argc, argv, "u:w:p:bl:e:")) != -1) {
+		switch (opt) {
+		case 'u': usbKBs = atof(optarg); break;
+		case 'w': writeUs = atof(optarg); break;
+		case 'p': programUs = atof(optarg); break;
+		case 'b': busyAfterWrite = true; break;
+		case 'l': latencyUs = atof(optarg); break;
+		case 'e': errorEvery = atol(optarg); break;
+		default: optind = argc + 1; break;
+		}
+	}
+	if (optind >= argc || usbKBs <= 0 || writeUs < 0 || programUs < 0 || latencyUs < 0 || errorEvery < 2) {
+		fprintf(stderr, "usage: %s [-u KB/s] [-w us] [-p us] [-b] [-l us] [-e n] file...\n", argv[0]);
+		return 2;
+	}
+	packetUs = CDC_DATA_FS_OUT_PACKET_SIZE * 1000.0 / usbKBs;
+	for (int i = optind; i < argc; i++) {
+		if (!load(argv[i])) {
+			fprintf(stderr, "%s: can't read %s\n", argv[0], argv[i]);
+			return 2;
+		}
+	}
+
+	image.assign((size_t)CARD_SECTORS * 512, 0xFF);
+	char path[4];
+	FATFS_LinkDriver(&RamDriver, path);
+	static FATFS fs;
+	static BYTE work[_MAX_SS];
+	if (f_mkfs(path, FM_ANY, 4096, work, sizeof(work)) != FR_OK || f_mount(&fs, path, 1) != FR_OK) {
+		fprintf(stderr, "%s: can't format the card\n", argv[0]);
+		return 2;
+	}
+
+	printf("%u files, USB %.0f KB/s, %.0f+%.0f us a sector written (busy waited %s), %.0f us to the host, window of %u frames, 1 in %u corrupted\n",
+			(unsigned)names.size(), usbKBs, writeUs, programUs, busyAfterWrite ? "after it" : "before the next command", latencyUs,
+			(unsigned)UPLOAD_WINDOW, (unsigned)errorEvery);
+	printf("                          plain              framed          framed, corrupted\n");
+	printf("file              size      s   MB/s         s   MB/s         s   MB/s  frames corrupted resends timeouts\n");
+	double bytes = 0, total[3] = { 0, 0, 0 };
+	for (size_t n = 0; n < names.size(); n++) {
+		const Result plain = upload(n, false, false),
+		             framed = upload(n, true, false),
+		             bad = upload(n, true, true);
+		const double mb = contents[n].size() / 1e6;
+		printf("%-14.14s %7u %6.2f %6.3f    %6.2f %6.3f    %6.2f %6.3f  %6u %9u %7u %8u\n", names[n].c_str() + 3,
+				(unsigned)contents[n].size(), plain.seconds, mb / plain.seconds, framed.seconds, mb / framed.seconds,
+				bad.seconds, mb / bad.seconds, (unsigned)bad.frames, (unsigned)bad.corrupted, (unsigned)bad.resends, (unsigned)bad.timeouts);
+		if (!plain.ok) fail("plain upload of", names[n]);
+		if (!framed.ok) fail("framed upload of", names[n]);
+		if (!bad.ok) fail("framed upload, corrupted, of", names[n]);
+		if (framed.resends || framed.timeouts) fail("frames sent again with none corrupted,", names[n]);
+		if (!bad.corrupted) fail("no frame corrupted in", names[n]);
+		bytes += mb;
+		total[0] += plain.seconds;
+		total[1] += framed.seconds;
+		total[2] += bad.seconds;
+	}
+	printf("%-22s %6.2f %6.3f    %6.2f %6.3f    %6.2f %6.3f\n", "all", total[0], bytes / total[0], total[1], bytes / total[1],
+			total[2], bytes / total[2]);
+
+	if (failed) return 1;
+	printf("PASS\n");
+	return 0;
+}
@@ -0,0 +1,376 @@
+/**
+  ******************************************************************************
+  * @file    sim/trace_analyze.cpp
+  * @brief   Decodes a stepper step timeline (STEPPER_TRACE) into per-axis
+  *          velocity/acceleration curves and reports stalls and jerk
+  *          violations
+  * @note    build: make sim
+  *          usage: build_sim/trace_analyze [-c curves.csv] [-w ms] [-g seconds]
+  *                     [-j mm/s] [-n count] [-r reference] trace
+  *            trace  a marlin_sim -T file, or a serial log holding M930 dumps
+  *            -c  write the curves, CSV: time, velocity (mm/s) and
+  *                acceleration (mm/s^2) of A, B, C and E
+  *            -w  curve sample width (default 10ms)
+  *            -g  longest time the planner may run dry between two blocks
+  *                for it to count as a stall, longer is a pause (default 2s)
+  *            -j  slack (mm/s) over the jerk limits before a junction is
+  *                reported (default 1)
+  *            -n  number of stalls and violations listed (default 10)
+  *            -r  compare with this trace instead, event by event: periods,
+  *                steps, directions, flags and the time between events.
+  *                Exits with 1 at the first difference. A change that
+  *                shouldn't change the motion (block_t layout, planner
+  *                bookkeeping) must leave a print's trace as it is. Steps
+  *                played by DMA (STEP_BURST) compare the same as steps of
+  *                the interrupt, they are counted apart
+  *          A stall is the queue running empty (block_buffer_tail ==
+  *          block_buffer_head) with more moves to come: the stepper
+  *          interrupt finished a block, found nothing to execute and idled
+  *          until the next block arrived. Junction velocities are the
+  *          step rate of the last interrupt of a block against the first
+  *          of the next, scaled by each axis' share of the step events,
+  *          and checked the way Planner::buffer_line() limits them on a
+  *          delta: the A/B carriage change against DEFAULT_XYJERK, C
+  *          against DEFAULT_ZJERK and E against DEFAULT_EJERK. Blocks cut
+  *          short by an endstop or a quick stop are not checked.
+  ******************************************************************************
+  */
+
+#include <unistd.h>
+#include <vector>
+
+#include "sim.h"
+#include "stepper_trace.h"
+
+/* Private Types -------------------------------------------------------------*/
+
+typedef struct {
+	double start;                 // time of the first interrupt (s)
+	double entryRate, exitRate;   // step events per second at either end
+	uint32_t events;              // step events (interrupts)
+	uint32_t steps[SIM_AXES];     // steps per axis
+	uint8_t dirs;
+	bool ended;                   // reached STEPPER_TRACE_END
+} TraceBlock;
+
+typedef struct {
+	double time, value, limit;
+	const char *axis;
+} TraceIssue;
+
+/* Private Variables ---------------------------------------------------------*/
+
+static const float stepsPerMm[SIM_AXES] = DEFAULT_AXIS_STEPS_PER_UNIT;
+
+static std::vector<stepper_trace_t> events;
+static uint32_t rate;
+
+/* Private Functions ---------------------------------------------------------*/
+
+static int hexval(char c)
+{
+	if (c >= '0' && c <= '9') return c - '0';
+	if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+	return -1;
+}
+
+// Binary file written by marlin_sim -T
+static bool load_binary(FILE *f, std::vector<stepper_trace_t> &events, uint32_t &rate)
+{
+	char magic[4];
+	if (fread(magic, 1, 4, f) != 4 || memcmp(magic, SIM_TRACE_MAGIC, 4)
+			|| fread(&rate, sizeof(rate), 1, f) != 1)
+		return false;
+	stepper_trace_t e;
+	while (fread(&e, sizeof(e), 1, f) == 1)
+		events.push_back(e);
+	return true;
+}
+
+// "trace:" lines of M930 dumps, anywhere in a serial log
+static bool load_text(FILE *f, std::vector<stepper_trace_t> &events, uint32_t &rate)
+{
+	char line[256];
+	bool gap = false;
+	while (fgets(line, sizeof(line), f)) {
+		char *p = strstr(line, "trace:");
+		if (!p) continue;
+		p += 6;
+		unsigned long n, lost, hz;
+		if (sscanf(p, "begin %lu %lu %lu", &n, &lost, &hz) == 3) {
+			rate = hz;
+			// dumps are separate recordings
+			gap = !events.empty() || lost;
+			continue;
+		}
+		stepper_trace_t e;
+		uint8_t *b = (uint8_t *)&e;
+		unsigned i = 0;
+		int hi, lo;
+		while ((hi = hexval(p[0])) >= 0 && (lo = hexval(p[1])) >= 0) {
+			b[i++] = hi << 4 | lo;
+			p += 2;
+			if (i == sizeof(e)) {
+				if (gap) e.flags |= STEPPER_TRACE_LOST;
+				gap = false;
+				events.push_back(e);
+				i = 0;
+			}
+		}
+	}
+	return rate != 0;
+}
+
+static bool load(const char *name, std::vector<stepper_trace_t> &events, uint32_t &rate)
+{
+	FILE *f = fopen(name, "rb");
+	if (!f) return false;
+	const bool loaded = load_binary(f, events, rate) || (rewind(f), load_text(f, events, rate));
+	fclose(f);
+	return loaded;
+}
+
+// 0 if the traces match, 1 and the first difference if not
+static int compare(const std::vector<stepper_trace_t> &ref, uint32_t refRate)
+{
+	if (refRate != rate) {
+		printf("differ       timer %u Hz, reference %u Hz\n", (unsigned)rate, (unsigned)refRate);
+		return 1;
+	}
+	uint64_t ticks = 0;
+	uint32_t bursts = 0, refBursts = 0;
+	const size_t n = min(events.size(), ref.size());
+	for (size_t i = 0; i < n; i++) {
+		const stepper_trace_t &e = events[i], &r = ref[i];
+		// the trace clock is free running, only the time between events counts
+		const bool sameTime = !i || (uint16_t)(e.time - events[i - 1].time) == (uint16_t)(r.time - ref[i - 1].time);
+		if (i) ticks += (uint16_t)(e.time - events[i - 1].time);
+		if (e.flags & STEPPER_TRACE_BURST) bursts++;
+		if (r.flags & STEPPER_TRACE_BURST) refBursts++;
+		if (!sameTime || e.period != r.period || e.steps != r.steps || e.dirs != r.dirs
+				|| (e.flags ^ r.flags) & ~STEPPER_TRACE_BURST) {
+			printf("differ       at event %u, %.6f s\n", (unsigned)i, (double)ticks / rate);
+			printf("  trace      period %5u steps %04x dirs %02x flags %02x\n", e.period, e.steps, e.dirs, e.flags);
+			printf("  reference  period %5u steps %04x dirs %02x flags %02x\n", r.period, r.steps, r.dirs, r.flags);
+			return 1;
+		}
+	}
+	if (events.size() != ref.size()) {
+		printf("differ       %u events, reference %u\n", (unsigned)events.size(), (unsigned)ref.size());
+		return 1;
+	}
+	printf("identical    %u events, %.3f s\n", (unsigned)n, (double)ticks / rate);
+	if (bursts || refBursts)
+		printf("bursts       %u events stepped by DMA, reference %u\n", (unsigned)bursts, (unsigned)refBursts);
+	return 0;
+}
+
+static double axis_velocity(const TraceBlock &b, double eventRate, int axis)
+{
+	if (!b.events) return 0.0;
+	double v = eventRate * b.steps[axis] / b.events / stepsPerMm[axis];
+	return TEST(b.dirs, axis) ? -v : v;
+}
+
+static void print_issues(const std::vector<TraceIssue> &list, int max)
+{
+	for (int i = 0; i < (int)list.size() && i < max; i++) {
+		const TraceIssue &t = list[i];
+		if (t.axis)
+			printf("  at %10.3f s  %-2s changed by %.2f mm/s (limit %.1f)\n", t.time, t.axis, t.value, t.limit);
+		else
+			printf("  at %10.3f s  dry for %.3f s\n", t.time, t.value);
+	}
+	if ((int)list.size() > max)
+		printf("  ...\n");
+}
+
+/* Exported Functions --------------------------------------------------------*/
+
+int main(int argc, char **argv)
+{
+	const char *curves = NULL, *reference = NULL;
+	double width = 0.010, maxGap = 2.0, slack = 1.0;
+	int list = 10;
+	int opt;
+	while ((opt = getopt(argc, argv, "c:w:g:j:n:r:")) != -1) {
+		switch (opt) {
+		case 'c': curves = optarg; break;
+		case 'w': width = atof(optarg) / 1000.0; break;
+		case 'g': maxGap = atof(optarg); break;
+		case 'j': slack = atof(optarg); break;
+		case 'n': list = atoi(optarg); break;
+		case 'r': reference = optarg; break;
+		default: optind = argc; break;
+		}
+	}
+	if (optind != argc - 1 || width <= 0.0) {
+		fprintf(stderr, "usage: %s [-c curves.csv] [-w ms] [-g seconds] [-j mm/s] [-n count] [-r reference] trace\n", argv[0]);
+		return 2;
+	}
+
+	if (!load(argv[optind], events, rate)) {
+		fprintf(stderr, "trace_analyze: no trace in %s\n", argv[optind]);
+		return 2;
+	}
+	if (reference) {
+		std::vector<stepper_trace_t> ref;
+		uint32_t refRate = 0;
+		if (!load(reference, ref, refRate)) {
+			fprintf(stderr, "trace_analyze: no trace in %s\n", reference);
+			return 2;
+		}
+		return compare(ref, refRate);
+	}
+
+	FILE *csv = NULL;
+	if (curves) {
+		csv = fopen(curves, "w");
+		if (!csv) {
+			fprintf(stderr, "trace_analyze: cannot write %s\n", curves);
+			return 2;
+		}
+		fprintf(csv, "time,vA,vB,vC,vE,aA,aB,aC,aE\n");
+	}
+
+	uint64_t ticks = 0;
+	uint32_t lostGaps = 0, blocks = 0, aborted = 0, bursts = 0;
+	uint32_t total[SIM_AXES] = { 0 };
+	double peak[SIM_AXES] = { 0 };
+	double dryStart = -1.0, pauseTime = 0.0, stallTime = 0.0;
+	uint32_t pauses = 0;
+	std::vector<TraceIssue> stalls, jerks;
+
+	TraceBlock cur, prev;
+	bool inBlock = false, havePrev = false;
+
+	// curve sampling: signed steps per axis in the current sample
+	double sampleEnd = width, lastV[SIM_AXES] = { 0 };
+	int32_t sample[SIM_AXES] = { 0 };
+
+	for (size_t i = 0; i < events.size(); i++) {
+		const stepper_trace_t &e = events[i];
+		if (i) ticks += (uint16_t)(e.time - events[i - 1].time);
+		double t = (double)ticks / rate;
+		if (e.flags & STEPPER_TRACE_BURST) bursts++;
+
+		if (e.flags & STEPPER_TRACE_LOST) {
+			// unknown time went by, nothing spans the gap
+			lostGaps++;
+			inBlock = havePrev = false;
+			dryStart = -1.0;
+		}
+
+		while (csv && t >= sampleEnd) {
+			fprintf(csv, "%.4f", sampleEnd - width);
+			double v[SIM_AXES];
+			for (int a = 0; a < SIM_AXES; a++) {
+				v[a] = sample[a] / stepsPerMm[a] / width;
+				fprintf(csv, ",%.3f", v[a]);
+				sample[a] = 0;
+			}
+			for (int a = 0; a < SIM_AXES; a++) {
+				fprintf(csv, ",%.1f", (v[a] - lastV[a]) / width);
+				lastV[a] = v[a];
+			}
+			fputc('\n', csv);
+			sampleEnd += width;
+		}
+
+		if (e.flags & STEPPER_TRACE_IDLE) {
+			if (inBlock || havePrev) {
+				if (dryStart < 0.0) dryStart = t;
+				inBlock = false;
+			}
+			continue;
+		}
+
+		if (e.flags & STEPPER_TRACE_BLOCK || !inBlock) {
+			if (dryStart >= 0.0) {
+				double dry = t - dryStart;
+				if (dry <= maxGap) {
+					TraceIssue s = { dryStart, dry, maxGap, NULL };
+					stalls.push_back(s);
+					stallTime += dry;
+				}
+				else {
+					pauses++;
+					pauseTime += dry;
+				}
+				havePrev = false;
+			}
+			else if (inBlock) {
+				// cut short (quick stop), no junction to check
+				havePrev = false;
+			}
+			dryStart = -1.0;
+			memset(&cur, 0, sizeof(cur));
+			cur.start = t;
+			cur.dirs = e.dirs;
+			cur.entryRate = e.period ? (double)rate / (e.period + 1) : 0.0;
+			inBlock = true;
+			blocks++;
+		}
+
+		cur.events++;
+		for (int a = 0; a < SIM_AXES; a++) {
+			uint8_t n = (e.steps >> (a * 4)) & 0xF;
+			cur.steps[a] += n;
+			total[a] += n;
+			sample[a] += TEST(e.dirs, a) ? -n : n;
+		}
+		cur.exitRate = e.period ? (double)rate / (e.period + 1) : 0.0;
+
+		if (e.flags & STEPPER_TRACE_END) {
+			cur.ended = true;
+			inBlock = false;
+			if (!e.steps) {
+				// killed with steps to go (endstop hit or quick stop)
+				aborted++;
+				havePrev = false;
+				continue;
+			}
+			for (int a = 0; a < SIM_AXES; a++) {
+				double v = fabs(axis_velocity(cur, cur.entryRate, a));
+				NOLESS(peak[a], v);
+				v = fabs(axis_velocity(cur, cur.exitRate, a));
+				NOLESS(peak[a], v);
+			}
+			// the junction into this block, now its step shares are known
+			if (havePrev) {
+				double dv[SIM_AXES];
+				for (int a = 0; a < SIM_AXES; a++)
+					dv[a] = axis_velocity(cur, cur.entryRate, a) - axis_velocity(prev, prev.exitRate, a);
+				const TraceIssue check[] = {
+					{ cur.start, HYPOT(dv[A_AXIS], dv[B_AXIS]), DEFAULT_XYJERK, "AB" },
+					{ cur.start, fabs(dv[C_AXIS]), DEFAULT_ZJERK, "C" },
+					{ cur.start, fabs(dv[E_AXIS]), DEFAULT_EJERK, "E" }
+				};
+				for (unsigned i = 0; i < COUNT(check); i++)
+					if (check[i].value > check[i].limit + slack)
+						jerks.push_back(check[i]);
+			}
+			prev = cur;
+			havePrev = true;
+		}
+	}
+	if (csv) fclose(csv);
+
+	double span = (double)ticks / rate;
+	printf("trace        %u events, %.3f s at %u Hz", (unsigned)events.size(), span, (unsigned)rate);
+	if (lostGaps) printf(", %u gaps", (unsigned)lostGaps);
+	printf("\nblocks       %u (%u cut short)\n", (unsigned)blocks, (unsigned)aborted);
+	printf("steps        A %u  B %u  C %u  E %u\n",
+			(unsigned)total[0], (unsigned)total[1], (unsigned)total[2], (unsigned)total[3]);
+	if (bursts)
+		printf("bursts       %u events stepped by DMA\n", (unsigned)bursts);
+	printf("peak speed   A %.1f  B %.1f  C %.1f  E %.1f mm/s\n", peak[0], peak[1], peak[2], peak[3]);
+	printf("stalls       %u, %.3f s (planner dry <= %.1f s between blocks)\n",
+			(unsigned)stalls.size(), stallTime, maxGap);
+	print_issues(stalls, list);
+	printf("pauses       %u, %.3f s\n", (unsigned)pauses, pauseTime);
+	printf("jerk         %u junctions over the limit\n", (unsigned)jerks.size());
+	print_issues(jerks, list);
+	return 0;
+}
@@ -17,6 +17,9 @@
 #include "usbd_desc.h"
 #include "usbd_cdc.h"
 #include "usbd_cdc_interface.h"
+#ifdef STEP_BURST
+#include "Marlin_export.h"
+#endif
 
 /* Private typedef -----------------------------------------------------------*/
 /* Private define ------------------------------------------------------------*/
@@ -204,6 +207,18 @@ void BSP_DMA_IRQHandler(void)
   HAL_DMA_IRQHandler(&(gBspAdcData.dmaHandle));
 }
 
+#ifdef STEP_BURST
+/**
+* @brief This function handles the step burst DMA interrupts, half of the
+*        step pin words played, the stepper refills that half.
+*/
+void BSP_STEP_BURST_DMA_IRQHandler(void)
+{
+  DMA1->IFCR = BSP_STEP_BURST_DMA_FLAGS;
+  IsrStepBurstHandler();
+}
+#endif
+
 /**
 * @brief This function handles ADC global interrupts.
 */
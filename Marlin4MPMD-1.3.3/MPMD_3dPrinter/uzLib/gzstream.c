@@ -0,0 +1,78 @@
+/**
+  ******************************************************************************
+  * @file    gzstream.c
+  * @brief   Streaming gzip reader on top of uzlib_uncomp
+  * @note    Inflates on demand into a small output buffer, so a compressed
+  *          file can be printed directly without first being expanded to a
+  *          second file on the SD card.
+  ******************************************************************************
+  */
+#include <string.h>
+#include "gzstream.h"
+
+/* uzlib source callback: refill the compressed input buffer */
+static int gzstream_fill(struct uzlib_uncomp *d)
+{
+    struct gzstream *s = (struct gzstream *)d;
+    int count = s->read(s->ctx, s->in, s->in_size);
+    if (count <= 0)
+        return -1;
+    d->source = s->in + 1;
+    d->source_limit = s->in + count;
+    return s->in[0];
+}
+
+int gzstream_open(struct gzstream *s, unsigned char *in, unsigned int in_size,
+                  gzstream_read_cb read, void *ctx)
+{
+    uzlib_init();
+    uzlib_uncompress_init(&s->d, s->dict, sizeof(s->dict));
+    memset(s->dict, 0, sizeof(s->dict));
+    s->read = read;
+    s->ctx = ctx;
+    s->in = in;
+    s->in_size = in_size;
+    s->d.source = in;
+    s->d.source_limit = in;
+    s->d.source_read_cb = gzstream_fill;
+    s->pRead = s->pReadEnd = s->out;
+    s->status = uzlib_gzip_parse_header(&s->d);
+    return s->status;
+}
+
+/*
+ * Copy up to len (at most GZSTREAM_OUT_SIZE) inflated bytes to buf. The
+ * bytes returned by the last call are always contiguous in the output
+ * buffer, so they can be handed back with gzstream_unread().
+ */
+int gzstream_read(struct gzstream *s, unsigned char *buf, unsigned int len)
+{
+    unsigned int avail = s->pReadEnd - s->pRead;
+    if (len > GZSTREAM_OUT_SIZE)
+        len = GZSTREAM_OUT_SIZE;
+    if (avail < len && s->status == TINF_OK) {
+        memmove(s->out, s->pRead, avail);
+        s->d.dest_start = s->out;
+        s->d.dest = s->out + avail;
+        s->d.dest_limit = s->out + GZSTREAM_OUT_SIZE;
+        s->status = uzlib_uncompress_chksum(&s->d);
+        s->pRead = s->out;
+        s->pReadEnd = s->d.dest;
+        avail = s->pReadEnd - s->pRead;
+    }
+    if (len > avail)
+        len = avail;
+    memcpy(buf, s->pRead, len);
+    s->pRead += len;
+    return len;
+}
+
+void gzstream_unread(struct gzstream *s, unsigned int len)
+{
+    s->pRead -= len;
+}
+
+int gzstream_eof(const struct gzstream *s)
+{
+    return s->status != TINF_OK && s->pRead >= s->pReadEnd;
+}
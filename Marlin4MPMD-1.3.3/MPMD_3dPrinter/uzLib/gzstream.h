@@ -0,0 +1,51 @@
+/**
+  ******************************************************************************
+  * @file    gzstream.h
+  * @brief   Header for streaming gzip reader used to print compressed files
+  * @note    The inflater only keeps a GZSTREAM_DICT_SIZE byte history, so
+  *          files must be deflated with a window no larger than that
+  *          (e.g. zlib wbits=9). Longer back references fail with
+  *          TINF_DICT_ERROR.
+  ******************************************************************************
+  */
+#ifndef __GZSTREAM_H
+#define __GZSTREAM_H
+
+#include "uzlib.h"
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* sliding dictionary (deflate window) kept by the inflater */
+#define GZSTREAM_DICT_SIZE 512
+/* inflated bytes buffered for the reader, also the largest single read */
+#define GZSTREAM_OUT_SIZE 128
+
+/* fills buf with up to len compressed bytes, returns count, 0 at EOF, <0 on error */
+typedef int (*gzstream_read_cb)(void *ctx, unsigned char *buf, unsigned int len);
+
+struct gzstream {
+    struct uzlib_uncomp d;  /* must be first, see gzstream_fill() */
+    gzstream_read_cb read;
+    void *ctx;
+    unsigned char *in;      /* compressed input buffer (caller supplied) */
+    unsigned int in_size;
+    int status;             /* TINF_OK while data remains, TINF_DONE at end, <0 on error */
+    unsigned char *pRead;
+    unsigned char *pReadEnd;
+    unsigned char dict[GZSTREAM_DICT_SIZE];
+    unsigned char out[GZSTREAM_OUT_SIZE];
+};
+
+int gzstream_open(struct gzstream *s, unsigned char *in, unsigned int in_size,
+                  gzstream_read_cb read, void *ctx);
+int gzstream_read(struct gzstream *s, unsigned char *buf, unsigned int len);
+void gzstream_unread(struct gzstream *s, unsigned int len);
+int gzstream_eof(const struct gzstream *s);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __GZSTREAM_H */
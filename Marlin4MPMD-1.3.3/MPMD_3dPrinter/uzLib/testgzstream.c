@@ -0,0 +1,136 @@
+/*
+ * testgzstream.c
+ *
+ * Host test for the streaming gzip reader used to print .gcode.gz and
+ * .bgc.gz files. The plain file is deflated with a GZSTREAM_DICT_SIZE
+ * window (or an existing .gz is used), then streamed back through
+ * gzstream in the same chunk sizes as CardReader (512 byte SD reads,
+ * 80 byte binary gcode reads with push back, single byte text reads)
+ * and compared byte for byte with the plain file.
+ *
+ * gcc -o testgzstream testgzstream.c gzstream.c tinflate.c tinfgzip.c \
+ *     crc32.c adler32.c genlz77.c defl_static.c
+ * ./testgzstream ../../SdCardContent/gcodes/stsmall.g [stsmall.g.gz]
+ *
+ * A compatible .gz can be made with python zlib.compressobj(9, zlib.DEFLATED, 16+9),
+ * plain gzip uses a 32K window and fails with TINF_DICT_ERROR.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gzstream.h"
+
+static unsigned char *plain;
+static long plainLen;
+
+static int read_file(void *ctx, unsigned char *buf, unsigned int len)
+{
+    return fread(buf, 1, len, (FILE *)ctx);
+}
+
+static unsigned char *load(const char *name, long *len)
+{
+    FILE *f = fopen(name, "rb");
+    unsigned char *data;
+    if (f == NULL)
+        return NULL;
+    fseek(f, 0, SEEK_END);
+    *len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    data = (unsigned char *)malloc(*len);
+    fread(data, 1, *len, f);
+    fclose(f);
+    return data;
+}
+
+static void put_le32(FILE *f, uint32_t v)
+{
+    fputc(v, f); fputc(v >> 8, f); fputc(v >> 16, f); fputc(v >> 24, f);
+}
+
+/* deflate the plain file with a window the reader can follow */
+static int write_gzip(const char *name)
+{
+    static const unsigned char header[10] = { 0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 4, 3 };
+    struct uzlib_comp comp;
+    FILE *f = fopen(name, "wb");
+    if (f == NULL)
+        return 0;
+    memset(&comp, 0, sizeof(comp));
+    comp.dict_size = GZSTREAM_DICT_SIZE;
+    comp.hash_bits = 12;
+    comp.hash_table = (uzlib_hash_entry_t *)calloc(1 << comp.hash_bits, sizeof(uzlib_hash_entry_t));
+    zlib_start_block(&comp.out);
+    uzlib_compress(&comp, plain, plainLen);
+    zlib_finish_block(&comp.out);
+    fwrite(header, 1, sizeof(header), f);
+    fwrite(comp.out.outbuf, 1, comp.out.outlen, f);
+    put_le32(f, ~uzlib_crc32(plain, plainLen, ~0));
+    put_le32(f, plainLen);
+    fclose(f);
+    free(comp.hash_table);
+    free(comp.out.outbuf);
+    return 1;
+}
+
+/* mode 0: byte reads (text), mode 1: 80 byte reads with push back (binary) */
+static int test_stream(const char *name, int mode)
+{
+    unsigned char in[512];
+    unsigned char buf[80];
+    struct gzstream gz;
+    long pos = 0;
+    int count, pushed = 0;
+    FILE *f = fopen(name, "rb");
+    if (f == NULL || gzstream_open(&gz, in, sizeof(in), read_file, f) != TINF_OK) {
+        printf("Failure opening %s\n", name);
+        return 0;
+    }
+    while (!gzstream_eof(&gz)) {
+        count = gzstream_read(&gz, buf, mode ? sizeof(buf) : 1);
+        if (count == 0)
+            break;
+        if (pos + count > plainLen || memcmp(buf, plain + pos, count) != 0) {
+            printf("Failure at offset %ld\n", pos);
+            fclose(f);
+            return 0;
+        }
+        if (mode && count > 7) {
+            /* hand back a varying tail, like a decoded command shorter than the read */
+            int back = (pos / 7) % (count - 1);
+            gzstream_unread(&gz, back);
+            count -= back;
+            pushed += back;
+        }
+        pos += count;
+    }
+    fclose(f);
+    if (gz.status != TINF_DONE || pos != plainLen) {
+        printf("Failure: status %d, %ld of %ld bytes\n", gz.status, pos, plainLen);
+        return 0;
+    }
+    printf("%s mode %d: %ld bytes match (%d pushed back)\n", name, mode, pos, pushed);
+    return 1;
+}
+
+int main(int argc, char **argv)
+{
+    const char *plainName = argc > 1 ? argv[1] : "../../SdCardContent/gcodes/stsmall.g";
+    const char *gzName = argc > 2 ? argv[2] : "testgzstream.gz";
+    int pass = 1;
+
+    plain = load(plainName, &plainLen);
+    if (plain == NULL) {
+        printf("Can't read %s\n", plainName);
+        return 1;
+    }
+    if (argc <= 2 && !write_gzip(gzName)) {
+        printf("Can't write %s\n", gzName);
+        return 1;
+    }
+    pass &= test_stream(gzName, 0);
+    pass &= test_stream(gzName, 1);
+    printf("%s\n", pass ? "PASS" : "FAIL");
+    free(plain);
+    return pass ? 0 : 1;
+}
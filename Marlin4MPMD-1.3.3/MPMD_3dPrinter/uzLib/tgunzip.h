@@ -14,7 +14,7 @@
 #ifndef __TGUNZIP_H
 #define __TGUNZIP_H
 
-int read_byte(struct uzlib_uncomp *uncomp);
+/* returns TINF_OK (0) on success, <0 on error */
 int decompress_gzip(char *fname_in, char *fname_out);
 
 #endif //
@@ -0,0 +1 @@
+#include "Configuration_STM.h"